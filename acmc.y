@@ -13,10 +13,11 @@ int yyerror(char *msg);
 
 /* Tokens utilizados na gramática */
 %token NUM ID
-%token IF ELSE WHILE RETURN VOID
+%token IF ELSE WHILE RETURN VOID CONST
 %right INT
 %token ERROR ENDFILE
-%token MAIS SUB MULT DIV
+%token MAIS SUB MULT DIV MOD
+%token EBIT OUBIT DESLE DESLD
 %token MENOR MENIG MAIOR MAIIG IGDAD DIFER IGUAL
 %token PV VIR APAR FPAR ACOL FCOL ACHAV FCHAV
 
@@ -62,20 +63,88 @@ var_declaracao: INT identificador PV
               $2->kind.exp = VarK;
               $2->type = intDType;
            }
-          | INT identificador ACOL numero FCOL PV
+          | INT identificador ACOL simples_expressao FCOL PV
            { 
-              // Declaração de vetor (array)
+              // Declaração de vetor (array); um tamanho que não é literal
+              // (constante nomeada ou expressão) é resolvido por foldConstants
               $$ = newExpNode(TypeK); 
               $$->attr.name = "INT";
-              $$->size = $4->attr.val;
+              $$->size = $4->kind.exp == ConstK ? $4->attr.val : 0;
               $$->child[0] = $2;
               $2->kind.exp = VarK;
               $2->type = intDType;
               $$->child[0]->child[0] = $4;
-              $4->kind.exp = ConstK;
+           }
+          | INT identificador IGUAL simples_expressao PV
+           { 
+              // Variável global inicializada: o valor vai para a imagem da
+              // memória de dados
+              $$ = newExpNode(TypeK);
+              $$->attr.name = "INT";
+              $$->size = 1;
+              $$->child[0] = $2;
+              $2->kind.exp = VarK;
+              $2->type = intDType;
+              $$->child[1] = $4;
+           }
+          | INT identificador ACOL simples_expressao FCOL IGUAL ACHAV inicializadores FCHAV PV
+           { 
+              // Vetor global inicializado; posições sem valor ficam com 0
+              $$ = newExpNode(TypeK); 
+              $$->attr.name = "INT";
+              $$->size = $4->kind.exp == ConstK ? $4->attr.val : 0;
+              $$->child[0] = $2;
+              $2->kind.exp = VarK;
+              $2->type = intDType;
+              $$->child[0]->child[0] = $4;
+              $$->child[1] = $8;
+           }
+          | INT identificador ACOL FCOL IGUAL ACHAV inicializadores FCHAV PV
+           { 
+              // Vetor com o tamanho dado pelo número de inicializadores
+              int count = 0;
+              for (YYSTYPE t = $7; t != NULL; t = t->sibling) count++;
+              $$ = newExpNode(TypeK); 
+              $$->attr.name = "INT";
+              $$->size = count;
+              $$->child[0] = $2;
+              $2->kind.exp = VarK;
+              $2->type = intDType;
+              $$->child[0]->child[0] = newExpNode(ConstK);
+              $$->child[0]->child[0]->type = intDType;
+              $$->child[0]->child[0]->attr.val = count;
+              $$->child[1] = $7;
+           }
+          | CONST INT identificador IGUAL simples_expressao PV
+           { 
+              // Constante nomeada: avaliada e substituída por foldConstants,
+              // não ocupa memória
+              $$ = newExpNode(TypeK);
+              $$->attr.name = "CONST";
+              $$->size = 0;
+              $$->child[0] = $3;
+              $3->kind.exp = VarK;
+              $3->type = intDType;
+              $$->child[1] = $5;
            }
           ;
 
+/* Lista de valores iniciais de um vetor, separados por vírgula */
+inicializadores: inicializadores VIR simples_expressao
+           { 
+              // Adiciona valor à lista
+              YYSTYPE t = $1;
+              if (t != NULL){
+                while (t->sibling != NULL)
+                   t = t->sibling;
+                t->sibling = $3;
+                $$ = $1;
+              }
+              else $$ = $3;
+           }
+         | simples_expressao { $$ = $1; }
+         ;
+
 /* Especificador de tipo: INT ou VOID */
 tipo_especificador: INT
            { 
@@ -118,6 +187,28 @@ fun_declaracao: INT identificador APAR params FPAR composto_decl
               $2->child[0] = $4; // Parâmetros
               $2->child[1] = $6; // Corpo da função
            }
+         | INT identificador APAR params FPAR PV
+           {
+              // Protótipo: função definida em outra unidade (acmc -c)
+              $$ = newExpNode(TypeK);
+              $$->attr.name = "INT";
+              $$->child[0] = $2;
+              $2->kind.exp = FuncK;
+              $2->type = intDType;
+              $2->child[0] = $4; // Parâmetros, sem corpo
+              $2->add = 1;       // Marca de protótipo
+           }
+         | VOID identificador APAR params FPAR PV
+           {
+              // Protótipo de função VOID
+              $$ = newExpNode(TypeK);
+              $$->attr.name = "VOID";
+              $$->child[0] = $2;
+              $2->kind.exp = FuncK;
+              $2->type = voidDType;
+              $2->child[0] = $4; // Parâmetros, sem corpo
+              $2->add = 1;       // Marca de protótipo
+           }
          ;
 
 /* Parâmetros: lista de parâmetros ou VOID indicando ausência de parâmetros */
@@ -294,17 +385,41 @@ var: identificador
        }
     ;
 
-/* Expressão simples: com ou sem operador relacional */
-simples_expressao: soma_expressao relacional soma_expressao
-                   { 
-                     // Expressão com operador relacional
-                     $$ = $2;
+/* Expressão simples: '|' entre expressões '&', com a precedência do C */
+simples_expressao: simples_expressao OUBIT e_expressao
+                   {
+                     // Operador '|'
+                     $$ = newExpNode(OpK);
+                     $$->attr.opr = OUBIT;
                      $$->child[0] = $1;
                      $$->child[1] = $3;
                    }
-                 | soma_expressao { $$ = $1; }
+                 | e_expressao { $$ = $1; }
                  ;
 
+/* Expressão '&' entre expressões relacionais */
+e_expressao: e_expressao EBIT relacional_expressao
+             {
+               // Operador '&'
+               $$ = newExpNode(OpK);
+               $$->attr.opr = EBIT;
+               $$->child[0] = $1;
+               $$->child[1] = $3;
+             }
+           | relacional_expressao { $$ = $1; }
+           ;
+
+/* Expressão com ou sem operador relacional */
+relacional_expressao: desloc_expressao relacional desloc_expressao
+                      { 
+                        // Expressão com operador relacional
+                        $$ = $2;
+                        $$->child[0] = $1;
+                        $$->child[1] = $3;
+                      }
+                    | desloc_expressao { $$ = $1; }
+                    ;
+
 /* Operadores relacionais */
 relacional: MENOR
               { 
@@ -344,6 +459,32 @@ relacional: MENOR
               }
            ;
 
+/* Expressão de deslocamento: '<<' e '>>' */
+desloc_expressao: desloc_expressao desloc soma_expressao
+                  {
+                    // Deslocamento de bits
+                    $$ = $2;
+                    $$->child[0] = $1;
+                    $$->child[1] = $3;
+                  }
+                | soma_expressao { $$ = $1; }
+                ;
+
+/* Operadores '<<' e '>>' */
+desloc: DESLE
+         {
+           // Operador '<<'
+           $$ = newExpNode(OpK);
+           $$->attr.opr = DESLE;
+         }
+      | DESLD
+         {
+           // Operador '>>' (lógico, como srl)
+           $$ = newExpNode(OpK);
+           $$->attr.opr = DESLD;
+         }
+      ;
+
 /* Expressão de soma/subtração */
 soma_expressao: soma_expressao soma termo
                 { 
@@ -370,7 +511,7 @@ soma: MAIS
         }
      ;
 
-/* Expressão de multiplicação/divisão */
+/* Expressão de multiplicação/divisão/resto */
 termo: termo mult fator
          { 
            // Operação de multiplicação ou divisão
@@ -381,7 +522,7 @@ termo: termo mult fator
        | fator { $$ = $1; }
        ;
 
-/* Operadores '*' e '/' */
+/* Operadores '*', '/' e '%' */
 mult: MULT
        { 
          // Operador '*'
@@ -394,6 +535,12 @@ mult: MULT
           $$ = newExpNode(OpK);
           $$->attr.opr = DIV;
         }
+     | MOD
+        {
+          // Operador '%'
+          $$ = newExpNode(OpK);
+          $$->attr.opr = MOD;
+        }
      ;
 
 /* Fatores: expressões entre parênteses, variável, chamada de função ou número */
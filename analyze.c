@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <limits.h>
 #include "globals.h"
 #include "symtab.h"
 #include "analyze.h"
@@ -131,6 +132,282 @@ static void insertNode(TreeNode *t) {
   }
 }
 
+/**************************************************/
+/* Constantes nomeadas: const int N = <expr>;      */
+/**************************************************/
+
+// Número máximo de nomes visíveis ao mesmo tempo durante a substituição
+#define MAXVISIBLE 1024
+
+// Nomes visíveis: constantes com seu valor e as variáveis/parâmetros que as
+// escondem. Globais ficam no fundo da pilha; os de cada função são
+// desempilhados ao fim do corpo (blocos internos não abrem escopo na árvore)
+static struct {
+  char *name;
+  int isConst;
+  int value;
+} visible[MAXVISIBLE];
+static int visibleCount = 0;
+static int scopeStart = 0;
+static int inFunction = 0;
+
+// Procura o nome do topo para o fundo; só devolve 1 se a declaração mais
+// próxima for uma constante
+static int lookupConst(char *name, int *value) {
+  for (int i = visibleCount - 1; i >= 0; i--) {
+    if (strcmp(visible[i].name, name) == 0) {
+      if (!visible[i].isConst) return 0;
+      *value = visible[i].value;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void declareName(char *name, int isConst, int value, int lineno) {
+  // Nenhum nome se repete no mesmo escopo, seja a constante a primeira
+  // declaração ou a segunda
+  for (int i = scopeStart; i < visibleCount; i++) {
+    if (strcmp(visible[i].name, name) == 0) {
+      fprintf(listing, "ERRO SEMÂNTICO: Múltiplas declarações de '%s'. LINHA: %d\n", name, lineno);
+      Error = TRUE;
+      return;
+    }
+  }
+  if (visibleCount == MAXVISIBLE) {
+    fprintf(listing, "ERRO SEMÂNTICO: Identificadores demais no escopo de '%s'. LINHA: %d\n", name, lineno);
+    Error = TRUE;
+    return;
+  }
+  visible[visibleCount].name = name;
+  visible[visibleCount].isConst = isConst;
+  visible[visibleCount].value = value;
+  visibleCount++;
+}
+
+// Transforma o nó, no lugar, na constante 'value'
+static void makeConst(TreeNode *t, int value) {
+  t->kind.exp = ConstK;
+  t->type = intDType;
+  t->attr.val = value;
+  for (int i = 0; i < MAXCHILDREN; i++) t->child[i] = NULL;
+}
+
+/*
+Avalia 'a op b' com a aritmética de 32 bits do processador. Devolve 0 quando
+a operação não pode ser dobrada: divisão por zero e deslocamento fora de 0 a
+31 ficam para o código (e para o erro de checkNode).
+*/
+static int foldOp(TokenType op, int a, int b, int *result) {
+  unsigned int ua = (unsigned int)a, ub = (unsigned int)b;
+  switch (op) {
+    case MAIS: *result = (int)(ua + ub); break;
+    case SUB: *result = (int)(ua - ub); break;
+    case MULT: *result = (int)(ua * ub); break;
+    case DIV:
+    case MOD:
+      if (b == 0 || (a == INT_MIN && b == -1)) return 0;
+      *result = op == DIV ? a / b : a % b;
+      break;
+    case EBIT: *result = a & b; break;
+    case OUBIT: *result = a | b; break;
+    case DESLE:
+    case DESLD:
+      if (b < 0 || b > 31) return 0;
+      *result = (int)(op == DESLE ? ua << b : ua >> b);
+      break;
+    case MENOR: *result = a < b; break;
+    case MENIG: *result = a <= b; break;
+    case MAIOR: *result = a > b; break;
+    case MAIIG: *result = a >= b; break;
+    case IGDAD: *result = a == b; break;
+    case DIFER: *result = a != b; break;
+    default: return 0;
+  }
+  return 1;
+}
+
+static TreeNode *foldList(TreeNode *list);
+static void foldNode(TreeNode *t);
+
+/*
+Valores iniciais (int x = 5; int v[3] = {1, 2, 3};): só em variáveis
+globais, que têm endereço fixo e vão para a imagem da memória de dados, e
+só com expressões constantes.
+*/
+static void checkInitializers(TreeNode *t) {
+  char *name = t->child[0]->attr.name;
+  if (inFunction) {
+    fprintf(listing, "ERRO SEMÂNTICO: Inicializador de '%s' fora do escopo global. LINHA: %d\n", name, t->lineno);
+    Error = TRUE;
+    return;
+  }
+  int count = 0;
+  for (TreeNode *value = t->child[1]; value != NULL; value = value->sibling) {
+    foldNode(value);
+    if (value->kind.exp != ConstK) {
+      fprintf(listing, "ERRO SEMÂNTICO: Inicializador de '%s' não é constante. LINHA: %d\n", name, t->lineno);
+      Error = TRUE;
+    }
+    count++;
+  }
+  if (t->child[0]->child[0] != NULL && t->size > 0 && count > t->size) {
+    fprintf(listing, "ERRO SEMÂNTICO: Inicializadores demais para o vetor '%s'. LINHA: %d\n", name, t->lineno);
+    Error = TRUE;
+  }
+}
+
+// Substitui constantes nomeadas e dobra operações de um único nó (e filhos)
+static void foldNode(TreeNode *t) {
+  int value;
+  if (t == NULL) return;
+
+  if (t->nodekind == StmtK) {
+    switch (t->kind.stmt) {
+      case AssignK:
+        if (lookupConst(t->child[0]->attr.name, &value)) {
+          fprintf(listing, "ERRO SEMÂNTICO: Atribuição à constante '%s'. LINHA: %d\n", t->child[0]->attr.name, t->lineno);
+          Error = TRUE;
+        }
+        foldNode(t->child[0]->child[0]);
+        foldNode(t->child[1]);
+        break;
+      case IfK:
+      case WhileK:
+        foldNode(t->child[0]);
+        t->child[1] = foldList(t->child[1]);
+        t->child[2] = foldList(t->child[2]);
+        break;
+      case ReturnK:
+        foldNode(t->child[0]);
+        break;
+      default:
+        break;
+    }
+    return;
+  }
+
+  switch (t->kind.exp) {
+    case IdK:
+    case VarK:
+      if (lookupConst(t->attr.name, &value)) {
+        if (t->child[0] != NULL) {
+          fprintf(listing, "ERRO SEMÂNTICO: Constante '%s' usada como vetor. LINHA: %d\n", t->attr.name, t->lineno);
+          Error = TRUE;
+        } else {
+          makeConst(t, value);
+        }
+      } else {
+        foldNode(t->child[0]);
+      }
+      break;
+    case CallK:
+      for (TreeNode *arg = t->child[0]; arg != NULL; arg = arg->sibling) foldNode(arg);
+      break;
+    case OpK:
+      foldNode(t->child[0]);
+      foldNode(t->child[1]);
+      if (t->child[0]->kind.exp == ConstK && t->child[1]->kind.exp == ConstK &&
+          foldOp(t->attr.opr, t->child[0]->attr.val, t->child[1]->attr.val, &value)) {
+        makeConst(t, value);
+      }
+      break;
+    case TypeK:
+      if (t->child[0] == NULL) break;
+      if (t->child[0]->kind.exp == VarK) {
+        // Tamanho de vetor: literal, constante nomeada ou expressão constante
+        TreeNode *size = t->child[0]->child[0];
+        if (size != NULL) {
+          foldNode(size);
+          if (size->kind.exp != ConstK || size->attr.val <= 0) {
+            fprintf(listing, "ERRO SEMÂNTICO: Tamanho do vetor '%s' não é uma constante positiva. LINHA: %d\n", t->child[0]->attr.name, t->lineno);
+            Error = TRUE;
+          } else {
+            t->size = size->attr.val;
+          }
+        }
+        if (t->child[1] != NULL) checkInitializers(t);
+        declareName(t->child[0]->attr.name, 0, 0, t->lineno);
+      } else if (t->child[0]->kind.exp == FuncK) {
+        int mark = visibleCount;
+        scopeStart = visibleCount;
+        inFunction = 1;
+        for (TreeNode *p = t->child[0]->child[0]; p != NULL; p = p->sibling) {
+          if (p->child[0] != NULL && p->child[0]->kind.exp == ParamK) {
+            declareName(p->child[0]->attr.name, 0, 0, p->lineno);
+          }
+        }
+        t->child[0]->child[1] = foldList(t->child[0]->child[1]);
+        visibleCount = mark;
+        scopeStart = 0;
+        inFunction = 0;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// Percorre uma lista de irmãos; declarações const são avaliadas e retiradas
+static TreeNode *foldList(TreeNode *list) {
+  TreeNode *head = NULL;
+  TreeNode **link = &head;
+  TreeNode *t = list;
+  while (t != NULL) {
+    TreeNode *next = t->sibling;
+    if (t->nodekind == ExpK && t->kind.exp == TypeK && strcmp(t->attr.name, "CONST") == 0) {
+      foldNode(t->child[1]);
+      if (t->child[1]->kind.exp != ConstK) {
+        fprintf(listing, "ERRO SEMÂNTICO: Valor da constante '%s' não é conhecido em tempo de compilação. LINHA: %d\n", t->child[0]->attr.name, t->lineno);
+        Error = TRUE;
+      } else {
+        declareName(t->child[0]->attr.name, 1, t->child[1]->attr.val, t->lineno);
+      }
+    } else {
+      foldNode(t);
+      *link = t;
+      link = &t->sibling;
+    }
+    t = next;
+  }
+  *link = NULL;
+  return head;
+}
+
+/*
+Avalia as declarações const, substitui cada uso pelo valor e dobra as
+operações entre constantes. Deve rodar antes de build_symbol_table: as
+constantes saem da árvore e não ocupam memória, e o restante do compilador
+só vê literais (imediatos, tamanhos de vetor, desvios resolvidos).
+*/
+TreeNode *foldConstants(TreeNode *syntax_tree) {
+  visibleCount = 0;
+  scopeStart = 0;
+  inFunction = 0;
+  return foldList(syntax_tree);
+}
+
+/*
+Sem -c não há ligação posterior: todo protótipo precisa da definição da
+função na própria unidade, senão a chamada desviaria para um rótulo que
+não existe.
+*/
+static void checkPrototypes(TreeNode *syntax_tree) {
+  for (TreeNode *t = syntax_tree; t != NULL; t = t->sibling) {
+    TreeNode *proto = t->child[0];
+    if (t->nodekind != ExpK || t->kind.exp != TypeK || proto == NULL || proto->kind.exp != FuncK || proto->add != 1) continue;
+    TreeNode *d = syntax_tree;
+    while (d != NULL && !(d->child[0] != NULL && d->child[0]->kind.exp == FuncK && d->child[0]->add != 1 &&
+                          strcmp(d->child[0]->attr.name, proto->attr.name) == 0)) {
+      d = d->sibling;
+    }
+    if (d == NULL) {
+      fprintf(listing, "ERRO SEMÂNTICO: Função '%s' declarada sem definição (use -c para ligar com acmc-ld). LINHA: %d\n", proto->attr.name, proto->lineno);
+      Error = TRUE;
+    }
+  }
+}
+
 /*
 Constrói a tabela de símbolos a partir da árvore sintática.
 Insere funções pré-definidas, percorre a árvore para inserir nós, realiza a verificação de tipos
@@ -147,8 +424,12 @@ void build_symbol_table(TreeNode *syntax_tree) {
   // Realiza a verificação de tipos na árvore
   typeCheck(syntax_tree);
 
-  // Verifica a existência da função main (ou similar)
-  findMain();
+  // Verifica a existência da função main (ou similar); com -c a unidade
+  // pode ser só uma biblioteca
+  if (!CompileOnly) {
+    findMain();
+    checkPrototypes(syntax_tree);
+  }
 
   // Se não houver erros, imprime a tabela de símbolos
   if (!Error) {
@@ -176,6 +457,11 @@ void checkNode(TreeNode *t) {
           if (((t->child[0]->kind.exp == CallK) &&( getFunType(t->child[0]->attr.name)) == voidDType) || ((t->child[1]->kind.exp == CallK) && (getFunType(t->child[1]->attr.name) == voidDType))) {
             typeError(t->child[0], "Operando com função VOID");
           }
+          // Deslocamento constante precisa caber no campo SHAMT (0 a 31)
+          if ((t->attr.opr == DESLE || t->attr.opr == DESLD) && t->child[1]->kind.exp == ConstK &&
+              (t->child[1]->attr.val < 0 || t->child[1]->attr.val > 31)) {
+            typeError(t->child[1], "Deslocamento fora do intervalo 0 a 31");
+          }
           break;
         default:
           break;
@@ -1,6 +1,10 @@
 #ifndef _ANALYZE_H_
 #define _ANALYZE_H_
 
+// Avalia as constantes nomeadas (const int N = ...;), substitui seus usos e
+// dobra operações entre constantes; devolve a árvore sem as declarações const
+TreeNode *foldConstants(TreeNode *);
+
 // Constrói a tabela de símbolos através de uma travessia em pré-ordem na árvore sintática
 void build_symbol_table(TreeNode *);
 
@@ -12,6 +12,8 @@
  */
 
 #include "assembly.h"
+#include "line_table.h"
+#include "code_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -29,6 +31,28 @@ static struct {
 } pending_allocas[MAX_PENDING_ALLOCAS];
 static int pending_alloca_count = 0;
 
+// Global variables of the unit (GLOBAL/GLOBAL_ARRAY). Their data addresses
+// are assigned by binary_generator.c, or by acmc-ld for a -c object, so the
+// code refers to them by name: "lw r4 r0 g", "lw r4 r5 vet" (vet[r5])
+#define MAX_GLOBALS 128
+static struct {
+    char name[64];
+    int size;              // 0 for a simple variable
+} globals[MAX_GLOBALS];
+static int global_count = 0;
+
+static int findGlobal(const char *name) {
+    for (int i = 0; i < global_count; i++) {
+        if (strcmp(globals[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// Blocks instrumented by the last generateAssemblyFromIRImproved call
+static BlockInfo block_map[MAX_BLOCK_COUNTERS];
+static int block_map_count = 0;
+static int function_block_count = 0;
+
 // Remove the typedef struct VarOffsetEntry definition, since it is now in assembly.h
 
 // Processor instruction information based on instrucoes_processador.md
@@ -36,53 +60,63 @@ typedef struct {
     char mnemonic[16];
     int opcode;
     int format; // 0=R-type, 1=I-type, 2=J-type
+    int cycles; // Worst-case cost, for --stats and --wcet
 } ProcessorInstruction;
 
-// Instruction set from processor specification
+// Instruction set from processor specification. The costs are the worst
+// case in the pipeline of acmc-sim --pipeline with its defaults: 1 cycle
+// per instruction, plus a load-use bubble after lw, the 2-cycle flush of a
+// taken branch or jr/jalr, 1 for j/jal, and the MULT/DIV unit (4 and 16
+// cycles). Memory never stalls.
 static ProcessorInstruction proc_instructions[] = {
-    {"add",        0x00, 0}, // 000000 - ADD RD, RS, RT
-    {"sub",        0x01, 0}, // 000001 - SUB RD, RS, RT  
-    {"mult",       0x02, 0}, // 000010 - MULT RS, RT (result in HI:LO, 32bit results in LO. ULA: result_64[63:32] = hilo[63:32];result_64[31:0] = hilo[31:0];)
-    {"div",        0x03, 0}, // 000011 - DIV RS, RT (quotient in LO, remainder in HI)
-    {"and",        0x04, 0}, // 000100 - AND RD, RS, RT
-    {"or",         0x05, 0}, // 000101 - OR RD, RS, RT
-    {"sll",        0x06, 0}, // 000110 - SLL RD, RS, SHAMT
-    {"srl",        0x07, 0}, // 000111 - SRL RD, RS, SHAMT
-    {"slt",        0x08, 0}, // 001000 - SLT RD, RS, RT
-    {"mfhi",       0x09, 0}, // 001001 - MFHI RD
-    {"mflo",       0x0A, 0}, // 001010 - MFLO RD
-    {"move",       0x0B, 0}, // 001011 - MOVE RD, RS
-    {"jr",         0x0C, 0}, // 001100 - JR RS
-    {"jalr",       0x0D, 0}, // 001101 - JALR RS
-    {"la",         0x0E, 1}, // 001110 - LA RT, ADDRESS
-    {"addi",       0x0F, 1}, // 001111 - ADDI RT, RS, IMMEDIATE
-    {"subi",       0x10, 1}, // 010000 - SUBI RT, RS, IMMEDIATE
-    {"andi",       0x11, 1}, // 010001 - ANDI RT, RS, IMMEDIATE
-    {"ori",        0x12, 1}, // 010010 - ORI RT, RS, IMMEDIATE
-    {"beq",        0x13, 1}, // 010011 - BEQ RS, RT, ADDRESS
-    {"bne",        0x14, 1}, // 010100 - BNE RS, RT, ADDRESS
-    {"bgt",        0x15, 1}, // 010101 - BGT RS, RT, ADDRESS
-    {"bgte",       0x16, 1}, // 010110 - BGTE RS, RT, ADDRESS
-    {"blt",        0x17, 1}, // 010111 - BLT RS, RT, ADDRESS
-    {"blte",       0x18, 1}, // 011000 - BLTE RS, RT, ADDRESS
-    {"set",        0x23, 0}, // 100011 - SET RD, RS, RT
-    {"lw",         0x19, 1}, // 011001 - LW RT, OFFSET(RS)
-    {"sw",         0x1A, 1}, // 011010 - SW RT, OFFSET(RS)
-    {"li",         0x1B, 1}, // 011011 - LI RT, IMMEDIATE
-    {"j",          0x1C, 2}, // 011100 - J ADDRESS
-    {"jal",        0x1D, 2}, // 011101 - JAL ADDRESS
-    {"halt",       0x1E, 0}, // 011110 - HALT
-    {"outputmem",  0x1F, 1}, // 011111 - OUTPUTMEM RS, ADDRESS
-    {"outputreg",  0x20, 0}, // 100000 - OUTPUTREG RS
-    {"outputreset",0x21, 0}, // 100001 - OUTPUT RESET
-    {"input",      0x22, 0}, // 100010 - INPUT RD
+    {"add",        0x00, 0, 1}, // 000000 - ADD RD, RS, RT
+    {"sub",        0x01, 0, 1}, // 000001 - SUB RD, RS, RT  
+    {"mult",       0x02, 0, 4}, // 000010 - MULT RS, RT (result in HI:LO, 32bit results in LO. ULA: result_64[63:32] = hilo[63:32];result_64[31:0] = hilo[31:0];)
+    {"div",        0x03, 0, 16}, // 000011 - DIV RS, RT (quotient in LO, remainder in HI)
+    {"and",        0x04, 0, 1}, // 000100 - AND RD, RS, RT
+    {"or",         0x05, 0, 1}, // 000101 - OR RD, RS, RT
+    {"sll",        0x06, 0, 1}, // 000110 - SLL RD, RS, SHAMT
+    {"srl",        0x07, 0, 1}, // 000111 - SRL RD, RS, SHAMT
+    {"slt",        0x08, 0, 1}, // 001000 - SLT RD, RS, RT
+    {"mfhi",       0x09, 0, 1}, // 001001 - MFHI RD
+    {"mflo",       0x0A, 0, 1}, // 001010 - MFLO RD
+    {"move",       0x0B, 0, 1}, // 001011 - MOVE RD, RS
+    {"jr",         0x0C, 0, 3}, // 001100 - JR RS
+    {"jalr",       0x0D, 0, 3}, // 001101 - JALR RS
+    {"la",         0x0E, 1, 1}, // 001110 - LA RT, ADDRESS
+    {"addi",       0x0F, 1, 1}, // 001111 - ADDI RT, RS, IMMEDIATE
+    {"subi",       0x10, 1, 1}, // 010000 - SUBI RT, RS, IMMEDIATE
+    {"andi",       0x11, 1, 1}, // 010001 - ANDI RT, RS, IMMEDIATE
+    {"ori",        0x12, 1, 1}, // 010010 - ORI RT, RS, IMMEDIATE
+    {"beq",        0x13, 1, 3}, // 010011 - BEQ RS, RT, ADDRESS
+    {"bne",        0x14, 1, 3}, // 010100 - BNE RS, RT, ADDRESS
+    {"bgt",        0x15, 1, 3}, // 010101 - BGT RS, RT, ADDRESS
+    {"bgte",       0x16, 1, 3}, // 010110 - BGTE RS, RT, ADDRESS
+    {"blt",        0x17, 1, 3}, // 010111 - BLT RS, RT, ADDRESS
+    {"blte",       0x18, 1, 3}, // 011000 - BLTE RS, RT, ADDRESS
+    {"set",        0x23, 0, 1}, // 100011 - SET RD, RS, RT
+    {"lw",         0x19, 1, 2}, // 011001 - LW RT, OFFSET(RS)
+    {"sw",         0x1A, 1, 1}, // 011010 - SW RT, OFFSET(RS)
+    {"li",         0x1B, 1, 1}, // 011011 - LI RT, IMMEDIATE
+    {"j",          0x1C, 2, 2}, // 011100 - J ADDRESS
+    {"jal",        0x1D, 2, 2}, // 011101 - JAL ADDRESS
+    {"halt",       0x1E, 0, 1}, // 011110 - HALT
+    {"outputmem",  0x1F, 1, 1}, // 011111 - OUTPUTMEM RS, ADDRESS
+    {"outputreg",  0x20, 0, 1}, // 100000 - OUTPUTREG RS
+    {"outputreset",0x21, 0, 1}, // 100001 - OUTPUT RESET
+    {"input",      0x22, 0, 1}, // 100010 - INPUT RD
+    {"swi",        0x24, 1, 1}, // 100100 - SWI RT, OFFSET(RS) (instruction memory)
 };
 
 // Initialize register mapping system
 void initializeContext(AssemblyContext *ctx, FILE *output) {
     ctx->output = output;
     ctx->instruction_count = 1;
-    ctx->next_temp_reg = 4;  // Start after parameter registers
+    ctx->ir_line = 0;
+    ctx->instrument_blocks = InstrumentBlocks;
+    ctx->block_pending = false;
+    ctx->block_names[0] = '\0';
+    ctx->block_count = 0;
     ctx->current_function[0] = '\0';
     ctx->label_counter = 0;
     ctx->param_counter = 0;  // Initialize parameter counter
@@ -108,6 +142,22 @@ void initializeContext(AssemblyContext *ctx, FILE *output) {
 // Handles IR generation inconsistencies while maintaining generic architecture
 //
 
+// Registers never handed to variables or temporaries: zero, the
+// parameters r1-r3, the return value r28, r29, the stack r30, the return
+// address r31, the scratch r57-r61 (constants, shifts, comparisons, block
+// counters) and LO/HI
+static int isReservedRegister(int reg) {
+    return reg <= 3 || (reg >= 28 && reg <= 31) || reg >= 57;
+}
+
+// True if a live mapping holds the register
+static int registerInUse(AssemblyContext *ctx, int reg) {
+    for (int i = 0; i < 128; i++) {
+        if (ctx->reg_map[i].valid && ctx->reg_map[i].phys_reg == reg) return 1;
+    }
+    return 0;
+}
+
 // Enhanced register allocation that handles IR inconsistencies
 int allocateRegister(AssemblyContext *ctx, const char *var_name) {
     // Check if already allocated
@@ -143,31 +193,25 @@ int allocateRegister(AssemblyContext *ctx, const char *var_name) {
         return phys_reg;
     }
     
-    // Local variables and parameters get next available register
-    int phys_reg = ctx->next_temp_reg;
-    
-    // Skip reserved registers (0, 31, 62, 63, 57, 58, 59, 1, 2, 3, 28)
-    while (phys_reg == 0 || phys_reg == 1 || phys_reg == 2 || phys_reg == 3 || phys_reg == 28 ||
-           phys_reg == 31 || phys_reg == 57 || phys_reg == 58 || phys_reg == 59 || phys_reg == 62 || phys_reg == 63) {
-        phys_reg++;
-        // Ensure you don't go past max registers, adjust wrap-around if needed
-        if (phys_reg >= 64) phys_reg = 4; // Wrap around safely to a non-reserved temp start
-    }
-    
-    ctx->next_temp_reg = phys_reg + 1;
-    if (ctx->next_temp_reg >= 57) ctx->next_temp_reg = 4;
-    
-    // Store mapping
-    for (int i = 0; i < 128; i++) {
-        if (!ctx->reg_map[i].valid) {
-            strcpy(ctx->reg_map[i].ir_name, var_name);
-            ctx->reg_map[i].phys_reg = phys_reg;
-            ctx->reg_map[i].valid = 1;
-            return phys_reg;
+    // Local variables and temporaries get the lowest free register in
+    // r4-r56. loadVar drops the old mapping of the temporary it redefines,
+    // so every statement reuses the same few registers however long the
+    // function is; registers already holding outgoing parameters are skipped
+    for (int phys_reg = 4; phys_reg <= 56; phys_reg++) {
+        if (isReservedRegister(phys_reg) || phys_reg <= ctx->param_counter || registerInUse(ctx, phys_reg)) continue;
+        for (int i = 0; i < 128; i++) {
+            if (!ctx->reg_map[i].valid) {
+                strcpy(ctx->reg_map[i].ir_name, var_name);
+                ctx->reg_map[i].phys_reg = phys_reg;
+                ctx->reg_map[i].valid = 1;
+                return phys_reg;
+            }
         }
+        break;
     }
-    
-    return phys_reg;
+
+    printf("Error: No free register for %s in %s\n", var_name, ctx->current_function);
+    return 59;
 }
 
 // Get or allocate memory offset for a variable
@@ -292,7 +336,6 @@ void resetFunctionContext(AssemblyContext *ctx, const char *func_name) {
         }
     }
     
-    ctx->next_temp_reg = 4;  // Reset temporary register allocation
     ctx->param_counter = 0;  // Reset parameter counter for new function
 }
 
@@ -307,14 +350,77 @@ int isImmediate(const char *str) {
     return 1;
 }
 
+// Loads a 32-bit constant: one addi when it fits the signed 14-bit
+// immediate, otherwise the high part shifted left and the low 14 bits ORed
+static void loadConstant(AssemblyContext *ctx, int reg, int32_t val) {
+    if (val >= -8192 && val <= 8191) {
+        emitInstruction(ctx, "addi r%d r0 %d", reg, val);
+        return;
+    }
+    loadConstant(ctx, reg, val >> 14);
+    emitInstruction(ctx, "sll r%d r%d 14", reg, reg);
+    if (val & 0x3FFF) emitInstruction(ctx, "ori r%d r%d %d", reg, reg, val & 0x3FFF);
+}
+
+// Register holding an IR operand; a constant is loaded into 'scratch'
+static int operandRegister(AssemblyContext *ctx, const char *operand, int scratch) {
+    if (!isImmediate(operand)) return allocateRegister(ctx, operand);
+    int32_t val = (int32_t)strtol(operand, NULL, 10);
+    if (val == 0) return 0;
+    loadConstant(ctx, scratch, val);
+    return scratch;
+}
+
+// Counter increment at the start of a basic block (uses scratch r61)
+static void emitBlockCounter(AssemblyContext *ctx) {
+    ctx->block_pending = false;
+    if (ctx->block_count >= MAX_BLOCK_COUNTERS) {
+        if (ctx->block_count++ == MAX_BLOCK_COUNTERS) {
+            printf("Warning: more than %d basic blocks, the rest are not instrumented\n", MAX_BLOCK_COUNTERS);
+        }
+        return;
+    }
+
+    BlockInfo *block = &block_map[block_map_count++];
+    snprintf(block->function, sizeof(block->function), "%s", ctx->current_function);
+    block->index = function_block_count++;
+    if (ctx->block_names[0]) {
+        strcpy(block->names, ctx->block_names);
+    } else {
+        snprintf(block->names, sizeof(block->names), "b%d", block->index);
+    }
+    block->address = ctx->instruction_count;
+    block->ir_line = ctx->ir_line;
+
+    int counter = BLOCK_COUNTER_BASE + ctx->block_count++;
+    emitInstruction(ctx, "lw r61 r0 %d", counter);
+    emitInstruction(ctx, "addi r61 r61 1");
+    emitInstruction(ctx, "sw r61 r0 %d", counter);
+}
+
+// Cost of an instruction (1 if the mnemonic is not in the table)
+int instructionCycles(const char *mnemonic) {
+    for (size_t i = 0; i < sizeof(proc_instructions) / sizeof(proc_instructions[0]); i++) {
+        if (strcmp(proc_instructions[i].mnemonic, mnemonic) == 0) return proc_instructions[i].cycles;
+    }
+    return 1;
+}
+
 // Emit assembly instruction with proper formatting
 void emitInstruction(AssemblyContext *ctx, const char *format, ...) {
+    if (ctx->block_pending) emitBlockCounter(ctx);
+    char text[256];
     va_list args;
     va_start(args, format);
-    fprintf(ctx->output, "%d-", ctx->instruction_count++);
-    vfprintf(ctx->output, format, args);
-    fprintf(ctx->output, "\n");
+    vsnprintf(text, sizeof(text), format, args);
     va_end(args);
+    lineTableAddInstruction(ctx->instruction_count, ctx->ir_line);
+    fprintf(ctx->output, "%d-%s\n", ctx->instruction_count++, text);
+
+    char mnemonic[16];
+    if (text[0] != '#' && sscanf(text, "%15s", mnemonic) == 1) {
+        codeStatsAddInstruction(mnemonic, instructionCycles(mnemonic));
+    }
 }
 
 // Emit label without instruction numbering
@@ -329,6 +435,7 @@ void emitLabel(AssemblyContext *ctx, const char *format, ...) {
 // Emit function label
 void emitFunctionLabel(AssemblyContext *ctx, const char *func_name) {
     fprintf(ctx->output, "Func %s:\n", func_name);
+    codeStatsBeginFunction(func_name);
     resetFunctionContext(ctx, func_name);
 }
 
@@ -399,6 +506,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             seen_real_instruction = false;
             pre_prologue_phase = true;
             fprintf(ctx->output, "Func %s:\n", arg1);
+            codeStatsBeginFunction(arg1);
             resetFunctionContext(ctx, arg1);
             // Flush pending allocas for this function
             for (int i = 0; i < pending_alloca_count; i++) {
@@ -435,6 +543,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             printf("DEBUG: Prologue for %s, stack size = %d\n", current_func_name, current_stack_size);
             emitInstruction(ctx, "addi r30 r30 %d", current_stack_size);
             emitInstruction(ctx, "sw r31 r30 0");
+            codeStatsSetFrame(current_stack_size, ctx->var_offset_map_count);
             // Save r1 and r2 as parameters if the function has at least 1 or 2 parameters
             int param_count = 0;
             for (int i = 0; i < ctx->var_offset_map_count; i++) {
@@ -499,8 +608,13 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             dest_reg = allocateRegister(ctx, arg3);
             printf("DEBUG: loadVar allocated register r%d for %s (param_load=%d)\n", dest_reg, arg3, is_param_load);
             
+            int global = offset < 0 ? findGlobal(arg2) : -1;
             if (offset >= 0) {
                 emitInstruction(ctx, "lw r%d r30 %d", dest_reg, offset);
+            } else if (global >= 0) {
+                // A global array is passed by its address
+                if (globals[global].size > 0) emitInstruction(ctx, "la r%d %s", dest_reg, arg2);
+                else emitInstruction(ctx, "lw r%d r0 %s", dest_reg, arg2);
             } else {
                 emitInstruction(ctx, "lw r%d r30 0", dest_reg);
             }
@@ -519,6 +633,8 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             int src_reg = allocateRegister(ctx, arg1);
             if (offset >= 0) {
                 emitInstruction(ctx, "sw r%d r30 %d", src_reg, offset);
+            } else if (findGlobal(arg2) >= 0) {
+                emitInstruction(ctx, "sw r%d r0 %s", src_reg, arg2);
             } else {
                 emitInstruction(ctx, "sw r%d r30 0", src_reg);
             }
@@ -527,9 +643,13 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             if (!prologue_emitted) {
                 emitInstruction(ctx, "addi r30 r30 %d", current_stack_size);
                 emitInstruction(ctx, "sw r31 r30 0");
+                codeStatsSetFrame(current_stack_size, ctx->var_offset_map_count);
                 prologue_emitted = true;
             }
             if (strcmp(arg1, "main") == 0) {
+                if (ctx->instrument_blocks) {
+                    emitInstruction(ctx, "jal bbdump");   // Counter table goes out before halt
+                }
                 emitInstruction(ctx, "halt");
             } else {
                 emitInstruction(ctx, "lw r31 r30 0");
@@ -552,20 +672,20 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
                     if (immediate_val == 0) {
                         emitInstruction(ctx, "move r1 r0"); // li r1, 0 -> move r1, r0
                     } else {
-                        emitInstruction(ctx, "addi r1 r0 %d", immediate_val); // li r1, immediate
+                        loadConstant(ctx, 1, immediate_val); // li r1, immediate
                     }
                 } else if (ctx->param_counter == 2) {
                     if (immediate_val == 0) {
                         emitInstruction(ctx, "move r2 r0"); // li r2, 0 -> move r2, r0
                     } else {
-                        emitInstruction(ctx, "addi r2 r0 %d", immediate_val); // li r2, immediate
+                        loadConstant(ctx, 2, immediate_val); // li r2, immediate
                     }
                 } else {
                     // For more parameters
                     if (immediate_val == 0) {
                         emitInstruction(ctx, "move r%d r0", ctx->param_counter);
                     } else {
-                        emitInstruction(ctx, "addi r%d r0 %d", ctx->param_counter, immediate_val);
+                        loadConstant(ctx, ctx->param_counter, immediate_val);
                     }
                 }
             } else {
@@ -625,29 +745,29 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             printf("DEBUG: Moved value from %s to %s (r%d <- r%d)\n", arg2, arg1, dest_reg, src_reg);
         } else if (strcmp(op, "add") == 0) {
             // Addition: add src1 src2 dest
-            int src1_reg = allocateRegister(ctx, arg1);
+            int src1_reg = operandRegister(ctx, arg1, 59);
             int dest_reg = allocateRegister(ctx, arg3);
             
-            if (isImmediate(arg2)) {
+            if (isImmediate(arg2) && atoi(arg2) >= -8192 && atoi(arg2) <= 8191) {
                 int val = atoi(arg2);
                 emitInstruction(ctx, "addi r%d r%d %d", dest_reg, src1_reg, val);
             } else {
-                int src2_reg = allocateRegister(ctx, arg2);
+                int src2_reg = operandRegister(ctx, arg2, 58);
                 emitInstruction(ctx, "add r%d r%d r%d", dest_reg, src1_reg, src2_reg);
             }
             
         } else if (strcmp(op, "sub") == 0) {
             // Subtraction: sub src1 src2 dest
-            int src1_reg = allocateRegister(ctx, arg1);
-            int src2_reg = allocateRegister(ctx, arg2);
+            int src1_reg = operandRegister(ctx, arg1, 58);
+            int src2_reg = operandRegister(ctx, arg2, 59);
             int dest_reg = allocateRegister(ctx, arg3);
             
             emitInstruction(ctx, "sub r%d r%d r%d", dest_reg, src1_reg, src2_reg);
             
         } else if (strcmp(op, "mult") == 0) {
             // Multiplication: mult src1 src2 dest
-            int src1_reg = allocateRegister(ctx, arg1);
-            int src2_reg = allocateRegister(ctx, arg2);
+            int src1_reg = operandRegister(ctx, arg1, 58);
+            int src2_reg = operandRegister(ctx, arg2, 59);
             int dest_reg = allocateRegister(ctx, arg3);
             
             emitInstruction(ctx, "mult r%d r%d", src1_reg, src2_reg);
@@ -655,33 +775,106 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             
         } else if (strcmp(op, "div") == 0) {
             // Division: div src1 src2 dest (changed from divisao to div)
-            int src1_reg = allocateRegister(ctx, arg1);
-            int src2_reg = allocateRegister(ctx, arg2);
+            int src1_reg = operandRegister(ctx, arg1, 58);
+            int src2_reg = operandRegister(ctx, arg2, 59);
             int dest_reg = allocateRegister(ctx, arg3);
             
             emitInstruction(ctx, "div r%d r%d", src1_reg, src2_reg);
             emitInstruction(ctx, "mflo r%d", dest_reg);  // Get quotient from LO
             
+        } else if (strcmp(op, "mod") == 0) {
+            // Remainder: mod src1 src2 dest. DIV leaves it in HI. A power-of-two
+            // constant k is andi with k-1; a negative dividend with a nonzero
+            // remainder then gets k subtracted, as C's % keeps its sign
+            int src1_reg = operandRegister(ctx, arg1, 58);
+            int dest_reg = allocateRegister(ctx, arg3);
+            int k = isImmediate(arg2) ? atoi(arg2) : 0;
+
+            if (k > 0 && k <= 8192 && (k & (k - 1)) == 0) {
+                emitInstruction(ctx, "andi r%d r%d %d", dest_reg, src1_reg, k - 1);
+                if (k > 1) {
+                    emitInstruction(ctx, "bgte r%d r0 mod_%d", src1_reg, ctx->label_counter);
+                    emitInstruction(ctx, "beq r%d r0 mod_%d", dest_reg, ctx->label_counter);
+                    emitInstruction(ctx, "addi r%d r%d %d", dest_reg, dest_reg, -k);  // -8192 still fits
+                    emitLabel(ctx, "mod_%d:", ctx->label_counter);
+                    ctx->label_counter++;
+                }
+            } else {
+                int src2_reg = operandRegister(ctx, arg2, 59);
+                emitInstruction(ctx, "div r%d r%d", src1_reg, src2_reg);
+                emitInstruction(ctx, "mfhi r%d", dest_reg);  // Get remainder from HI
+            }
+
+        } else if (strcmp(op, "mfhi") == 0 || strcmp(op, "mflo") == 0) {
+            // mfhi dest ___ ___: remainder/quotient of the previous div, which
+            // had the same operands (codegen only emits it then)
+            int dest_reg = allocateRegister(ctx, arg1);
+            emitInstruction(ctx, "%s r%d", op, dest_reg);
+            
+        } else if (strcmp(op, "and") == 0 || strcmp(op, "or") == 0) {
+            // Bitwise and/or: and src1 src2 dest. Both are commutative, so a
+            // constant on either side becomes the immediate of andi/ori, which
+            // is zero-extended (0 to 16383)
+            const char *src = arg1, *other = arg2;
+            if (isImmediate(arg1) && !isImmediate(arg2)) {
+                src = arg2;
+                other = arg1;
+            }
+            int src_reg = operandRegister(ctx, src, 58);
+            int dest_reg = allocateRegister(ctx, arg3);
+
+            if (isImmediate(other) && atoi(other) >= 0 && atoi(other) <= 16383) {
+                emitInstruction(ctx, "%si r%d r%d %d", op, dest_reg, src_reg, atoi(other));
+            } else {
+                int other_reg = operandRegister(ctx, other, 59);
+                emitInstruction(ctx, "%s r%d r%d r%d", op, dest_reg, src_reg, other_reg);
+            }
+
+        } else if (strcmp(op, "sll") == 0 || strcmp(op, "srl") == 0) {
+            // Shift: sll src amount dest. SLL/SRL take the amount in SHAMT, so
+            // a variable amount is applied in steps of 1, 2, 4, 8 and 16, one
+            // per bit of its low 5 bits (forward branches only)
+            int src_reg = operandRegister(ctx, arg1, 58);
+            int dest_reg = allocateRegister(ctx, arg3);
+
+            if (isImmediate(arg2)) {
+                emitInstruction(ctx, "%s r%d r%d %d", op, dest_reg, src_reg, atoi(arg2) & 31);
+            } else {
+                int amount_reg = allocateRegister(ctx, arg2);
+                if (amount_reg == dest_reg) {
+                    emitInstruction(ctx, "move r57 r%d", amount_reg);
+                    amount_reg = 57;
+                }
+                emitInstruction(ctx, "move r%d r%d", dest_reg, src_reg);
+                for (int step = 1; step < 32; step <<= 1) {
+                    emitInstruction(ctx, "andi r59 r%d %d", amount_reg, step);
+                    emitInstruction(ctx, "beq r59 r0 shift_%d", ctx->label_counter);
+                    emitInstruction(ctx, "%s r%d r%d %d", op, dest_reg, dest_reg, step);
+                    emitLabel(ctx, "shift_%d:", ctx->label_counter);
+                    ctx->label_counter++;
+                }
+            }
+
         } else if (strcmp(op, "slt") == 0) {
             // Set less than: slt src1 src2 dest (dest = src1 < src2)
-            int src1_reg = allocateRegister(ctx, arg1);
-            int src2_reg = allocateRegister(ctx, arg2);
+            int src1_reg = operandRegister(ctx, arg1, 58);
+            int src2_reg = operandRegister(ctx, arg2, 57);
             int dest_reg = allocateRegister(ctx, arg3);
             
             emitInstruction(ctx, "slt r%d r%d r%d", dest_reg, src1_reg, src2_reg);
             
         } else if (strcmp(op, "sgt") == 0) {
             // Set greater than: sgt src1 src2 dest (dest = src1 > src2)
-            int src1_reg = allocateRegister(ctx, arg1);
-            int src2_reg = allocateRegister(ctx, arg2);
+            int src1_reg = operandRegister(ctx, arg1, 58);
+            int src2_reg = operandRegister(ctx, arg2, 57);
             int dest_reg = allocateRegister(ctx, arg3);
             
             emitInstruction(ctx, "slt r%d r%d r%d", dest_reg, src2_reg, src1_reg); // Swap operands
             
         } else if (strcmp(op, "slet") == 0) {
             // Set less than or equal: slet src1 src2 dest (dest = src1 <= src2)
-            int src1_reg = allocateRegister(ctx, arg1);
-            int src2_reg = allocateRegister(ctx, arg2);
+            int src1_reg = operandRegister(ctx, arg1, 58);
+            int src2_reg = operandRegister(ctx, arg2, 57);
             int dest_reg = allocateRegister(ctx, arg3);
             
             emitInstruction(ctx, "slt r59 r%d r%d", src2_reg, src1_reg); // r59 = src2 < src1
@@ -690,8 +883,8 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             
         } else if (strcmp(op, "sget") == 0) {
             // Set greater than or equal: sget src1 src2 dest (dest = src1 >= src2)
-            int src1_reg = allocateRegister(ctx, arg1);
-            int src2_reg = allocateRegister(ctx, arg2);
+            int src1_reg = operandRegister(ctx, arg1, 58);
+            int src2_reg = operandRegister(ctx, arg2, 57);
             int dest_reg = allocateRegister(ctx, arg3);
             
             emitInstruction(ctx, "slt r59 r%d r%d", src1_reg, src2_reg); // r59 = src1 < src2
@@ -738,6 +931,19 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
                 ctx->label_counter++;
             }
             
+        } else if (strcmp(op, "loadVet") == 0 && findGlobal(arg1) >= 0) {
+            // loadVet array _ index dest on a global array: the index register
+            // is the base and the array's address the offset
+            int index_reg = operandRegister(ctx, arg3, 58);
+            int dest_reg = allocateRegister(ctx, arg4);
+            emitInstruction(ctx, "lw r%d r%d %s", dest_reg, index_reg, arg1);
+
+        } else if (strcmp(op, "storeVet") == 0 && findGlobal(arg2) >= 0) {
+            // storeVet src array index scope on a global array
+            int src_reg = operandRegister(ctx, arg1, 59);
+            int index_reg = operandRegister(ctx, arg3, 58);
+            emitInstruction(ctx, "sw r%d r%d %s", src_reg, index_reg, arg2);
+
         } else if (strcmp(op, "loadVet") == 0) {
             // loadVet array_name base_offset index_reg dest_reg (new IR format)
             int dest_reg = allocateRegister(ctx, arg4); // dest_reg is in arg4
@@ -760,9 +966,57 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             emitInstruction(ctx, "add r57 r57 r58");                 // r57 = effective_address = r57 + byte_offset
             emitInstruction(ctx, "sw r%d r57 0", src_reg);           // Store to effective_address
             
-        } else if (strcmp(op, "GLOBAL_ARRAY") == 0) {
-            // Global array declaration
-            emitInstruction(ctx, "# Global array %s[%s]", arg1, arg2);
+        } else if (strcmp(op, "outputVar") == 0 && ctx->in_function) {
+            // outputVar scope var: outputmem reads the word itself, instead of
+            // lw + move r1 + outputreg r1
+            int offset = -1;
+            for (int i = 0; i < ctx->var_offset_map_count; i++) {
+                if (strcmp(ctx->var_offsets[i].name, arg2) == 0 && strcmp(ctx->var_offsets[i].scope, arg1) == 0) {
+                    offset = ctx->var_offsets[i].offset;
+                    break;
+                }
+            }
+            int global = offset < 0 ? findGlobal(arg2) : -1;
+            if (offset >= 0) {
+                emitInstruction(ctx, "outputmem r30 %d", offset);
+            } else if (global >= 0 && globals[global].size > 0) {
+                // The value of an array name is its address, as in loadVar
+                emitInstruction(ctx, "la r59 %s", arg2);
+                emitInstruction(ctx, "outputreg r59");
+            } else if (global >= 0) {
+                emitInstruction(ctx, "outputmem r0 %s", arg2);
+            } else {
+                emitInstruction(ctx, "outputmem r30 0");
+            }
+
+        } else if (strcmp(op, "outputVet") == 0 && findGlobal(arg1) >= 0) {
+            // outputVet array _ index on a global array, addressed as in loadVet
+            int index_reg = operandRegister(ctx, arg3, 58);
+            emitInstruction(ctx, "outputmem r%d %s", index_reg, arg1);
+
+        } else if (strcmp(op, "outputVet") == 0) {
+            // outputVet array base_offset index: the address of the generic loadVet
+            int index_val_reg = operandRegister(ctx, arg3, 58);
+            emitInstruction(ctx, "addi r57 r30 %d", atoi(arg2));
+            emitInstruction(ctx, "sll r58 r%d 2", index_val_reg);
+            emitInstruction(ctx, "add r57 r57 r58");
+            emitInstruction(ctx, "outputmem r57 0");
+
+        } else if (strcmp(op, "GLOBAL_ARRAY") == 0 || strcmp(op, "GLOBAL") == 0) {
+            // Global declaration: no instruction word, the binary generator
+            // reserves the data words
+            int size = op[6] == '_' ? atoi(arg2) : 0;
+            if (findGlobal(arg1) < 0 && global_count < MAX_GLOBALS) {
+                snprintf(globals[global_count].name, sizeof(globals[0].name), "%s", arg1);
+                globals[global_count].size = size;
+                global_count++;
+            }
+            if (size > 0) emitLabel(ctx, "# Global array %s[%d]", arg1, size);
+            else emitLabel(ctx, "# Global %s", arg1);
+
+        } else if (strcmp(op, "GLOBAL_INIT") == 0) {
+            // Initial value of a global word, for the data memory image
+            emitLabel(ctx, "# Data %s %s %s", arg1, arg2, arg3);
             
         } else if (strcmp(op, "li") == 0) {
             // LI RT, IMMEDIATE - convert to addi from r0
@@ -771,7 +1025,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             if (immediate_val == 0) {
                 emitInstruction(ctx, "move r%d r0", rt_reg);
             } else {
-                emitInstruction(ctx, "addi r%d r0 %d", rt_reg, immediate_val);
+                loadConstant(ctx, rt_reg, immediate_val);
             }
         } else if (strcmp(op, "set") == 0) {
         printf("DEBUG: Processing set instruction\n");
@@ -980,7 +1234,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             
         } else if (strcmp(op, "BR_NE") == 0) {
             // Direct branch if not equal: BR_NE src1 src2 label
-            int src1_reg = allocateRegister(ctx, arg1);
+            int src1_reg = operandRegister(ctx, arg1, 59);
             int src2_reg;
             
             if (isImmediate(arg2)) {
@@ -989,7 +1243,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
                 if (val == 0) {
                     emitInstruction(ctx, "bne r%d r0 %s", src1_reg, arg3);
                 } else {
-                    emitInstruction(ctx, "li r58 %d", val);
+                    loadConstant(ctx, 58, val);
                     emitInstruction(ctx, "bne r%d r58 %s", src1_reg, arg3);
                 }
             } else {
@@ -999,7 +1253,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
 
         } else if (strcmp(op, "BR_EQ") == 0) {
             // Direct branch if equal: BR_EQ src1 src2 label
-            int src1_reg = allocateRegister(ctx, arg1);
+            int src1_reg = operandRegister(ctx, arg1, 59);
             int src2_reg;
             
             if (isImmediate(arg2)) {
@@ -1008,7 +1262,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
                 if (val == 0) {
                     emitInstruction(ctx, "beq r%d r0 %s", src1_reg, arg3);
                 } else {
-                    emitInstruction(ctx, "li r58 %d", val);
+                    loadConstant(ctx, 58, val);
                     emitInstruction(ctx, "beq r%d r58 %s", src1_reg, arg3);
                 }
             } else {
@@ -1018,7 +1272,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
 
         } else if (strcmp(op, "BR_GE") == 0) {
             // Direct branch if greater or equal: BR_GE src1 src2 label
-            int src1_reg = allocateRegister(ctx, arg1);
+            int src1_reg = operandRegister(ctx, arg1, 59);
             int src2_reg;
             
             if (isImmediate(arg2)) {
@@ -1026,7 +1280,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
                 if (val == 0) {
                     emitInstruction(ctx, "bgte r%d r0 %s", src1_reg, arg3);
                 } else {
-                    emitInstruction(ctx, "li r58 %d", val);
+                    loadConstant(ctx, 58, val);
                     emitInstruction(ctx, "bgte r%d r58 %s", src1_reg, arg3);
                 }
             } else {
@@ -1036,7 +1290,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             
         } else if (strcmp(op, "BR_LT") == 0) {
             // Direct branch if less than: BR_LT src1 src2 label
-            int src1_reg = allocateRegister(ctx, arg1);
+            int src1_reg = operandRegister(ctx, arg1, 59);
             int src2_reg;
             
             if (isImmediate(arg2)) {
@@ -1044,7 +1298,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
                 if (val == 0) {
                     emitInstruction(ctx, "blt r%d r0 %s", src1_reg, arg3);
                 } else {
-                    emitInstruction(ctx, "li r58 %d", val);
+                    loadConstant(ctx, 58, val);
                     emitInstruction(ctx, "blt r%d r58 %s", src1_reg, arg3);
                 }
             } else {
@@ -1054,7 +1308,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             
         } else if (strcmp(op, "BR_LE") == 0) {
             // Direct branch if less than or equal: BR_LE src1 src2 label
-            int src1_reg = allocateRegister(ctx, arg1);
+            int src1_reg = operandRegister(ctx, arg1, 59);
             int src2_reg;
             
             if (isImmediate(arg2)) {
@@ -1062,7 +1316,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
                 if (val == 0) {
                     emitInstruction(ctx, "blte r%d r0 %s", src1_reg, arg3);
                 } else {
-                    emitInstruction(ctx, "li r58 %d", val);
+                    loadConstant(ctx, 58, val);
                     emitInstruction(ctx, "blte r%d r58 %s", src1_reg, arg3);
                 }
             } else {
@@ -1072,7 +1326,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
             
         } else if (strcmp(op, "BR_GT") == 0) {
             // Direct branch if greater than: BR_GT src1 src2 label
-            int src1_reg = allocateRegister(ctx, arg1);
+            int src1_reg = operandRegister(ctx, arg1, 59);
             int src2_reg;
             
             if (isImmediate(arg2)) {
@@ -1080,7 +1334,7 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
                 if (val == 0) {
                     emitInstruction(ctx, "bgt r%d r0 %s", src1_reg, arg3);
                 } else {
-                    emitInstruction(ctx, "li r58 %d", val);
+                    loadConstant(ctx, 58, val);
                     emitInstruction(ctx, "bgt r%d r58 %s", src1_reg, arg3);
                 }
             } else {
@@ -1174,6 +1428,88 @@ void processIRLine(AssemblyContext *ctx, const char *line) {
     } while (reprocess);
 }
 
+// Basic blocks start at function entries, at labels and after conditional
+// branches (the fallthrough). The counter is emitted with the next real
+// instruction, so consecutive labels share one block; the block is named
+// after all of them, which gives profiles a key that does not depend on
+// the order codegen laid the blocks out in.
+static void markBlockLeader(AssemblyContext *ctx, const char *line) {
+    char op[64], arg1[64];
+    int parsed = sscanf(line, "%63s %63s", op, arg1);
+    if (parsed < 1) return;
+
+    if (strcmp(op, "funInicio") == 0) {
+        function_block_count = 0;
+        if (parsed == 2 && strcmp(arg1, "main") == 0) {
+            emitInstruction(ctx, "jal bbclear");   // Counters start from zero
+        }
+        strcpy(ctx->block_names, "entry");
+        ctx->block_pending = true;
+    } else if (strcmp(op, "label_op") == 0 && parsed == 2) {
+        size_t used = ctx->block_pending ? strlen(ctx->block_names) : 0;
+        if (used + strlen(arg1) + 2 <= sizeof(ctx->block_names)) {
+            snprintf(ctx->block_names + used, sizeof(ctx->block_names) - used, "%s%s",
+                     used ? "," : "", arg1);
+        }
+        ctx->block_pending = true;
+    } else if (strcmp(op, "bne") == 0 || strncmp(op, "BR_", 3) == 0) {
+        ctx->block_names[0] = '\0';
+        ctx->block_pending = true;
+    }
+}
+
+// bbclear zeroes the counters; bbdump outputs the block count followed by
+// one counter per block. Both are emitted after all functions because the
+// number of blocks is only known at the end.
+static void emitBlockCounterRoutines(AssemblyContext *ctx) {
+    int count = ctx->block_count < MAX_BLOCK_COUNTERS ? ctx->block_count : MAX_BLOCK_COUNTERS;
+
+    emitFunctionLabel(ctx, "bbclear");
+    emitInstruction(ctx, "addi r61 r0 %d", count);
+    emitLabel(ctx, "bbclearloop:");
+    emitInstruction(ctx, "beq r61 r0 bbclearend");
+    emitInstruction(ctx, "subi r61 r61 1");
+    emitInstruction(ctx, "sw r0 r61 %d", BLOCK_COUNTER_BASE);
+    emitInstruction(ctx, "j bbclearloop");
+    emitLabel(ctx, "bbclearend:");
+    emitInstruction(ctx, "jr r31");
+
+    emitFunctionLabel(ctx, "bbdump");
+    emitInstruction(ctx, "addi r60 r0 %d", count);
+    emitInstruction(ctx, "outputreg r60");
+    emitInstruction(ctx, "move r61 r0");
+    emitLabel(ctx, "bbdumploop:");
+    emitInstruction(ctx, "beq r61 r60 bbdumpend");
+    emitInstruction(ctx, "outputmem r61 %d", BLOCK_COUNTER_BASE);
+    emitInstruction(ctx, "addi r61 r61 1");
+    emitInstruction(ctx, "j bbdumploop");
+    emitLabel(ctx, "bbdumpend:");
+    emitInstruction(ctx, "jr r31");
+}
+
+int writeBlockMap(const char *blocks_filename, const char *source_filename) {
+    FILE *f = fopen(blocks_filename, "w");
+    if (!f) {
+        printf("Error: Could not create block map %s\n", blocks_filename);
+        return -1;
+    }
+
+    fprintf(f, "# acmc basic-block map for %s\n", source_filename);
+    fprintf(f, "# Counter i lives at data address %d+i; bbdump outputs the count, then the counters\n",
+            BLOCK_COUNTER_BASE);
+    fprintf(f, "blocks %d base %d\n", block_map_count, BLOCK_COUNTER_BASE);
+    fprintf(f, "# id function block names address ir_line source_line\n");
+    for (int i = 0; i < block_map_count; i++) {
+        const BlockInfo *block = &block_map[i];
+        fprintf(f, "%d %s %d %s %d %d %d\n", i, block->function, block->index, block->names,
+                block->address, block->ir_line, lineTableSourceLine(block->ir_line));
+    }
+
+    int failed = ferror(f);
+    fclose(f);
+    return failed ? -1 : 0;
+}
+
 // Main assembly generation function - generic for any C- program
 void generateAssemblyFromIRImproved(const char *ir_file, const char *assembly_file) {
     FILE *ir = fopen(ir_file, "r");
@@ -1192,6 +1528,9 @@ void generateAssemblyFromIRImproved(const char *ir_file, const char *assembly_fi
     // Initialize generic assembly context
     AssemblyContext ctx;
     initializeContext(&ctx, out);
+    global_count = 0;
+    block_map_count = 0;
+    function_block_count = 0;
     
     char line[512];
     
@@ -1215,7 +1554,15 @@ void generateAssemblyFromIRImproved(const char *ir_file, const char *assembly_fi
         char *newline = strchr(line, '\n');
         if (newline) *newline = '\0';
         
+        ctx.ir_line++;
         processIRLine(&ctx, line);
+        if (ctx.instrument_blocks) markBlockLeader(&ctx, line);
+    }
+
+    if (ctx.instrument_blocks) {
+        ctx.ir_line = 0;
+        ctx.block_pending = false;
+        emitBlockCounterRoutines(&ctx);
     }
     
     fclose(temp_out);
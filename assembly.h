@@ -2,6 +2,7 @@
 #define _ASSEMBLY_H_
 
 #include "globals.h"
+#include "memory_map.h"
 #include <stdio.h>
 #include <stdbool.h>
 #define MAX_FUNC_VARS 64
@@ -97,7 +98,7 @@ typedef struct {
     RegisterType rs, rt, rd;
     int immediate;
     char label[MAX_LABEL_LEN];
-    int line_number;
+    int line_number;     // IR line (1-based line of the .ir file) it was generated from
 } AssemblyInstruction;
 
 // Label tracking structure
@@ -148,7 +149,6 @@ typedef struct {
     FILE *output;
     int instruction_count;
     RegisterMapping reg_map[128];  // Support many variables
-    int next_temp_reg;             // Next available temporary register
     char current_function[64];     // Current function name
     int label_counter;             // For generating unique labels
     int param_counter;             // Track parameter order in current function
@@ -156,8 +156,22 @@ typedef struct {
     int var_offset_map_count;
     bool in_function;
     VarOffsetEntry var_offsets[MAX_FUNC_VARS];
+    int ir_line;                   // Line of the .ir file being translated
+    bool instrument_blocks;        // Emit a counter at the start of each basic block
+    bool block_pending;            // Next emitted instruction starts a block
+    char block_names[128];         // Labels starting the pending block ("entry" at a function start)
+    int block_count;               // Counters allocated so far
 } AssemblyContext;
 
+// One instrumented basic block, as written to the .blocks map
+typedef struct {
+    char function[64];
+    int index;           // Block number within the function
+    char names[128];     // Comma-separated labels of the block, "b<index>" if it has none
+    int address;         // Address of the counter's first instruction
+    int ir_line;
+} BlockInfo;
+
 // Main assembly generation functions
 void generateAssemblyFromIRImproved(const char *ir_file, const char *assembly_file);
 void initializeContext(AssemblyContext *ctx, FILE *output);
@@ -171,4 +185,10 @@ void emitInstruction(AssemblyContext *ctx, const char *format, ...);
 void emitLabel(AssemblyContext *ctx, const char *format, ...);
 void emitFunctionLabel(AssemblyContext *ctx, const char *func_name);
 
+// Writes the .blocks map of the last instrumented compilation; returns 0 on success
+int writeBlockMap(const char *blocks_filename, const char *source_filename);
+
+// Worst-case cycles of an instruction, from the opcode table
+int instructionCycles(const char *mnemonic);
+
 #endif
@@ -7,7 +7,7 @@
  * Architecture Analysis from Quartus Project:
  * - 64 registers (R0-R63): R62=LO, R63=HI, R31=return address, R0=zero
  * - 32-bit instructions with 6-bit opcodes
- * - Memory addressing: 14-bit immediate, 6-bit addresses for jumps
+ * - Memory addressing: 14-bit immediate, 14-bit branch targets, 26-bit jump targets
  * - Stack-based function calls with R30 as stack pointer
  */
 
@@ -16,12 +16,14 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdint.h>
+#include "memory_map.h"
+#include "data_image.h"
 
 // Instruction formats from processor specification
 typedef enum {
     FORMAT_R = 0,  // R-type: OPCODE | RS | RT | RD | unused
     FORMAT_I = 1,  // I-type: OPCODE | RS | RT | IMMEDIATE(14-bit)
-    FORMAT_J = 2   // J-type: OPCODE | ADDRESS(6-bit) | unused
+    FORMAT_J = 2   // J-type: OPCODE | ADDRESS(26-bit)
 } InstructionFormat;
 
 // Processor instruction definition
@@ -63,7 +65,7 @@ static ProcessorInstruction instructions[] = {
     {"andi",       0x11, FORMAT_I, "ANDI RT, RS, IMMEDIATE"}, // 010001
     {"ori",        0x12, FORMAT_I, "ORI RT, RS, IMMEDIATE"},  // 010010
     
-    // Branch instructions (I-type with address in [5:0])
+    // Branch instructions (I-type with address in [13:0])
     {"beq",        0x13, FORMAT_I, "BEQ RS, RT, ADDRESS"},   // 010011
     {"bne",        0x14, FORMAT_I, "BNE RS, RT, ADDRESS"},   // 010100
     {"bgt",        0x15, FORMAT_I, "BGT RS, RT, ADDRESS"},   // 010101
@@ -89,18 +91,45 @@ static ProcessorInstruction instructions[] = {
     {"outputreset",0x21, FORMAT_R, "OUTPUT RESET"},          // 100001
     {"input",      0x22, FORMAT_R, "INPUT RD"},              // 100010
     {"set",        0x23, FORMAT_R, "SET RD, RS, RT"},        // 100011
+    
+    // Store into instruction memory (resident bootloader)
+    {"swi",        0x24, FORMAT_I, "SWI RT, OFFSET(RS)"},    // 100100
 };
 
 #define NUM_INSTRUCTIONS (sizeof(instructions) / sizeof(instructions[0]))
 
-// Label storage for address resolution
+// Label storage for address resolution. Local labels (L0, L1, ...) restart
+// in every function, so each label remembers the function it belongs to.
 typedef struct {
     char name[64];
+    char function[64];     // Empty for function entry points
     uint32_t address;
 } Label;
 
-static Label labels[256];
+static Label *labels = NULL;
 static int label_count = 0;
+static int label_capacity = 0;
+static char current_function[64] = "";
+// Labels missing from the file; an object (acmc -c) leaves them to acmc-ld
+static int undefined_labels = 0;
+static int external_labels_allowed = 0;
+
+// Global variables declared in the assembly ("# Global g", "# Global array
+// vet[10]"), placed the way acmc-ld places a single object: downwards from
+// the block counters, in declaration order. "# Data vet 2 4" gives vet[2]
+// the initial value 4 in the data image.
+typedef struct {
+    char name[64];
+    int size;
+    uint32_t address;
+} DataSymbol;
+
+static DataSymbol data_symbols[128];
+static int data_symbol_count = 0;
+static uint32_t data_top = BLOCK_COUNTER_BASE;
+static DataWord *data_words = NULL;
+static int data_word_count = 0;
+static int data_word_capacity = 0;
 
 // Parse register number from string (e.g., "r5" -> 5, "R31" -> 31)
 int parseRegister(const char *reg_str) {
@@ -118,7 +147,13 @@ int parseImmediate(const char *imm_str) {
     printf("DEBUG: parseImmediate called for '%s'\n", imm_str);
     if (!imm_str) return 0;
     
-    // Check if it's a label reference
+    // Check if it's a label reference, preferring the current function's labels
+    for (int i = 0; i < label_count; i++) {
+        if (strcmp(labels[i].name, imm_str) == 0 && strcmp(labels[i].function, current_function) == 0) {
+            printf("DEBUG: Found label '%s' at address %u\n", labels[i].name, labels[i].address);
+            return labels[i].address;
+        }
+    }
     for (int i = 0; i < label_count; i++) {
         if (strcmp(labels[i].name, imm_str) == 0) {
             printf("DEBUG: Found label '%s' at address %u\n", labels[i].name, labels[i].address);
@@ -126,9 +161,20 @@ int parseImmediate(const char *imm_str) {
         }
     }
     
-    // Parse as number
-    printf("DEBUG: Label '%s' NOT FOUND. Attempting atoi. Result: %d\n", imm_str, atoi(imm_str));
-    return atoi(imm_str);
+    // Global variables resolve to their data address
+    for (int i = 0; i < data_symbol_count; i++) {
+        if (strcmp(data_symbols[i].name, imm_str) == 0) return data_symbols[i].address;
+    }
+
+    // Parse as number; anything else is a label nobody defined
+    char *end;
+    long value = strtol(imm_str, &end, 10);
+    if (end != imm_str && *end == '\0') return (int)value;
+    if (!external_labels_allowed) {
+        printf("Error: undefined label '%s' in %s\n", imm_str, current_function[0] ? current_function : "assembly");
+        undefined_labels++;
+    }
+    return 0;
 }
 
 // Find instruction by mnemonic
@@ -159,15 +205,16 @@ uint32_t generateRType(ProcessorInstruction *instr, int rs, int rt, int rd, int
 uint32_t generateIType(ProcessorInstruction *instr, int rs, int rt, int immediate) {
     uint32_t binary = 0;
     
-    // Special handling for branch instructions - address goes in [5:0]
+    // Special handling for branch instructions - address goes in [13:0]
     if (strcmp(instr->mnemonic, "beq") == 0 || strcmp(instr->mnemonic, "bne") == 0 ||
         strcmp(instr->mnemonic, "bgt") == 0 || strcmp(instr->mnemonic, "bgte") == 0 ||
         strcmp(instr->mnemonic, "blt") == 0 || strcmp(instr->mnemonic, "blte") == 0) {
-        // Branch format: [31:26] OPCODE | [25:20] RS | [19:14] RT | [13:6] unused | [5:0] ADDRESS
+        // Branch format: [31:26] OPCODE | [25:20] RS | [19:14] RT | [13:0] ADDRESS
+        // (programs under 64 words encode exactly as with the old [5:0] field)
         binary |= ((uint32_t)instr->opcode & 0x3F) << 26;  // OPCODE [31:26]
         binary |= ((uint32_t)rs & 0x3F) << 20;             // RS [25:20]
         binary |= ((uint32_t)rt & 0x3F) << 14;             // RT [19:14]
-        binary |= ((uint32_t)immediate & 0x3F);            // ADDRESS [5:0]
+        binary |= ((uint32_t)immediate & 0x3FFF);          // ADDRESS [13:0]
     } else {
         // Regular I-type format: [31:26] OPCODE | [25:20] RS | [19:14] RT | [13:0] IMMEDIATE
         binary |= ((uint32_t)instr->opcode & 0x3F) << 26;  // OPCODE [31:26]
@@ -183,10 +230,11 @@ uint32_t generateIType(ProcessorInstruction *instr, int rs, int rt, int immediat
 uint32_t generateJType(ProcessorInstruction *instr, int address) {
     uint32_t binary = 0;
     
-    // Format: [31:26] OPCODE | [25:0] ADDRESS (but spec says [5:0] ADDRESS in low bits)
-    // Following spec: [31:26] OPCODE | [25:6] unused | [5:0] ADDRESS
+    // Format: [31:26] OPCODE | [25:0] ADDRESS
+    // The spec only uses [5:0], which truncates any target above 63; the
+    // full field keeps small programs bit-identical and lets larger ones run
     binary |= ((uint32_t)instr->opcode & 0x3F) << 26;  // OPCODE [31:26]
-    binary |= ((uint32_t)address & 0x3F);              // ADDRESS [5:0]
+    binary |= ((uint32_t)address & 0x3FFFFFF);         // ADDRESS [25:0]
     
     return binary;
 }
@@ -328,7 +376,8 @@ uint32_t parseInstruction(const char *line, uint32_t pc) {
                     rt = parseRegister(tokens[2]);
                     immediate = parseImmediate(tokens[3]);
                 }
-            } else if (strcmp(instr->mnemonic, "lw") == 0 || strcmp(instr->mnemonic, "sw") == 0) {
+            } else if (strcmp(instr->mnemonic, "lw") == 0 || strcmp(instr->mnemonic, "sw") == 0 ||
+                       strcmp(instr->mnemonic, "swi") == 0) {
                 // Format: LW RT, OFFSET(RS) or LW RT RS OFFSET
                 if (token_count >= 4) {
                     rt = parseRegister(tokens[1]);
@@ -367,11 +416,95 @@ uint32_t parseInstruction(const char *line, uint32_t pc) {
     return 0;
 }
 
+// Returns the instruction number of a "N-..." line, or -1 if it is not numbered
+static int lineNumberPrefix(const char *line) {
+    const char *p = line;
+    if (!isdigit((unsigned char)*p)) return -1;
+    while (isdigit((unsigned char)*p)) p++;
+    return *p == '-' ? atoi(line) : -1;
+}
+
+// Tracks "Func name:" lines so labels are resolved within their function
+static void updateCurrentFunction(const char *line) {
+    const char *func_start = strstr(line, "Func ");
+    if (!func_start || !strchr(func_start, ':')) return;
+    func_start += 5; // Skip "Func "
+    while (*func_start == ' ') func_start++;
+    size_t len = strcspn(func_start, ":");
+    if (len >= sizeof(current_function)) len = sizeof(current_function) - 1;
+    memcpy(current_function, func_start, len);
+    current_function[len] = '\0';
+}
+
+static DataSymbol *findDataSymbol(const char *name) {
+    for (int i = 0; i < data_symbol_count; i++) {
+        if (strcmp(data_symbols[i].name, name) == 0) return &data_symbols[i];
+    }
+    return NULL;
+}
+
+// Global declarations and initial values in the comment lines of the assembly
+static void collectData(const char *line) {
+    char name[64];
+    int size = 1, index, value;
+    if (sscanf(line, "# Global array %63[^[][%d]", name, &size) == 2 || sscanf(line, "# Global %63s", name) == 1) {
+        if (findDataSymbol(name) || data_symbol_count == (int)(sizeof(data_symbols) / sizeof(data_symbols[0]))) return;
+        if (size < 1 || (uint32_t)size > data_top) {
+            printf("Error: global variables need more than %d words of data memory\n", BLOCK_COUNTER_BASE);
+            return;
+        }
+        DataSymbol *symbol = &data_symbols[data_symbol_count++];
+        snprintf(symbol->name, sizeof(symbol->name), "%s", name);
+        symbol->size = size;
+        data_top -= size;
+        symbol->address = data_top;
+    } else if (sscanf(line, "# Data %63s %d %d", name, &index, &value) == 3) {
+        DataSymbol *symbol = findDataSymbol(name);
+        if (!symbol || index < 0 || index >= symbol->size) {
+            printf("Error: initial value for %s[%d] outside the variable\n", name, index);
+            return;
+        }
+        if (data_word_count == data_word_capacity) {
+            int capacity = data_word_capacity ? data_word_capacity * 2 : 64;
+            DataWord *grown = realloc(data_words, capacity * sizeof(DataWord));
+            if (!grown) return;
+            data_words = grown;
+            data_word_capacity = capacity;
+        }
+        data_words[data_word_count].address = symbol->address + index;
+        data_words[data_word_count].value = value;
+        data_word_count++;
+    }
+}
+
+// Appends a label, growing the table as needed (the shift_N and mod_N
+// labels of a long function alone run into the hundreds)
+static void addLabel(const char *name, const char *function, uint32_t address) {
+    if (label_count == label_capacity) {
+        int capacity = label_capacity ? label_capacity * 2 : 256;
+        Label *grown = realloc(labels, capacity * sizeof(Label));
+        if (!grown) {
+            printf("Error: out of memory for label %s\n", name);
+            return;
+        }
+        labels = grown;
+        label_capacity = capacity;
+    }
+    Label *label = &labels[label_count++];
+    snprintf(label->name, sizeof(label->name), "%s", name);
+    snprintf(label->function, sizeof(label->function), "%s", function);
+    label->address = address;
+}
+
 // First pass: collect labels
 void collectLabels(FILE *asm_file) {
     char line[512];
-    uint32_t pc = 0;
-    
+    uint32_t pc = 0;   // Address of the next instruction word
+
+    current_function[0] = '\0';
+    data_symbol_count = 0;
+    data_top = BLOCK_COUNTER_BASE;
+    data_word_count = 0;
     while (fgets(line, sizeof(line), asm_file)) {
         // Remove newline
         char *newline = strchr(line, '\n');
@@ -382,63 +515,39 @@ void collectLabels(FILE *asm_file) {
         while (*trimmed_line == ' ' || *trimmed_line == '\t') trimmed_line++;
         if (*trimmed_line == '\0') continue;
         
-        // Check for numbered instructions to track pc properly
-        char *dash = strchr(trimmed_line, '-');
-        if (dash) {
-            // Extract instruction number
-            char *number_end = dash;
-            *number_end = '\0';
-            int instruction_number = atoi(trimmed_line);
-            *number_end = '-'; // Restore the dash
-            
-            char *after_dash = dash + 1;
-            while (*after_dash == ' ' || *after_dash == '\t') after_dash++;
-            
-            // Update pc to match instruction number
-            if (!strstr(after_dash, "Func") && !strstr(after_dash, "CEHOLDER") && 
-                !strchr(after_dash, ':') && after_dash[0] != '#') {
-                pc = instruction_number;
-            }
+        // Numbered lines (including numbered comments) occupy word N
+        int instruction_number = lineNumberPrefix(trimmed_line);
+        if (instruction_number >= 0) {
+            pc = instruction_number + 1;
+            continue;
+        }
+        if (trimmed_line[0] == '#') {
+            collectData(trimmed_line);
+            continue;
         }
         
         // Check for function definitions (e.g., "Func gcd:")
         if (strstr(trimmed_line, "Func ") && strchr(trimmed_line, ':')) {
-            char *func_start = strstr(trimmed_line, "Func ");
-            func_start += 5; // Skip "Func "
-            while (*func_start == ' ') func_start++;
-            
-            char *colon = strchr(func_start, ':');
-            if (colon) {
-                *colon = '\0';
-                strcpy(labels[label_count].name, func_start);
-                labels[label_count].address = pc; // Next instruction will be at this PC
-                label_count++;
-            }
+            updateCurrentFunction(trimmed_line);
+            addLabel(current_function, "", pc); // Next instruction will be at this PC
         }
         
         // Check for label definitions (simple labels like "L0:", "equal_0:", etc.)
-        else if (strchr(trimmed_line, ':') && !strstr(trimmed_line, "Func")) {
+        else if (strchr(trimmed_line, ':')) {
             char *colon = strchr(trimmed_line, ':');
             *colon = '\0';
             
-            // Remove any number prefix (e.g., "10-equal_0:" -> "equal_0")
-            char *dash_in_label = strchr(trimmed_line, '-');
-            char *label_name = dash_in_label ? dash_in_label + 1 : trimmed_line;
-            while (*label_name == ' ' || *label_name == '\t') label_name++;
-            
-            strcpy(labels[label_count].name, label_name);
-            printf("DEBUG: Stored label '%s' at address %u\n", labels[label_count].name, labels[label_count].address);
-            labels[label_count].address = pc + 1; // Points to next instruction after current pc
-            label_count++;
+            addLabel(trimmed_line, current_function, pc);
+            printf("DEBUG: Stored label '%s' at address %u\n", trimmed_line, pc);
         }
         
-        // For non-numbered lines like "j 39", increment pc
-        if (!dash && trimmed_line[0] != '#' && !strstr(trimmed_line, "Func") && 
-            !strstr(trimmed_line, "CEHOLDER") && !strchr(trimmed_line, ':')) {
+        // For non-numbered instructions like "j 39", increment pc
+        else if (trimmed_line[0] != '#' && !strstr(trimmed_line, "CEHOLDER")) {
             pc++;
         }
     }
     
+    current_function[0] = '\0';
     rewind(asm_file);
 }
 
@@ -453,7 +562,8 @@ void printBinaryWithComments(FILE *output, uint32_t binary, uint32_t address, co
     uint8_t rt = (binary >> 14) & 0x3F;
     uint8_t rd = (binary >> 8) & 0x3F;
     uint16_t immediate = binary & 0x3FFF;
-    uint8_t address_field = binary & 0x3F;
+    uint16_t branch_address = binary & 0x3FFF;
+    uint32_t jump_address = binary & 0x3FFFFFF;
     
     fprintf(output, "# OPCODE=%06b", opcode);
     
@@ -466,12 +576,12 @@ void printBinaryWithComments(FILE *output, uint32_t binary, uint32_t address, co
                 fprintf(output, ", RS=R%u, RT=R%u, RD=R%u", rs, rt, rd);
             } else if (instructions[i].format == FORMAT_I) {
                 if (strstr(instructions[i].mnemonic, "b") == instructions[i].mnemonic) {
-                    fprintf(output, ", RS=R%u, RT=R%u, ADDR=%u", rs, rt, address_field);
+                    fprintf(output, ", RS=R%u, RT=R%u, ADDR=%u", rs, rt, branch_address);
                 } else {
                     fprintf(output, ", RS=R%u, RT=R%u, IMM=%u", rs, rt, immediate);
                 }
             } else if (instructions[i].format == FORMAT_J) {
-                fprintf(output, ", ADDR=%u", address_field);
+                fprintf(output, ", ADDR=%u", jump_address);
             }
             break;
         }
@@ -499,18 +609,18 @@ void printBinaryClean(FILE *output, uint32_t binary) {
 }
 
 // Main binary generation function - generates both formats
-void generateBinaryFromAssembly(const char *asm_filename, const char *clean_bin_filename, const char *commented_bin_filename) {
+int generateBinaryFromAssembly(const char *asm_filename, const char *clean_bin_filename, const char *commented_bin_filename) {
     FILE *asm_file = fopen(asm_filename, "r");
     if (!asm_file) {
         printf("Error: Cannot open assembly file %s\n", asm_filename);
-        return;
+        return -1;
     }
     
     FILE *clean_bin_file = fopen(clean_bin_filename, "w");
     if (!clean_bin_file) {
         printf("Error: Cannot create clean binary file %s\n", clean_bin_filename);
         fclose(asm_file);
-        return;
+        return -1;
     }
     
     FILE *commented_bin_file = fopen(commented_bin_filename, "w");
@@ -518,7 +628,7 @@ void generateBinaryFromAssembly(const char *asm_filename, const char *clean_bin_
         printf("Error: Cannot create commented binary file %s\n", commented_bin_filename);
         fclose(asm_file);
         fclose(clean_bin_file);
-        return;
+        return -1;
     }
     
     // Header for commented version
@@ -539,6 +649,8 @@ void generateBinaryFromAssembly(const char *asm_filename, const char *clean_bin_
     // Second pass: generate binary
     char line[512];
     uint32_t pc = 0;
+    undefined_labels = 0;
+    external_labels_allowed = 0;
     
     while (fgets(line, sizeof(line), asm_file)) {
         // Remove newline
@@ -552,6 +664,9 @@ void generateBinaryFromAssembly(const char *asm_filename, const char *clean_bin_
         char original_line[512];
         strcpy(original_line, line);
         
+        // Keep label lookups scoped to the function being encoded
+        updateCurrentFunction(line);
+        
         // Generate binary for instruction
         uint32_t binary = parseInstruction(line, pc);
         
@@ -581,15 +696,170 @@ void generateBinaryFromAssembly(const char *asm_filename, const char *clean_bin_
     fclose(asm_file);
     fclose(clean_bin_file);
     fclose(commented_bin_file);
+
+    // A jump to an undefined label would run whatever sits at address 0
+    if (undefined_labels > 0) {
+        printf("Error: %d reference(s) to undefined labels, no binary generated\n", undefined_labels);
+        remove(clean_bin_filename);
+        remove(commented_bin_filename);
+        return -1;
+    }
     
+    // Initialized globals go to the data image; a stale one is removed
+    char data_filename[300];
+    snprintf(data_filename, sizeof(data_filename), "%s", clean_bin_filename);
+    char *extension = strrchr(data_filename, '.');
+    if (extension && strcmp(extension, ".bin") == 0) *extension = '\0';
+    strncat(data_filename, DATA_IMAGE_SUFFIX, sizeof(data_filename) - strlen(data_filename) - 1);
+    if (data_word_count > 0) {
+        if (dataImageWrite(data_filename, asm_filename, data_words, data_word_count) == 0) {
+            printf("  Data image: %s (%d initialized words)\n", data_filename, data_word_count);
+        }
+    } else {
+        remove(data_filename);
+    }
+
     printf("Binary generation completed:\n");
     printf("  Clean binary: %s\n", clean_bin_filename);
     printf("  Commented binary: %s\n", commented_bin_filename);
     printf("Generated %u binary instructions\n", pc);
+    return 0;
+}
+
+// Looks a label up like parseImmediate (current function first), without
+// falling back to a number; returns 0 if it is defined in this file
+static int findLabelAddress(const char *name, uint32_t *address) {
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < label_count; i++) {
+            if (strcmp(labels[i].name, name) == 0 && (pass == 1 || strcmp(labels[i].function, current_function) == 0)) {
+                *address = labels[i].address;
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+// Operand holding an address: 3 for branches and lw/sw (a global
+// variable), 2 for la and outputmem, 1 for j/jal, 0 if the instruction
+// has none
+static int addressOperand(const char *mnemonic, int *field_bits) {
+    ProcessorInstruction *instr = findInstruction(mnemonic);
+    if (!instr) return 0;
+    if (instr->format == FORMAT_J) {
+        *field_bits = 26;
+        return 1;
+    }
+    *field_bits = 14;
+    if (strcmp(instr->mnemonic, "la") == 0 || strcmp(instr->mnemonic, "outputmem") == 0) return 2;
+    if (strcmp(instr->mnemonic, "lw") == 0 || strcmp(instr->mnemonic, "sw") == 0) return 3;
+    if (instr->format == FORMAT_I && instr->mnemonic[0] == 'b') return 3;
+    return 0;
+}
+
+// Relocatable object (acmc -c, format in linker.c): the numbered words of
+// the assembly without the jump to main, rebased to 0, with the functions
+// the unit defines, its global variables and the address fields acmc-ld
+// patches
+int generateObjectFromAssembly(const char *asm_filename, const char *object_filename, const char *source_filename) {
+    FILE *asm_file = fopen(asm_filename, "r");
+    if (!asm_file) {
+        printf("Error: Cannot open assembly file %s\n", asm_filename);
+        return -1;
+    }
+
+    label_count = 0;
+    collectLabels(asm_file);
+    external_labels_allowed = 1;
+
+    // Code goes to a temporary file while the relocations are collected
+    FILE *code = tmpfile();
+    FILE *relocations = tmpfile();
+    FILE *obj = fopen(object_filename, "w");
+    if (!code || !relocations || !obj) {
+        printf("Error: Cannot create object file %s\n", object_filename);
+        if (code) fclose(code);
+        if (relocations) fclose(relocations);
+        if (obj) fclose(obj);
+        fclose(asm_file);
+        return -1;
+    }
+
+    const char *base = strrchr(source_filename, '/');
+    fprintf(obj, "ACMC-OBJ 1\n");
+    fprintf(obj, "source %s\n", base ? base + 1 : source_filename);
+
+    char line[512];
+    uint32_t words = 0;
+    current_function[0] = '\0';
+    while (fgets(line, sizeof(line), asm_file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        updateCurrentFunction(line);
+
+        // Global variables reserve data words and carry their initial values;
+        // the unnumbered "j <main>" is replaced by the linker's own
+        char name[64];
+        int size, index;
+        const char *comment = strchr(line, '#');
+        if (comment && sscanf(comment, "# Global array %63[^[][%d]", name, &size) == 2) {
+            fprintf(obj, "common %s %d\n", name, size);
+        } else if (comment && sscanf(comment, "# Global %63s", name) == 1) {
+            fprintf(obj, "common %s 1\n", name);
+        } else if (comment && sscanf(comment, "# Data %63s %d %d", name, &index, &size) == 3) {
+            fprintf(obj, "data %s %d %d\n", name, index, size);
+        }
+        int number = lineNumberPrefix(line);
+        if (number < 1) continue;
+
+        uint32_t binary = parseInstruction(line, number);
+        if (binary == 0xFFFFFFFF) continue;
+        uint32_t offset = number - 1;
+
+        char text[256], mnemonic[16] = "", operands[3][64];
+        snprintf(text, sizeof(text), "%s", strchr(line, '-') + 1);
+        int operand_count = sscanf(text, "%15s %63s %63s %63s", mnemonic, operands[0], operands[1], operands[2]) - 1;
+        int field_bits = 0;
+        int operand = text[0] == '#' ? 0 : addressOperand(mnemonic, &field_bits);
+        if (operand > 0 && operand <= operand_count) {
+            const char *target = operands[operand - 1];
+            uint32_t mask = (1u << field_bits) - 1;
+            uint32_t address;
+            if (isdigit((unsigned char)target[0]) || target[0] == '-') {
+                // Absolute address, left as written
+            } else if (findLabelAddress(target, &address) == 0) {
+                binary = (binary & ~mask) | ((address - 1) & mask);
+                fprintf(relocations, "reloc %u %d .text\n", offset, field_bits);
+            } else {
+                binary &= ~mask;
+                fprintf(relocations, "reloc %u %d %s\n", offset, field_bits, target);
+            }
+        }
+
+        for (int i = 31; i >= 0; i--) fputc('0' + ((binary >> i) & 1), code);
+        fprintf(code, " %s\n", text);
+        words = offset + 1;
+    }
+
+    for (int i = 0; i < label_count; i++) {
+        if (labels[i].function[0] == '\0') fprintf(obj, "symbol %s %u\n", labels[i].name, labels[i].address - 1);
+    }
+    rewind(relocations);
+    while (fgets(line, sizeof(line), relocations)) fputs(line, obj);
+    fprintf(obj, "text %u\n", words);
+    rewind(code);
+    while (fgets(line, sizeof(line), code)) fputs(line, obj);
+
+    int failed = ferror(obj);
+    fclose(code);
+    fclose(relocations);
+    fclose(obj);
+    fclose(asm_file);
+    current_function[0] = '\0';
+    return failed ? -1 : 0;
 }
 
 // Convenience function with automatic naming
-void generateBinaryWithAutoNaming(const char *base_filename) {
+int generateBinaryWithAutoNaming(const char *base_filename) {
     // Extract base name without extension
     char base_name[256];
     strcpy(base_name, base_filename);
@@ -602,7 +872,7 @@ void generateBinaryWithAutoNaming(const char *base_filename) {
     snprintf(clean_filename, sizeof(clean_filename), "%s.bin", base_name);
     snprintf(commented_filename, sizeof(commented_filename), "%s.binbd", base_name);
     
-    generateBinaryFromAssembly(base_filename, clean_filename, commented_filename);
+    return generateBinaryFromAssembly(base_filename, clean_filename, commented_filename);
 }
 
 // End of binary_generator.c - integrated as library
@@ -8,10 +8,14 @@
  * following the custom MIPS processor specification.
  */
 
-// Generate both clean (.bin) and commented (.binbd) binary files from assembly
-void generateBinaryWithAutoNaming(const char *base_filename);
+// Generate both clean (.bin) and commented (.binbd) binary files from assembly;
+// returns 0 on success, -1 if a file fails or a label is undefined
+int generateBinaryWithAutoNaming(const char *base_filename);
 
-// Generate binary files with specific filenames
-void generateBinaryFromAssembly(const char *asm_filename, const char *clean_bin_filename, const char *commented_bin_filename);
+// Generate binary files with specific filenames; returns 0 on success
+int generateBinaryFromAssembly(const char *asm_filename, const char *clean_bin_filename, const char *commented_bin_filename);
+
+// Generate a relocatable object for acmc-ld (acmc -c); returns 0 on success
+int generateObjectFromAssembly(const char *asm_filename, const char *object_filename, const char *source_filename);
 
 #endif /* BINARY_GENERATOR_H */
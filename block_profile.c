@@ -0,0 +1,93 @@
+/*
+ * block_profile.c - Basic-block profile reader (see block_profile.h)
+ */
+
+#include "block_profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char function[64];
+    char block[64];
+    long count;
+} ProfileEntry;
+
+static ProfileEntry *entries = NULL;
+static int entry_count = 0;
+static int entry_capacity = 0;
+static int loaded = 0;
+
+static ProfileEntry *findEntry(const char *function, const char *block) {
+    for (int i = 0; i < entry_count; i++) {
+        if (strcmp(entries[i].block, block) == 0 && strcmp(entries[i].function, function) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+int blockProfileLoad(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "Profile %s not found\n", filename);
+        return -1;
+    }
+
+    char line[256];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        char function[64], block[64];
+        long count;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (sscanf(line, "%63s %63s %ld", function, block, &count) != 3 || count < 0) {
+            fprintf(stderr, "%s:%d: expected <function> <block> <count>\n", filename, line_number);
+            fclose(f);
+            blockProfileFree();
+            return -1;
+        }
+
+        ProfileEntry *entry = findEntry(function, block);
+        if (entry) {
+            entry->count += count;
+            continue;
+        }
+        if (entry_count == entry_capacity) {
+            int new_capacity = entry_capacity ? entry_capacity * 2 : 128;
+            ProfileEntry *grown = realloc(entries, new_capacity * sizeof(ProfileEntry));
+            if (!grown) {
+                fclose(f);
+                blockProfileFree();
+                return -1;
+            }
+            entries = grown;
+            entry_capacity = new_capacity;
+        }
+        entry = &entries[entry_count++];
+        strcpy(entry->function, function);
+        strcpy(entry->block, block);
+        entry->count = count;
+    }
+
+    fclose(f);
+    loaded = 1;
+    return 0;
+}
+
+int blockProfileLoaded(void) {
+    return loaded;
+}
+
+long blockProfileCount(const char *function, const char *block) {
+    ProfileEntry *entry = findEntry(function, block);
+    return entry ? entry->count : -1;
+}
+
+void blockProfileFree(void) {
+    free(entries);
+    entries = NULL;
+    entry_count = 0;
+    entry_capacity = 0;
+    loaded = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef BLOCK_PROFILE_H
+#define BLOCK_PROFILE_H
+
+/**
+ * block_profile.h - Basic-block execution counts for profile-guided layout
+ *
+ * A profile is the text file written by "acmc-blocks -o" from the counters
+ * of a program compiled with --instrument=blocks (on the board or in
+ * acmc-sim). Each line is
+ *
+ *     <function> <block> <count>
+ *
+ * where <block> is "entry" or the IR label that starts the block (L3, the
+ * then-part L3t of an if, the body L5b of a while). Labels restart in every
+ * function and do not depend on the layout chosen, so a profile stays valid
+ * for the optimized build. Lines starting with '#' are comments; repeated
+ * keys are added, so the profiles of several runs can be concatenated.
+ */
+
+// Reads a profile; returns 0 on success
+int blockProfileLoad(const char *filename);
+
+// True once a profile has been loaded
+int blockProfileLoaded(void);
+
+// Count of 'block' in 'function', or -1 if the profile does not have it
+long blockProfileCount(const char *function, const char *block);
+
+void blockProfileFree(void);
+
+#endif /* BLOCK_PROFILE_H */
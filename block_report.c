@@ -0,0 +1,237 @@
+/*
+ * block_report.c - Decodes basic-block counter dumps (acmc-blocks)
+ *
+ * A program compiled with "acmc --instrument=blocks" counts every basic
+ * block it enters and, right before main halts, outputs the number of
+ * blocks followed by one counter per block. This tool takes the captured
+ * output values (one integer per line, from the board or from acmc-sim)
+ * and the compiler's .blocks map, and prints the hot blocks, functions
+ * and source lines. With -o it also writes the counts as a profile for
+ * "acmc --profile-use" (see block_profile.h).
+ *
+ * Usage: acmc-blocks [-o <profile>] <program.blocks> <output-values-file>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char function[64];
+    int index;
+    char names[128];
+    int address;
+    int ir_line;
+    int source_line;
+    long long count;
+} Block;
+
+typedef struct {
+    const char *name;        // Function name, or NULL for a source line entry
+    int line;                // Source line, or a function's first address
+    long long count;
+    int blocks;
+} Total;
+
+static Block *blocks = NULL;
+static int block_count = 0;
+
+static int load_map(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open block map %s\n", filename);
+        return -1;
+    }
+
+    char line[256];
+    int declared = -1, loaded = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (declared < 0) {
+            if (sscanf(line, "blocks %d", &declared) != 1 || declared < 0) break;
+            blocks = calloc(declared ? declared : 1, sizeof(Block));
+            if (!blocks) break;
+            continue;
+        }
+        int id;
+        Block b = {0};
+        if (sscanf(line, "%d %63s %d %127s %d %d %d", &id, b.function, &b.index, b.names,
+                   &b.address, &b.ir_line, &b.source_line) != 7 || id != loaded || id >= declared) {
+            declared = -1;
+            break;
+        }
+        blocks[loaded++] = b;
+    }
+    fclose(f);
+
+    if (declared < 0 || loaded != declared) {
+        fprintf(stderr, "Error: %s is not a valid block map\n", filename);
+        return -1;
+    }
+    block_count = loaded;
+    return 0;
+}
+
+// The dump is the tail of the output: the block count, then the counters
+static int load_counts(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open output values %s\n", filename);
+        return -1;
+    }
+
+    long long *values = NULL;
+    int count = 0, capacity = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char *end;
+        long long value = strtoll(line, &end, 10);
+        if (end == line) continue;   // Headers such as "== input.txt"
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            long long *grown = realloc(values, capacity * sizeof(long long));
+            if (!grown) {
+                free(values);
+                fclose(f);
+                return -1;
+            }
+            values = grown;
+        }
+        values[count++] = value;
+    }
+    fclose(f);
+
+    int start = count - block_count;
+    if (start < 1 || values[start - 1] != block_count) {
+        fprintf(stderr, "Error: %s does not end with a dump of %d block counters\n",
+                filename, block_count);
+        free(values);
+        return -1;
+    }
+    for (int i = 0; i < block_count; i++) blocks[i].count = values[start + i];
+    free(values);
+    return 0;
+}
+
+static int compare_blocks(const void *a, const void *b) {
+    const Block *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return x->address - y->address;
+}
+
+static int compare_totals(const void *a, const void *b) {
+    const Total *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return x->line - y->line;
+}
+
+// Adds a block to the entry with the same function name (or source line)
+static int add_total(Total *totals, int count, const Block *b, int by_line) {
+    for (int i = 0; i < count; i++) {
+        if (by_line ? totals[i].line == b->source_line : strcmp(totals[i].name, b->function) == 0) {
+            totals[i].count += b->count;
+            totals[i].blocks++;
+            return count;
+        }
+    }
+    totals[count].name = by_line ? NULL : b->function;
+    totals[count].line = by_line ? b->source_line : b->address;
+    totals[count].count = b->count;
+    totals[count].blocks = 1;
+    return count + 1;
+}
+
+// One "<function> <block> <count>" line per name of every block
+static int write_profile(const char *filename, const char *map_filename) {
+    FILE *f = fopen(filename, "w");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot write profile %s\n", filename);
+        return -1;
+    }
+    fprintf(f, "# acmc block profile from %s\n", map_filename);
+    for (int i = 0; i < block_count; i++) {
+        char names[sizeof(blocks[i].names)];
+        strcpy(names, blocks[i].names);
+        for (char *name = strtok(names, ","); name; name = strtok(NULL, ",")) {
+            fprintf(f, "%s %s %lld\n", blocks[i].function, name, blocks[i].count);
+        }
+    }
+    int failed = ferror(f);
+    fclose(f);
+    return failed ? -1 : 0;
+}
+
+static double percent(long long part, long long total) {
+    return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *profile_file = NULL;
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "-o") == 0) {
+        profile_file = argv[arg + 1];
+        arg += 2;
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "Usage: %s [-o <profile>] <program.blocks> <output-values-file>\n", argv[0]);
+        return 1;
+    }
+    if (load_map(argv[arg]) != 0 || load_counts(argv[arg + 1]) != 0) return 1;
+    if (profile_file && write_profile(profile_file, argv[arg]) != 0) return 1;
+
+    Total *functions = calloc(block_count ? block_count : 1, sizeof(Total));
+    Total *lines = calloc(block_count ? block_count : 1, sizeof(Total));
+    if (!functions || !lines) return 1;
+
+    long long total = 0;
+    int function_count = 0, line_count = 0;
+    for (int i = 0; i < block_count; i++) {
+        total += blocks[i].count;
+        function_count = add_total(functions, function_count, &blocks[i], 0);
+        line_count = add_total(lines, line_count, &blocks[i], 1);
+    }
+
+    printf("Basic blocks: %d, block entries: %lld\n\n", block_count, total);
+
+    qsort(functions, function_count, sizeof(Total), compare_totals);
+    printf("Functions\n");
+    printf("%12s %7s %7s  %s\n", "entries", "%", "blocks", "function");
+    for (int i = 0; i < function_count; i++) {
+        printf("%12lld %6.2f%% %7d  %s\n", functions[i].count,
+               percent(functions[i].count, total), functions[i].blocks, functions[i].name);
+    }
+
+    qsort(lines, line_count, sizeof(Total), compare_totals);
+    printf("\nSource lines\n");
+    printf("%12s %7s %7s  %s\n", "entries", "%", "blocks", "line");
+    for (int i = 0; i < line_count; i++) {
+        if (lines[i].count == 0) break;
+        if (lines[i].line > 0) {
+            printf("%12lld %6.2f%% %7d  %d\n", lines[i].count, percent(lines[i].count, total),
+                   lines[i].blocks, lines[i].line);
+        } else {
+            printf("%12lld %6.2f%% %7d  (no line)\n", lines[i].count, percent(lines[i].count, total),
+                   lines[i].blocks);
+        }
+    }
+
+    // Sorted on a copy: the function totals point at names in 'blocks'
+    Block *sorted = malloc((block_count ? block_count : 1) * sizeof(Block));
+    if (!sorted) return 1;
+    memcpy(sorted, blocks, block_count * sizeof(Block));
+    qsort(sorted, block_count, sizeof(Block), compare_blocks);
+    printf("\nBlocks\n");
+    printf("%12s %7s  %-20s %5s %7s %7s %7s  %s\n", "entries", "%", "function", "block",
+           "address", "ir", "source", "labels");
+    for (int i = 0; i < block_count; i++) {
+        const Block *b = &sorted[i];
+        printf("%12lld %6.2f%%  %-20s %5d %7d %7d %7d  %s\n", b->count, percent(b->count, total),
+               b->function, b->index, b->address, b->ir_line, b->source_line, b->names);
+    }
+
+    free(sorted);
+    free(functions);
+    free(lines);
+    free(blocks);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * bootloader.c - Resident loader image (see bootloader.h)
+ */
+
+#include "bootloader.h"
+#include "binary_generator.h"
+#include <stdio.h>
+#include <string.h>
+
+#define STRINGIFY(x) #x
+#define TO_STRING(x) STRINGIFY(x)
+
+// The loader; its own address (label bootloader) is the largest program.
+// Lines ending in ':' are labels.
+static const char *const loader[] = {
+    "sync:",
+    "input r1",
+    "la r2 " TO_STRING(BOOTLOADER_SYNC),
+    "bne r1 r2 sync",
+    "input r1",                 // Word count
+    "blte r1 r0 bad",
+    "la r2 bootloader",
+    "bgt r1 r2 bad",
+    "input r7",                 // Word 0: j main
+    "move r3 r7",               // Checksum sums s1 and s2
+    "move r4 r7",
+    "addi r2 r0 1",
+    "load:",
+    "beq r2 r1 check",
+    "input r5",
+    "swi r5 r2 0",
+    "add r3 r3 r5",
+    "add r4 r4 r3",
+    "addi r2 r2 1",
+    "j load",
+    "check:",
+    "input r6",
+    "bne r4 r6 bad",
+    "andi r7 r7 16383",         // Target of "j main"
+    "outputreg r1",
+    "move r1 r0",
+    "move r2 r0",
+    "move r3 r0",
+    "move r4 r0",
+    "move r5 r0",
+    "move r6 r0",
+    "jr r7",
+    "bad:",
+    "subi r1 r0 1",
+    "outputreg r1",
+    "j sync",
+};
+
+#define LOADER_LINES ((int)(sizeof(loader) / sizeof(loader[0])))
+
+static int isLabel(const char *line) {
+    return line[strlen(line) - 1] == ':';
+}
+
+int bootloaderGenerate(const char *base_filename, int memory_words) {
+    if (memory_words < BOOTLOADER_WORDS + 2 || memory_words > BOOTLOADER_MAX_MEMORY) {
+        fprintf(stderr, "Instruction memory for the bootloader must have %d to %d words\n", BOOTLOADER_WORDS + 2,
+                BOOTLOADER_MAX_MEMORY);
+        return -1;
+    }
+    unsigned base = (unsigned)(memory_words - BOOTLOADER_WORDS);
+
+    char asm_filename[256], bin_filename[256], binbd_filename[256];
+    snprintf(asm_filename, sizeof(asm_filename), "%s.asm", base_filename);
+    snprintf(bin_filename, sizeof(bin_filename), "%s.bin", base_filename);
+    snprintf(binbd_filename, sizeof(binbd_filename), "%s.binbd", base_filename);
+
+    FILE *out = fopen(asm_filename, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Cannot create %s\n", asm_filename);
+        return -1;
+    }
+
+    // Same layout as the compiler's .asm: the jump, then numbered words
+    fprintf(out, "j %u\n", base);
+    for (unsigned address = 1; address < base; address++) {
+        fprintf(out, "%u-# Program space\n", address);
+    }
+    fprintf(out, "Func bootloader:\n");
+    unsigned address = base;
+    for (int i = 0; i < LOADER_LINES; i++) {
+        if (isLabel(loader[i])) {
+            fprintf(out, "%s\n", loader[i]);
+        } else {
+            fprintf(out, "%u-%s\n", address++, loader[i]);
+        }
+    }
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Error writing %s\n", asm_filename);
+        return -1;
+    }
+
+    return generateBinaryFromAssembly(asm_filename, bin_filename, binbd_filename);
+}
@@ -0,0 +1,35 @@
+#ifndef BOOTLOADER_H
+#define BOOTLOADER_H
+
+/**
+ * bootloader.h - Resident loader that receives programs through INPUT
+ *
+ * acmc --bootloader writes an image of the whole instruction memory: word
+ * 0 jumps to the loader at the top of the memory and every other word is
+ * free for the program. The loader reads, with INPUT:
+ *
+ *     BOOTLOADER_SYNC        skipped until it arrives
+ *     n                      words of the program, 1 <= n <= loader address
+ *     word 0 ... word n-1    the .bin, word 0 being "j main"
+ *     checksum               s2 of s1 += word, s2 += s1 (wrapping, from 0)
+ *
+ * and stores words 1 to n-1 at their addresses with SWI. Word 0 is only
+ * used for its target, so a reset still starts the loader. If the checksum
+ * matches it outputs n and jumps to main with r1-r6 cleared; otherwise (or
+ * for a bad n) it outputs -1 and waits for the next BOOTLOADER_SYNC.
+ * acmc-upload (upload.c) writes this stream from a .bin. Only the
+ * instruction memory is loaded: the initial values of globals
+ * (<program>.data.mif, see data_image.h) have no place in the stream, so
+ * acmc-upload refuses programs that have them.
+ */
+
+#define BOOTLOADER_SYNC 6860              // 0x1ACC, fits the 14-bit LA
+#define BOOTLOADER_WORDS 32               // Size of the loader in bootloader.c
+#define BOOTLOADER_DEFAULT_MEMORY 1024    // Instruction memory words
+#define BOOTLOADER_MAX_MEMORY 16384       // Branch targets have 14 bits
+
+// Writes <base_filename>.asm, .bin and .binbd for an instruction memory of
+// 'memory_words' words. Returns 0 on success.
+int bootloaderGenerate(const char *base_filename, int memory_words);
+
+#endif /* BOOTLOADER_H */
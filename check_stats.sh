@@ -0,0 +1,94 @@
+#!/bin/bash
+
+# Compares the static code metrics (acmc --stats) of the programs in
+# samples.manifest with the baselines in expected/<program>.stats.json.
+# Fails if any metric of any function grew.
+#
+#   ./check_stats.sh            compare
+#   ./check_stats.sh --update   rewrite the baselines from the current compiler
+
+ACMC=${ACMC:-./acmc}
+update=0
+if [ "$1" = "--update" ]; then
+    update=1
+fi
+
+# Prints the changes between two .stats.json files; exit status 1 on a regression
+compare_stats() {
+    awk '
+    function parse(line, fields,    n, parts, i, kv) {
+        sub(/^[^{]*[{]/, "", line)
+        gsub(/[}"]/, "", line)
+        sub(/,[ \t]*$/, "", line)
+        n = split(line, parts, /, */)
+        for (i = 1; i <= n; i++) {
+            split(parts[i], kv, /: */)
+            gsub(/^[ \t]+/, "", kv[1])
+            fields[kv[1]] = kv[2]
+        }
+    }
+    /"name":/ {
+        split("", fields)
+        parse($0, fields)
+        name = fields["name"]
+        for (key in fields) {
+            if (key == "name") continue
+            if (FNR == NR) {
+                base[name, key] = fields[key]
+                base_function[name] = 1
+            } else {
+                current_function[name] = 1
+                if (!(name in base_function)) continue
+                old = base[name, key]
+                if (fields[key] > old) {
+                    printf "  %s.%s: %d -> %d (+%d)\n", name, key, old, fields[key], fields[key] - old
+                    regressed = 1
+                } else if (fields[key] < old) {
+                    printf "  %s.%s: %d -> %d (%d)\n", name, key, old, fields[key], fields[key] - old
+                }
+            }
+        }
+    }
+    END {
+        for (name in current_function) if (!(name in base_function)) printf "  %s: new function\n", name
+        for (name in base_function) if (!(name in current_function)) printf "  %s: function removed\n", name
+        exit regressed
+    }' "$1" "$2"
+}
+
+echo "=== Static Code Metrics ==="
+echo
+
+status=0
+for program in $(awk '!/^#/ && NF { sub(/\.bin$/, "", $1); print $1 }' samples.manifest); do
+    # Linked images (globals_link.bin) have no single source to measure
+    [ -f "$program.c-" ] || continue
+    baseline="expected/$program.stats.json"
+    rm -f "$program.stats.json"
+    if ! "$ACMC" --stats "$program.c-" > /dev/null 2>&1 || [ ! -f "$program.stats.json" ]; then
+        echo "❌ $program: compilation failed"
+        status=1
+        continue
+    fi
+
+    if [ $update = 1 ]; then
+        cp "$program.stats.json" "$baseline"
+        echo "Updated $baseline"
+    elif [ ! -f "$baseline" ]; then
+        echo "❌ $program: no baseline (run $0 --update)"
+        status=1
+    else
+        changes=$(compare_stats "$baseline" "$program.stats.json")
+        if [ $? -ne 0 ]; then
+            echo "❌ $program: REGRESSION"
+            status=1
+        elif [ -n "$changes" ]; then
+            echo "✅ $program: changed, no regression (run $0 --update to accept)"
+        else
+            echo "✅ $program: unchanged"
+        fi
+        [ -n "$changes" ] && echo "$changes"
+    fi
+done
+
+exit $status
@@ -0,0 +1,115 @@
+/*
+ * code_stats.c - Static code-quality metrics (see code_stats.h)
+ */
+
+#include "code_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    STAT_INSTRUCTIONS, STAT_LOADS, STAT_STORES, STAT_SPILL_SLOTS, STAT_MOVES,
+    STAT_BRANCHES, STAT_JUMPS, STAT_CALLS, STAT_FRAME_SIZE, STAT_CYCLES,
+    STAT_COUNT
+} StatKind;
+
+static const char *stat_names[STAT_COUNT] = {
+    "instructions", "loads", "stores", "spill_slots", "moves",
+    "branches", "jumps", "calls", "frame_size", "static_cycles"
+};
+
+typedef struct {
+    char name[64];
+    long values[STAT_COUNT];
+} FunctionStats;
+
+static FunctionStats *functions = NULL;
+static int function_count = 0;
+static int function_capacity = 0;
+static FunctionStats *current = NULL;
+
+void codeStatsReset(void) {
+    free(functions);
+    functions = NULL;
+    function_count = 0;
+    function_capacity = 0;
+    current = NULL;
+}
+
+void codeStatsBeginFunction(const char *function) {
+    current = NULL;
+    if (function_count == function_capacity) {
+        int new_capacity = function_capacity ? function_capacity * 2 : 16;
+        FunctionStats *grown = realloc(functions, new_capacity * sizeof(FunctionStats));
+        if (!grown) return;
+        functions = grown;
+        function_capacity = new_capacity;
+    }
+    current = &functions[function_count++];
+    memset(current, 0, sizeof(*current));
+    strncpy(current->name, function, sizeof(current->name) - 1);
+}
+
+static int isOneOf(const char *mnemonic, const char *const *names) {
+    for (int i = 0; names[i]; i++) {
+        if (strcmp(mnemonic, names[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+void codeStatsAddInstruction(const char *mnemonic, int cycles) {
+    static const char *const branches[] = { "beq", "bne", "bgt", "bgte", "blt", "blte", NULL };
+    static const char *const jumps[] = { "j", "jr", NULL };
+    static const char *const calls[] = { "jal", "jalr", NULL };
+
+    // The jump to main comes before every function
+    if (!current) return;
+    long *v = current->values;
+    v[STAT_INSTRUCTIONS]++;
+    v[STAT_CYCLES] += cycles;
+    if (strcmp(mnemonic, "lw") == 0) v[STAT_LOADS]++;
+    else if (strcmp(mnemonic, "sw") == 0) v[STAT_STORES]++;
+    else if (strcmp(mnemonic, "move") == 0) v[STAT_MOVES]++;
+    else if (isOneOf(mnemonic, branches)) v[STAT_BRANCHES]++;
+    else if (isOneOf(mnemonic, jumps)) v[STAT_JUMPS]++;
+    else if (isOneOf(mnemonic, calls)) v[STAT_CALLS]++;
+}
+
+void codeStatsSetFrame(int slots, int variables) {
+    if (!current) return;
+    current->values[STAT_FRAME_SIZE] = slots;
+    current->values[STAT_SPILL_SLOTS] = slots - 1 - variables > 0 ? slots - 1 - variables : 0;
+}
+
+static void writeFunction(FILE *f, const FunctionStats *fs, const char *end) {
+    fprintf(f, "{\"name\": \"%s\"", fs->name);
+    for (int s = 0; s < STAT_COUNT; s++) fprintf(f, ", \"%s\": %ld", stat_names[s], fs->values[s]);
+    fprintf(f, "}%s\n", end);
+}
+
+int codeStatsWrite(const char *stats_filename, const char *source_filename) {
+    FILE *f = fopen(stats_filename, "w");
+    if (!f) {
+        printf("Error: Could not create %s\n", stats_filename);
+        return -1;
+    }
+
+    FunctionStats total;
+    memset(&total, 0, sizeof(total));
+    strcpy(total.name, "total");
+
+    const char *base = strrchr(source_filename, '/');
+    fprintf(f, "{\n  \"source\": \"%s\",\n  \"functions\": [\n", base ? base + 1 : source_filename);
+    for (int i = 0; i < function_count; i++) {
+        fprintf(f, "    ");
+        writeFunction(f, &functions[i], i + 1 < function_count ? "," : "");
+        for (int s = 0; s < STAT_COUNT; s++) total.values[s] += functions[i].values[s];
+    }
+    fprintf(f, "  ],\n  \"total\": ");
+    writeFunction(f, &total, "");
+    fprintf(f, "}\n");
+
+    int failed = ferror(f);
+    fclose(f);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,45 @@
+#ifndef CODE_STATS_H
+#define CODE_STATS_H
+
+/**
+ * code_stats.h - Static code-quality metrics of the generated assembly
+ *
+ * assembly.c reports every machine instruction it emits, with its cost
+ * from the opcode table, and the frame of every function. acmc --stats
+ * writes the totals per function as <name>.stats.json, one function per
+ * line so that check_stats.sh can compare them with the baselines in
+ * expected/ without a JSON parser:
+ *
+ *     {
+ *       "source": "fibonacci.c-",
+ *       "functions": [
+ *         {"name": "fibonacci", "instructions": 50, "loads": 13, ...},
+ *         ...
+ *       ],
+ *       "total": {"name": "total", "instructions": 67, ...}
+ *     }
+ *
+ * Metrics: instructions, loads (lw), stores (sw), spill_slots (frame
+ * words beyond the return address and the declared variables), moves,
+ * branches (conditional), jumps (j, jr), calls (jal, jalr), frame_size
+ * (words) and static_cycles (sum of the opcode costs). Lower is better
+ * for all of them.
+ */
+
+// Forgets the functions of the previous compilation
+void codeStatsReset(void);
+
+// Following instructions belong to 'function'
+void codeStatsBeginFunction(const char *function);
+
+// One instruction of the current function, 'cycles' from the opcode table
+void codeStatsAddInstruction(const char *mnemonic, int cycles);
+
+// Stack frame of the current function: 'slots' words, 'variables' of them
+// for parameters and locals (the return address takes one more)
+void codeStatsSetFrame(int slots, int variables);
+
+// Writes the JSON report; returns 0 on success
+int codeStatsWrite(const char *stats_filename, const char *source_filename);
+
+#endif /* CODE_STATS_H */
@@ -8,7 +8,9 @@
  * - STORE_VAR: Armazenamento de registrador na memória de variável
  * - STORE_VET: Armazenamento de registrador em elemento de array
  * - PARAM/LOCAL: Declarações de parâmetros e variáveis locais
- * - ADD/SUB/MUL/DIV: Operações aritméticas
+ * - ADD/SUB/MUL/DIV/MOD: Operações aritméticas
+ * - MFHI/MFLO: Resto/quociente da última divisão com os mesmos operandos
+ * - AND/OR/SLL/SRL: Operações de bits (&, |, <<, >>)
  * - CMP: Comparação entre valores
  * - BR_EQ/BR_NE/BR_LT/BR_LE/BR_GT/BR_GE: Saltos condicionais
  * - GOTO: Salto incondicional
@@ -28,6 +30,10 @@
 #include "symtab.h"
 #include "assembly.h"
 #include "binary_generator.h"
+#include "line_table.h"
+#include "code_stats.h"
+#include "block_profile.h"
+#include "reachability.h"
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -45,6 +51,7 @@ static char* generate_load_var(const char *scope, const char *var_name);
 static char* generate_load_vet(const char *array_name, TreeNode *index_tree);
 static void generate_store_var(const char *temp_reg, const char *var_name, const char *scope);
 static void generate_store_vet(const char *src_reg, const char *array_name, TreeNode *index_tree);
+static int generate_output_from_memory(TreeNode *arg);
 static void generate_move(const char *src_reg, const char *dst_reg);
 
 // Tamanhos máximos de buffer para geração de função
@@ -335,6 +342,14 @@ static int tempCount = 0;    // Contador para variáveis temporárias (reiniciad
 static int labelCount = 0;   // Contador para rótulos (reiniciado por função)
 static GlobalVarList globalVars = NULL; // Lista de variáveis globais
 
+// Linha do código fonte de cada instrução no buffer, para a tabela de linhas
+static int instruction_source_line[MAX_FUNC_INSTRUCTIONS];
+static int current_source_line;
+static int current_function_line;
+
+// Linhas já escritas no arquivo .ir (a próxima linha é ir_lines_written + 1)
+static int ir_lines_written;
+
 // Temporary register pool for enhanced system
 typedef struct {
     char name[32];
@@ -353,6 +368,7 @@ static int temp_pool_initialized = 0;
 static void generate_alloca_mem_var(const char *scope, const char *var_name) {
     if (outputFile) {
         fprintf(outputFile, "allocaMemVar %s %s ___\n", scope, var_name);
+        ir_lines_written++;
     }
 }
 
@@ -360,6 +376,7 @@ static void generate_alloca_mem_var(const char *scope, const char *var_name) {
 static void generate_alloca_mem_vet(const char *scope, const char *var_name, int size) {
     if (outputFile) {
         fprintf(outputFile, "allocaMemVet %s %s ___\n", scope, var_name);
+        ir_lines_written++;
     }
 }
 
@@ -464,6 +481,14 @@ static int param_count;
 // Nome da função atualmente sendo processada
 static char current_func_name_codegen[MAX_IDENTIFIER_LEN];
 
+// Operandos (nome de variável ou constante) do último div/mod emitido
+// enquanto HI e LO ainda guardam o resto e o quociente dele
+static struct {
+    int valid;
+    char left[MAX_IDENTIFIER_LEN];
+    char right[MAX_IDENTIFIER_LEN];
+} last_division;
+
 // Declarações antecipadas para funções auxiliares:
 // Estas funções são utilizadas para auxiliar na geração de código intermediário (IR).
 // Elas incluem funcionalidades como adicionar variáveis locais, gerar código para expressões,
@@ -618,6 +643,24 @@ static int isGlobalVar(char *name) {
 // Adiciona instrução ao buffer da função atual
 // As instruções são coletadas em buffer para permitir a geração correta
 // das declarações LOCAL antes das instruções do corpo da função
+// HI e LO deixam de valer em rótulos (outro caminho pode chegar ali), em
+// chamadas de funções do programa, em outro mult/div e quando um operando
+// da divisão é escrito
+static void update_last_division(const char *instruction) {
+    char op[32], arg1[MAX_IDENTIFIER_LEN], arg2[MAX_IDENTIFIER_LEN];
+    if (!last_division.valid || sscanf(instruction, "%31s %255s %255s", op, arg1, arg2) < 1) return;
+
+    if (strcmp(op, "label_op") == 0 || strcmp(op, "funInicio") == 0 || strcmp(op, "funFim") == 0 ||
+        strcmp(op, "mult") == 0 || strcmp(op, "div") == 0 || strcmp(op, "mod") == 0) {
+        last_division.valid = 0;
+    } else if (strcmp(op, "call") == 0 && strcmp(arg1, "input") != 0 && strcmp(arg1, "output") != 0) {
+        last_division.valid = 0;
+    } else if (strcmp(op, "storeVar") == 0 &&
+               (strcmp(arg2, last_division.left) == 0 || strcmp(arg2, last_division.right) == 0)) {
+        last_division.valid = 0;
+    }
+}
+
 static void emit_buffered(const char *instruction_format, ...) {
     if (instruction_buffer_count >= MAX_FUNC_INSTRUCTIONS) {
         fprintf(stderr, "Erro: Muitas instruções para a função %s\n", current_func_name_codegen);
@@ -628,7 +671,9 @@ static void emit_buffered(const char *instruction_format, ...) {
     va_start(args, instruction_format);
     vsnprintf(buf, sizeof(buf), instruction_format, args);
     va_end(args);
+    instruction_source_line[instruction_buffer_count] = current_source_line;
     instruction_buffer[instruction_buffer_count++] = copyString(buf);
+    update_last_division(buf);
     
     // Coleta estatísticas aprimoradas
     stats.total_instructions++;
@@ -719,6 +764,18 @@ static void emit_global_decl(const char *name, int size) {
     } else {
         fprintf(outputFile, "GLOBAL %s, __, __, __\n", name); // Variável global simples
     }
+    ir_lines_written++;
+}
+
+// Emite os valores iniciais de uma global (GLOBAL_INIT nome, índice, valor);
+// zeros são omitidos, a memória de dados começa zerada
+static void emit_global_init(const char *name, TreeNode *values) {
+    int index = 0;
+    for (TreeNode *value = values; value != NULL; value = value->sibling, index++) {
+        if (value->attr.val == 0) continue;
+        fprintf(outputFile, "GLOBAL_INIT %s, %d, %d, __\n", name, index, value->attr.val);
+        ir_lines_written++;
+    }
 }
 
 // Esta função é chamada quando o escopo de uma função termina.
@@ -727,9 +784,12 @@ static void flush_function_buffer() {
     for (int i = 0; i < instruction_buffer_count; ++i) {
         fprintf(outputFile, "%s\n", instruction_buffer[i]);
         free(instruction_buffer[i]);
+        lineTableSetIRLine(++ir_lines_written, instruction_source_line[i]);
     }
     if (outputFile) {
         fprintf(outputFile, "funFim %s ___ ___\n\n", current_func_name_codegen);
+        lineTableSetIRLine(++ir_lines_written, current_function_line);
+        ir_lines_written++;
     }
     instruction_buffer_count = 0;
     local_vars_count = 0;
@@ -753,6 +813,11 @@ static const char *get_ir_op_string(TokenType op) {
     }
 }
 
+// Operadores relacionais, que viram desvios diretos em if/while
+static int is_comparison(TokenType op) {
+    return op == IGDAD || op == DIFER || op == MENOR || op == MENIG || op == MAIOR || op == MAIIG;
+}
+
 // Obtém string da instrução de salto IR para operações de comparação
 // branch_on_true: 1 se salta quando condição é verdadeira, 0 se salta quando falsa
 // Isto permite usar a mesma função para gerar ambos if e while com lógica inversa
@@ -769,6 +834,48 @@ static const char *get_ir_branch_instruction(TokenType op, int branch_on_true) {
 }
 
 
+// Operando de divisão sem efeito colateral: variável simples ou constante
+static int division_operand_key(TreeNode *tree, char *key, size_t size) {
+    if (tree->nodekind != ExpK) return 0;
+    if (tree->kind.exp == ConstK) {
+        snprintf(key, size, "%d", tree->attr.val);
+        return 1;
+    }
+    if ((tree->kind.exp == IdK || tree->kind.exp == VarK) && tree->child[0] == NULL) {
+        snprintf(key, size, "%s", tree->attr.name);
+        return 1;
+    }
+    return 0;
+}
+
+// O backend troca '% k' por andi quando k é potência de 2 (até 8192), sem div
+static int is_power_of_two_divisor(TreeNode *tree) {
+    return tree->nodekind == ExpK && tree->kind.exp == ConstK && tree->attr.val > 0 &&
+           tree->attr.val <= 8192 && (tree->attr.val & (tree->attr.val - 1)) == 0;
+}
+
+// a / b e a % b com os operandos da última divisão só leem LO ou HI
+static char *reuse_last_division(TreeNode *tree) {
+    char left[MAX_IDENTIFIER_LEN], right[MAX_IDENTIFIER_LEN];
+    if (!last_division.valid || !division_operand_key(tree->child[0], left, sizeof(left)) ||
+        !division_operand_key(tree->child[1], right, sizeof(right)) ||
+        strcmp(left, last_division.left) != 0 || strcmp(right, last_division.right) != 0) {
+        return NULL;
+    }
+    char *result_temp = allocate_temp_register();
+    if (outputFile) {
+        emit_buffered("%s %s ___ ___", tree->attr.opr == MOD ? "mfhi" : "mflo", result_temp);
+    }
+    return result_temp;
+}
+
+// Guarda os operandos do div/mod recém-emitido, se forem simples
+static void remember_division(TreeNode *tree) {
+    if (tree->attr.opr == MOD && is_power_of_two_divisor(tree->child[1])) return;
+    last_division.valid = division_operand_key(tree->child[0], last_division.left, sizeof(last_division.left)) &&
+                          division_operand_key(tree->child[1], last_division.right, sizeof(last_division.right));
+}
+
 // Gera código IR para expressões usando operações fundamentais load/store
 // Esta função processa recursivamente a árvore de expressões e produz o código IR necessário
 // com operações explícitas de load/store seguindo o padrão do compilador de referência
@@ -799,6 +906,10 @@ char *generate_expression_code(TreeNode *tree) {
                     }
 
                 case OpK: // Arithmetic or comparison operation
+                    if (tree->attr.opr == DIV || tree->attr.opr == MOD) {
+                        result_temp = reuse_last_division(tree);
+                        if (result_temp) return result_temp;
+                    }
                     left_temp = generate_expression_code(tree->child[0]);
                     right_temp = generate_expression_code(tree->child[1]);
                     
@@ -812,6 +923,11 @@ char *generate_expression_code(TreeNode *tree) {
                         case SUB:  op_str = "sub"; break;
                         case MULT: op_str = "mult"; break;
                         case DIV:  op_str = "div"; break;  // Use DIV instead of divisao
+                        case MOD:  op_str = "mod"; break;  // div + mfhi (resto em HI)
+                        case EBIT:  op_str = "and"; break;  // andi quando um operando é constante
+                        case OUBIT: op_str = "or"; break;   // ori quando um operando é constante
+                        case DESLE: op_str = "sll"; break;
+                        case DESLD: op_str = "srl"; break;  // Deslocamento lógico
                         // For comparison operations, we'll now use simple set/clear pattern
                         // These should rarely be used now with direct branching
                         case IGDAD:  op_str = "set"; break;  // Use processor's SET instruction
@@ -829,6 +945,7 @@ char *generate_expression_code(TreeNode *tree) {
                     if (outputFile) {
                         emit_buffered("%s %s %s %s", op_str, left_temp, right_temp, result_temp);
                     }
+                    if (tree->attr.opr == DIV || tree->attr.opr == MOD) remember_division(tree);
                     
                     // Release operand temporary registers if they are temporaries
                     if (left_temp[0] == 't') release_temp_register(left_temp);
@@ -841,6 +958,11 @@ char *generate_expression_code(TreeNode *tree) {
                         int arg_count = 0;
                         TreeNode *arg_node = tree->child[0];
 
+                        if (outputFile && strcmp(tree->attr.name, "output") == 0 &&
+                            generate_output_from_memory(arg_node)) {
+                            return NULL;
+                        }
+
                         // Generate parameter setup
                         while(arg_node != NULL) {
                             char *arg_temp = generate_expression_code(arg_node);
@@ -886,15 +1008,97 @@ char *generate_expression_code(TreeNode *tree) {
 }
 
 
+// Desvio condicional de if/while: salta para 'label' quando a condição
+// tem o valor 'branch_on_true'. Comparações viram um BR_* direto;
+// outras expressões são comparadas com zero
+static void emit_condition_branch(TreeNode *cond, int branch_on_true, const char *label) {
+    if (cond->kind.exp == OpK && is_comparison(cond->attr.opr)) {
+        char *op1_temp = generate_expression_code(cond->child[0]);
+        char *op2_temp = generate_expression_code(cond->child[1]);
+
+        const char *branch_op = get_ir_branch_instruction(cond->attr.opr, branch_on_true);
+        if (strcmp(branch_op, "BR_UNKNOWN") == 0) {
+            fprintf(stderr, "Erro: Operador de comparação desconhecido\n");
+            branch_op = branch_on_true ? "BR_EQ" : "BR_NE";
+        }
+        if (outputFile) {
+            emit_buffered("%s %s %s %s", branch_op, op1_temp, op2_temp, label);
+        }
+
+        if (op1_temp[0] == 't') release_temp_register(op1_temp);
+        if (op2_temp[0] == 't') release_temp_register(op2_temp);
+    } else if (cond->kind.exp == ConstK) {
+        // Condição dobrada em tempo de compilação (ex.: if (DEBUG == 1)):
+        // ou o desvio é sempre tomado, ou não é emitido
+        if (outputFile && (cond->attr.val != 0) == branch_on_true) {
+            emit_buffered("jump %s ___ ___", label);
+        }
+    } else {
+        char *cond_temp = generate_expression_code(cond);
+        if (outputFile) {
+            emit_buffered("%s %s 0 %s", branch_on_true ? "BR_NE" : "BR_EQ", cond_temp, label);
+        }
+        if (cond_temp[0] == 't') release_temp_register(cond_temp);
+    }
+}
+
+// Rótulos extras (L<n>t no then, L<n>b no corpo do while) dão nome estável
+// aos blocos do fallthrough; só são emitidos ao instrumentar ou com perfil
+static int emit_block_labels(void) {
+    return InstrumentBlocks || blockProfileLoaded();
+}
+
+// Desvio tomado e não tomado custam o mesmo no processador; o custo do if é
+// o salto para o fim, pago pelo caminho que fica no fallthrough. Vale pôr o
+// then no destino do desvio quando ele executa mais que o else (ou que o
+// caminho sem then). O bloco de junção conta then + else
+static int profile_prefers_then_at_target(const char *label_then, const char *label_end_if) {
+    long then_count = blockProfileCount(current_func_name_codegen, label_then);
+    long join_count = blockProfileCount(current_func_name_codegen, label_end_if);
+    if (then_count < 0 || join_count < 0) return 0;
+    return then_count > join_count - then_count;
+}
+
+// Com o teste no fim, cada iteração economiza o salto de volta e cada entrada
+// paga um salto até o teste. O cabeçalho conta entradas + iterações
+static int profile_prefers_rotation(const char *label_head, const char *label_body) {
+    long head_count = blockProfileCount(current_func_name_codegen, label_head);
+    long body_count = blockProfileCount(current_func_name_codegen, label_body);
+    if (head_count < 0 || body_count < 0) return 0;
+    return body_count > head_count - body_count;
+}
+
+// Linha onde o comando começa. Os nós são criados na redução, então if/while
+// guardam a linha do último token; a condição ou o lado esquerdo fica no início
+static int statement_line(TreeNode *tree) {
+    if (tree->nodekind == StmtK && tree->child[0] != NULL) {
+        switch (tree->kind.stmt) {
+            case IfK:
+            case WhileK:
+            case AssignK:
+            case ReturnK:
+                return tree->child[0]->lineno;
+            default:
+                break;
+        }
+    }
+    return tree->lineno;
+}
+
 // Gera código IR para comandos usando operações fundamentais load/store
 // Processa diferentes tipos de comandos como atribuições, ifs, whiles, returns
 // com operações explícitas de load/store seguindo o padrão do compilador de referência
 static void generate_statement_code(TreeNode *tree) {
     if (tree == NULL) return;
 
-    char *val_temp, *idx_temp, *base_temp, *addr_temp, *cond_temp;
+    // O salto de volta do while e os rótulos finais voltam para a linha do comando
+    int saved_source_line = current_source_line;
+    current_source_line = statement_line(tree);
+
+    char *val_temp, *idx_temp, *base_temp, *addr_temp;
     char *label1, *label2;
     char *label_false = NULL, *label_end_if = NULL;
+    char label_then[MAX_LABEL_LEN + 1], label_body[MAX_LABEL_LEN + 1];
     switch (tree->nodekind) {
         case StmtK:
             switch (tree->kind.stmt) {
@@ -909,8 +1113,11 @@ static void generate_statement_code(TreeNode *tree) {
                         char *li_temp_reg = allocate_temp_register(); // Allocate a new temp register for the constant
                         emit_buffered("li %s %s ___", li_temp_reg, const_val_str); // Generate LI IR: li temp_reg, const_value
 
-                        // Now use this temp_reg for storing
-                        generate_store_var(li_temp_reg, tree->child[0]->attr.name, current_func_name_codegen);
+                        // Now use this temp_reg for storing (var = const ou var[idx] = const)
+                        if (tree->child[0]->child[0] != NULL)
+                            generate_store_vet(li_temp_reg, tree->child[0]->attr.name, tree->child[0]->child[0]);
+                        else
+                            generate_store_var(li_temp_reg, tree->child[0]->attr.name, current_func_name_codegen);
 
                         release_temp_register(li_temp_reg); // Release the temporary used for the constant
                         free(const_val_str);
@@ -942,44 +1149,30 @@ static void generate_statement_code(TreeNode *tree) {
                 case IfK: // Conditional if-then-else
                     label_false = newLabel(); // Label for the 'else' part or end of if (if no else)
                     label_end_if = newLabel(); // Label for the end of the entire if-else construct
-                    
-                    // Generate condition evaluation - DIRECT BRANCH APPROACH
-                    if (tree->child[0]->kind.exp == OpK) {
-                        // Comparison operation - generate direct branch instructions
-                        char *op1_temp = generate_expression_code(tree->child[0]->child[0]);
-                        char *op2_temp = generate_expression_code(tree->child[0]->child[1]);
-                        
-                        // Generate direct branch instruction based on comparison operator
-                        const char *branch_op = NULL;
-                        switch (tree->child[0]->attr.opr) {
-                            case IGDAD: branch_op = "BR_NE"; break;  // If NOT equal, branch to false
-                            case DIFER: branch_op = "BR_EQ"; break;  // If equal, branch to false  
-                            case MAIIG: branch_op = "BR_LT"; break;  // If less than, branch to false
-                            case MENIG: branch_op = "BR_GT"; break;  // If greater than, branch to false
-                            case MAIOR: branch_op = "BR_LE"; break;  // If less or equal, branch to false
-                            case MENOR: branch_op = "BR_GE"; break;  // If greater or equal, branch to false
-                            default:
-                                fprintf(stderr, "Erro: Operador de comparação desconhecido\n");
-                                branch_op = "BR_NE";
-                                break;
+                    snprintf(label_then, sizeof(label_then), "%st", label_false);
+
+                    if (profile_prefers_then_at_target(label_then, label_end_if)) {
+                        // Perfil: o then é o caminho quente e fica sem o salto para o fim
+                        emit_condition_branch(tree->child[0], 1, label_then);
+                        emit_buffered("label_op %s ___ ___", label_false);
+                        if (tree->child[2] != NULL) {
+                            generate_code_recursive(tree->child[2]);
                         }
-                        
-                        if (outputFile) {
-                            emit_buffered("%s %s %s %s", branch_op, op1_temp, op2_temp, label_false);
-                        }
-                        
-                        // Release comparison operands
-                        if (op1_temp[0] == 't') release_temp_register(op1_temp);
-                        if (op2_temp[0] == 't') release_temp_register(op2_temp);
-                        
-                    } else { 
-                        // Simple condition variable - branch if zero (false)
-                        cond_temp = generate_expression_code(tree->child[0]);
-                        emit_buffered("BR_EQ %s r0 %s", cond_temp, label_false);
-                        if (cond_temp[0] == 't') release_temp_register(cond_temp);
+                        emit_buffered("jump %s ___ ___", label_end_if);
+
+                        emit_buffered("label_op %s ___ ___", label_then);
+                        generate_code_single(tree->child[1]);
+                        emit_buffered("label_op %s ___ ___", label_end_if);
+                        break;
                     }
 
+                    // Branch to 'else' when the condition is false
+                    emit_condition_branch(tree->child[0], 0, label_false);
+
                     // THEN BLOCK - fall through if condition is true
+                    if (emit_block_labels()) {
+                        emit_buffered("label_op %s ___ ___", label_then);
+                    }
                     generate_code_single(tree->child[1]); 
                     emit_buffered("jump %s ___ ___", label_end_if); // Jump to end of if-else
 
@@ -996,44 +1189,31 @@ static void generate_statement_code(TreeNode *tree) {
                 case WhileK: // While loop
                     label1 = newLabel(); // Loop start label
                     label2 = newLabel(); // Loop end label
+                    snprintf(label_body, sizeof(label_body), "%sb", label1);
+
+                    if (profile_prefers_rotation(label1, label_body)) {
+                        // Perfil: laço quente com o teste no fim, sem o salto de volta
+                        // a cada iteração; só a entrada paga o salto até o teste
+                        emit_buffered("jump %s ___ ___", label1);
+                        emit_buffered("label_op %s ___ ___", label_body);
+                        for (TreeNode *stmt = tree->child[1]; stmt != NULL; stmt = stmt->sibling) {
+                            generate_code_single(stmt);
+                        }
+                        emit_buffered("label_op %s ___ ___", label1);
+                        emit_condition_branch(tree->child[0], 1, label_body);
+                        emit_buffered("label_op %s ___ ___", label2);
+                        break;
+                    }
                     
                     // Loop start label
                     if (outputFile) {
                         emit_buffered("label_op %s ___ ___", label1);
                     }
                     
-                    // Generate condition evaluation - DIRECT BRANCH APPROACH
-                    if (tree->child[0]->kind.exp == OpK) {
-                        // Comparison operation - generate direct branch to exit
-                        char *op1_temp = generate_expression_code(tree->child[0]->child[0]);
-                        char *op2_temp = generate_expression_code(tree->child[0]->child[1]);
-                        
-                        // Generate direct branch instruction to EXIT loop when condition is FALSE
-                        const char *branch_op = NULL;
-                        switch (tree->child[0]->attr.opr) {
-                            case IGDAD: branch_op = "BR_NE"; break;  // If NOT equal, exit loop
-                            case DIFER: branch_op = "BR_EQ"; break;  // If equal, exit loop
-                            case MAIIG: branch_op = "BR_LT"; break;  // If less than, exit loop
-                            case MENIG: branch_op = "BR_GT"; break;  // If greater than, exit loop
-                            case MAIOR: branch_op = "BR_LE"; break;  // If less or equal, exit loop
-                            case MENOR: branch_op = "BR_GE"; break;  // If greater or equal, exit loop
-                            default: branch_op = "BR_NE"; break;
-                        }
-                        
-                        if (outputFile) {
-                            emit_buffered("%s %s %s %s", branch_op, op1_temp, op2_temp, label2);
-                        }
-                        
-                        if (op1_temp[0] == 't') release_temp_register(op1_temp);
-                        if (op2_temp[0] == 't') release_temp_register(op2_temp);
-                        
-                    } else {
-                        // Simple condition variable - exit loop if zero (false)
-                        cond_temp = generate_expression_code(tree->child[0]);
-                        if (outputFile) {
-                            emit_buffered("BR_EQ %s r0 %s", cond_temp, label2);
-                        }
-                        if (cond_temp[0] == 't') release_temp_register(cond_temp);
+                    // Exit the loop when the condition is false
+                    emit_condition_branch(tree->child[0], 0, label2);
+                    if (emit_block_labels()) {
+                        emit_buffered("label_op %s ___ ___", label_body);
                     }
 
                     // Generate loop body
@@ -1084,6 +1264,7 @@ static void generate_statement_code(TreeNode *tree) {
             fprintf(stderr, "Erro: Tipo de nó desconhecido em generate_statement_code\n");
             break;
     }
+    current_source_line = saved_source_line;
 }
 
 
@@ -1165,7 +1346,8 @@ static void generateFunctions(TreeNode *tree) {
 
     if (tree->nodekind == ExpK && tree->kind.exp == TypeK) {
         TreeNode *actual_decl = tree->child[0];
-        if (actual_decl != NULL && actual_decl->kind.exp == FuncK) {
+        // Protótipos (sem corpo) não geram código
+        if (actual_decl != NULL && actual_decl->kind.exp == FuncK && actual_decl->add != 1) {
             // Initialize for new function
             instruction_buffer_count = 0;
             local_vars_count = 0;
@@ -1248,6 +1430,10 @@ void codeGen(TreeNode *syntaxTree, char * irOutputFile, const char *sourceFilena
     }
     
     // Initialize enhanced IR system
+    lineTableReset();
+    codeStatsReset();
+    ir_lines_written = 0;
+    current_source_line = 0;
     init_register_pool();
     current_scope_level = 0;
     current_stack_offset = 0;
@@ -1264,6 +1450,10 @@ void codeGen(TreeNode *syntaxTree, char * irOutputFile, const char *sourceFilena
     printf("Memory Management: Stack-based with alignment\n");
     printf("=============================================\n\n");
     
+    // Funções e globais inalcançáveis a partir do main não são geradas
+    reachabilityAnalyze(syntaxTree);
+    reachabilityReport(stdout);
+
     globalVars = NULL; // Inicializa lista de variáveis globais
 
     // Processa todas as declarações de nível superior
@@ -1272,7 +1462,7 @@ void codeGen(TreeNode *syntaxTree, char * irOutputFile, const char *sourceFilena
         // Primeiro passo: Gera declarações de variáveis globais
         if (current->nodekind == ExpK && current->kind.exp == TypeK) {
             TreeNode *actual_decl = current->child[0];
-            if (actual_decl != NULL && actual_decl->kind.exp == VarK) {
+            if (actual_decl != NULL && actual_decl->kind.exp == VarK && reachabilityGlobalLive(actual_decl->attr.name)) {
                 // Declaração de variável global
                 int size = 0; // 0 para variável simples, >0 para tamanho do array
                 if (actual_decl->child[0] != NULL && actual_decl->child[0]->kind.exp == ConstK) { // Array
@@ -1280,6 +1470,7 @@ void codeGen(TreeNode *syntaxTree, char * irOutputFile, const char *sourceFilena
                 }
                 addGlobalVar(copyString(actual_decl->attr.name), size); // Adiciona à lista interna
                 emit_global_decl(actual_decl->attr.name, size);         // Emite para arquivo
+                emit_global_init(actual_decl->attr.name, current->child[1]);
             }
         }
         current = current->sibling;
@@ -1288,6 +1479,7 @@ void codeGen(TreeNode *syntaxTree, char * irOutputFile, const char *sourceFilena
     // Adiciona linha em branco após declarações globais se alguma foi impressa
     if (globalVars != NULL) {
         fprintf(outputFile, "\n");
+        ir_lines_written++;
     }
     
     // Segundo passo: Gera código de função
@@ -1295,7 +1487,9 @@ void codeGen(TreeNode *syntaxTree, char * irOutputFile, const char *sourceFilena
     while (current != NULL) {
         if (current->nodekind == ExpK && current->kind.exp == TypeK) {
             TreeNode *actual_decl = current->child[0];
-            if (actual_decl != NULL && actual_decl->kind.exp == FuncK) {
+            // Protótipos (sem corpo) e funções mortas não geram código
+            if (actual_decl != NULL && actual_decl->kind.exp == FuncK && actual_decl->add != 1 &&
+                reachabilityFunctionLive(actual_decl->attr.name)) {
                 // Initialize for new function
                 instruction_buffer_count = 0;
                 local_vars_count = 0;
@@ -1307,6 +1501,10 @@ void codeGen(TreeNode *syntaxTree, char * irOutputFile, const char *sourceFilena
                 release_all_temps();
                 stats.total_functions++;
 
+                // Prólogo e epílogo ficam na linha do cabeçalho da função
+                current_function_line = actual_decl->lineno;
+                current_source_line = current_function_line;
+
                 // Collect parameters
                 TreeNode *param_node = actual_decl->child[0];
                 while (param_node != NULL && param_count < MAX_FUNC_PARAMS) {
@@ -1366,6 +1564,7 @@ void codeGen(TreeNode *syntaxTree, char * irOutputFile, const char *sourceFilena
     
     // Finish and cleanup
     fclose(outputFile);
+    reachabilityFree();
     
     // Print compilation statistics
     printf("\n=== Compilation Statistics ===\n");
@@ -1668,6 +1867,7 @@ static void emit_buffered_with_stats(const char *instruction_format, ...) {
     va_start(args, instruction_format);
     vsnprintf(buf, sizeof(buf), instruction_format, args);
     va_end(args);
+    instruction_source_line[instruction_buffer_count] = current_source_line;
     instruction_buffer[instruction_buffer_count++] = copyString(buf);
     
     // Atualiza estatísticas
@@ -1787,21 +1987,79 @@ void generateAssemblyFromIR(const char *irOutputFile, const char *sourceFilename
     generateAssemblyFromIRImproved(irOutputFile, assemblyFilename);
     printf("✓ Código Assembly gerado em %s\n", assemblyFilename);
     
-    // Generate binary files (.bin and .binbd) from assembly
-    generateBinaryWithAutoNaming(assemblyFilename);
-    
     // Generate clean filenames for output messages
     char baseFilename[256];
     strcpy(baseFilename, assemblyFilename);
     char *asmDot = strrchr(baseFilename, '.');
     if (asmDot) *asmDot = '\0';
-    
-    printf("✓ Código Binário limpo gerado em %s.bin\n", baseFilename);
-    printf("✓ Código Binário comentado gerado em %s.binbd\n", baseFilename);
+
+    if (CompileOnly) {
+        // Objeto relocável, ligado depois pelo acmc-ld (-c)
+        char objectFilename[300];
+        snprintf(objectFilename, sizeof(objectFilename), "%s.obj", baseFilename);
+        if (generateObjectFromAssembly(assemblyFilename, objectFilename, sourceFilename) == 0) {
+            printf("✓ Objeto relocável gerado em %s\n", objectFilename);
+        } else {
+            Error = TRUE;
+        }
+    } else {
+        // Generate binary files (.bin and .binbd) from assembly
+        if (generateBinaryWithAutoNaming(assemblyFilename) == 0) {
+            printf("✓ Código Binário limpo gerado em %s.bin\n", baseFilename);
+            printf("✓ Código Binário comentado gerado em %s.binbd\n", baseFilename);
+        } else {
+            Error = TRUE;
+        }
+    }
+
+    // Address -> IR line -> source line table
+    char linesFilename[300];
+    snprintf(linesFilename, sizeof(linesFilename), "%s.lines", baseFilename);
+    if (lineTableWrite(linesFilename, sourceFilename, irOutputFile) == 0) {
+        printf("✓ Tabela de linhas gerada em %s\n", linesFilename);
+    }
+
+    // Mapa dos contadores de blocos básicos (--instrument=blocks)
+    if (InstrumentBlocks) {
+        char blocksFilename[300];
+        snprintf(blocksFilename, sizeof(blocksFilename), "%s.blocks", baseFilename);
+        if (writeBlockMap(blocksFilename, sourceFilename) == 0) {
+            printf("✓ Mapa de blocos gerado em %s\n", blocksFilename);
+        }
+    }
+
+    // Métricas estáticas por função (--stats)
+    if (WriteCodeStats) {
+        char statsFilename[300];
+        snprintf(statsFilename, sizeof(statsFilename), "%s.stats.json", baseFilename);
+        if (codeStatsWrite(statsFilename, sourceFilename) == 0) {
+            printf("✓ Métricas do código geradas em %s\n", statsFilename);
+        }
+    }
 }
 
 static void generate_store_vet(const char *src_reg, const char *array_name, TreeNode *index_tree) {
     char *index_temp_reg = generate_expression_code(index_tree);
     emit_buffered("storeVet %s %s %s %s", src_reg, array_name, index_temp_reg, current_func_name_codegen);
     if (index_temp_reg && index_temp_reg[0] == 't') release_temp_register(index_temp_reg);
-}
\ No newline at end of file
+}
+
+// output(x) e output(v[i]): o valor vai para a saída direto da memória
+// (outputVar/outputVet viram outputmem), sem carga em registrador nem
+// move para r1. Retorna 0 se o argumento não é uma variável ou elemento
+static int generate_output_from_memory(TreeNode *arg) {
+    if (arg == NULL || arg->sibling != NULL || arg->nodekind != ExpK ||
+        (arg->kind.exp != IdK && arg->kind.exp != VarK)) {
+        return 0;
+    }
+    if (arg->child[0] == NULL) {
+        emit_buffered("outputVar %s %s ___", current_func_name_codegen, arg->attr.name);
+        return 1;
+    }
+    char *index_temp_reg = generate_expression_code(arg->child[0]);
+    VariableInfo *array_info = get_variable_info(arg->attr.name);
+    int base = array_info && array_info->stack_offset >= 0 ? array_info->stack_offset : 0;
+    emit_buffered("outputVet %s %d %s ___", arg->attr.name, base, index_temp_reg);
+    if (index_temp_reg && index_temp_reg[0] == 't') release_temp_register(index_temp_reg);
+    return 1;
+}
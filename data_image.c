@@ -0,0 +1,47 @@
+/*
+ * data_image.c - Data memory initialization files (.data.mif)
+ */
+
+#include "data_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static int compareAddress(const void *a, const void *b) {
+    uint32_t x = ((const DataWord *)a)->address, y = ((const DataWord *)b)->address;
+    return x < y ? -1 : x > y;
+}
+
+static void writeZeros(FILE *f, uint32_t first, uint32_t last) {
+    if (first == last) fprintf(f, "\t%u : 0;\n", first);
+    else fprintf(f, "\t[%u..%u] : 0;\n", first, last);
+}
+
+int dataImageWrite(const char *filename, const char *origin, DataWord *words, int count) {
+    qsort(words, count, sizeof(DataWord), compareAddress);
+    for (int i = 0; i < count; i++) {
+        if (words[i].address >= DATA_IMAGE_DEPTH || (i > 0 && words[i].address == words[i - 1].address)) {
+            fprintf(stderr, "Error: %s: bad or repeated data address %u\n", filename, words[i].address);
+            return -1;
+        }
+    }
+
+    FILE *f = fopen(filename, "w");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot create data image %s\n", filename);
+        return -1;
+    }
+    fprintf(f, "-- Initial data memory of %s\n", origin);
+    fprintf(f, "WIDTH=32;\nDEPTH=%d;\n\nADDRESS_RADIX=DEC;\nDATA_RADIX=DEC;\n\nCONTENT BEGIN\n", DATA_IMAGE_DEPTH);
+    uint32_t next = 0;
+    for (int i = 0; i < count; i++) {
+        if (words[i].address > next) writeZeros(f, next, words[i].address - 1);
+        fprintf(f, "\t%u : %d;\n", words[i].address, words[i].value);
+        next = words[i].address + 1;
+    }
+    if (next < DATA_IMAGE_DEPTH) writeZeros(f, next, DATA_IMAGE_DEPTH - 1);
+    fprintf(f, "END;\n");
+
+    int failed = ferror(f);
+    fclose(f);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef DATA_IMAGE_H
+#define DATA_IMAGE_H
+
+/**
+ * data_image.h - Initial contents of the data memory (.data.mif)
+ *
+ * Global variables with initializers ("int v[3] = {1, 2, 3};") get their
+ * values from the memory initialization file of the data RAM instead of
+ * stores executed at start-up. binary_generator.c writes <name>.data.mif
+ * next to the .bin, acmc-ld writes one for a linked image and acmc-sim
+ * loads it together with the program.
+ *
+ * The file is a Quartus .mif with WIDTH=32, DEPTH=DATA_IMAGE_DEPTH and
+ * decimal radix: one line per initialized word, and zero-filled ranges
+ * "[first..last] : 0;" between them.
+ */
+
+#include <stdint.h>
+
+#define DATA_IMAGE_DEPTH 16384         // 14-bit data address space
+#define DATA_IMAGE_SUFFIX ".data.mif"
+
+typedef struct {
+    uint32_t address;
+    int32_t value;
+} DataWord;
+
+// Writes the words, sorted by address (distinct, below DATA_IMAGE_DEPTH);
+// 'origin' names the program in the header comment. Returns 0 on success.
+int dataImageWrite(const char *filename, const char *origin, DataWord *words, int count);
+
+#endif /* DATA_IMAGE_H */
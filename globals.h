@@ -24,7 +24,7 @@
 #endif
 
 // Número máximo de palavras reservadas na linguagem
-#define MAXRESERVED 8
+#define MAXRESERVED 9
 
 // Tipo de token utilizado pelo Yacc/Bison
 typedef int TokenType;
@@ -36,6 +36,15 @@ extern FILE *listing;  // Arquivo de saída para listagem
 // Número da linha atual do código fonte para relatórios
 extern int lineno;
 
+// Instrumenta os blocos básicos com contadores (--instrument=blocks)
+extern int InstrumentBlocks;
+
+// Grava as métricas estáticas do código gerado em .stats.json (--stats)
+extern int WriteCodeStats;
+
+// Compila só a unidade, sem exigir main, e grava o objeto .obj (-c)
+extern int CompileOnly;
+
 /**************************************************/
 /********** Árvore Sintática para Parsing ********/
 /**************************************************/
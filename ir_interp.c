@@ -0,0 +1,840 @@
+/*
+ * ir_interp.c - Interpreter for the intermediate code (see ir_interp.h)
+ */
+
+#include "ir_interp.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IR_NAME_LEN 64
+#define IR_MAX_ARGS 64                 // param values waiting for their call
+#define IR_MAX_DEPTH 100000            // Active calls
+#define IR_MAX_LOCAL_ARRAY (1 << 20)   // Elements; local arrays have no size in the IR
+
+#define IR_CALL_INPUT (-1)
+#define IR_CALL_OUTPUT (-2)
+
+typedef enum {
+    IR_LOAD_VAR, IR_STORE_VAR, IR_LOAD_VET, IR_STORE_VET,
+    IR_ADD, IR_SUB, IR_MULT, IR_DIV, IR_MOD,
+    IR_MFHI, IR_MFLO,
+    IR_AND, IR_OR, IR_SLL, IR_SRL,
+    IR_SEQ, IR_SNE, IR_SLT, IR_SLE, IR_SGT, IR_SGE,
+    IR_LI, IR_MOVE,
+    IR_BR_EQ, IR_BR_NE, IR_BR_LT, IR_BR_LE, IR_BR_GT, IR_BR_GE,
+    IR_JUMP, IR_PARAM, IR_CALL, IR_FUN_END,
+    IR_OUTPUT_VAR, IR_OUTPUT_VET,
+    IR_LABEL,                          // Not counted
+    IR_OPS
+} IrOp;
+
+static const char *op_names[IR_OPS] = {
+    "loadVar", "storeVar", "loadVet", "storeVet",
+    "add", "sub", "mult", "div", "mod",
+    "mfhi", "mflo",
+    "and", "or", "sll", "srl",
+    "seq", "sne", "slt", "sle", "sgt", "sge",
+    "li", "move",
+    "BR_EQ", "BR_NE", "BR_LT", "BR_LE", "BR_GT", "BR_GE",
+    "jump", "param", "call", "funFim",
+    "outputVar", "outputVet",
+    "label_op"
+};
+
+// Other spellings the backend accepts for the comparisons
+static const struct {
+    const char *name;
+    IrOp op;
+} op_aliases[] = {
+    {"set", IR_SEQ}, {"sdt", IR_SNE}, {"slet", IR_SLE}, {"sget", IR_SGE},
+};
+
+typedef enum { OPND_NONE, OPND_IMM, OPND_TEMP, OPND_RF, OPND_ZERO, OPND_LOCAL, OPND_GLOBAL } OperandKind;
+
+typedef struct {
+    OperandKind kind;
+    int32_t n;                 // Value, temporary or variable slot
+} IrOperand;
+
+typedef struct {
+    IrOp op;
+    IrOperand a, b, c;         // c is the destination, when there is one
+    int target;                // Instruction of a label, or function called
+    int function;
+    int line;
+} IrInsn;
+
+typedef struct {
+    int32_t *data;
+    int32_t size;
+    int fixed;                 // Global arrays have their declared size
+} IrArray;
+
+typedef struct {
+    int32_t value;
+    IrArray *array;            // Set when the value refers to an array
+} IrValue;
+
+typedef struct {
+    char name[IR_NAME_LEN];
+    IrValue value;
+    IrArray array;
+} IrGlobal;
+
+typedef struct {
+    char name[IR_NAME_LEN];
+    int entry;                 // -1 until its funInicio is seen
+    char (*vars)[IR_NAME_LEN];
+    int var_count, var_capacity;
+    int declared;              // Variables from allocaMemVar, parameters first
+    int temp_count;
+    uint64_t calls;
+    uint64_t operations;
+} IrFunction;
+
+typedef struct {
+    char name[IR_NAME_LEN];
+    int function;
+    int insn;
+} IrLabel;
+
+// A quadruple as read, before its operands are resolved
+typedef struct {
+    IrOp op;
+    char args[4][IR_NAME_LEN];
+    int function;
+    int line;
+} IrRawInsn;
+
+typedef struct {
+    int function;
+    int return_pc;
+    IrValue *vars;
+    IrArray *arrays;           // Storage of the local arrays
+    IrValue *temps;
+} IrFrame;
+
+typedef struct {
+    const char *filename;
+    IrInsn *code;
+    int code_count;
+    IrFunction *functions;
+    int function_count, function_capacity;
+    IrGlobal *globals;
+    int global_count, global_capacity;
+    IrLabel *labels;
+    int label_count, label_capacity;
+
+    IrFrame *frames;
+    int depth, frame_capacity;
+    IrValue args[IR_MAX_ARGS];
+    int arg_count;
+    IrValue rf;                // $rf / r28: return value
+    int32_t hi, lo;            // Remainder and quotient of the last div/mod
+    FILE *input;
+    FILE *output;
+
+    uint64_t operations;
+    uint64_t op_counts[IR_OPS];
+    uint32_t outputs;
+    int finished;
+    int failed;
+    int failed_line;
+    char message[128];
+} IrProgram;
+
+static void *growArray(void *items, int *capacity, size_t size) {
+    int new_capacity = *capacity ? *capacity * 2 : 16;
+    void *grown = realloc(items, new_capacity * size);
+    if (grown) *capacity = new_capacity;
+    return grown;
+}
+
+static void fail(IrProgram *p, int line, const char *format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(p->message, sizeof(p->message), format, ap);
+    va_end(ap);
+    p->failed = 1;
+    p->failed_line = line;
+}
+
+// --- Loading ---
+
+static int findFunction(const IrProgram *p, const char *name) {
+    for (int i = 0; i < p->function_count; i++) {
+        if (strcmp(p->functions[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int addFunction(IrProgram *p, const char *name) {
+    int f = findFunction(p, name);
+    if (f >= 0) return f;
+    if (p->function_count == p->function_capacity) {
+        IrFunction *grown = growArray(p->functions, &p->function_capacity, sizeof(IrFunction));
+        if (!grown) return -1;
+        p->functions = grown;
+    }
+    IrFunction *fn = &p->functions[p->function_count];
+    memset(fn, 0, sizeof(*fn));
+    strcpy(fn->name, name);
+    fn->entry = -1;
+    return p->function_count++;
+}
+
+static int findVariable(const IrFunction *fn, const char *name) {
+    for (int i = 0; i < fn->var_count; i++) {
+        if (strcmp(fn->vars[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+static int addVariable(IrFunction *fn, const char *name) {
+    if (fn->var_count == fn->var_capacity) {
+        char (*grown)[IR_NAME_LEN] = growArray(fn->vars, &fn->var_capacity, IR_NAME_LEN);
+        if (!grown) return -1;
+        fn->vars = grown;
+    }
+    strcpy(fn->vars[fn->var_count], name);
+    return fn->var_count++;
+}
+
+static int findGlobal(const IrProgram *p, const char *name) {
+    for (int i = 0; i < p->global_count; i++) {
+        if (strcmp(p->globals[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int addGlobal(IrProgram *p, const char *name, int size) {
+    if (findGlobal(p, name) >= 0) return 0;
+    if (p->global_count == p->global_capacity) {
+        IrGlobal *grown = growArray(p->globals, &p->global_capacity, sizeof(IrGlobal));
+        if (!grown) return -1;
+        p->globals = grown;
+    }
+    IrGlobal *g = &p->globals[p->global_count];
+    memset(g, 0, sizeof(*g));
+    strcpy(g->name, name);
+    if (size > 0) {
+        g->array.data = calloc(size, sizeof(int32_t));
+        if (!g->array.data) return -1;
+        g->array.size = size;
+        g->array.fixed = 1;
+    }
+    p->global_count++;
+    return 0;
+}
+
+static int addLabel(IrProgram *p, const char *name, int function, int insn) {
+    if (p->label_count == p->label_capacity) {
+        IrLabel *grown = growArray(p->labels, &p->label_capacity, sizeof(IrLabel));
+        if (!grown) return -1;
+        p->labels = grown;
+    }
+    IrLabel *l = &p->labels[p->label_count++];
+    strcpy(l->name, name);
+    l->function = function;
+    l->insn = insn;
+    return 0;
+}
+
+static int findLabel(const IrProgram *p, int function, const char *name) {
+    for (int i = 0; i < p->label_count; i++) {
+        if (p->labels[i].function == function && strcmp(p->labels[i].name, name) == 0) return p->labels[i].insn;
+    }
+    return -1;
+}
+
+static int lookupOp(const char *name, IrOp *op) {
+    for (int i = 0; i < IR_OPS; i++) {
+        if (strcmp(op_names[i], name) == 0) {
+            *op = (IrOp)i;
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < sizeof(op_aliases) / sizeof(op_aliases[0]); i++) {
+        if (strcmp(op_aliases[i].name, name) == 0) {
+            *op = op_aliases[i].op;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Immediates, temporaries, $rf (r28) and r0
+static int parseValue(IrFunction *fn, const char *s, IrOperand *o) {
+    if (isdigit((unsigned char)s[0]) || (s[0] == '-' && isdigit((unsigned char)s[1]))) {
+        o->kind = OPND_IMM;
+        o->n = (int32_t)strtol(s, NULL, 10);
+    } else if (strcmp(s, "$rf") == 0 || strcmp(s, "r28") == 0) {
+        o->kind = OPND_RF;
+    } else if (strcmp(s, "r0") == 0) {
+        o->kind = OPND_ZERO;
+    } else if (s[0] == 't' && isdigit((unsigned char)s[1])) {
+        o->kind = OPND_TEMP;
+        o->n = atoi(s + 1);
+        if (o->n >= fn->temp_count) fn->temp_count = o->n + 1;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int parseDestination(IrFunction *fn, const char *s, IrOperand *o) {
+    return parseValue(fn, s, o) == 0 && o->kind != OPND_IMM ? 0 : -1;
+}
+
+// Declared locals first, then globals; any other name becomes a local
+// that reads as 0 until it is stored
+static int parseVariable(IrProgram *p, IrFunction *fn, const char *name, IrOperand *o) {
+    int slot = findVariable(fn, name);
+    if (slot < 0) {
+        int g = findGlobal(p, name);
+        if (g >= 0) {
+            o->kind = OPND_GLOBAL;
+            o->n = g;
+            return 0;
+        }
+        slot = addVariable(fn, name);
+        if (slot < 0) return -1;
+    }
+    o->kind = OPND_LOCAL;
+    o->n = slot;
+    return 0;
+}
+
+static int resolveInsn(IrProgram *p, const IrRawInsn *raw, IrInsn *in) {
+    IrFunction *fn = &p->functions[raw->function];
+    const char (*args)[IR_NAME_LEN] = raw->args;
+    int ok = 1;
+
+    memset(in, 0, sizeof(*in));
+    in->op = raw->op;
+    in->function = raw->function;
+    in->line = raw->line;
+    in->target = -1;
+
+    switch (raw->op) {
+        case IR_LOAD_VAR:      // loadVar scope var dest
+            ok = parseVariable(p, fn, args[1], &in->a) == 0 && parseDestination(fn, args[2], &in->c) == 0;
+            break;
+        case IR_STORE_VAR:     // storeVar src var scope
+            ok = parseValue(fn, args[0], &in->a) == 0 && parseVariable(p, fn, args[1], &in->b) == 0;
+            break;
+        case IR_LOAD_VET:      // loadVet array base index dest
+            ok = parseVariable(p, fn, args[0], &in->a) == 0 && parseValue(fn, args[2], &in->b) == 0 &&
+                 parseDestination(fn, args[3], &in->c) == 0;
+            break;
+        case IR_OUTPUT_VAR:    // outputVar scope var
+            ok = parseVariable(p, fn, args[1], &in->a) == 0;
+            break;
+        case IR_OUTPUT_VET:    // outputVet array base index
+            ok = parseVariable(p, fn, args[0], &in->a) == 0 && parseValue(fn, args[2], &in->b) == 0;
+            break;
+        case IR_STORE_VET:     // storeVet src array index scope
+            ok = parseValue(fn, args[0], &in->a) == 0 && parseVariable(p, fn, args[1], &in->b) == 0 &&
+                 parseValue(fn, args[2], &in->c) == 0;
+            break;
+        case IR_LI:            // li dest value
+        case IR_MOVE:          // move dest src
+            ok = parseDestination(fn, args[0], &in->c) == 0 && parseValue(fn, args[1], &in->a) == 0;
+            break;
+        case IR_MFHI:          // mfhi dest
+        case IR_MFLO:
+            ok = parseDestination(fn, args[0], &in->c) == 0;
+            break;
+        case IR_BR_EQ: case IR_BR_NE: case IR_BR_LT:
+        case IR_BR_LE: case IR_BR_GT: case IR_BR_GE:
+            ok = parseValue(fn, args[0], &in->a) == 0 && parseValue(fn, args[1], &in->b) == 0;
+            in->target = findLabel(p, raw->function, args[2]);
+            if (ok && in->target < 0) {
+                fail(p, raw->line, "label %s not found in %s", args[2], fn->name);
+                return -1;
+            }
+            break;
+        case IR_JUMP:
+            in->target = findLabel(p, raw->function, args[0]);
+            if (in->target < 0) {
+                fail(p, raw->line, "label %s not found in %s", args[0], fn->name);
+                return -1;
+            }
+            break;
+        case IR_PARAM:
+            ok = parseValue(fn, args[0], &in->a) == 0;
+            break;
+        case IR_CALL:          // call function count
+            if (strcmp(args[0], "input") == 0) {
+                in->target = IR_CALL_INPUT;
+            } else if (strcmp(args[0], "output") == 0) {
+                in->target = IR_CALL_OUTPUT;
+            } else {
+                in->target = findFunction(p, args[0]);
+                if (in->target < 0 || p->functions[in->target].entry < 0) {
+                    fail(p, raw->line, "function %s not found", args[0]);
+                    return -1;
+                }
+            }
+            ok = parseValue(fn, args[1], &in->b) == 0 && in->b.kind == OPND_IMM && in->b.n >= 0;
+            break;
+        case IR_FUN_END:
+        case IR_LABEL:
+            break;
+        default:               // Arithmetic and comparisons: op src1 src2 dest
+            ok = parseValue(fn, args[0], &in->a) == 0 && parseValue(fn, args[1], &in->b) == 0 &&
+                 parseDestination(fn, args[2], &in->c) == 0;
+            break;
+    }
+    if (!ok) {
+        fail(p, raw->line, "bad operands for %s", op_names[raw->op]);
+        return -1;
+    }
+    return 0;
+}
+
+static void freeProgram(IrProgram *p) {
+    for (int i = 0; i < p->depth; i++) {
+        IrFrame *fr = &p->frames[i];
+        for (int v = 0; v < p->functions[fr->function].var_count; v++) free(fr->arrays[v].data);
+        free(fr->vars);
+        free(fr->arrays);
+        free(fr->temps);
+    }
+    free(p->frames);
+    for (int i = 0; i < p->function_count; i++) free(p->functions[i].vars);
+    free(p->functions);
+    for (int i = 0; i < p->global_count; i++) free(p->globals[i].array.data);
+    free(p->globals);
+    free(p->labels);
+    free(p->code);
+}
+
+// Reads the quadruples, then resolves names once every function, global
+// and label is known
+static int loadProgram(IrProgram *p, const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "IR file %s not found\n", filename);
+        return -1;
+    }
+
+    IrRawInsn *raw = NULL;
+    int raw_count = 0, raw_capacity = 0;
+    int current = -1;
+    char line[512];
+    int line_number = 0;
+    while (!p->failed && fgets(line, sizeof(line), f)) {
+        char fields[5][IR_NAME_LEN] = { "" };
+        line_number++;
+        int parsed = sscanf(line, "%63s %63s %63s %63s %63s", fields[0], fields[1], fields[2], fields[3], fields[4]);
+        if (parsed < 1 || fields[0][0] == '#') continue;
+        for (int i = 0; i < 5; i++) {
+            char *comma = strchr(fields[i], ',');
+            if (comma) *comma = '\0';
+        }
+
+        size_t length = strlen(fields[0]);
+        if (strcmp(fields[0], "GLOBAL_ARRAY") == 0 || strcmp(fields[0], "GLOBAL") == 0) {
+            int size = fields[0][6] == '_' ? atoi(fields[2]) : 0;
+            if (addGlobal(p, fields[1], size) != 0) fail(p, line_number, "cannot allocate %s", fields[1]);
+            continue;
+        }
+        if (strcmp(fields[0], "GLOBAL_INIT") == 0) {   // GLOBAL_INIT name index value
+            int g = findGlobal(p, fields[1]);
+            int index = atoi(fields[2]);
+            if (g < 0) {
+                fail(p, line_number, "initial value for undeclared %s", fields[1]);
+            } else if (p->globals[g].array.fixed) {
+                if (index < 0 || index >= p->globals[g].array.size) fail(p, line_number, "%s[%d] out of bounds", fields[1], index);
+                else p->globals[g].array.data[index] = (int32_t)strtol(fields[3], NULL, 10);
+            } else {
+                p->globals[g].value.value = (int32_t)strtol(fields[3], NULL, 10);
+            }
+            continue;
+        }
+        if (strcmp(fields[0], "allocaMemVar") == 0) {
+            int fn = addFunction(p, fields[1]);
+            if (fn < 0 || findVariable(&p->functions[fn], fields[2]) >= 0) continue;
+            if (addVariable(&p->functions[fn], fields[2]) < 0) fail(p, line_number, "out of memory");
+            p->functions[fn].declared = p->functions[fn].var_count;
+            continue;
+        }
+        if (strcmp(fields[0], "funInicio") == 0) {
+            current = addFunction(p, fields[1]);
+            if (current >= 0) p->functions[current].entry = raw_count;
+            continue;
+        }
+
+        IrOp op;
+        int is_label = length > 1 && fields[0][length - 1] == ':';
+        if (is_label) {
+            fields[0][length - 1] = '\0';
+            strcpy(fields[1], fields[0]);
+            op = IR_LABEL;
+        } else if (lookupOp(fields[0], &op) != 0) {
+            fail(p, line_number, "unsupported IR operation %s", fields[0]);
+            break;
+        }
+        if (current < 0) {
+            fail(p, line_number, "%s outside a function", fields[0]);
+            break;
+        }
+        if (op == IR_LABEL && addLabel(p, fields[1], current, raw_count) != 0) {
+            fail(p, line_number, "out of memory");
+            break;
+        }
+        if (raw_count == raw_capacity) {
+            IrRawInsn *grown = growArray(raw, &raw_capacity, sizeof(IrRawInsn));
+            if (!grown) {
+                fail(p, line_number, "out of memory");
+                break;
+            }
+            raw = grown;
+        }
+        IrRawInsn *r = &raw[raw_count++];
+        r->op = op;
+        r->function = current;
+        r->line = line_number;
+        for (int i = 0; i < 4; i++) strcpy(r->args[i], fields[i + 1]);
+        if (op == IR_FUN_END) current = -1;
+    }
+    fclose(f);
+
+    p->code = p->failed ? NULL : malloc((raw_count ? raw_count : 1) * sizeof(IrInsn));
+    if (!p->failed && !p->code) fail(p, line_number, "out of memory");
+    for (int i = 0; i < raw_count && !p->failed; i++) {
+        resolveInsn(p, &raw[i], &p->code[i]);
+    }
+    p->code_count = raw_count;
+    free(raw);
+
+    for (int i = 0; i < p->global_count; i++) {
+        if (p->globals[i].array.fixed) p->globals[i].value.array = &p->globals[i].array;
+    }
+    if (!p->failed && raw_count > 0 && p->code[raw_count - 1].op != IR_FUN_END) {
+        fail(p, p->code[raw_count - 1].line, "function %s has no funFim", p->functions[p->code[raw_count - 1].function].name);
+    }
+    if (p->failed) {
+        fprintf(stderr, "%s:%d: %s\n", filename, p->failed_line, p->message);
+        return -1;
+    }
+    return 0;
+}
+
+// --- Execution ---
+
+static int pushFrame(IrProgram *p, int function, int return_pc) {
+    if (p->depth == IR_MAX_DEPTH) {
+        fail(p, p->code[return_pc - 1].line, "more than %d nested calls", IR_MAX_DEPTH);
+        return -1;
+    }
+    if (p->depth == p->frame_capacity) {
+        IrFrame *grown = growArray(p->frames, &p->frame_capacity, sizeof(IrFrame));
+        if (!grown) return -1;
+        p->frames = grown;
+    }
+    IrFunction *fn = &p->functions[function];
+    IrFrame *fr = &p->frames[p->depth];
+    fr->function = function;
+    fr->return_pc = return_pc;
+    fr->vars = calloc(fn->var_count ? fn->var_count : 1, sizeof(IrValue));
+    fr->arrays = calloc(fn->var_count ? fn->var_count : 1, sizeof(IrArray));
+    fr->temps = calloc(fn->temp_count ? fn->temp_count : 1, sizeof(IrValue));
+    if (!fr->vars || !fr->arrays || !fr->temps) {
+        free(fr->vars);
+        free(fr->arrays);
+        free(fr->temps);
+        return -1;
+    }
+    p->depth++;
+    fn->calls++;
+    return 0;
+}
+
+static void popFrame(IrProgram *p) {
+    IrFrame *fr = &p->frames[--p->depth];
+    for (int v = 0; v < p->functions[fr->function].var_count; v++) free(fr->arrays[v].data);
+    free(fr->vars);
+    free(fr->arrays);
+    free(fr->temps);
+}
+
+static IrValue readValue(const IrProgram *p, const IrFrame *fr, const IrOperand *o) {
+    IrValue v = { 0, NULL };
+    if (o->kind == OPND_IMM) v.value = o->n;
+    else if (o->kind == OPND_TEMP) v = fr->temps[o->n];
+    else if (o->kind == OPND_RF) v = p->rf;
+    return v;
+}
+
+static void writeValue(IrProgram *p, IrFrame *fr, const IrOperand *o, IrValue v) {
+    if (o->kind == OPND_TEMP) fr->temps[o->n] = v;
+    else if (o->kind == OPND_RF) p->rf = v;
+}
+
+static IrValue *variable(IrProgram *p, IrFrame *fr, const IrOperand *o) {
+    return o->kind == OPND_GLOBAL ? &p->globals[o->n].value : &fr->vars[o->n];
+}
+
+// Element 'index' of the array in variable 'o'; a local that does not
+// hold a reference gets an array of its own that grows as it is indexed
+static int32_t *element(IrProgram *p, IrFrame *fr, const IrInsn *in, const IrOperand *o, int32_t index) {
+    IrValue *v = variable(p, fr, o);
+    if (!v->array && o->kind == OPND_LOCAL) v->array = &fr->arrays[o->n];
+    IrArray *a = v->array;
+    if (!a) {
+        fail(p, in->line, "%s is not an array", p->globals[o->n].name);
+        return NULL;
+    }
+    if (index < 0 || (a->fixed && index >= a->size)) {
+        fail(p, in->line, "index %d out of bounds (size %d)", index, a->size);
+        return NULL;
+    }
+    if (index >= a->size) {
+        int32_t size = a->size ? a->size : 16;
+        while (size <= index) size *= 2;
+        int32_t *grown = index < IR_MAX_LOCAL_ARRAY ? realloc(a->data, size * sizeof(int32_t)) : NULL;
+        if (!grown) {
+            fail(p, in->line, "local array index %d too large", index);
+            return NULL;
+        }
+        memset(grown + a->size, 0, (size - a->size) * sizeof(int32_t));
+        a->data = grown;
+        a->size = size;
+    }
+    return &a->data[index];
+}
+
+static void call(IrProgram *p, const IrInsn *in, int *pc) {
+    int n = in->b.n;
+    if (n > p->arg_count) {
+        fail(p, in->line, "call with %d arguments but %d params", n, p->arg_count);
+        return;
+    }
+    IrValue *args = &p->args[p->arg_count - n];
+    p->arg_count -= n;
+
+    if (in->target == IR_CALL_INPUT) {
+        long value;
+        if (fscanf(p->input, "%ld", &value) != 1) {
+            fail(p, in->line, "input() with no values left");
+            return;
+        }
+        p->rf.value = (int32_t)value;
+        p->rf.array = NULL;
+    } else if (in->target == IR_CALL_OUTPUT) {
+        if (n > 0) {
+            fprintf(p->output, "%d\n", args[0].value);
+            p->outputs++;
+        }
+    } else {
+        IrFunction *fn = &p->functions[in->target];
+        if (n > fn->declared) {
+            fail(p, in->line, "%s takes %d parameters at most", fn->name, fn->declared);
+            return;
+        }
+        // args lives in p->args, which the new frame does not touch
+        if (pushFrame(p, in->target, *pc) != 0) {
+            if (!p->failed) fail(p, in->line, "out of memory");
+            return;
+        }
+        memcpy(p->frames[p->depth - 1].vars, args, n * sizeof(IrValue));
+        *pc = fn->entry;
+    }
+}
+
+static int compare(IrOp op, int32_t x, int32_t y) {
+    switch (op) {
+        case IR_SEQ: case IR_BR_EQ: return x == y;
+        case IR_SNE: case IR_BR_NE: return x != y;
+        case IR_SLT: case IR_BR_LT: return x < y;
+        case IR_SLE: case IR_BR_LE: return x <= y;
+        case IR_SGT: case IR_BR_GT: return x > y;
+        default:                    return x >= y;
+    }
+}
+
+static void execute(IrProgram *p) {
+    int main_function = findFunction(p, "main");
+    if (main_function < 0 || p->functions[main_function].entry < 0) {
+        fail(p, 0, "no main function");
+        return;
+    }
+    if (pushFrame(p, main_function, -1) != 0) {
+        fail(p, 0, "out of memory");
+        return;
+    }
+
+    int pc = p->functions[main_function].entry;
+    while (!p->failed && !p->finished) {
+        const IrInsn *in = &p->code[pc++];
+        IrFrame *fr = &p->frames[p->depth - 1];
+        if (in->op != IR_LABEL) {
+            if (p->operations == IR_MAX_OPERATIONS) {
+                fail(p, in->line, "stopped after %llu operations", (unsigned long long)p->operations);
+                break;
+            }
+            p->operations++;
+            p->op_counts[in->op]++;
+            p->functions[fr->function].operations++;
+        }
+
+        IrValue x = readValue(p, fr, &in->a);
+        IrValue y = readValue(p, fr, &in->b);
+        IrValue result = { 0, NULL };
+        int32_t *cell;
+        switch (in->op) {
+            case IR_LOAD_VAR:
+                writeValue(p, fr, &in->c, *variable(p, fr, &in->a));
+                break;
+            case IR_STORE_VAR:
+                *variable(p, fr, &in->b) = x;
+                break;
+            case IR_LOAD_VET:
+                cell = element(p, fr, in, &in->a, y.value);
+                if (cell) {
+                    result.value = *cell;
+                    writeValue(p, fr, &in->c, result);
+                }
+                break;
+            case IR_STORE_VET:
+                cell = element(p, fr, in, &in->b, readValue(p, fr, &in->c).value);
+                if (cell) *cell = x.value;
+                break;
+            case IR_OUTPUT_VAR:
+                fprintf(p->output, "%d\n", variable(p, fr, &in->a)->value);
+                p->outputs++;
+                break;
+            case IR_OUTPUT_VET:
+                cell = element(p, fr, in, &in->a, y.value);
+                if (cell) {
+                    fprintf(p->output, "%d\n", *cell);
+                    p->outputs++;
+                }
+                break;
+            case IR_ADD:
+                result.value = (int32_t)((uint32_t)x.value + (uint32_t)y.value);
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_SUB:
+                result.value = (int32_t)((uint32_t)x.value - (uint32_t)y.value);
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_MULT:
+                result.value = (int32_t)((uint32_t)x.value * (uint32_t)y.value);
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_DIV:
+            case IR_MOD:
+                if (y.value == 0) {
+                    fail(p, in->line, "division by zero");
+                    break;
+                }
+                p->lo = y.value == -1 ? (int32_t)(0u - (uint32_t)x.value) : x.value / y.value;
+                p->hi = y.value == -1 ? 0 : x.value % y.value;
+                result.value = in->op == IR_DIV ? p->lo : p->hi;
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_MFHI:
+                result.value = p->hi;
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_MFLO:
+                result.value = p->lo;
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_AND:
+                result.value = x.value & y.value;
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_OR:
+                result.value = x.value | y.value;
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_SLL:               // Low 5 bits of the amount, as the backend
+                result.value = (int32_t)((uint32_t)x.value << (y.value & 31));
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_SRL:
+                result.value = (int32_t)((uint32_t)x.value >> (y.value & 31));
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_SEQ: case IR_SNE: case IR_SLT:
+            case IR_SLE: case IR_SGT: case IR_SGE:
+                result.value = compare(in->op, x.value, y.value);
+                writeValue(p, fr, &in->c, result);
+                break;
+            case IR_LI:
+            case IR_MOVE:
+                writeValue(p, fr, &in->c, x);
+                break;
+            case IR_BR_EQ: case IR_BR_NE: case IR_BR_LT:
+            case IR_BR_LE: case IR_BR_GT: case IR_BR_GE:
+                if (compare(in->op, x.value, y.value)) pc = in->target;
+                break;
+            case IR_JUMP:
+                pc = in->target;
+                break;
+            case IR_PARAM:
+                if (p->arg_count == IR_MAX_ARGS) fail(p, in->line, "more than %d params pending", IR_MAX_ARGS);
+                else p->args[p->arg_count++] = x;
+                break;
+            case IR_CALL:
+                call(p, in, &pc);
+                break;
+            case IR_FUN_END:
+                pc = fr->return_pc;
+                popFrame(p);
+                if (p->depth == 0) p->finished = 1;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void writeReport(const IrProgram *p, FILE *report) {
+    fprintf(report, "\n=== IR Execution ===\n");
+    if (p->finished) fprintf(report, "Status: finished\n");
+    else fprintf(report, "Status: stopped at %s:%d: %s\n", p->filename, p->failed_line, p->message);
+    fprintf(report, "Outputs: %u\n", p->outputs);
+    fprintf(report, "Dynamic IR operations: %llu\n", (unsigned long long)p->operations);
+    for (int op = 0; op < IR_LABEL; op++) {
+        if (p->op_counts[op]) {
+            fprintf(report, "  %-10s %12llu\n", op_names[op], (unsigned long long)p->op_counts[op]);
+        }
+    }
+    fprintf(report, "Per function:\n");
+    fprintf(report, "  %-16s %10s %12s\n", "function", "calls", "operations");
+    for (int f = 0; f < p->function_count; f++) {
+        const IrFunction *fn = &p->functions[f];
+        if (fn->entry < 0) continue;
+        fprintf(report, "  %-16s %10llu %12llu\n", fn->name, (unsigned long long)fn->calls,
+                (unsigned long long)fn->operations);
+    }
+    fprintf(report, "====================\n");
+}
+
+int irRun(const char *ir_filename, FILE *input, FILE *output, FILE *report) {
+    IrProgram program;
+    memset(&program, 0, sizeof(program));
+    program.filename = ir_filename;
+    program.input = input;
+    program.output = output;
+
+    if (loadProgram(&program, ir_filename) != 0) {
+        freeProgram(&program);
+        return -1;
+    }
+    execute(&program);
+    if (program.failed) fprintf(stderr, "%s:%d: %s\n", ir_filename, program.failed_line, program.message);
+    writeReport(&program, report);
+
+    int finished = program.finished;
+    freeProgram(&program);
+    return finished ? 0 : -1;
+}
@@ -0,0 +1,33 @@
+#ifndef IR_INTERP_H
+#define IR_INTERP_H
+
+/**
+ * ir_interp.h - Interpreter for the intermediate code (.ir)
+ *
+ * Runs the quadruples written by codeGen() directly, without going through
+ * assembly and binary: loadVar/storeVar, loadVet/storeVet, the arithmetic
+ * and comparison operations, li/move, BR_*, jump, param/call (input and
+ * output included), outputVar/outputVet and the function boundaries. Every operation executed
+ * is counted, per opcode and per function, so two versions of the IR of
+ * a program can be compared on dynamic work and on output.
+ *
+ * The meaning is that of the IR as written: a name is local to the
+ * function that declares it with allocaMemVar, global if there is a
+ * GLOBAL/GLOBAL_ARRAY for it and local otherwise (block variables, which
+ * have no allocaMemVar); arrays are passed by reference; "move r28 x"
+ * only sets the return value and the function returns at funFim, as in
+ * the code the backend generates. label_op and the declarations are not counted.
+ */
+
+#include <stdio.h>
+
+// Operations a run may execute before it is stopped
+#define IR_MAX_OPERATIONS 100000000ULL
+
+// Runs main from the IR in 'ir_filename'. Values for input() are read
+// from 'input' (whitespace-separated integers); output() writes one value
+// per line to 'output'. The status and the operation counts go to
+// 'report'. Returns 0 if main reached funFim.
+int irRun(const char *ir_filename, FILE *input, FILE *output, FILE *report);
+
+#endif /* IR_INTERP_H */
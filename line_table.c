@@ -0,0 +1,137 @@
+/*
+ * line_table.c - Address -> IR line -> source line table (.lines files)
+ */
+
+#include "line_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Source line per IR line
+static int *ir_source_line = NULL;
+static int ir_line_capacity = 0;
+
+// IR line per instruction address
+static int *address_ir_line = NULL;
+static int address_capacity = 0;
+static int address_count = 0;
+
+// Grows 'table' so that index 'needed' exists; new entries are 0
+static int growTable(int **table, int *capacity, int needed) {
+    if (needed < *capacity) return 0;
+    int new_capacity = *capacity ? *capacity : 256;
+    while (new_capacity <= needed) new_capacity *= 2;
+    int *grown = realloc(*table, new_capacity * sizeof(int));
+    if (!grown) return -1;
+    memset(grown + *capacity, 0, (new_capacity - *capacity) * sizeof(int));
+    *table = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+void lineTableReset(void) {
+    free(ir_source_line);
+    free(address_ir_line);
+    ir_source_line = NULL;
+    address_ir_line = NULL;
+    ir_line_capacity = 0;
+    address_capacity = 0;
+    address_count = 0;
+}
+
+void lineTableSetIRLine(int ir_line, int source_line) {
+    if (ir_line <= 0 || growTable(&ir_source_line, &ir_line_capacity, ir_line) != 0) return;
+    ir_source_line[ir_line] = source_line;
+}
+
+void lineTableAddInstruction(int address, int ir_line) {
+    if (address < 0 || growTable(&address_ir_line, &address_capacity, address) != 0) return;
+    address_ir_line[address] = ir_line;
+    if (address >= address_count) address_count = address + 1;
+}
+
+static void writeULEB(FILE *f, unsigned long value) {
+    do {
+        unsigned char byte = value & 0x7F;
+        value >>= 7;
+        if (value) byte |= 0x80;
+        fputc(byte, f);
+    } while (value);
+}
+
+static void writeSLEB(FILE *f, long value) {
+    int more = 1;
+    while (more) {
+        unsigned char byte = value & 0x7F;
+        value >>= 7;   // Arithmetic shift keeps the sign
+        if ((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40))) {
+            more = 0;
+        } else {
+            byte |= 0x80;
+        }
+        fputc(byte, f);
+    }
+}
+
+static void writeName(FILE *f, const char *path) {
+    const char *slash = strrchr(path, '/');
+    const char *name = slash ? slash + 1 : path;
+    writeULEB(f, strlen(name));
+    fwrite(name, 1, strlen(name), f);
+}
+
+int lineTableSourceLine(int ir_line) {
+    return ir_line > 0 && ir_line < ir_line_capacity ? ir_source_line[ir_line] : 0;
+}
+
+int lineTableAddressSourceLine(int address) {
+    return address >= 0 && address < address_count ? lineTableSourceLine(address_ir_line[address]) : 0;
+}
+
+int lineTableWrite(const char *lines_filename, const char *source_filename, const char *ir_filename) {
+    FILE *f = fopen(lines_filename, "wb");
+    if (!f) {
+        printf("Error: Could not create line table %s\n", lines_filename);
+        return -1;
+    }
+
+    fwrite(LINE_TABLE_MAGIC, 1, strlen(LINE_TABLE_MAGIC), f);
+    fputc(LINE_TABLE_VERSION, f);
+    writeName(f, source_filename);
+    writeName(f, ir_filename);
+
+    // Rows are counted first so the header can hold the count
+    int rows = 0;
+    int ir = 0, source = 0;
+    for (int address = 0; address < address_count; address++) {
+        int next_ir = address_ir_line[address];
+        int next_source = lineTableSourceLine(next_ir);
+        if (next_ir != ir || next_source != source) {
+            rows++;
+            ir = next_ir;
+            source = next_source;
+        }
+    }
+    writeULEB(f, (unsigned long)rows);
+
+    int last_address = 0;
+    ir = 0;
+    source = 0;
+    for (int address = 0; address < address_count; address++) {
+        int next_ir = address_ir_line[address];
+        int next_source = lineTableSourceLine(next_ir);
+        if (next_ir != ir || next_source != source) {
+            writeULEB(f, (unsigned long)(address - last_address));
+            writeSLEB(f, (long)next_ir - ir);
+            writeSLEB(f, (long)next_source - source);
+            last_address = address;
+            ir = next_ir;
+            source = next_source;
+        }
+    }
+    writeULEB(f, (unsigned long)address_count);
+
+    int failed = ferror(f);
+    fclose(f);
+    return failed ? -1 : 0;
+}
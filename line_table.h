@@ -0,0 +1,47 @@
+#ifndef LINE_TABLE_H
+#define LINE_TABLE_H
+
+/**
+ * line_table.h - Source line mapping through the compiler pipeline
+ *
+ * codegen.c records the C- source line of every IR line it writes and
+ * assembly.c records the IR line of every machine instruction it emits.
+ * After the binary is generated the table is written next to it as a
+ * .lines file mapping address -> IR line -> source line.
+ *
+ * File format (all integers LEB128, like a DWARF line program):
+ *
+ *     "ACMCLINE" version(1 byte)
+ *     uleb  length, bytes     source file name (no directory)
+ *     uleb  length, bytes     IR file name (no directory)
+ *     uleb  row count
+ *     rows: uleb address delta, sleb IR line delta, sleb source line delta
+ *     uleb  end address (one past the last instruction)
+ *
+ * Rows start from (0, 0, 0). A row is written only where the IR or
+ * source line changes and covers the addresses up to the next row.
+ * Line 0 means "no line" (the initial jump to main).
+ */
+
+#define LINE_TABLE_MAGIC "ACMCLINE"
+#define LINE_TABLE_VERSION 1
+
+// Forgets everything recorded for the previous compilation
+void lineTableReset(void);
+
+// IR line (1-based line of the .ir file) produced by a source line
+void lineTableSetIRLine(int ir_line, int source_line);
+
+// Machine instruction at 'address' produced by IR line 'ir_line'
+void lineTableAddInstruction(int address, int ir_line);
+
+// Source line recorded for an IR line (0 if none)
+int lineTableSourceLine(int ir_line);
+
+// Source line of the instruction at 'address' (0 if none)
+int lineTableAddressSourceLine(int address);
+
+// Writes the .lines file; returns 0 on success
+int lineTableWrite(const char *lines_filename, const char *source_filename, const char *ir_filename);
+
+#endif /* LINE_TABLE_H */
@@ -0,0 +1,602 @@
+/*
+ * linker.c - Links relocatable objects into a program image (acmc-ld)
+ *
+ * "acmc -c unit.c-" writes unit.obj instead of unit.bin. A unit calls the
+ * functions of other units through a prototype ("int gcd(int u, int v);")
+ * and the jal is left for the linker. The object is a text file:
+ *
+ *     ACMC-OBJ 1
+ *     source lib.c-
+ *     common vet 10        global variable of 10 words; units declaring the
+ *                          same name share it, with the largest size
+ *     data vet 2 4         initial value 4 for vet[2]
+ *     symbol gcd 0         function defined by the unit, at text word 0
+ *     reloc 12 14 .text    the 14-bit field of word 12 holds a text word of
+ *                          this unit (branch, j or la to a local label)
+ *     reloc 20 26 gcd      the 26-bit field of word 20 gets the address of gcd
+ *     text 52              then one line per word: the bits and the assembly
+ *     00111100000111100000000000000111 addi r30 r30 7
+ *
+ * The image starts with "j main", followed by the text of every object in
+ * command-line order. Global variables are laid out downwards from the
+ * block counters (BLOCK_COUNTER_BASE in memory_map.h), away from the stack
+ * that grows up from 0. The output is the .bin and the commented .binbd
+ * that acmc writes for a single unit, plus the .data.mif with the initial
+ * values of the global variables (data_image.h) when there are any; -M
+ * prints the link map.
+ *
+ * With --boot every argument is a separate program (a comma-separated list
+ * of objects, each list with its own main and its own symbols) and the
+ * image starts with a boot dispatcher instead of "j main":
+ *
+ *     input r1                   selector, 0 for the first program
+ *     addi r58 r0 <k>            for every program k
+ *     beq r1 r58 boot<k>
+ *     halt                       unknown selector
+ *   boot<k>:
+ *     addi r30 r0 <stack base>   start of the program's data partition
+ *     move r1 r0                 registers as after reset
+ *     move r58 r0
+ *     j <main of k>
+ *
+ * The data memory below the block counters is split in equal partitions,
+ * one per program: its stack grows up from the start of the partition and
+ * its global variables are laid out down from the end.
+ *
+ * Usage: acmc-ld [-o <program.bin>] [-M] <object>...
+ *        acmc-ld --boot [-o <rom.bin>] [-M] <objects>,... <objects>,...
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data_image.h"
+#include "memory_map.h"
+
+#define TEXT_LIMIT (1 << 14)        // Branch targets have 14 bits
+#define OPCODE_MOVE 0x0B
+#define OPCODE_ADDI 0x0F
+#define OPCODE_BEQ 0x13
+#define OPCODE_J 0x1C
+#define OPCODE_HALT 0x1E
+#define OPCODE_INPUT 0x22
+#define SCRATCH_REGISTER 58         // r58, the compiler's scratch register
+
+typedef struct {
+    uint32_t offset;
+    int bits;
+    char symbol[64];                // ".text" for the unit's own code
+} Relocation;
+
+typedef struct {
+    char name[64];
+    uint32_t value;                 // Text offset, or size of a common
+} Symbol;
+
+typedef struct {
+    char name[64];
+    int index;
+    int32_t value;
+} DataInit;
+
+typedef struct {
+    char filename[256];
+    char source[256];
+    uint32_t *words;
+    char **text;
+    uint32_t word_count;
+    Symbol *symbols;
+    int symbol_count;
+    Symbol *commons;
+    int common_count;
+    Relocation *relocations;
+    int relocation_count;
+    DataInit *inits;
+    int init_count;
+    uint32_t base;
+} Object;
+
+typedef struct {
+    char name[64];
+    uint32_t address;
+    int size;                       // Words of a variable, 0 for a function
+    int object;                     // Defining object (first one for a variable)
+} Global;
+
+// Objects linked together, with their own main and symbols
+typedef struct {
+    int first_object;
+    int object_count;
+    Global *globals;
+    int global_count;
+    int global_capacity;
+    uint32_t main_address;
+    uint32_t stack_base;            // r30 on entry
+    uint32_t data_top;              // Global variables go below
+} Program;
+
+// Word of the generated start-up code
+typedef struct {
+    uint32_t word;
+    char text[64];
+} BootWord;
+
+static Object *objects = NULL;
+static int object_count = 0;
+static int object_capacity = 0;
+static Program *programs = NULL;
+static int program_count = 0;
+static BootWord *boot = NULL;
+static int boot_count = 0;
+static int boot_capacity = 0;
+
+static void *grow(void *items, int count, int *capacity, size_t size) {
+    if (count < *capacity) return items;
+    int new_capacity = *capacity ? *capacity * 2 : 16;
+    void *grown = realloc(items, new_capacity * size);
+    if (!grown) {
+        fprintf(stderr, "acmc-ld: out of memory\n");
+        exit(1);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+static int read_object(Object *o, const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "acmc-ld: cannot open %s\n", filename);
+        return -1;
+    }
+    memset(o, 0, sizeof(*o));
+    snprintf(o->filename, sizeof(o->filename), "%s", filename);
+
+    char line[512];
+    int line_number = 0;
+    int symbol_capacity = 0, common_capacity = 0, relocation_capacity = 0, init_capacity = 0;
+    uint32_t word = 0;
+    int in_text = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line_number == 1) {
+            if (strcmp(line, "ACMC-OBJ 1") != 0) break;
+            continue;
+        }
+
+        if (in_text) {
+            if (word == o->word_count) break;
+            uint32_t bits = 0;
+            int n = 0;
+            while (n < 32 && (line[n] == '0' || line[n] == '1')) bits = (bits << 1) | (uint32_t)(line[n++] - '0');
+            if (n != 32) break;
+            o->words[word] = bits;
+            o->text[word] = strdup(line[32] == ' ' ? line + 33 : "");
+            word++;
+            continue;
+        }
+
+        char keyword[16], name[64];
+        unsigned value;
+        int bits, initial;
+        if (sscanf(line, "source %255s", o->source) == 1) {
+            continue;
+        } else if (sscanf(line, "symbol %63s %u", name, &value) == 2) {
+            o->symbols = grow(o->symbols, o->symbol_count, &symbol_capacity, sizeof(Symbol));
+            Symbol *s = &o->symbols[o->symbol_count++];
+            snprintf(s->name, sizeof(s->name), "%s", name);
+            s->value = value;
+        } else if (sscanf(line, "common %63s %u", name, &value) == 2) {
+            o->commons = grow(o->commons, o->common_count, &common_capacity, sizeof(Symbol));
+            Symbol *s = &o->commons[o->common_count++];
+            snprintf(s->name, sizeof(s->name), "%s", name);
+            s->value = value;
+        } else if (sscanf(line, "data %63s %d %d", name, &bits, &initial) == 3) {
+            o->inits = grow(o->inits, o->init_count, &init_capacity, sizeof(DataInit));
+            DataInit *d = &o->inits[o->init_count++];
+            snprintf(d->name, sizeof(d->name), "%s", name);
+            d->index = bits;
+            d->value = initial;
+        } else if (sscanf(line, "reloc %u %d %63s", &value, &bits, name) == 3 && (bits == 14 || bits == 26)) {
+            o->relocations = grow(o->relocations, o->relocation_count, &relocation_capacity, sizeof(Relocation));
+            Relocation *r = &o->relocations[o->relocation_count++];
+            r->offset = value;
+            r->bits = bits;
+            snprintf(r->symbol, sizeof(r->symbol), "%s", name);
+        } else if (sscanf(line, "text %u", &value) == 1) {
+            o->word_count = value;
+            o->words = calloc(value ? value : 1, sizeof(uint32_t));
+            o->text = calloc(value ? value : 1, sizeof(char *));
+            if (!o->words || !o->text) break;
+            in_text = 1;
+        } else if (sscanf(line, "%15s", keyword) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+
+    if (!in_text || word != o->word_count) {
+        fprintf(stderr, "acmc-ld: %s:%d: not an acmc object or truncated\n", filename, line_number);
+        return -1;
+    }
+    for (int i = 0; i < o->relocation_count; i++) {
+        if (o->relocations[i].offset >= o->word_count) {
+            fprintf(stderr, "acmc-ld: %s: relocation at word %u is outside the text\n", filename, o->relocations[i].offset);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static Global *find_global(Program *p, const char *name) {
+    for (int i = 0; i < p->global_count; i++) {
+        if (strcmp(p->globals[i].name, name) == 0) return &p->globals[i];
+    }
+    return NULL;
+}
+
+static Global *add_global(Program *p, const char *name, int object) {
+    p->globals = grow(p->globals, p->global_count, &p->global_capacity, sizeof(Global));
+    Global *g = &p->globals[p->global_count++];
+    memset(g, 0, sizeof(*g));
+    snprintf(g->name, sizeof(g->name), "%s", name);
+    g->object = object;
+    return g;
+}
+
+// Places the text of a program from 'address' and its data below
+// p->data_top, and builds its symbol table; returns the error count
+static int layout(Program *p, uint32_t *address) {
+    int errors = 0;
+    int end = p->first_object + p->object_count;
+    for (int i = p->first_object; i < end; i++) {
+        objects[i].base = *address;
+        *address += objects[i].word_count;
+    }
+
+    for (int i = p->first_object; i < end; i++) {
+        Object *o = &objects[i];
+        for (int s = 0; s < o->symbol_count; s++) {
+            Global *g = find_global(p, o->symbols[s].name);
+            if (g) {
+                fprintf(stderr, "acmc-ld: multiple definition of '%s' (%s and %s)\n", g->name,
+                        objects[g->object].filename, o->filename);
+                errors++;
+                continue;
+            }
+            add_global(p, o->symbols[s].name, i)->address = o->base + o->symbols[s].value;
+        }
+    }
+
+    for (int i = p->first_object; i < end; i++) {
+        Object *o = &objects[i];
+        for (int c = 0; c < o->common_count; c++) {
+            Global *g = find_global(p, o->commons[c].name);
+            if (g && g->size == 0) {
+                fprintf(stderr, "acmc-ld: '%s' is a function in %s and a variable in %s\n", g->name,
+                        objects[g->object].filename, o->filename);
+                errors++;
+                continue;
+            }
+            if (!g) g = add_global(p, o->commons[c].name, i);
+            if ((int)o->commons[c].value > g->size) g->size = o->commons[c].value;
+        }
+    }
+    uint32_t data = p->data_top;
+    for (int i = 0; i < p->global_count; i++) {
+        Global *g = &p->globals[i];
+        if (g->size == 0) continue;
+        if ((uint32_t)g->size > data - p->stack_base) {
+            fprintf(stderr, "acmc-ld: global variables of %s need more than %u words\n",
+                    objects[p->first_object].filename, p->data_top - p->stack_base);
+            errors++;
+            break;
+        }
+        data -= g->size;
+        g->address = data;
+    }
+
+    Global *entry = find_global(p, "main");
+    if (!entry || entry->size != 0) {
+        fprintf(stderr, "acmc-ld: %s: undefined reference to 'main'\n", objects[p->first_object].filename);
+        errors++;
+    } else {
+        p->main_address = entry->address;
+    }
+    return errors;
+}
+
+// Patches every relocated field of a program
+static int relocate(Program *p) {
+    int errors = 0;
+    for (int i = p->first_object; i < p->first_object + p->object_count; i++) {
+        Object *o = &objects[i];
+        for (int r = 0; r < o->relocation_count; r++) {
+            Relocation *rel = &o->relocations[r];
+            uint32_t mask = (1u << rel->bits) - 1;
+            uint32_t *word = &o->words[rel->offset];
+            uint32_t value;
+            if (strcmp(rel->symbol, ".text") == 0) {
+                value = o->base + (*word & mask);
+            } else {
+                Global *g = find_global(p, rel->symbol);
+                if (!g) {
+                    fprintf(stderr, "acmc-ld: %s: undefined reference to '%s'\n", o->filename, rel->symbol);
+                    errors++;
+                    continue;
+                }
+                value = g->address;
+            }
+            if (value > mask) {
+                fprintf(stderr, "acmc-ld: %s: address %u of '%s' does not fit in %d bits\n", o->filename, value,
+                        rel->symbol, rel->bits);
+                errors++;
+                continue;
+            }
+            *word = (*word & ~mask) | value;
+        }
+    }
+    return errors;
+}
+
+static uint32_t encode_r(int opcode, int rs, int rt, int rd) {
+    return ((uint32_t)opcode << 26) | ((uint32_t)rs << 20) | ((uint32_t)rt << 14) | ((uint32_t)rd << 8);
+}
+
+static uint32_t encode_i(int opcode, int rs, int rt, uint32_t immediate) {
+    return ((uint32_t)opcode << 26) | ((uint32_t)rs << 20) | ((uint32_t)rt << 14) | (immediate & 0x3FFF);
+}
+
+static void emit_boot(uint32_t word, const char *format, int a, int b) {
+    boot = grow(boot, boot_count, &boot_capacity, sizeof(BootWord));
+    boot[boot_count].word = word;
+    snprintf(boot[boot_count].text, sizeof(boot[boot_count].text), format, a, b);
+    boot_count++;
+}
+
+// Start-up code: "j main", or the dispatcher of --boot (see the top of the
+// file). Its size does not depend on the addresses, so it is built once
+// before the layout and again after it.
+static void build_boot(int dispatcher) {
+    boot_count = 0;
+    if (!dispatcher) {
+        emit_boot(((uint32_t)OPCODE_J << 26) | programs[0].main_address, "j main", 0, 0);
+        return;
+    }
+    emit_boot(encode_r(OPCODE_INPUT, 0, 0, 1), "input r1", 0, 0);
+    uint32_t entries = 2 + 2 * program_count;
+    for (int k = 0; k < program_count; k++) {
+        emit_boot(encode_i(OPCODE_ADDI, 0, SCRATCH_REGISTER, k), "addi r58 r0 %d", k, 0);
+        emit_boot(encode_i(OPCODE_BEQ, 1, SCRATCH_REGISTER, entries + 4 * k), "beq r1 r58 boot%d", k, 0);
+    }
+    emit_boot(encode_r(OPCODE_HALT, 0, 0, 0), "halt", 0, 0);
+    for (int k = 0; k < program_count; k++) {
+        Program *p = &programs[k];
+        emit_boot(encode_i(OPCODE_ADDI, 0, 30, p->stack_base), "addi r30 r0 %u", (int)p->stack_base, 0);
+        emit_boot(encode_r(OPCODE_MOVE, 0, 0, 1), "move r1 r0", 0, 0);
+        emit_boot(encode_r(OPCODE_MOVE, 0, 0, SCRATCH_REGISTER), "move r58 r0", 0, 0);
+        emit_boot(((uint32_t)OPCODE_J << 26) | p->main_address, "j main (program %d)", k, 0);
+    }
+}
+
+static void write_bits(FILE *f, uint32_t word, int separators) {
+    for (int i = 31; i >= 0; i--) {
+        fputc('0' + ((word >> i) & 1), f);
+        if (separators && (i == 26 || i == 20 || i == 14 || i == 8 || i == 6)) fputc(' ', f);
+    }
+    fputc('\n', f);
+}
+
+static int write_image(const char *bin_filename) {
+    char binbd_filename[300];
+    snprintf(binbd_filename, sizeof(binbd_filename), "%s", bin_filename);
+    char *dot = strrchr(binbd_filename, '.');
+    if (dot && strcmp(dot, ".bin") == 0) *dot = '\0';
+    strncat(binbd_filename, ".binbd", sizeof(binbd_filename) - strlen(binbd_filename) - 1);
+
+    FILE *bin = fopen(bin_filename, "w");
+    FILE *binbd = fopen(binbd_filename, "w");
+    if (!bin || !binbd) {
+        fprintf(stderr, "acmc-ld: cannot create %s\n", bin ? binbd_filename : bin_filename);
+        if (bin) fclose(bin);
+        if (binbd) fclose(binbd);
+        return -1;
+    }
+
+    fprintf(binbd, "# Binary representation linked from");
+    for (int i = 0; i < object_count; i++) fprintf(binbd, " %s", objects[i].filename);
+    fprintf(binbd, "\n# Format: [31:26] OPCODE | [25:20] RS | [19:14] RT | [13:8] RD | [7:0] IMEDIATO/ENDEREÇO\n\n");
+
+    for (int w = 0; w < boot_count; w++) {
+        write_bits(bin, boot[w].word, 0);
+        fprintf(binbd, "# Address %d: %s\n", w, boot[w].text);
+        write_bits(binbd, boot[w].word, 1);
+        fputc('\n', binbd);
+    }
+    for (int i = 0; i < object_count; i++) {
+        Object *o = &objects[i];
+        for (uint32_t w = 0; w < o->word_count; w++) {
+            write_bits(bin, o->words[w], 0);
+            fprintf(binbd, "# Address %u: %s (%s)\n", o->base + w, o->text[w], o->filename);
+            write_bits(binbd, o->words[w], 1);
+            fputc('\n', binbd);
+        }
+    }
+
+    int failed = ferror(bin) || ferror(binbd);
+    fclose(bin);
+    fclose(binbd);
+    if (failed) fprintf(stderr, "acmc-ld: error writing %s\n", bin_filename);
+    return failed ? -1 : 0;
+}
+
+// Writes the initial values of the global variables to <output>.data.mif,
+// or removes a stale one when no unit initializes anything
+static int write_data_image(const char *bin_filename) {
+    char data_filename[300];
+    snprintf(data_filename, sizeof(data_filename), "%s", bin_filename);
+    char *dot = strrchr(data_filename, '.');
+    if (dot && strcmp(dot, ".bin") == 0) *dot = '\0';
+    strncat(data_filename, DATA_IMAGE_SUFFIX, sizeof(data_filename) - strlen(data_filename) - 1);
+
+    DataWord *words = NULL;
+    int count = 0, capacity = 0, errors = 0;
+    for (int k = 0; k < program_count; k++) {
+        Program *p = &programs[k];
+        for (int i = p->first_object; i < p->first_object + p->object_count; i++) {
+            Object *o = &objects[i];
+            for (int d = 0; d < o->init_count; d++) {
+                Global *g = find_global(p, o->inits[d].name);
+                if (!g || g->size == 0 || o->inits[d].index < 0 || o->inits[d].index >= g->size) {
+                    fprintf(stderr, "acmc-ld: %s: bad initial value for '%s[%d]'\n", o->filename, o->inits[d].name,
+                            o->inits[d].index);
+                    errors++;
+                    continue;
+                }
+                words = grow(words, count, &capacity, sizeof(DataWord));
+                words[count].address = g->address + o->inits[d].index;
+                words[count].value = o->inits[d].value;
+                count++;
+            }
+        }
+    }
+
+    int result = errors ? -1 : 0;
+    if (!errors && count > 0) result = dataImageWrite(data_filename, bin_filename, words, count);
+    else if (!errors) remove(data_filename);
+    free(words);
+    return result;
+}
+
+static void print_map(int dispatcher) {
+    printf("Text:\n");
+    printf("  %5u-%-5u  %s\n", 0u, (unsigned)boot_count - 1, dispatcher ? "boot dispatcher" : "j main");
+    for (int i = 0; i < object_count; i++) {
+        Object *o = &objects[i];
+        printf("  %5u-%-5u  %s (%s)\n", o->base, o->base + o->word_count - 1, o->filename, o->source);
+        for (int s = 0; s < o->symbol_count; s++) printf("  %5u          %s\n", o->base + o->symbols[s].value, o->symbols[s].name);
+    }
+    for (int k = 0; k < program_count; k++) {
+        Program *p = &programs[k];
+        if (dispatcher) {
+            printf("Program %d (%s): main at %u, data %u-%u\n", k, objects[p->first_object].filename, p->main_address,
+                   p->stack_base, p->data_top - 1);
+        } else {
+            printf("Data:\n");
+        }
+        for (int i = 0; i < p->global_count; i++) {
+            Global *g = &p->globals[i];
+            if (g->size) printf("  %5u        %s (%d word%s)\n", g->address, g->name, g->size, g->size == 1 ? "" : "s");
+        }
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: acmc-ld [-o <program.bin>] [-M] <object>...\n");
+    fprintf(stderr, "       acmc-ld --boot [-o <rom.bin>] [-M] <objects>,... <objects>,...\n");
+}
+
+// Reads the comma-separated objects of 'list' as one program
+static int read_program(char *list) {
+    Program *p = &programs[program_count++];
+    memset(p, 0, sizeof(*p));
+    p->first_object = object_count;
+    for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+        objects = grow(objects, object_count, &object_capacity, sizeof(Object));
+        if (read_object(&objects[object_count], name) != 0) return -1;
+        object_count++;
+        p->object_count++;
+    }
+    if (p->object_count == 0) {
+        usage();
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    int print_link_map = 0;
+    int dispatcher = 0;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            output = argv[++arg];
+        } else if (strcmp(argv[arg], "-M") == 0) {
+            print_link_map = 1;
+        } else if (strcmp(argv[arg], "--boot") == 0) {
+            dispatcher = 1;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (arg == argc) {
+        usage();
+        return 1;
+    }
+
+    // Without --boot all the objects make one program
+    programs = calloc(argc - arg, sizeof(Program));
+    if (!programs) return 1;
+    if (dispatcher) {
+        for (; arg < argc; arg++) {
+            if (read_program(argv[arg]) != 0) return 1;
+        }
+    } else {
+        Program *p = &programs[program_count++];
+        p->object_count = argc - arg;
+        objects = calloc(p->object_count, sizeof(Object));
+        if (!objects) return 1;
+        for (; arg < argc; arg++) {
+            if (read_object(&objects[object_count++], argv[arg]) != 0) return 1;
+        }
+    }
+
+    // Equal data partitions; the programs follow the start-up code
+    uint32_t partition = BLOCK_COUNTER_BASE / program_count;
+    build_boot(dispatcher);
+    uint32_t address = boot_count;
+    int errors = 0;
+    for (int k = 0; k < program_count; k++) {
+        programs[k].stack_base = k * partition;
+        programs[k].data_top = (k + 1) * partition;
+        errors += layout(&programs[k], &address);
+    }
+    if (address > TEXT_LIMIT) {
+        fprintf(stderr, "acmc-ld: image has %u words; branch targets reach %d\n", address, TEXT_LIMIT);
+        errors++;
+    }
+    for (int k = 0; k < program_count; k++) errors += relocate(&programs[k]);
+    if (errors) return 1;
+    build_boot(dispatcher);
+
+    // Default output: the first object with main, as <name>.bin
+    char default_output[300];
+    if (!output) {
+        Global *entry = find_global(&programs[0], "main");
+        snprintf(default_output, sizeof(default_output), "%s", objects[entry->object].filename);
+        char *dot = strrchr(default_output, '.');
+        if (dot && strcmp(dot, ".obj") == 0) *dot = '\0';
+        strncat(default_output, ".bin", sizeof(default_output) - strlen(default_output) - 1);
+        output = default_output;
+    }
+    if (write_image(output) != 0 || write_data_image(output) != 0) return 1;
+    if (print_link_map) print_map(dispatcher);
+
+    for (int i = 0; i < object_count; i++) {
+        for (uint32_t w = 0; w < objects[i].word_count; w++) free(objects[i].text[w]);
+        free(objects[i].text);
+        free(objects[i].words);
+        free(objects[i].symbols);
+        free(objects[i].commons);
+        free(objects[i].relocations);
+        free(objects[i].inits);
+    }
+    for (int k = 0; k < program_count; k++) free(programs[k].globals);
+    free(objects);
+    free(programs);
+    free(boot);
+    return 0;
+}
@@ -4,55 +4,87 @@
 #include "analyze.h"
 #include "codegen.h"
 #include "symtab.h"
+#include "block_profile.h"
+#include "ir_interp.h"
+#include "wcet.h"
+#include "bootloader.h"
 
 // Incluir stdio e string para operações com arquivos e strings
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 FILE *source;
 FILE *listing;
 int lineno = 0;
 int Error = FALSE;
-
-// Função para comparar dois arquivos linha a linha
-int compareFiles(const char *file1, const char *file2) {
-    FILE *f1 = fopen(file1, "r");
-    FILE *f2 = fopen(file2, "r");
-    if (!f1 || !f2) {
-        if (f1) fclose(f1);
-        if (f2) fclose(f2);
-        return 0;
-    }
-    
-    char buf1[256], buf2[256];
-    int equal = 1;
-    while (1) {
-        char *s1 = fgets(buf1, sizeof(buf1), f1);
-        char *s2 = fgets(buf2, sizeof(buf2), f2);
-        if (s1 == NULL && s2 == NULL)
-            break;
-        if (s1 == NULL || s2 == NULL || strcmp(buf1, buf2) != 0) {
-            equal = 0;
-            break;
-        }
-    }
-    fclose(f1);
-    fclose(f2);
-    return equal;
-}
+int InstrumentBlocks = FALSE;
+int WriteCodeStats = FALSE;
+int CompileOnly = FALSE;
 
 int main(int argc, char *argv[]) {
   TreeNode *syntax_tree;
   char filename[100];
+  int run_ir = FALSE;
+  const char *ir_input = NULL;
+  int wcet = FALSE;
+  long long wcet_deadline = -1;
+  int status = 0;
+
+  // Opções antes do nome do arquivo
+  int arg = 1;
+  while (arg < argc && argv[arg][0] == '-') {
+    if (strcmp(argv[arg], "-c") == 0) {
+      // Objeto relocável em vez de binário; main pode estar em outra unidade
+      CompileOnly = TRUE;
+    } else if (strcmp(argv[arg], "--instrument=blocks") == 0) {
+      InstrumentBlocks = TRUE;
+    } else if (strncmp(argv[arg], "--profile-use=", 14) == 0) {
+      // Contagens de blocos usadas no layout de if/while
+      if (blockProfileLoad(argv[arg] + 14) != 0) return 1;
+    } else if (strcmp(argv[arg], "--stats") == 0) {
+      WriteCodeStats = TRUE;
+    } else if (strcmp(argv[arg], "--run-ir") == 0) {
+      run_ir = TRUE;
+    } else if (strncmp(argv[arg], "--run-ir=", 9) == 0) {
+      // Entradas de input() lidas do arquivo em vez de stdin
+      run_ir = TRUE;
+      ir_input = argv[arg] + 9;
+    } else if (strcmp(argv[arg], "--wcet") == 0) {
+      wcet = TRUE;
+    } else if (strncmp(argv[arg], "--wcet=", 7) == 0) {
+      // Prazo em ciclos: falha se o limite do programa for maior
+      wcet = TRUE;
+      wcet_deadline = atoll(argv[arg] + 7);
+    } else if (strcmp(argv[arg], "--bootloader") == 0) {
+      // Carregador residente; não compila nenhum arquivo
+      return bootloaderGenerate("bootloader", BOOTLOADER_DEFAULT_MEMORY) == 0 ? 0 : 1;
+    } else if (strncmp(argv[arg], "--bootloader=", 13) == 0) {
+      // Tamanho da memória de instruções da placa, em palavras
+      return bootloaderGenerate("bootloader", atoi(argv[arg] + 13)) == 0 ? 0 : 1;
+    } else {
+      fprintf(stderr, "Unknown option %s\n", argv[arg]);
+      return 1;
+    }
+    arg++;
+  }
+
+  // Os contadores de blocos têm endereços fixos e rotinas próprias em cada
+  // unidade, então não podem ser ligados
+  if (CompileOnly && InstrumentBlocks) {
+    fprintf(stderr, "-c cannot be combined with --instrument=blocks\n");
+    return 1;
+  }
 
   // Verifica se o número de argumentos está correto
-  if (argc != 2) {
-    fprintf(stderr, "try: %s <filename>\n", argv[0]);
+  if (argc - arg != 1) {
+    fprintf(stderr, "try: %s [-c] [--instrument=blocks] [--profile-use=<profile>] [--stats] [--run-ir[=<input>]] [--wcet[=<cycles>]] <filename>\n", argv[0]);
+    fprintf(stderr, "     %s --bootloader[=<words>]\n", argv[0]);
     return 1;
   }
 
   // Copia o nome do arquivo informado
-  strcpy(filename, argv[1]);
+  strcpy(filename, argv[arg]);
   // Se o nome do arquivo não tiver extensão, adiciona ".c-"
   if (strchr(filename, '.') == NULL) {
     strcat(filename, ".c-");
@@ -72,10 +104,14 @@ int main(int argc, char *argv[]) {
   fprintf(listing, "\nSyntax tree:\n\n");
   print_tree(syntax_tree);
 
+  // Substitui as constantes nomeadas e dobra as expressões constantes
+  if (!Error) syntax_tree = foldConstants(syntax_tree);
+
   // Se não houver erros, constrói a tabela de símbolos e gera o código intermediário
+  if (!Error) build_symbol_table(syntax_tree);
+
+  // Erros semânticos também interrompem a geração de código
   if (!Error) {
-    build_symbol_table(syntax_tree);
-    
     // Generate IR filename from source filename
     char irFilename[256];
     strcpy(irFilename, filename);
@@ -92,8 +128,55 @@ int main(int argc, char *argv[]) {
     // Chama a função para gerar o código intermediário; 
     // esta função deve gravar a saída em arquivo .ir baseado no nome do source
     codeGen(syntax_tree, irFilename, filename);
+
+    // Executa o código intermediário gerado; as saídas vão para o .irout
+    // e as contagens de operações para a listagem
+    if (run_ir) {
+      char outFilename[256];
+      strcpy(outFilename, irFilename);
+      strcat(outFilename, "out");
+      FILE *in = ir_input ? fopen(ir_input, "r") : stdin;
+      FILE *out = fopen(outFilename, "w");
+      if (in == NULL) {
+        fprintf(stderr, "File %s not found\n", ir_input);
+        status = 1;
+      } else if (out == NULL) {
+        fprintf(stderr, "Cannot create %s\n", outFilename);
+        status = 1;
+      } else if (irRun(irFilename, in, out, listing) != 0) {
+        status = 1;
+      }
+      if (in != NULL && in != stdin) fclose(in);
+      if (out != NULL) fclose(out);
+    }
+
+    // Limite de ciclos no pior caso do assembly gerado, em <nome>.wcet
+    if (wcet) {
+      char asmFilename[256], wcetFilename[256];
+      strcpy(asmFilename, irFilename);
+      strcpy(strrchr(asmFilename, '.'), ".asm");
+      strcpy(wcetFilename, irFilename);
+      strcpy(strrchr(wcetFilename, '.'), ".wcet");
+      long long bound;
+      if (wcetAnalyze(asmFilename, filename, wcetFilename, &bound) != 0) {
+        status = 1;
+      } else {
+        printf("✓ Limite de tempo no pior caso gerado em %s\n", wcetFilename);
+        if (wcet_deadline >= 0 && (bound == WCET_UNBOUNDED || bound > wcet_deadline)) {
+          if (bound == WCET_UNBOUNDED) {
+            fprintf(stderr, "WCET: no bound for %s (see %s), deadline %lld cycles\n", filename, wcetFilename, wcet_deadline);
+          } else {
+            fprintf(stderr, "WCET: %lld cycles exceeds the deadline of %lld cycles\n", bound, wcet_deadline);
+          }
+          status = 1;
+        }
+      }
+    }
   }
 
+  if (Error) status = 1;
+
+  blockProfileFree();
   fclose(source);
-  return 0;
+  return status;
 }
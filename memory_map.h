@@ -0,0 +1,17 @@
+#ifndef MEMORY_MAP_H
+#define MEMORY_MAP_H
+
+/**
+ * memory_map.h - Layout of the data memory shared by the compiler, acmc-ld
+ * and acmc-objdump
+ *
+ * The stack grows up from 0. Global variables are laid out downwards from
+ * BLOCK_COUNTER_BASE, and the basic-block counters (acmc --instrument=blocks)
+ * sit at BLOCK_COUNTER_BASE, the top of the data memory reachable with a
+ * 14-bit immediate from r0.
+ */
+
+#define BLOCK_COUNTER_BASE 7168
+#define MAX_BLOCK_COUNTERS 1024
+
+#endif /* MEMORY_MAP_H */
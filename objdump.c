@@ -0,0 +1,482 @@
+/*
+ * objdump.c - Disassembler for program images (acmc-objdump)
+ *
+ * Decodes a .bin, .binbd, .mif or .raw image (see sim_load_program()) with
+ * the simulator's decoder and prints it in the syntax of the .asm listing.
+ * Branch and jump targets get labels: function entries are named from the
+ * "Func name:" blocks of the listing when there is one, otherwise every
+ * JAL target is a function (fn_<address>), the target of the jump in word
+ * 0 is main and word 0 itself is _start. Other targets keep the label of
+ * the listing, or are L1, L2, ... numbered within each function. With a .lines table every instruction is
+ * annotated with the C- source line it came from. Runs of zero words
+ * (free memory in a .mif, the program space of the bootloader) are shown
+ * once.
+ *
+ * The listing and line table default to <image>.asm and <image>.lines
+ * next to the image, when they exist. --plain leaves out addresses, words
+ * and source lines, so the output of two compiler versions can be diffed.
+ * --check compares every word with the instruction the listing says it
+ * encodes (labels and global variables resolved) and reports the ones
+ * that differ.
+ *
+ * Usage: acmc-objdump [--asm <file>] [--lines <file>] [--plain | --check] <image>
+ */
+
+#include "simulator.h"
+#include "sim_lines.h"
+#include "memory_map.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_ZERO_RUN 4
+
+typedef struct {
+    uint32_t address;
+    char *text;
+    int function;              // Index in 'functions', -1 before the first
+} ListingLine;
+
+typedef struct {
+    char name[64];
+    uint32_t entry;
+} Function;
+
+typedef struct {
+    char name[64];
+    int function;
+    uint32_t address;
+} Label;
+
+static SimProgram prog;
+static Function *functions = NULL;
+static int function_count = 0;
+static int *function_at = NULL;        // Function entered at each address, or -1
+static int *label_at = NULL;           // Label number at each address, 0 if none
+static const char **label_name = NULL; // Name from the listing, if it has one
+
+static ListingLine *listing = NULL;
+static int listing_count = 0;
+static Label *listing_labels = NULL;
+static int listing_label_count = 0;
+static Label *data_labels = NULL;      // "# Global" lines, at their data addresses
+static int data_label_count = 0;
+
+static char **source_text = NULL;
+static int source_lines = 0;
+
+static void *grow(void *items, int count, size_t size) {
+    if (count & (count - 1)) return items;      // Capacity doubles at powers of two
+    void *grown = realloc(items, (count ? count * 2 : 16) * size);
+    if (!grown) {
+        fprintf(stderr, "acmc-objdump: out of memory\n");
+        exit(1);
+    }
+    return grown;
+}
+
+static int add_function(const char *name, uint32_t entry) {
+    for (int i = 0; i < function_count; i++) {
+        if (functions[i].entry == entry) return i;
+    }
+    functions = grow(functions, function_count, sizeof(Function));
+    snprintf(functions[function_count].name, sizeof(functions[function_count].name), "%s", name);
+    functions[function_count].entry = entry;
+    return function_count++;
+}
+
+// "# Global array name[size]" or "# Global name": the next global variable,
+// placed downward from BLOCK_COUNTER_BASE in the order of the listing
+static void add_data_label(const char *line) {
+    char name[64];
+    int size = 1;
+    if (sscanf(line, "# Global array %63[^[][%d]", name, &size) != 2 && sscanf(line, "# Global %63s", name) != 1) return;
+    uint32_t top = data_label_count ? data_labels[data_label_count - 1].address : BLOCK_COUNTER_BASE;
+    data_labels = grow(data_labels, data_label_count, sizeof(Label));
+    Label *l = &data_labels[data_label_count++];
+    snprintf(l->name, sizeof(l->name), "%s", name);
+    l->function = -1;
+    l->address = top - size;
+}
+
+// Reads the .asm listing: numbered words, "Func name:" blocks, labels and
+// the global variables
+static int load_listing(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "acmc-objdump: cannot open %s\n", filename);
+        return -1;
+    }
+    char line[512];
+    int function = -1, seen_numbered = 0;
+    uint32_t next = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *s = line + strspn(line, " \t");
+        if (*s == '\0') continue;
+
+        char *end;
+        unsigned long address = strtoul(s, &end, 10);
+        int numbered = end != s && *end == '-';
+        if (strncmp(s, "Func ", 5) == 0) {
+            char *colon = strchr(s + 5, ':');
+            if (colon) *colon = '\0';
+            function = add_function(s + 5, next);
+            continue;
+        }
+        if (*s == '#') {
+            add_data_label(s);
+            continue;
+        }
+        if (!numbered && s[strlen(s) - 1] == ':') {
+            s[strlen(s) - 1] = '\0';
+            listing_labels = grow(listing_labels, listing_label_count, sizeof(Label));
+            Label *l = &listing_labels[listing_label_count++];
+            snprintf(l->name, sizeof(l->name), "%s", s);
+            l->function = function;
+            l->address = next;
+            continue;
+        }
+        if (!numbered && seen_numbered) continue;
+
+        // "N-text", or the unnumbered "j <main>" of word 0
+        listing = grow(listing, listing_count, sizeof(ListingLine));
+        ListingLine *l = &listing[listing_count++];
+        l->address = numbered ? (uint32_t)address : 0;
+        l->text = strdup(numbered ? end + 1 : s);
+        l->function = function;
+        next = l->address + 1;
+        seen_numbered |= numbered;
+    }
+    fclose(f);
+    return 0;
+}
+
+// Source text of the line table's C- file, if it can be read
+static void load_source(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) return;
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        source_text = grow(source_text, source_lines, sizeof(char *));
+        source_text[source_lines++] = strdup(line + strspn(line, " \t"));
+    }
+    fclose(f);
+}
+
+static int reg(int r) {
+    return r == SIM_REG_SINK ? 0 : r;
+}
+
+static int has_target(const SimInsn *in) {
+    return (in->op >= SIM_OP_BEQ && in->op <= SIM_OP_BLTE) || in->op == SIM_OP_J || in->op == SIM_OP_JAL;
+}
+
+// Name of a branch or jump target, or its number
+static void target_name(uint32_t target, int symbolic, char *out, size_t size) {
+    if (symbolic && target < prog.length && function_at[target] >= 0) {
+        snprintf(out, size, "%s", functions[function_at[target]].name);
+    } else if (symbolic && target < prog.length && label_name[target]) {
+        snprintf(out, size, "%s", label_name[target]);
+    } else if (symbolic && target < prog.length && label_at[target]) {
+        snprintf(out, size, "L%d", label_at[target]);
+    } else {
+        snprintf(out, size, "%u", target);
+    }
+}
+
+// One word in the syntax of assembly.c
+static void disassemble(uint32_t word, int symbolic, char *out, size_t size) {
+    SimInsn in;
+    sim_decode(word, &in);
+    const char *name = sim_opcode_name(in.op);
+    char target[80];
+    if (word == 0) {
+        snprintf(out, size, "nop");
+        return;
+    }
+    if (has_target(&in)) target_name((uint32_t)in.imm, symbolic, target, sizeof(target));
+
+    switch (in.op) {
+        case SIM_OP_ADD: case SIM_OP_SUB: case SIM_OP_AND: case SIM_OP_OR:
+        case SIM_OP_SLT: case SIM_OP_SET:
+            snprintf(out, size, "%s r%d r%d r%d", name, reg(in.rd), in.rs, in.rt);
+            break;
+        case SIM_OP_MULT: case SIM_OP_DIV:
+            snprintf(out, size, "%s r%d r%d", name, in.rs, in.rt);
+            break;
+        case SIM_OP_SLL: case SIM_OP_SRL:
+            snprintf(out, size, "%s r%d r%d %d", name, reg(in.rd), in.rs, in.imm);
+            break;
+        case SIM_OP_MFHI: case SIM_OP_MFLO: case SIM_OP_INPUT:
+            snprintf(out, size, "%s r%d", name, reg(in.rd));
+            break;
+        case SIM_OP_MOVE:
+            snprintf(out, size, "%s r%d r%d", name, reg(in.rd), in.rs);
+            break;
+        case SIM_OP_JR: case SIM_OP_JALR: case SIM_OP_OUTPUTREG:
+            snprintf(out, size, "%s r%d", name, in.rs);
+            break;
+        case SIM_OP_LA: case SIM_OP_LI:
+            snprintf(out, size, "%s r%d %d", name, reg(in.rt), in.imm);
+            break;
+        case SIM_OP_ADDI: case SIM_OP_SUBI: case SIM_OP_ANDI: case SIM_OP_ORI:
+        case SIM_OP_LW: case SIM_OP_SW: case SIM_OP_SWI:
+            snprintf(out, size, "%s r%d r%d %d", name, reg(in.rt), in.rs, in.imm);
+            break;
+        case SIM_OP_BEQ: case SIM_OP_BNE: case SIM_OP_BGT:
+        case SIM_OP_BGTE: case SIM_OP_BLT: case SIM_OP_BLTE:
+            snprintf(out, size, "%s r%d r%d %s", name, in.rs, in.rt, target);
+            break;
+        case SIM_OP_J: case SIM_OP_JAL:
+            snprintf(out, size, "%s %s", name, target);
+            break;
+        case SIM_OP_OUTPUTMEM:
+            snprintf(out, size, "%s r%d %d", name, in.rs, in.imm);
+            break;
+        case SIM_OP_HALT: case SIM_OP_OUTPUTRESET:
+            snprintf(out, size, "%s", name);
+            break;
+        default:
+            snprintf(out, size, ".word 0x%08x", word);
+            break;
+    }
+}
+
+// Functions (from the listing or the call targets) and labels
+static void find_symbols(void) {
+    function_at = malloc(prog.length * sizeof(int));
+    label_at = calloc(prog.length, sizeof(int));
+    label_name = calloc(prog.length, sizeof(char *));
+    if (!function_at || !label_at || !label_name) exit(1);
+    for (uint32_t a = 0; a < prog.length; a++) function_at[a] = -1;
+
+    if (function_count == 0) {
+        SimInsn in;
+        sim_decode(prog.words[0], &in);
+        if (in.op == SIM_OP_J && (uint32_t)in.imm < prog.length) add_function("main", (uint32_t)in.imm);
+        for (uint32_t a = 0; a < prog.length; a++) {
+            sim_decode(prog.words[a], &in);
+            if (in.op != SIM_OP_JAL || (uint32_t)in.imm >= prog.length) continue;
+            char name[32];
+            snprintf(name, sizeof(name), "fn_%u", (uint32_t)in.imm);
+            add_function(name, (uint32_t)in.imm);
+        }
+    }
+    add_function("_start", 0);
+    for (int i = 0; i < function_count; i++) {
+        if (functions[i].entry < prog.length) function_at[functions[i].entry] = i;
+    }
+
+    for (uint32_t a = 0; a < prog.length; a++) {
+        SimInsn in;
+        sim_decode(prog.words[a], &in);
+        uint32_t target = (uint32_t)in.imm;
+        if (has_target(&in) && target < prog.length && function_at[target] < 0) label_at[target] = -1;
+    }
+    int next = 1;
+    for (uint32_t a = 0; a < prog.length; a++) {
+        if (function_at[a] >= 0) next = 1;
+        if (label_at[a]) label_at[a] = next++;
+    }
+    for (int i = 0; i < listing_label_count; i++) {
+        uint32_t a = listing_labels[i].address;
+        if (a < prog.length && label_at[a] && !label_name[a]) label_name[a] = listing_labels[i].name;
+    }
+}
+
+static uint32_t zero_run(uint32_t a) {
+    uint32_t end = a;
+    while (end < prog.length && prog.words[end] == 0 && (end == a || (!label_at[end] && function_at[end] < 0))) end++;
+    return end - a;
+}
+
+static void print_disassembly(const char *image, const SimLines *lines, int plain) {
+    if (!plain) printf("%s: %u words\n", image, prog.length);
+    uint32_t last_line = 0;
+    for (uint32_t a = 0; a < prog.length; a++) {
+        if (function_at[a] >= 0) {
+            printf("\n%s:\n", functions[function_at[a]].name);
+            last_line = 0;
+        }
+        if (label_name[a]) {
+            printf("%s:\n", label_name[a]);
+        } else if (label_at[a]) {
+            printf("L%d:\n", label_at[a]);
+        }
+
+        uint32_t run = prog.words[a] == 0 ? zero_run(a) : 1;
+        if (run >= MIN_ZERO_RUN) {
+            if (plain) {
+                printf("    nop (%u words)\n", run);
+            } else {
+                printf("%8u-%-5u  %08x  nop (%u words)\n", a, a + run - 1, 0u, run);
+            }
+            a += run - 1;
+            continue;
+        }
+
+        uint32_t line = lines && a < lines->length ? lines->source_line[a] : 0;
+        if (!plain && line && line != last_line) {
+            const char *text = line <= (uint32_t)source_lines ? source_text[line - 1] : "";
+            printf("%24s; %u: %s\n", "", line, text);
+            last_line = line;
+        }
+
+        char text[128];
+        disassemble(prog.words[a], 1, text, sizeof(text));
+        if (plain) {
+            printf("    %s\n", text);
+        } else {
+            printf("%8u  %08x  %s\n", a, prog.words[a], text);
+        }
+    }
+}
+
+// Address of a listing label, in the function of the line first, then of a
+// function or global variable
+static int listing_label(const char *name, int function, uint32_t *address) {
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < listing_label_count; i++) {
+            if (strcmp(listing_labels[i].name, name) == 0 && (pass == 1 || listing_labels[i].function == function)) {
+                *address = listing_labels[i].address;
+                return 1;
+            }
+        }
+    }
+    for (int i = 0; i < function_count; i++) {
+        if (strcmp(functions[i].name, name) == 0) {
+            *address = functions[i].entry;
+            return 1;
+        }
+    }
+    for (int i = 0; i < data_label_count; i++) {
+        if (strcmp(data_labels[i].name, name) == 0) {
+            *address = data_labels[i].address;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Operand as a number: registers without the 'r', labels as addresses
+static long operand_value(const char *token, int function) {
+    uint32_t address;
+    if ((token[0] == 'r' || token[0] == 'R') && isdigit((unsigned char)token[1])) return atol(token + 1);
+    if (!isdigit((unsigned char)token[0]) && token[0] != '-' && listing_label(token, function, &address)) return address;
+    return atol(token);
+}
+
+// Compares the listing with the image; returns the number of mismatches
+static int check_listing(void) {
+    int mismatches = 0, checked = 0;
+    for (int i = 0; i < listing_count; i++) {
+        const ListingLine *l = &listing[i];
+        if (l->address >= prog.length) {
+            printf("%u: %s: not in the image\n", l->address, l->text);
+            mismatches++;
+            continue;
+        }
+        char decoded[128], expected[256];
+        disassemble(prog.words[l->address], 0, decoded, sizeof(decoded));
+        snprintf(expected, sizeof(expected), "%s", l->text[0] == '#' ? "nop" : l->text);
+        checked++;
+
+        // Same mnemonic and operand values; missing operands are 0
+        char *save_d, *save_e;
+        char *d = strtok_r(decoded, " \t,", &save_d);
+        char *e = strtok_r(expected, " \t,", &save_e);
+        int same = d && e && strcasecmp(d, e) == 0;
+        while (same) {
+            d = strtok_r(NULL, " \t,", &save_d);
+            e = strtok_r(NULL, " \t,", &save_e);
+            if (!d && !e) break;
+            if (!d || operand_value(d, -1) != (e ? operand_value(e, l->function) : 0)) same = 0;
+        }
+        if (!same) {
+            disassemble(prog.words[l->address], 0, decoded, sizeof(decoded));
+            printf("%u: listing has '%s', image decodes as '%s'\n", l->address, l->text, decoded);
+            mismatches++;
+        }
+    }
+    if (mismatches) {
+        printf("Checked %d words: %d differ from the listing\n", checked, mismatches);
+    } else {
+        printf("Checked %d words: all match the listing\n", checked);
+    }
+    return mismatches;
+}
+
+// <stem><extension> next to the image, if that file exists
+static char *companion_file(const char *image, const char *extension) {
+    const char *dot = strrchr(image, '.');
+    size_t stem = dot && strchr(dot, '/') == NULL ? (size_t)(dot - image) : strlen(image);
+    char *path = malloc(stem + strlen(extension) + 1);
+    if (!path) return NULL;
+    memcpy(path, image, stem);
+    strcpy(path + stem, extension);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        free(path);
+        return NULL;
+    }
+    fclose(f);
+    return path;
+}
+
+int main(int argc, char *argv[]) {
+    const char *asm_file = NULL, *lines_file = NULL, *image = NULL;
+    int plain = 0, check = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--asm") == 0 && i + 1 < argc) {
+            asm_file = argv[++i];
+        } else if (strcmp(argv[i], "--lines") == 0 && i + 1 < argc) {
+            lines_file = argv[++i];
+        } else if (strcmp(argv[i], "--plain") == 0) {
+            plain = 1;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = 1;
+        } else if (!image && argv[i][0] != '-') {
+            image = argv[i];
+        } else {
+            image = NULL;
+            break;
+        }
+    }
+    if (!image || (plain && check)) {
+        fprintf(stderr, "Usage: %s [--asm <file>] [--lines <file>] [--plain | --check] <image>\n", argv[0]);
+        return 1;
+    }
+
+    if (sim_load_program(&prog, image) != 0) return 1;
+    if (prog.length == 0) {
+        fprintf(stderr, "acmc-objdump: %s is empty\n", image);
+        return 1;
+    }
+
+    char *companion = asm_file ? NULL : companion_file(image, ".asm");
+    if ((asm_file || companion) && load_listing(asm_file ? asm_file : companion) != 0) return 1;
+    free(companion);
+    if (check && listing_count == 0) {
+        fprintf(stderr, "acmc-objdump: --check needs the .asm listing (--asm)\n");
+        return 1;
+    }
+    find_symbols();
+
+    int status = 0;
+    if (check) {
+        status = check_listing() != 0;
+    } else {
+        SimLines lines;
+        char *table = lines_file ? NULL : companion_file(image, ".lines");
+        int have_lines = !plain && (lines_file || table) && sim_lines_load(&lines, lines_file ? lines_file : table) == 0;
+        free(table);
+        if (have_lines) load_source(lines.source_file);
+        print_disassembly(image, have_lines ? &lines : NULL, plain);
+        if (have_lines) sim_lines_free(&lines);
+    }
+
+    sim_free_program(&prog);
+    return status;
+}
@@ -0,0 +1,145 @@
+/*
+ * reachability.c - Dead function and dead global elimination (see reachability.h)
+ */
+
+#include "reachability.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    TreeNode *decl;             // FuncK or VarK node
+    int size;                   // Words of a global array, 0 for a scalar
+    int live;
+} Definition;
+
+static Definition *functions = NULL;
+static int function_count = 0;
+static Definition *variables = NULL;
+static int variable_count = 0;
+static int analyzed = 0;
+
+static Definition *findDefinition(Definition *defs, int count, const char *name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(defs[i].name, name) == 0) return &defs[i];
+    }
+    return NULL;
+}
+
+// Parameters and locals at the top of the body of 'function'
+static int hidesGlobal(TreeNode *function, const char *name) {
+    for (TreeNode *p = function->child[0]; p != NULL; p = p->sibling) {
+        TreeNode *param = p->kind.exp == TypeK ? p->child[0] : p;
+        if (param != NULL && param->kind.exp == ParamK && strcmp(param->attr.name, name) == 0) return 1;
+    }
+    for (TreeNode *s = function->child[1]; s != NULL; s = s->sibling) {
+        if (s->nodekind == ExpK && s->kind.exp == TypeK && s->child[0] != NULL &&
+            s->child[0]->kind.exp == VarK && strcmp(s->child[0]->attr.name, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void markFunction(const char *name);
+
+// Marks what the statements and expressions under 't' call and name
+static void markUses(TreeNode *function, TreeNode *t) {
+    for (; t != NULL; t = t->sibling) {
+        if (t->nodekind == ExpK && t->kind.exp == CallK) {
+            markFunction(t->attr.name);
+        } else if (t->nodekind == ExpK && t->kind.exp == IdK && t->attr.name != NULL) {
+            Definition *g = findDefinition(variables, variable_count, t->attr.name);
+            if (g && !hidesGlobal(function, t->attr.name)) g->live = 1;
+        }
+        for (int i = 0; i < MAXCHILDREN; i++) markUses(function, t->child[i]);
+    }
+}
+
+static void markFunction(const char *name) {
+    Definition *f = findDefinition(functions, function_count, name);
+    if (f == NULL || f->live) return;   // input/output, or already visited
+    f->live = 1;
+    markUses(f->decl, f->decl->child[1]);
+}
+
+void reachabilityAnalyze(TreeNode *syntax_tree) {
+    reachabilityFree();
+    for (TreeNode *t = syntax_tree; t != NULL; t = t->sibling) {
+        if (t->nodekind != ExpK || t->kind.exp != TypeK || t->child[0] == NULL) continue;
+        TreeNode *decl = t->child[0];
+        Definition **defs;
+        int *count;
+        if (decl->kind.exp == FuncK && decl->add != 1) {
+            defs = &functions;
+            count = &function_count;
+        } else if (decl->kind.exp == VarK) {
+            defs = &variables;
+            count = &variable_count;
+        } else {
+            continue;
+        }
+        Definition *grown = realloc(*defs, (*count + 1) * sizeof(Definition));
+        if (grown == NULL) {
+            reachabilityFree();
+            return;
+        }
+        *defs = grown;
+        Definition *d = &grown[(*count)++];
+        d->name = decl->attr.name;
+        d->decl = decl;
+        d->size = decl->child[0] != NULL ? decl->child[0]->attr.val : 0;
+        d->live = 0;
+    }
+
+    // A library unit (acmc -c) exports everything
+    if (CompileOnly) {
+        reachabilityFree();
+        return;
+    }
+    markFunction("main");
+    analyzed = 1;
+}
+
+int reachabilityFunctionLive(const char *function) {
+    Definition *f = analyzed ? findDefinition(functions, function_count, function) : NULL;
+    return f == NULL || f->live;
+}
+
+int reachabilityGlobalLive(const char *variable) {
+    Definition *g = analyzed ? findDefinition(variables, variable_count, variable) : NULL;
+    return g == NULL || g->live;
+}
+
+void reachabilityReport(FILE *out) {
+    if (!analyzed) return;
+    fprintf(out, "=== Dead Code Elimination ===\n");
+    int removed_functions = 0, removed_globals = 0;
+    for (int i = 0; i < function_count; i++) {
+        if (functions[i].live) continue;
+        fprintf(out, "Removed function %s (line %d)\n", functions[i].name, functions[i].decl->lineno);
+        removed_functions++;
+    }
+    for (int i = 0; i < variable_count; i++) {
+        if (variables[i].live) continue;
+        if (variables[i].size > 0) {
+            fprintf(out, "Removed global %s[%d] (line %d)\n", variables[i].name, variables[i].size,
+                    variables[i].decl->lineno);
+        } else {
+            fprintf(out, "Removed global %s (line %d)\n", variables[i].name, variables[i].decl->lineno);
+        }
+        removed_globals++;
+    }
+    fprintf(out, "Dead code: %d of %d functions and %d of %d globals removed\n\n", removed_functions,
+            function_count, removed_globals, variable_count);
+}
+
+void reachabilityFree(void) {
+    free(functions);
+    free(variables);
+    functions = NULL;
+    variables = NULL;
+    function_count = 0;
+    variable_count = 0;
+    analyzed = 0;
+}
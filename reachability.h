@@ -0,0 +1,33 @@
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include "globals.h"
+#include <stdio.h>
+
+/**
+ * reachability.h - Whole-program dead function and dead global elimination
+ *
+ * Walks the call graph of the syntax tree from main: a function is live if
+ * a live function calls it, a global variable if a live function names it
+ * (parameters and the locals at the top of the body hide a global of the
+ * same name; locals of inner blocks do not, which only keeps a few more).
+ * codeGen() skips everything else, so unused helpers take no instruction
+ * memory and unused globals no data.
+ *
+ * With acmc -c every function of the unit may be called from another
+ * object, so nothing is removed.
+ */
+
+// Finds the live functions and globals of 'syntax_tree', rooted at main
+void reachabilityAnalyze(TreeNode *syntax_tree);
+
+// True unless the analysis found 'function' / 'variable' unreachable
+int reachabilityFunctionLive(const char *function);
+int reachabilityGlobalLive(const char *variable);
+
+// Lists the removed functions and globals with their source lines
+void reachabilityReport(FILE *out);
+
+void reachabilityFree(void);
+
+#endif /* REACHABILITY_H */
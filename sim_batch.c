@@ -0,0 +1,487 @@
+/*
+ * sim_batch.c - Lockstep multi-input simulation
+ *
+ * All per-lane work is written as fixed-width loops over
+ * SIM_BATCH_LANES with a blend against the lane mask, e.g.
+ *
+ *     value = rs[l] + rt[l];
+ *     rd[l] = (value & lane[l]) | (rd[l] & ~lane[l]);
+ *
+ * which GCC and Clang vectorize at -O2 (SSE2 by default, AVX2 when built
+ * with -mavx2). DIV goes through double precision when no lane can trap.
+ * Scattered memory accesses and I/O stay scalar per lane.
+ */
+
+#include "sim_batch.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LANE_BIT(l) (1u << (l))
+
+#define WRAP_ADD(a, b) ((int32_t)((uint32_t)(a) + (uint32_t)(b)))
+#define WRAP_SUB(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)))
+
+// dst[l] = expr for the lanes in the mask; 'l' is visible inside expr.
+// The result goes through a local array so the compiler does not need a
+// runtime alias check between dst and the source rows to vectorize, and
+// the blend is skipped while all 16 lanes run together.
+#define LANE_OP(dst, expr) do { \
+        int32_t value_[SIM_BATCH_LANES]; \
+        for (int l = 0; l < SIM_BATCH_LANES; l++) value_[l] = (expr); \
+        if (full) { \
+            memcpy((dst), value_, sizeof(value_)); \
+        } else { \
+            for (int l = 0; l < SIM_BATCH_LANES; l++) \
+                (dst)[l] = (value_[l] & lane[l]) | ((dst)[l] & ~lane[l]); \
+        } \
+    } while (0)
+
+// Registers known to hold the same value in every lane of the mask, so a
+// load/store through them is a single row of the interleaved memory
+#define REG_BIT(r) ((r) < 64 ? 1ull << (r) : 0)
+#define FORGET(r) (known &= ~REG_BIT(r))
+#define SAME(r) (known |= REG_BIT(r), uniform |= REG_BIT(r))
+#define COPY(d, s) do { \
+        if (known & uniform & REG_BIT(s)) SAME(d); else FORGET(d); \
+    } while (0)
+#define BOTH(d, a, c) do { \
+        uint64_t both_ = REG_BIT(a) | REG_BIT(c); \
+        if ((known & uniform & both_) == both_) SAME(d); else FORGET(d); \
+    } while (0)
+
+// Runs body once for every lane set in mask
+#define FOR_MASK(l, mask) \
+    for (int l = 0; l < SIM_BATCH_LANES; l++) \
+        if ((mask) & LANE_BIT(l))
+
+int sim_batch_init(SimBatch *b, uint32_t lanes, uint32_t mem_words) {
+    memset(b, 0, sizeof(*b));
+    if (lanes == 0 || lanes > SIM_BATCH_LANES) {
+        fprintf(stderr, "Error: batch size must be 1..%d lanes\n", SIM_BATCH_LANES);
+        return -1;
+    }
+    b->lanes = lanes;
+    b->mem_words = mem_words ? mem_words : SIM_DEFAULT_MEM_WORDS;
+    b->mem = calloc((size_t)b->mem_words * SIM_BATCH_LANES, sizeof(int32_t));
+    if (!b->mem) {
+        fprintf(stderr, "Error: Cannot allocate %u words of batch memory\n", b->mem_words * SIM_BATCH_LANES);
+        return -1;
+    }
+    for (uint32_t l = lanes; l < SIM_BATCH_LANES; l++) b->status[l] = SIM_HALTED;
+    return 0;
+}
+
+void sim_batch_load_data(SimBatch *b, const SimProgram *prog) {
+    uint32_t words = prog->data_length < b->mem_words ? prog->data_length : b->mem_words;
+    for (uint32_t a = 0; a < words; a++) {
+        int32_t *row = b->mem + (size_t)a * SIM_BATCH_LANES;
+        for (uint32_t l = 0; l < SIM_BATCH_LANES; l++) row[l] = prog->data[a];
+    }
+}
+
+void sim_batch_reset(SimBatch *b) {
+    memset(b->regs, 0, sizeof(b->regs));
+    memset(b->mem, 0, (size_t)b->mem_words * SIM_BATCH_LANES * sizeof(int32_t));
+    for (uint32_t l = 0; l < SIM_BATCH_LANES; l++) {
+        b->pc[l] = 0;
+        b->status[l] = l < b->lanes ? SIM_RUNNING : SIM_HALTED;
+        b->icount[l] = 0;
+        b->input_pos[l] = 0;
+        b->output_count[l] = 0;
+    }
+    b->steps = 0;
+    b->split_steps = 0;
+}
+
+void sim_batch_free(SimBatch *b) {
+    free(b->mem);
+    b->mem = NULL;
+    for (int l = 0; l < SIM_BATCH_LANES; l++) {
+        free(b->output[l]);
+        b->output[l] = NULL;
+    }
+}
+
+static void push_output(SimBatch *b, int l, int32_t value) {
+    if (b->output_count[l] == b->output_capacity[l]) {
+        uint32_t capacity = b->output_capacity[l] ? b->output_capacity[l] * 2 : 64;
+        int32_t *grown = realloc(b->output[l], capacity * sizeof(int32_t));
+        if (!grown) return;
+        b->output[l] = grown;
+        b->output_capacity[l] = capacity;
+    }
+    b->output[l][b->output_count[l]++] = value;
+}
+
+void sim_batch_run(SimBatch *b, const SimProgram *prog) {
+    const uint32_t length = prog->length;
+    SimInsn *code = malloc((length ? length : 1) * sizeof(SimInsn));
+    if (!code) {
+        fprintf(stderr, "Error: Cannot allocate decoded program\n");
+        return;
+    }
+    for (uint32_t i = 0; i < length; i++) sim_decode(prog->words[i], &code[i]);
+
+    int32_t (*R)[SIM_BATCH_LANES] = b->regs;
+    int32_t *mem = b->mem;
+    const uint32_t mem_words = b->mem_words;
+    const uint64_t limit = b->max_steps ? b->max_steps : UINT64_MAX;
+
+    int32_t lane[SIM_BATCH_LANES];   // -1 for lanes in the current mask
+    uint32_t alive = 0;
+    for (uint32_t l = 0; l < b->lanes; l++) {
+        if (b->status[l] == SIM_RUNNING) alive |= LANE_BIT(l);
+    }
+
+    uint32_t pc = 0;
+    uint32_t mask = 0;
+    int first_lane = 0;
+    int full = 0;                  // mask has all SIM_BATCH_LANES lanes
+    int regroup = 1;
+    uint64_t steps = 0, split_steps = 0;
+    uint64_t run = 0;              // Retired by every lane in mask, not yet in icount
+    uint64_t known = 0, uniform = 0;
+
+    while (alive) {
+        if (regroup) {
+            // Lowest pc runs first so lanes re-join at loop exits
+            pc = UINT32_MAX;
+            FOR_MASK(l, alive) {
+                if (b->pc[l] < pc) pc = b->pc[l];
+            }
+            mask = 0;
+            FOR_MASK(l, alive) {
+                if (b->pc[l] == pc) mask |= LANE_BIT(l);
+            }
+            for (int l = 0; l < SIM_BATCH_LANES; l++) lane[l] = (mask & LANE_BIT(l)) ? -1 : 0;
+            full = mask == (uint32_t)((1ull << SIM_BATCH_LANES) - 1);
+            first_lane = 0;
+            while (!(mask & LANE_BIT(first_lane))) first_lane++;
+            known = REG_BIT(0);
+            uniform = REG_BIT(0);
+            regroup = 0;
+        }
+
+        if (pc >= length) {
+            FOR_MASK(l, mask) {
+                b->status[l] = SIM_TRAP_PC;
+                b->pc[l] = pc;
+                b->icount[l] += run;
+            }
+            run = 0;
+            alive &= ~mask;
+            regroup = 1;
+            continue;
+        }
+
+        const SimInsn *in = &code[pc];
+        uint32_t next = pc + 1;
+        uint32_t trapped = 0;      // Lanes that faulted (instruction not retired)
+        uint32_t halted = 0;
+        int split = 0;             // Next pc is per lane, already in b->pc
+        int transfer = 0;          // Control transfer: check the step limit
+
+        steps++;
+        if (mask != alive) split_steps++;
+
+        switch (in->op) {
+            case SIM_OP_ADD:
+                LANE_OP(R[in->rd], WRAP_ADD(R[in->rs][l], R[in->rt][l]));
+                BOTH(in->rd, in->rs, in->rt);
+                break;
+            case SIM_OP_SUB:
+                LANE_OP(R[in->rd], WRAP_SUB(R[in->rs][l], R[in->rt][l]));
+                BOTH(in->rd, in->rs, in->rt);
+                break;
+            case SIM_OP_AND:
+                LANE_OP(R[in->rd], R[in->rs][l] & R[in->rt][l]);
+                BOTH(in->rd, in->rs, in->rt);
+                break;
+            case SIM_OP_OR:
+                LANE_OP(R[in->rd], R[in->rs][l] | R[in->rt][l]);
+                BOTH(in->rd, in->rs, in->rt);
+                break;
+            case SIM_OP_SLL:
+                LANE_OP(R[in->rd], (int32_t)((uint32_t)R[in->rs][l] << (in->imm & 31)));
+                COPY(in->rd, in->rs);
+                break;
+            case SIM_OP_SRL:
+                LANE_OP(R[in->rd], (int32_t)((uint32_t)R[in->rs][l] >> (in->imm & 31)));
+                COPY(in->rd, in->rs);
+                break;
+            case SIM_OP_SLT:
+                LANE_OP(R[in->rd], R[in->rs][l] < R[in->rt][l]);
+                BOTH(in->rd, in->rs, in->rt);
+                break;
+            case SIM_OP_SET:
+                LANE_OP(R[in->rd], R[in->rs][l] == R[in->rt][l]);
+                BOTH(in->rd, in->rs, in->rt);
+                break;
+            case SIM_OP_MFHI:
+                LANE_OP(R[in->rd], R[SIM_REG_HI][l]);
+                COPY(in->rd, SIM_REG_HI);
+                break;
+            case SIM_OP_MFLO:
+                LANE_OP(R[in->rd], R[SIM_REG_LO][l]);
+                COPY(in->rd, SIM_REG_LO);
+                break;
+            case SIM_OP_MOVE:
+                LANE_OP(R[in->rd], R[in->rs][l]);
+                COPY(in->rd, in->rs);
+                break;
+            case SIM_OP_MULT: {
+                int32_t hi[SIM_BATCH_LANES];
+                for (int l = 0; l < SIM_BATCH_LANES; l++) {
+                    hi[l] = (int32_t)(((int64_t)R[in->rs][l] * R[in->rt][l]) >> 32);
+                }
+                LANE_OP(R[SIM_REG_LO], (int32_t)((uint32_t)R[in->rs][l] * (uint32_t)R[in->rt][l]));
+                LANE_OP(R[SIM_REG_HI], hi[l]);
+                FORGET(SIM_REG_LO);
+                FORGET(SIM_REG_HI);
+                break;
+            }
+            case SIM_OP_DIV: {
+                // Common case: no lane divides by 0 or -1. Then the quotient
+                // is computed in double precision, which is exact for 32-bit
+                // operands and vectorizes, unlike integer division.
+                const int32_t *a = R[in->rs];
+                const int32_t *c = R[in->rt];
+                int32_t special = 0;
+                FORGET(SIM_REG_LO);
+                FORGET(SIM_REG_HI);
+                for (int l = 0; l < SIM_BATCH_LANES; l++) special |= -((c[l] == 0) | (c[l] == -1)) & lane[l];
+                if (!special) {
+                    int32_t quotient[SIM_BATCH_LANES];
+                    for (int l = 0; l < SIM_BATCH_LANES; l++) {
+                        int32_t divisor = lane[l] ? c[l] : 1;
+                        quotient[l] = (int32_t)((double)a[l] / (double)divisor);
+                    }
+                    LANE_OP(R[SIM_REG_HI], WRAP_SUB(a[l], (int32_t)((uint32_t)quotient[l] * (uint32_t)c[l])));
+                    LANE_OP(R[SIM_REG_LO], quotient[l]);
+                    break;
+                }
+                FOR_MASK(l, mask) {
+                    int32_t dividend = R[in->rs][l];
+                    int32_t divisor = R[in->rt][l];
+                    if (divisor == 0) {
+                        b->status[l] = SIM_TRAP_DIV_ZERO;
+                        trapped |= LANE_BIT(l);
+                    } else if (divisor == -1) {
+                        R[SIM_REG_LO][l] = WRAP_SUB(0, dividend);
+                        R[SIM_REG_HI][l] = 0;
+                    } else {
+                        R[SIM_REG_LO][l] = dividend / divisor;
+                        R[SIM_REG_HI][l] = dividend % divisor;
+                    }
+                }
+                break;
+            }
+            case SIM_OP_LA: case SIM_OP_LI:
+                LANE_OP(R[in->rt], in->imm);
+                SAME(in->rt);
+                break;
+            case SIM_OP_ADDI:
+                LANE_OP(R[in->rt], WRAP_ADD(R[in->rs][l], in->imm));
+                COPY(in->rt, in->rs);
+                break;
+            case SIM_OP_SUBI:
+                LANE_OP(R[in->rt], WRAP_SUB(R[in->rs][l], in->imm));
+                COPY(in->rt, in->rs);
+                break;
+            case SIM_OP_ANDI:
+                LANE_OP(R[in->rt], R[in->rs][l] & in->imm);
+                COPY(in->rt, in->rs);
+                break;
+            case SIM_OP_ORI:
+                LANE_OP(R[in->rt], R[in->rs][l] | in->imm);
+                COPY(in->rt, in->rs);
+                break;
+            case SIM_OP_LW: case SIM_OP_SW: {
+                // Stack slots are addressed off r30, which is usually the
+                // same in every lane: then the access is one contiguous row
+                int32_t base = R[in->rs][first_lane];
+                if (!(known & REG_BIT(in->rs))) {
+                    int32_t differs = 0;
+                    for (int l = 0; l < SIM_BATCH_LANES; l++) differs |= (R[in->rs][l] ^ base) & lane[l];
+                    known |= REG_BIT(in->rs);
+                    if (differs) uniform &= ~REG_BIT(in->rs); else uniform |= REG_BIT(in->rs);
+                }
+                if (in->op == SIM_OP_LW) FORGET(in->rt);
+                uint32_t addr = (uint32_t)WRAP_ADD(base, in->imm);
+                if ((uniform & REG_BIT(in->rs)) && addr < mem_words) {
+                    int32_t *row = mem + (size_t)addr * SIM_BATCH_LANES;
+                    if (in->op == SIM_OP_LW) {
+                        LANE_OP(R[in->rt], row[l]);
+                    } else if (full) {
+                        memcpy(row, R[in->rt], SIM_BATCH_LANES * sizeof(int32_t));
+                    } else {
+                        for (int l = 0; l < SIM_BATCH_LANES; l++) {
+                            row[l] = (R[in->rt][l] & lane[l]) | (row[l] & ~lane[l]);
+                        }
+                    }
+                    break;
+                }
+            }
+                /* fall through */
+            case SIM_OP_OUTPUTMEM:
+                FOR_MASK(l, mask) {
+                    uint32_t addr = (uint32_t)WRAP_ADD(R[in->rs][l], in->imm);
+                    if (addr >= mem_words) {
+                        b->status[l] = SIM_TRAP_MEM;
+                        trapped |= LANE_BIT(l);
+                    } else if (in->op == SIM_OP_LW) {
+                        R[in->rt][l] = mem[(size_t)addr * SIM_BATCH_LANES + l];
+                    } else if (in->op == SIM_OP_SW) {
+                        mem[(size_t)addr * SIM_BATCH_LANES + l] = R[in->rt][l];
+                    } else {
+                        push_output(b, l, mem[(size_t)addr * SIM_BATCH_LANES + l]);
+                    }
+                }
+                break;
+            case SIM_OP_BEQ: case SIM_OP_BNE: case SIM_OP_BGT:
+            case SIM_OP_BGTE: case SIM_OP_BLT: case SIM_OP_BLTE: {
+                const int32_t *a = R[in->rs];
+                const int32_t *c = R[in->rt];
+                int32_t cond[SIM_BATCH_LANES];
+                switch (in->op) {
+                    case SIM_OP_BEQ:  for (int l = 0; l < SIM_BATCH_LANES; l++) cond[l] = a[l] == c[l]; break;
+                    case SIM_OP_BNE:  for (int l = 0; l < SIM_BATCH_LANES; l++) cond[l] = a[l] != c[l]; break;
+                    case SIM_OP_BGT:  for (int l = 0; l < SIM_BATCH_LANES; l++) cond[l] = a[l] > c[l]; break;
+                    case SIM_OP_BGTE: for (int l = 0; l < SIM_BATCH_LANES; l++) cond[l] = a[l] >= c[l]; break;
+                    case SIM_OP_BLT:  for (int l = 0; l < SIM_BATCH_LANES; l++) cond[l] = a[l] < c[l]; break;
+                    default:          for (int l = 0; l < SIM_BATCH_LANES; l++) cond[l] = a[l] <= c[l]; break;
+                }
+                uint32_t taken = 0;
+                for (int l = 0; l < SIM_BATCH_LANES; l++) taken |= (uint32_t)cond[l] << l;
+                taken &= mask;
+                transfer = 1;
+                if (taken == mask) {
+                    next = (uint32_t)in->imm;
+                } else if (taken != 0) {
+                    FOR_MASK(l, mask) b->pc[l] = (taken & LANE_BIT(l)) ? (uint32_t)in->imm : pc + 1;
+                    split = 1;
+                }
+                break;
+            }
+            case SIM_OP_J:
+                next = (uint32_t)in->imm;
+                transfer = 1;
+                break;
+            case SIM_OP_JAL:
+                LANE_OP(R[SIM_REG_RA], (int32_t)(pc + 1));
+                SAME(SIM_REG_RA);
+                next = (uint32_t)in->imm;
+                transfer = 1;
+                break;
+            case SIM_OP_JR: case SIM_OP_JALR: {
+                uint32_t target = 0;
+                int seen = 0;
+                int uniform = 1;
+                FOR_MASK(l, mask) {
+                    b->pc[l] = (uint32_t)R[in->rs][l];
+                    if (!seen) {
+                        target = b->pc[l];
+                        seen = 1;
+                    } else if (b->pc[l] != target) {
+                        uniform = 0;
+                    }
+                }
+                if (in->op == SIM_OP_JALR) {
+                    LANE_OP(R[SIM_REG_RA], (int32_t)(pc + 1));
+                    SAME(SIM_REG_RA);
+                }
+                transfer = 1;
+                if (uniform) {
+                    next = target;
+                } else {
+                    split = 1;
+                }
+                break;
+            }
+            case SIM_OP_HALT:
+                FOR_MASK(l, mask) b->status[l] = SIM_HALTED;
+                halted = mask;
+                break;
+            case SIM_OP_OUTPUTREG:
+                FOR_MASK(l, mask) push_output(b, l, R[in->rs][l]);
+                break;
+            case SIM_OP_OUTPUTRESET:
+                break;
+            case SIM_OP_INPUT:
+                FORGET(in->rd);
+                FOR_MASK(l, mask) {
+                    if (b->input_pos[l] >= b->input_count[l]) {
+                        b->status[l] = SIM_TRAP_INPUT;
+                        trapped |= LANE_BIT(l);
+                    } else {
+                        R[in->rd][l] = b->input[l][b->input_pos[l]++];
+                    }
+                }
+                break;
+            default:
+                FOR_MASK(l, mask) b->status[l] = SIM_TRAP_OPCODE;
+                trapped = mask;
+                break;
+        }
+
+        // Retire the instruction in every lane that did not fault
+        uint32_t retired = mask & ~trapped;
+        if (trapped == 0) {
+            run++;
+        } else {
+            FOR_MASK(l, retired) b->icount[l]++;
+        }
+
+        uint32_t stopped = trapped | halted;
+        if (transfer && b->max_steps) {
+            FOR_MASK(l, retired & ~halted) {
+                if (b->icount[l] + run >= limit) {
+                    b->status[l] = SIM_STEP_LIMIT;
+                    b->pc[l] = split ? b->pc[l] : next;
+                    stopped |= LANE_BIT(l);
+                    alive &= ~LANE_BIT(l);
+                }
+            }
+        }
+
+        if (stopped == 0 && !split && mask == alive) {
+            pc = next;             // Converged fast path
+            continue;
+        }
+
+        FOR_MASK(l, trapped | halted) b->pc[l] = pc;
+        alive &= ~(trapped | halted);
+        if (!split) {
+            FOR_MASK(l, mask & ~stopped) b->pc[l] = next;
+        }
+        FOR_MASK(l, mask) b->icount[l] += run;
+        run = 0;
+        regroup = 1;
+    }
+
+    b->steps += steps;
+    b->split_steps += split_steps;
+    free(code);
+}
+
+void sim_batch_extract(const SimBatch *b, uint32_t lane, SimMachine *m) {
+    for (int r = 0; r <= SIM_NUM_REGS; r++) m->regs[r] = b->regs[r][lane];
+    uint32_t words = m->mem_words < b->mem_words ? m->mem_words : b->mem_words;
+    for (uint32_t a = 0; a < words; a++) m->mem[a] = b->mem[(size_t)a * SIM_BATCH_LANES + lane];
+    m->pc = b->pc[lane];
+    m->status = b->status[lane];
+    m->icount = b->icount[lane];
+    m->input_pos = b->input_pos[lane];
+
+    m->output_count = 0;
+    if (b->output_count[lane] > m->output_capacity) {
+        int32_t *grown = realloc(m->output, b->output_count[lane] * sizeof(int32_t));
+        if (!grown) return;
+        m->output = grown;
+        m->output_capacity = b->output_count[lane];
+    }
+    if (b->output_count[lane]) {
+        memcpy(m->output, b->output[lane], b->output_count[lane] * sizeof(int32_t));
+    }
+    m->output_count = b->output_count[lane];
+}
@@ -0,0 +1,61 @@
+#ifndef SIM_BATCH_H
+#define SIM_BATCH_H
+
+/**
+ * sim_batch.h - Lockstep simulation of one program over many input sets
+ *
+ * Up to SIM_BATCH_LANES copies of the machine run the same image side by
+ * side. Registers and data memory are stored structure-of-arrays (one
+ * int32_t per lane, lanes contiguous), so every ALU instruction becomes a
+ * fixed-width loop the compiler turns into SIMD code.
+ *
+ * Lanes that share a pc execute together under a lane mask. When a branch
+ * splits them, the lanes with the lowest pc run first and the others wait,
+ * which re-joins them at the end of loops and if/else arms.
+ */
+
+#include "simulator.h"
+
+#define SIM_BATCH_LANES 16
+
+typedef struct {
+    int32_t regs[SIM_NUM_REGS + 1][SIM_BATCH_LANES];
+    int32_t *mem;          // mem_words * SIM_BATCH_LANES, lane-interleaved
+    uint32_t mem_words;
+    uint32_t lanes;        // Lanes in use, <= SIM_BATCH_LANES
+
+    uint32_t pc[SIM_BATCH_LANES];
+    SimStatus status[SIM_BATCH_LANES];
+    uint64_t icount[SIM_BATCH_LANES];
+
+    const int32_t *input[SIM_BATCH_LANES];
+    uint32_t input_count[SIM_BATCH_LANES];
+    uint32_t input_pos[SIM_BATCH_LANES];
+
+    int32_t *output[SIM_BATCH_LANES];
+    uint32_t output_count[SIM_BATCH_LANES];
+    uint32_t output_capacity[SIM_BATCH_LANES];
+
+    uint64_t max_steps;    // Per lane, 0 = unlimited
+    uint64_t steps;        // Instructions issued for the whole batch
+    uint64_t split_steps;  // Issued while the lanes were diverged
+} SimBatch;
+
+int sim_batch_init(SimBatch *b, uint32_t lanes, uint32_t mem_words);
+
+// Clears machine state and output of every lane; keeps inputs and limits
+void sim_batch_reset(SimBatch *b);
+
+// Copies the initial data memory of 'prog' into every lane
+void sim_batch_load_data(SimBatch *b, const SimProgram *prog);
+void sim_batch_free(SimBatch *b);
+
+// Runs until every lane has halted, trapped or reached the step limit
+void sim_batch_run(SimBatch *b, const SimProgram *prog);
+
+// Copies the final state of one lane into a SimMachine, for comparison
+// with the scalar engines (m must come from sim_machine_init with the
+// same memory size)
+void sim_batch_extract(const SimBatch *b, uint32_t lane, SimMachine *m);
+
+#endif /* SIM_BATCH_H */
@@ -0,0 +1,377 @@
+/*
+ * sim_cache.c - Data-cache model for acmc-sim --cache
+ *
+ * Like the profiler, the model runs on the reference interpreter: the
+ * address of each LW/SW is computed from the registers before the step and
+ * charged to the cache once the instruction retires, so trapping accesses
+ * never reach it.
+ */
+
+#include "sim_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INVALID_TAG UINT32_MAX
+#define REGION_GAP 16
+#define TOP_SETS 8
+
+static int is_power_of_two(uint32_t v) {
+    return v && (v & (v - 1)) == 0;
+}
+
+int sim_cache_parse(SimCacheConfig *config, const char *spec) {
+    char buffer[256];
+    *config = (SimCacheConfig){ 256, 4, 2, 1, 10 };
+    if (!spec) return 0;
+    if (strlen(spec) >= sizeof(buffer)) {
+        fprintf(stderr, "Error: cache specification too long\n");
+        return -1;
+    }
+    strcpy(buffer, spec);
+
+    for (char *item = strtok(buffer, ","); item; item = strtok(NULL, ",")) {
+        char *value = strchr(item, '=');
+        if (!value) {
+            fprintf(stderr, "Error: expected key=value in cache specification, got '%s'\n", item);
+            return -1;
+        }
+        *value++ = '\0';
+        char *end;
+        unsigned long number = strtoul(value, &end, 0);
+        int numeric = *value != '\0' && *end == '\0';
+        if (strcmp(item, "policy") == 0) {
+            if (strcmp(value, "wb") == 0) {
+                config->write_back = 1;
+            } else if (strcmp(value, "wt") == 0) {
+                config->write_back = 0;
+            } else {
+                fprintf(stderr, "Error: cache policy must be wb or wt\n");
+                return -1;
+            }
+        } else if (!numeric) {
+            fprintf(stderr, "Error: cache %s must be a number\n", item);
+            return -1;
+        } else if (strcmp(item, "size") == 0) {
+            config->size = (uint32_t)number;
+        } else if (strcmp(item, "line") == 0) {
+            config->line = (uint32_t)number;
+        } else if (strcmp(item, "ways") == 0) {
+            config->ways = (uint32_t)number;
+        } else if (strcmp(item, "latency") == 0) {
+            config->latency = (uint32_t)number;
+        } else {
+            fprintf(stderr, "Error: unknown cache parameter '%s'\n", item);
+            return -1;
+        }
+    }
+
+    if (!is_power_of_two(config->size) || !is_power_of_two(config->line) || config->line > config->size) {
+        fprintf(stderr, "Error: cache size and line must be powers of two, line <= size\n");
+        return -1;
+    }
+    if (config->ways == 0 || config->size % (config->line * config->ways) != 0 ||
+        !is_power_of_two(config->size / (config->line * config->ways))) {
+        fprintf(stderr, "Error: %u ways do not divide %u lines into a power of two of sets\n",
+                config->ways, config->size / config->line);
+        return -1;
+    }
+    return 0;
+}
+
+int sim_cache_init(SimCache *c, const SimCacheConfig *config, const SimProgram *prog, uint32_t mem_words) {
+    memset(c, 0, sizeof(*c));
+    c->config = *config;
+    c->sets = config->size / (config->line * config->ways);
+    while ((1u << c->line_shift) < config->line) c->line_shift++;
+
+    size_t ways = (size_t)c->sets * config->ways;
+    c->tags = malloc(ways * sizeof(uint32_t));
+    c->dirty = calloc(ways, 1);
+    c->age = calloc(ways, sizeof(uint32_t));
+    c->length = prog->length;
+    c->by_pc = calloc(prog->length ? prog->length : 1, sizeof(SimCacheCounts));
+    c->words = mem_words;
+    c->by_address = calloc(mem_words ? mem_words : 1, sizeof(SimCacheCounts));
+    c->seen = calloc(((size_t)mem_words >> c->line_shift) + 1, 1);
+    if (!c->tags || !c->dirty || !c->age || !c->by_pc || !c->by_address || !c->seen) {
+        sim_cache_free(c);
+        return -1;
+    }
+    for (size_t i = 0; i < ways; i++) c->tags[i] = INVALID_TAG;
+    return 0;
+}
+
+void sim_cache_free(SimCache *c) {
+    free(c->tags);
+    free(c->dirty);
+    free(c->age);
+    free(c->by_pc);
+    free(c->by_address);
+    free(c->seen);
+    memset(c, 0, sizeof(*c));
+}
+
+static void count(SimCacheCounts *counts, int write, int miss, uint32_t stalls) {
+    if (write) {
+        counts->writes++;
+        counts->write_misses += miss;
+    } else {
+        counts->reads++;
+        counts->read_misses += miss;
+    }
+    counts->stalls += stalls;
+}
+
+uint32_t sim_cache_access(SimCache *c, uint32_t pc, uint32_t address, int write) {
+    uint32_t line = address >> c->line_shift;
+    uint32_t set = line & (c->sets - 1);
+    uint32_t *tags = &c->tags[(size_t)set * c->config.ways];
+    uint8_t *dirty = &c->dirty[(size_t)set * c->config.ways];
+    uint32_t *age = &c->age[(size_t)set * c->config.ways];
+    uint32_t stalls = 0;
+    int miss = 1;
+
+    uint32_t way;
+    for (way = 0; way < c->config.ways; way++) {
+        if (tags[way] == line) break;
+    }
+    if (way < c->config.ways) {
+        miss = 0;
+        age[way] = ++c->clock;
+        if (write) {
+            if (c->config.write_back) dirty[way] = 1; else stalls = c->config.latency;
+        }
+    } else if (write && !c->config.write_back) {
+        stalls = c->config.latency;   // No-write-allocate
+    } else {
+        // Fill the least recently used way (invalid ways have age 0)
+        uint32_t victim = 0;
+        for (way = 1; way < c->config.ways; way++) {
+            if (age[way] < age[victim]) victim = way;
+        }
+        if (tags[victim] != INVALID_TAG && dirty[victim]) {
+            stalls += c->config.latency;
+            c->writebacks++;
+        }
+        stalls += c->config.latency;
+        tags[victim] = line;
+        dirty[victim] = (uint8_t)(write != 0);
+        age[victim] = ++c->clock;
+    }
+
+    if (miss && address < c->words) {
+        if (!c->seen[line]) c->compulsory++;
+        c->seen[line] = 1;
+    }
+    count(&c->total, write, miss, stalls);
+    if (pc < c->length) count(&c->by_pc[pc], write, miss, stalls);
+    if (address < c->words) count(&c->by_address[address], write, miss, stalls);
+    return stalls;
+}
+
+SimStatus sim_cache_run(SimCache *c, SimMachine *m, const SimProgram *prog) {
+    while (m->status == SIM_RUNNING) {
+        uint32_t pc = m->pc;
+        uint64_t before = m->icount;
+        int access = 0;
+        uint32_t address = 0;
+        if (pc < prog->length) {
+            SimInsn in;
+            sim_decode(prog->words[pc], &in);
+            if (in.op == SIM_OP_LW || in.op == SIM_OP_SW) {
+                access = in.op == SIM_OP_SW ? 2 : 1;
+                address = (uint32_t)m->regs[in.rs] + (uint32_t)in.imm;   // Before LW overwrites rs
+            }
+        }
+        sim_step(m, prog);
+        if (m->icount == before) break;
+        if (access) sim_cache_access(c, pc, address, access == 2);
+    }
+    return m->status;
+}
+
+// ---------------------------------------------------------------------------
+// Reports
+// ---------------------------------------------------------------------------
+
+static uint64_t accesses(const SimCacheCounts *counts) {
+    return counts->reads + counts->writes;
+}
+
+static uint64_t misses(const SimCacheCounts *counts) {
+    return counts->read_misses + counts->write_misses;
+}
+
+static double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+static void add_counts(SimCacheCounts *to, const SimCacheCounts *from) {
+    to->reads += from->reads;
+    to->writes += from->writes;
+    to->read_misses += from->read_misses;
+    to->write_misses += from->write_misses;
+    to->stalls += from->stalls;
+}
+
+static void write_row(const SimCacheCounts *counts, uint64_t all_stalls, FILE *out) {
+    fprintf(out, "%7.2f %11llu %11llu %11llu %6.2f",
+            percent(counts->stalls, all_stalls), (unsigned long long)counts->stalls,
+            (unsigned long long)accesses(counts), (unsigned long long)misses(counts),
+            percent(misses(counts), accesses(counts)));
+}
+
+void sim_cache_write_summary(const SimCache *c, uint64_t instructions, FILE *out) {
+    const SimCacheConfig *k = &c->config;
+    const SimCacheCounts *t = &c->total;
+    uint64_t cycles = instructions + t->stalls;   // One cycle per instruction
+    fprintf(out, "Cache: %u words, %u-word lines, %u-way, %s, RAM latency %u cycles\n",
+            k->size, k->line, k->ways, k->write_back ? "write-back" : "write-through", k->latency);
+    fprintf(out, "Cache accesses: %llu (%llu LW, %llu SW)\n", (unsigned long long)accesses(t),
+            (unsigned long long)t->reads, (unsigned long long)t->writes);
+    fprintf(out, "Cache misses: %llu (%.2f%%; %llu LW, %llu SW; %llu compulsory), %llu write-backs\n",
+            (unsigned long long)misses(t), percent(misses(t), accesses(t)),
+            (unsigned long long)t->read_misses, (unsigned long long)t->write_misses,
+            (unsigned long long)c->compulsory, (unsigned long long)c->writebacks);
+    fprintf(out, "Cache stall cycles: %llu (%llu cycles unpipelined, CPI %.3f)\n", (unsigned long long)t->stalls,
+            (unsigned long long)cycles, instructions ? (double)cycles / (double)instructions : 0.0);
+}
+
+typedef struct {
+    const char *name;
+    uint32_t key;              // Function index, source line or address
+    SimCacheCounts counts;
+} ReportRow;
+
+static int compare_rows(const void *a, const void *b) {
+    const ReportRow *ra = a, *rb = b;
+    if (ra->counts.stalls != rb->counts.stalls) return ra->counts.stalls < rb->counts.stalls ? 1 : -1;
+    if (misses(&ra->counts) != misses(&rb->counts)) return misses(&ra->counts) < misses(&rb->counts) ? 1 : -1;
+    return ra->key < rb->key ? -1 : ra->key > rb->key;
+}
+
+static const char *function_name(const SimProfile *functions, uint32_t pc) {
+    return pc < functions->length ? functions->functions[functions->function_of[pc]].name : "?";
+}
+
+static void write_functions(const SimCache *c, const SimProfile *functions, FILE *out) {
+    ReportRow *rows = calloc(functions->function_count ? functions->function_count : 1, sizeof(ReportRow));
+    if (!rows) return;
+    for (int f = 0; f < functions->function_count; f++) {
+        rows[f].name = functions->functions[f].name;
+        rows[f].key = (uint32_t)f;
+    }
+    for (uint32_t pc = 0; pc < c->length && pc < functions->length; pc++) {
+        add_counts(&rows[functions->function_of[pc]].counts, &c->by_pc[pc]);
+    }
+    qsort(rows, functions->function_count, sizeof(ReportRow), compare_rows);
+
+    fprintf(out, "Stalls by function:\n\n");
+    fprintf(out, " %%stall      stalls    accesses      misses  miss%%  function\n");
+    for (int i = 0; i < functions->function_count; i++) {
+        if (accesses(&rows[i].counts) == 0) continue;
+        write_row(&rows[i].counts, c->total.stalls, out);
+        fprintf(out, "  %s\n", rows[i].name);
+    }
+    free(rows);
+}
+
+// One row per source line when there is a line table, per address otherwise
+static void write_sites(const SimCache *c, const SimProfile *functions, const SimLines *lines, FILE *out) {
+    ReportRow *rows = calloc(c->length ? c->length : 1, sizeof(ReportRow));
+    if (!rows) return;
+    int count = 0;
+    for (uint32_t pc = 0; pc < c->length; pc++) {
+        if (accesses(&c->by_pc[pc]) == 0) continue;
+        uint32_t key = pc;
+        if (lines) key = pc < lines->length ? lines->source_line[pc] : 0;
+        int r;
+        for (r = 0; r < count; r++) {
+            if (rows[r].key == key && (!lines || rows[r].name == function_name(functions, pc))) break;
+        }
+        if (r == count) {
+            rows[count].name = function_name(functions, pc);
+            rows[count].key = key;
+            count++;
+        }
+        add_counts(&rows[r].counts, &c->by_pc[pc]);
+    }
+    qsort(rows, count, sizeof(ReportRow), compare_rows);
+
+    if (lines) {
+        fprintf(out, "Stalls by source line (%s):\n\n", lines->source_file);
+    } else {
+        fprintf(out, "Stalls by LW/SW address (no line table):\n\n");
+    }
+    fprintf(out, " %%stall      stalls    accesses      misses  miss%%  %-8s  function\n", lines ? "line" : "pc");
+    for (int i = 0; i < count; i++) {
+        write_row(&rows[i].counts, c->total.stalls, out);
+        if (lines && rows[i].key == 0) {
+            fprintf(out, "  %-8s  %s\n", "-", rows[i].name);
+        } else {
+            fprintf(out, "  %-8u  %s\n", rows[i].key, rows[i].name);
+        }
+    }
+    free(rows);
+}
+
+// Regions: runs of touched words separated by more than REGION_GAP
+// untouched ones. Arrays and stack frames show up as separate regions.
+static void write_regions(const SimCache *c, FILE *out) {
+    uint32_t gap = c->config.line > REGION_GAP ? c->config.line : REGION_GAP;
+    fprintf(out, "Stalls by address region:\n\n");
+    fprintf(out, " %%stall      stalls    accesses      misses  miss%%  words\n");
+    uint32_t start = 0, end = 0;
+    int open = 0;
+    SimCacheCounts counts = { 0 };
+    for (uint32_t a = 0; a <= c->words; a++) {
+        int touched = a < c->words && accesses(&c->by_address[a]) != 0;
+        if (open && (a == c->words || (touched && a - end > gap + 1))) {
+            write_row(&counts, c->total.stalls, out);
+            fprintf(out, "  %u..%u\n", start, end);
+            open = 0;
+        }
+        if (!touched) continue;
+        if (!open) {
+            memset(&counts, 0, sizeof(counts));
+            start = a;
+            open = 1;
+        }
+        end = a;
+        add_counts(&counts, &c->by_address[a]);
+    }
+}
+
+// Sets with the most misses: several hot lines mapping to the same set
+// point at a conflict that padding or moving an array would remove
+static void write_sets(const SimCache *c, FILE *out) {
+    ReportRow *rows = calloc(c->sets, sizeof(ReportRow));
+    if (!rows) return;
+    for (uint32_t s = 0; s < c->sets; s++) rows[s].key = s;
+    for (uint32_t a = 0; a < c->words; a++) {
+        add_counts(&rows[(a >> c->line_shift) & (c->sets - 1)].counts, &c->by_address[a]);
+    }
+    qsort(rows, c->sets, sizeof(ReportRow), compare_rows);
+
+    fprintf(out, "Busiest sets (%u sets):\n\n", c->sets);
+    fprintf(out, " %%stall      stalls    accesses      misses  miss%%  set\n");
+    for (uint32_t i = 0; i < c->sets && i < TOP_SETS; i++) {
+        if (misses(&rows[i].counts) == 0) break;
+        write_row(&rows[i].counts, c->total.stalls, out);
+        fprintf(out, "  %u\n", rows[i].key);
+    }
+    free(rows);
+}
+
+void sim_cache_write_report(const SimCache *c, uint64_t instructions, const SimProfile *functions,
+                            const SimLines *lines, FILE *out) {
+    sim_cache_write_summary(c, instructions, out);
+    fprintf(out, "\n");
+    write_functions(c, functions, out);
+    fprintf(out, "\n");
+    write_sites(c, functions, lines, out);
+    fprintf(out, "\n");
+    write_regions(c, out);
+    fprintf(out, "\n");
+    write_sets(c, out);
+}
@@ -0,0 +1,83 @@
+#ifndef SIM_CACHE_H
+#define SIM_CACHE_H
+
+/**
+ * sim_cache.h - Data-cache and memory-latency model for the ACMC simulator
+ *
+ * Models a set-associative data cache with LRU replacement in front of an
+ * external RAM that takes 'latency' cycles per transfer. Every instruction
+ * costs one cycle, as in the rest of the simulator; a cache miss stalls the
+ * pipeline for the line fill, plus a write-back when the victim is dirty.
+ *
+ * Write policies:
+ *   wb  write-back, write-allocate: a store miss fills the line first and
+ *       dirty lines are written back when they are evicted
+ *   wt  write-through, no-write-allocate: every store goes to RAM (no write
+ *       buffer, so it stalls for 'latency'); a store hit updates the line
+ *
+ * Stalls are accounted per LW/SW address, so the report can split them by
+ * function, source line and address region.
+ */
+
+#include "simulator.h"
+#include "sim_lines.h"
+#include "sim_profile.h"
+
+typedef struct {
+    uint32_t size;             // Words; a power of two
+    uint32_t line;             // Words per line; a power of two
+    uint32_t ways;
+    int write_back;            // 1 = wb, 0 = wt
+    uint32_t latency;          // Cycles per RAM transfer
+} SimCacheConfig;
+
+typedef struct {
+    uint64_t reads, writes;
+    uint64_t read_misses, write_misses;
+    uint64_t stalls;
+} SimCacheCounts;
+
+typedef struct {
+    SimCacheConfig config;
+    uint32_t sets;
+    uint32_t line_shift;
+    uint32_t *tags;            // sets * ways, UINT32_MAX = invalid
+    uint8_t *dirty;
+    uint32_t *age;             // LRU stamp per way
+    uint32_t clock;
+
+    uint32_t length;           // Program words
+    SimCacheCounts *by_pc;
+    uint32_t words;            // Data words covered by by_address
+    SimCacheCounts *by_address;
+    uint8_t *seen;             // Per line: already filled once
+    uint64_t compulsory;       // Misses on lines never cached before
+    uint64_t writebacks;
+    SimCacheCounts total;
+} SimCache;
+
+// Parses "key=value,..." (size, line, ways, policy, latency) over the
+// defaults size=256,line=4,ways=2,policy=wb,latency=10; spec may be NULL.
+// Returns 0 on success; prints the problem otherwise.
+int sim_cache_parse(SimCacheConfig *config, const char *spec);
+
+// mem_words bounds the per-address statistics. Returns 0 on success.
+int sim_cache_init(SimCache *c, const SimCacheConfig *config, const SimProgram *prog, uint32_t mem_words);
+void sim_cache_free(SimCache *c);
+
+// Stall cycles of one access
+uint32_t sim_cache_access(SimCache *c, uint32_t pc, uint32_t address, int write);
+
+// Runs the machine to completion with the reference interpreter
+SimStatus sim_cache_run(SimCache *c, SimMachine *m, const SimProgram *prog);
+
+// One-line summary per counter, for --stats
+void sim_cache_write_summary(const SimCache *c, uint64_t instructions, FILE *out);
+
+// Stalls per function, per source line (or address without a line table)
+// and per address region. 'functions' comes from sim_profile_init() and
+// supplies the names; 'lines' may be NULL.
+void sim_cache_write_report(const SimCache *c, uint64_t instructions, const SimProfile *functions,
+                            const SimLines *lines, FILE *out);
+
+#endif /* SIM_CACHE_H */
@@ -0,0 +1,170 @@
+/*
+ * sim_checkpoint.c - Save and copy-on-write restore of simulator state
+ */
+
+#include "sim_checkpoint.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define CHECKPOINT_MAGIC "ACMCCKPT"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_BYTE_ORDER 0x01020304u
+
+static uint64_t program_hash(const SimProgram *prog) {
+    uint64_t h = 14695981039346656037ull;   // FNV-1a
+    for (uint32_t i = 0; i < prog->length; i++) {
+        uint32_t w = prog->words[i];
+        for (int b = 0; b < 4; b++) {
+            h ^= (w >> (8 * b)) & 0xFF;
+            h *= 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+SimStatus sim_checkpoint_run_to(SimMachine *m, const SimProgram *prog, const SimCheckpointPoint *at) {
+    while (m->status == SIM_RUNNING && m->icount < at->icount && m->pc != at->pc) {
+        sim_step(m, prog);
+    }
+    return m->status;
+}
+
+int sim_checkpoint_save(const char *filename, const SimMachine *m, const SimProgram *prog) {
+    FILE *f = fopen(filename, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot create checkpoint %s\n", filename);
+        return -1;
+    }
+
+    uint32_t version = CHECKPOINT_VERSION, order = CHECKPOINT_BYTE_ORDER;
+    uint64_t hash = program_hash(prog);
+    fwrite(CHECKPOINT_MAGIC, 1, 8, f);
+    fwrite(&version, sizeof(version), 1, f);
+    fwrite(&order, sizeof(order), 1, f);
+    fwrite(&hash, sizeof(hash), 1, f);
+    fwrite(&prog->length, sizeof(prog->length), 1, f);
+    fwrite(&m->pc, sizeof(m->pc), 1, f);
+    fwrite(&m->icount, sizeof(m->icount), 1, f);
+    fwrite(&m->mem_words, sizeof(m->mem_words), 1, f);
+    fwrite(&m->input_pos, sizeof(m->input_pos), 1, f);
+    fwrite(&m->input_count, sizeof(m->input_count), 1, f);
+    fwrite(&m->output_count, sizeof(m->output_count), 1, f);
+    fwrite(m->regs, sizeof(int32_t), SIM_NUM_REGS, f);
+    if (m->input_count) fwrite(m->input, sizeof(int32_t), m->input_count, f);
+    if (m->output_count) fwrite(m->output, sizeof(int32_t), m->output_count, f);
+
+    long header = ftell(f);
+    for (long pad = header; header >= 0 && pad % SIM_CHECKPOINT_ALIGN; pad++) fputc(0, f);
+    fwrite(m->mem, sizeof(int32_t), m->mem_words, f);
+
+    int failed = header < 0 || ferror(f);
+    if (fclose(f) != 0) failed = 1;
+    if (failed) fprintf(stderr, "Error: Cannot write checkpoint %s\n", filename);
+    return failed ? -1 : 0;
+}
+
+static int read_values(FILE *f, void *values, size_t size, size_t count) {
+    return count == 0 || fread(values, size, count, f) == count ? 0 : -1;
+}
+
+int sim_checkpoint_open(SimCheckpoint *c, const char *filename) {
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open checkpoint %s\n", filename);
+        return -1;
+    }
+
+    char magic[8];
+    uint32_t version = 0, order = 0;
+    int ok = fread(magic, 1, 8, f) == 8 && memcmp(magic, CHECKPOINT_MAGIC, 8) == 0 &&
+             read_values(f, &version, sizeof(version), 1) == 0 && version == CHECKPOINT_VERSION &&
+             read_values(f, &order, sizeof(order), 1) == 0;
+    if (ok && order != CHECKPOINT_BYTE_ORDER) {
+        fprintf(stderr, "Error: checkpoint %s was written with another byte order\n", filename);
+        fclose(f);
+        return -1;
+    }
+    ok = ok &&
+         read_values(f, &c->program_hash, sizeof(c->program_hash), 1) == 0 &&
+         read_values(f, &c->program_length, sizeof(c->program_length), 1) == 0 &&
+         read_values(f, &c->pc, sizeof(c->pc), 1) == 0 &&
+         read_values(f, &c->icount, sizeof(c->icount), 1) == 0 &&
+         read_values(f, &c->mem_words, sizeof(c->mem_words), 1) == 0 &&
+         read_values(f, &c->input_pos, sizeof(c->input_pos), 1) == 0 &&
+         read_values(f, &c->input_count, sizeof(c->input_count), 1) == 0 &&
+         read_values(f, &c->output_count, sizeof(c->output_count), 1) == 0 &&
+         read_values(f, c->regs, sizeof(int32_t), SIM_NUM_REGS) == 0 &&
+         c->mem_words > 0 && c->input_pos <= c->input_count;
+    if (ok) {
+        c->input = malloc((c->input_count ? c->input_count : 1) * sizeof(int32_t));
+        c->output = malloc((c->output_count ? c->output_count : 1) * sizeof(int32_t));
+        ok = c->input && c->output &&
+             read_values(f, c->input, sizeof(int32_t), c->input_count) == 0 &&
+             read_values(f, c->output, sizeof(int32_t), c->output_count) == 0;
+    }
+    long header = ok ? ftell(f) : -1;
+    fclose(f);
+    if (header < 0) {
+        fprintf(stderr, "Error: %s is not a valid checkpoint\n", filename);
+        sim_checkpoint_close(c);
+        return -1;
+    }
+    c->mem_offset = ((uint64_t)header + SIM_CHECKPOINT_ALIGN - 1) / SIM_CHECKPOINT_ALIGN * SIM_CHECKPOINT_ALIGN;
+
+    c->fd = open(filename, O_RDONLY);
+    off_t size = c->fd >= 0 ? lseek(c->fd, 0, SEEK_END) : -1;
+    if (size < 0 || (uint64_t)size < c->mem_offset + (uint64_t)c->mem_words * sizeof(int32_t)) {
+        fprintf(stderr, "Error: checkpoint %s is truncated\n", filename);
+        sim_checkpoint_close(c);
+        return -1;
+    }
+    return 0;
+}
+
+void sim_checkpoint_close(SimCheckpoint *c) {
+    if (c->fd >= 0) close(c->fd);
+    free(c->input);
+    free(c->output);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+int sim_checkpoint_matches(const SimCheckpoint *c, const SimProgram *prog) {
+    return c->program_length == prog->length && c->program_hash == program_hash(prog);
+}
+
+int sim_checkpoint_restore(const SimCheckpoint *c, SimMachine *m) {
+    memset(m, 0, sizeof(*m));
+    size_t bytes = (size_t)c->mem_words * sizeof(int32_t);
+    void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, c->fd, (off_t)c->mem_offset);
+    if (mem == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map checkpoint memory\n");
+        return -1;
+    }
+    m->mem = mem;
+    m->mem_words = c->mem_words;
+    m->mem_mapped = bytes;
+
+    if (c->output_count) {
+        m->output = malloc(c->output_count * sizeof(int32_t));
+        if (!m->output) {
+            sim_machine_free(m);
+            return -1;
+        }
+        memcpy(m->output, c->output, c->output_count * sizeof(int32_t));
+        m->output_count = m->output_capacity = c->output_count;
+    }
+    memcpy(m->regs, c->regs, sizeof(c->regs));
+    m->pc = c->pc;
+    m->icount = c->icount;
+    m->input = c->input;
+    m->input_count = c->input_count;
+    m->input_pos = c->input_pos;
+    m->status = SIM_RUNNING;
+    return 0;
+}
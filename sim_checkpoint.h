@@ -0,0 +1,71 @@
+#ifndef SIM_CHECKPOINT_H
+#define SIM_CHECKPOINT_H
+
+/**
+ * sim_checkpoint.h - Machine checkpoints for the ACMC simulator
+ *
+ * A checkpoint holds the whole state of a SimMachine that is still
+ * running: registers (HI/LO included), PC, instruction count, the input
+ * stream with its cursor, the values output so far and data memory. It is
+ * bound to the program it was taken from by a hash of the instruction
+ * words.
+ *
+ * File format, in host byte order (a marker rejects foreign files):
+ *
+ *     "ACMCCKPT" version byte-order program-hash program-length
+ *     pc icount mem-words input-pos input-count output-count
+ *     registers, input values, output values
+ *     padding to SIM_CHECKPOINT_ALIGN, then mem-words words of memory
+ *
+ * The memory image is page aligned so that sim_checkpoint_restore() maps
+ * it copy-on-write: any number of machines, threads or processes restored
+ * from one file share the pages they only read.
+ */
+
+#include "simulator.h"
+
+#define SIM_CHECKPOINT_ALIGN 65536   // Largest page size we expect
+
+typedef struct {
+    int fd;
+    uint64_t program_hash;
+    uint32_t program_length;
+    uint32_t pc;
+    uint64_t icount;
+    uint32_t mem_words;
+    uint32_t input_pos;
+    int32_t regs[SIM_NUM_REGS];
+    int32_t *input;
+    uint32_t input_count;
+    int32_t *output;
+    uint32_t output_count;
+    uint64_t mem_offset;       // Of the memory image in the file
+} SimCheckpoint;
+
+// Where --checkpoint-at stops: after 'icount' instructions, or when the
+// next instruction is at 'pc' (UINT32_MAX: no pc)
+typedef struct {
+    uint64_t icount;
+    uint32_t pc;
+} SimCheckpointPoint;
+
+// Steps the machine with the reference interpreter up to the point.
+// Returns the status: SIM_RUNNING if the point was reached.
+SimStatus sim_checkpoint_run_to(SimMachine *m, const SimProgram *prog, const SimCheckpointPoint *at);
+
+// Writes a running machine; returns 0 on success
+int sim_checkpoint_save(const char *filename, const SimMachine *m, const SimProgram *prog);
+
+// Reads the state and keeps the file open for the memory mappings
+int sim_checkpoint_open(SimCheckpoint *c, const char *filename);
+void sim_checkpoint_close(SimCheckpoint *c);
+
+// True if the checkpoint was taken from this program
+int sim_checkpoint_matches(const SimCheckpoint *c, const SimProgram *prog);
+
+// Sets up 'm' (in place of sim_machine_init()) in the checkpointed state,
+// memory mapped copy-on-write; the input stream points into 'c', which
+// must stay open while the machine runs. sim_machine_free() releases it.
+int sim_checkpoint_restore(const SimCheckpoint *c, SimMachine *m);
+
+#endif /* SIM_CHECKPOINT_H */
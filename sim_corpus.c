@@ -0,0 +1,371 @@
+/*
+ * sim_corpus.c - Parallel corpus runner for acmc-sim --batch
+ *
+ * Programs named in the manifest are loaded and predecoded once and shared
+ * read-only by all workers; every job gets its own SimMachine. Finished
+ * jobs are printed as soon as every job before them in the manifest is
+ * done, so the stream stays in order while the pool runs ahead.
+ *
+ * The target core retires one instruction per clock, so the reported
+ * cycle count equals the instruction count.
+ */
+
+#include "sim_corpus.h"
+#include "sim_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CORPUS_MESSAGE_SIZE 256
+
+typedef struct {
+    char *program_name;        // As written in the manifest
+    char *input_name;
+    char *expected_name;
+    char *input_path;          // Resolved against the manifest directory
+    char *expected_path;
+    int program;               // Index into Corpus.programs
+    int line;
+} CorpusJob;
+
+typedef struct {
+    int done;
+    int ran;                   // The program was started
+    int ok;
+    SimStatus status;
+    uint32_t pc;
+    uint64_t instructions;
+    uint32_t outputs;
+    double seconds;
+    char message[CORPUS_MESSAGE_SIZE];
+} CorpusResult;
+
+typedef struct {
+    char *path;
+    SimProgram prog;
+    int loaded;
+} CorpusProgram;
+
+typedef struct {
+    const SimCorpusOptions *options;
+    FILE *out;
+
+    CorpusJob *jobs;
+    int job_count;
+    CorpusProgram *programs;
+    int program_count;
+    CorpusResult *results;
+
+    pthread_mutex_t emit_lock;
+    int next_to_emit;
+    int failures;
+    uint64_t instructions;
+} Corpus;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static char *copy_string(const char *s) {
+    char *copy = malloc(strlen(s) + 1);
+    if (copy) strcpy(copy, s);
+    return copy;
+}
+
+// Joins 'name' to the directory of 'manifest' unless it is absolute
+static char *resolve_path(const char *manifest, const char *name) {
+    const char *slash = strrchr(manifest, '/');
+    if (name[0] == '/' || !slash) return copy_string(name);
+    size_t dir_len = (size_t)(slash - manifest) + 1;
+    char *path = malloc(dir_len + strlen(name) + 1);
+    if (!path) return NULL;
+    memcpy(path, manifest, dir_len);
+    strcpy(path + dir_len, name);
+    return path;
+}
+
+static int find_program(Corpus *c, const char *path) {
+    for (int i = 0; i < c->program_count; i++) {
+        if (strcmp(c->programs[i].path, path) == 0) return i;
+    }
+    CorpusProgram *grown = realloc(c->programs, (c->program_count + 1) * sizeof(CorpusProgram));
+    if (!grown) return -1;
+    c->programs = grown;
+    CorpusProgram *p = &c->programs[c->program_count];
+    p->path = copy_string(path);
+    p->loaded = sim_load_program(&p->prog, path) == 0;
+    if (p->loaded) {
+        sim_predecode(&p->prog, c->options->fuse);
+        p->loaded = p->prog.code != NULL;
+    }
+    return c->program_count++;
+}
+
+static int parse_manifest(Corpus *c, const char *manifest) {
+    FILE *f = fopen(manifest, "r");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open manifest %s\n", manifest);
+        return -1;
+    }
+
+    int capacity = 0;
+    char line[1024];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        char *fields[3] = { NULL, NULL, NULL };
+        int count = 0;
+        for (char *tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+            if (count == 3) {
+                fprintf(stderr, "Error: %s:%d: too many fields\n", manifest, line_number);
+                fclose(f);
+                return -1;
+            }
+            fields[count++] = tok;
+        }
+        if (count == 0) continue;
+
+        if (c->job_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            CorpusJob *grown = realloc(c->jobs, capacity * sizeof(CorpusJob));
+            if (!grown) {
+                fclose(f);
+                return -1;
+            }
+            c->jobs = grown;
+        }
+
+        CorpusJob *job = &c->jobs[c->job_count];
+        memset(job, 0, sizeof(*job));
+        job->line = line_number;
+        job->program_name = copy_string(fields[0]);
+        char *program_path = resolve_path(manifest, fields[0]);
+        job->program = program_path ? find_program(c, program_path) : -1;
+        free(program_path);
+        if (fields[1] && strcmp(fields[1], "-") != 0) {
+            job->input_name = copy_string(fields[1]);
+            job->input_path = resolve_path(manifest, fields[1]);
+        }
+        if (fields[2] && strcmp(fields[2], "-") != 0) {
+            job->expected_name = copy_string(fields[2]);
+            job->expected_path = resolve_path(manifest, fields[2]);
+        }
+        c->job_count++;
+    }
+    fclose(f);
+    return 0;
+}
+
+// Compares the program output with the expected values
+static int check_output(const SimMachine *m, const int32_t *expected, uint32_t count, char *message) {
+    uint32_t common = m->output_count < count ? m->output_count : count;
+    for (uint32_t i = 0; i < common; i++) {
+        if (m->output[i] != expected[i]) {
+            snprintf(message, CORPUS_MESSAGE_SIZE, "output %u is %d, expected %d", i, m->output[i], expected[i]);
+            return 0;
+        }
+    }
+    if (m->output_count != count) {
+        snprintf(message, CORPUS_MESSAGE_SIZE, "%u output values, expected %u", m->output_count, count);
+        return 0;
+    }
+    return 1;
+}
+
+static void run_job(Corpus *c, int index) {
+    const CorpusJob *job = &c->jobs[index];
+    CorpusResult *r = &c->results[index];
+    int32_t *input = NULL, *expected = NULL;
+    uint32_t input_count = 0, expected_count = 0;
+
+    if (job->program < 0 || !c->programs[job->program].loaded) {
+        snprintf(r->message, CORPUS_MESSAGE_SIZE, "cannot load program");
+        return;
+    }
+    if (job->input_path && sim_read_input_file(job->input_path, &input, &input_count) != 0) {
+        snprintf(r->message, CORPUS_MESSAGE_SIZE, "cannot read input file");
+        return;
+    }
+    if (job->expected_path && sim_read_input_file(job->expected_path, &expected, &expected_count) != 0) {
+        snprintf(r->message, CORPUS_MESSAGE_SIZE, "cannot read expected output");
+        free(input);
+        return;
+    }
+
+    const SimCheckpoint *checkpoint = c->options->checkpoint;
+    if (checkpoint && !sim_checkpoint_matches(checkpoint, &c->programs[job->program].prog)) {
+        snprintf(r->message, CORPUS_MESSAGE_SIZE, "checkpoint is for another program");
+        free(input);
+        free(expected);
+        return;
+    }
+
+    SimMachine m;
+    int ready = checkpoint ? sim_checkpoint_restore(checkpoint, &m) == 0
+                           : sim_machine_init(&m, c->options->mem_words) == 0;
+    if (ready) {
+        if (!checkpoint) sim_machine_load_data(&m, &c->programs[job->program].prog);
+        if (!checkpoint || job->input_path) {
+            m.input = input;
+            m.input_count = input_count;
+        }
+        uint64_t first = m.icount;   // Instructions before the checkpoint are not this job's
+        m.max_steps = c->options->max_steps ? first + c->options->max_steps : 0;
+
+        // Jobs share the image; one that writes its code runs on a copy
+        const SimProgram *prog = &c->programs[job->program].prog;
+        SimProgram copy = { 0 };
+        if (prog->writes_code) {
+            if (sim_copy_program(&copy, prog) == 0) sim_predecode(&copy, c->options->fuse);
+            prog = &copy;
+        }
+
+        double start = now_seconds();
+        sim_run(&m, prog);
+        r->seconds = now_seconds() - start;
+        sim_free_program(&copy);
+
+        r->ran = 1;
+        r->status = m.status;
+        r->pc = m.pc;
+        r->instructions = m.icount - first;
+        r->outputs = m.output_count;
+        if (m.status != SIM_HALTED) {
+            snprintf(r->message, CORPUS_MESSAGE_SIZE, "%s at pc %u", sim_status_name(m.status), m.pc);
+        } else if (!job->expected_path || check_output(&m, expected, expected_count, r->message)) {
+            r->ok = 1;
+        }
+        sim_machine_free(&m);
+    } else {
+        snprintf(r->message, CORPUS_MESSAGE_SIZE, "cannot allocate machine");
+    }
+    free(input);
+    free(expected);
+}
+
+static void print_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; s && *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(out, "\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(out, "\\u%04x", *s);
+        } else {
+            fputc(*s, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void emit_result(Corpus *c, int index) {
+    const CorpusJob *job = &c->jobs[index];
+    const CorpusResult *r = &c->results[index];
+    const char *status = r->ran ? sim_status_name(r->status) : "not run";
+    FILE *out = c->out;
+
+    if (c->options->format == SIM_CORPUS_JSON) {
+        fprintf(out, "{\"job\":%d,\"program\":", index + 1);
+        print_json_string(out, job->program_name);
+        fprintf(out, ",\"input\":");
+        if (job->input_name) print_json_string(out, job->input_name); else fprintf(out, "null");
+        fprintf(out, ",\"expected\":");
+        if (job->expected_name) print_json_string(out, job->expected_name); else fprintf(out, "null");
+        fprintf(out, ",\"ok\":%s,\"status\":", r->ok ? "true" : "false");
+        print_json_string(out, status);
+        fprintf(out, ",\"instructions\":%llu,\"cycles\":%llu,\"outputs\":%u,\"wall_ms\":%.3f",
+                (unsigned long long)r->instructions, (unsigned long long)r->instructions,
+                r->outputs, r->seconds * 1e3);
+        if (!r->ok) {
+            fprintf(out, ",\"message\":");
+            print_json_string(out, r->message);
+        }
+        fprintf(out, "}\n");
+    } else {
+        fprintf(out, "%s %d - %s", r->ok ? "ok" : "not ok", index + 1, job->program_name);
+        if (job->input_name) fprintf(out, " < %s", job->input_name);
+        fprintf(out, "\n  ---\n");
+        if (!r->ok) fprintf(out, "  message: \"%s\"\n", r->message);
+        fprintf(out, "  status: %s\n", status);
+        fprintf(out, "  instructions: %llu\n", (unsigned long long)r->instructions);
+        fprintf(out, "  cycles: %llu\n", (unsigned long long)r->instructions);
+        fprintf(out, "  wall_ms: %.3f\n", r->seconds * 1e3);
+        fprintf(out, "  manifest_line: %d\n", job->line);
+        fprintf(out, "  ...\n");
+    }
+    fflush(out);
+}
+
+static void corpus_worker(int index, int worker, void *arg) {
+    Corpus *c = arg;
+    (void)worker;
+
+    run_job(c, index);
+
+    pthread_mutex_lock(&c->emit_lock);
+    c->results[index].done = 1;
+    while (c->next_to_emit < c->job_count && c->results[c->next_to_emit].done) {
+        int next = c->next_to_emit++;
+        if (!c->results[next].ok) c->failures++;
+        c->instructions += c->results[next].instructions;
+        emit_result(c, next);
+    }
+    pthread_mutex_unlock(&c->emit_lock);
+}
+
+int sim_corpus_run(const char *manifest, const SimCorpusOptions *options, FILE *out) {
+    Corpus c;
+    memset(&c, 0, sizeof(c));
+    c.options = options;
+    c.out = out;
+
+    int result = -1;
+    if (parse_manifest(&c, manifest) == 0) {
+        c.results = calloc(c.job_count ? c.job_count : 1, sizeof(CorpusResult));
+        if (c.results) {
+            int threads = options->threads > 0 ? options->threads : sim_pool_default_threads();
+            pthread_mutex_init(&c.emit_lock, NULL);
+
+            if (options->format == SIM_CORPUS_TAP) {
+                fprintf(out, "TAP version 13\n1..%d\n", c.job_count);
+            }
+            double start = now_seconds();
+            if (sim_pool_run(c.job_count, threads, corpus_worker, &c) == 0) {
+                double seconds = now_seconds() - start;
+                if (options->format == SIM_CORPUS_JSON) {
+                    fprintf(out, "{\"summary\":{\"jobs\":%d,\"passed\":%d,\"failed\":%d,"
+                                 "\"instructions\":%llu,\"wall_s\":%.3f,\"threads\":%d}}\n",
+                            c.job_count, c.job_count - c.failures, c.failures,
+                            (unsigned long long)c.instructions, seconds, threads);
+                } else {
+                    fprintf(out, "# passed %d/%d, %llu instructions, %.3f s on %d threads\n",
+                            c.job_count - c.failures, c.job_count,
+                            (unsigned long long)c.instructions, seconds, threads);
+                }
+                result = c.failures;
+            }
+            pthread_mutex_destroy(&c.emit_lock);
+        }
+    }
+
+    for (int i = 0; i < c.job_count; i++) {
+        free(c.jobs[i].program_name);
+        free(c.jobs[i].input_name);
+        free(c.jobs[i].expected_name);
+        free(c.jobs[i].input_path);
+        free(c.jobs[i].expected_path);
+    }
+    for (int i = 0; i < c.program_count; i++) {
+        if (c.programs[i].loaded) sim_free_program(&c.programs[i].prog);
+        free(c.programs[i].path);
+    }
+    free(c.jobs);
+    free(c.programs);
+    free(c.results);
+    return result;
+}
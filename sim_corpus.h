@@ -0,0 +1,44 @@
+#ifndef SIM_CORPUS_H
+#define SIM_CORPUS_H
+
+/**
+ * sim_corpus.h - Runs a manifest of simulator jobs on a thread pool
+ *
+ * Manifest format, one job per line ('#' starts a comment):
+ *
+ *     <program.bin> [input-file|-] [expected-output|-]
+ *
+ * Relative paths are taken from the manifest's directory. Input and
+ * expected files hold whitespace-separated integers. A job passes when
+ * the program executes HALT and, if an expected file is given, prints
+ * exactly those values.
+ *
+ * Results are streamed in manifest order as TAP or as JSON lines.
+ *
+ * With a checkpoint, every job restores it (copy-on-write, so the jobs
+ * share its memory pages) and runs on from there; the job's program must
+ * be the one checkpointed, and an input file replaces the stream while
+ * keeping the checkpointed cursor.
+ */
+
+#include "simulator.h"
+#include "sim_checkpoint.h"
+
+typedef enum {
+    SIM_CORPUS_TAP = 0,
+    SIM_CORPUS_JSON
+} SimCorpusFormat;
+
+typedef struct {
+    int threads;               // <= 0: one per online processor
+    SimCorpusFormat format;
+    uint32_t mem_words;        // 0: SIM_DEFAULT_MEM_WORDS
+    uint64_t max_steps;        // Per job, 0 = unlimited
+    int fuse;                  // Superinstructions in the interpreter
+    const SimCheckpoint *checkpoint;   // Jobs start from it instead of reset; NULL: none
+} SimCorpusOptions;
+
+// Returns the number of failed jobs, or -1 if the manifest cannot be used
+int sim_corpus_run(const char *manifest, const SimCorpusOptions *options, FILE *out);
+
+#endif /* SIM_CORPUS_H */
@@ -0,0 +1,539 @@
+/*
+ * sim_jit.c - Dynamic binary translation from the ACMC ISA to x86-64
+ *
+ * Host register assignment inside translated code:
+ *   rbx = &SimMachine.regs[0]     r12 = data memory      r13d = mem_words
+ *   r14 = instructions retired    r15 = step limit       rbp  = JitContext
+ *   eax/ecx/edx are scratch
+ *
+ * A block runs from its entry pc up to the first control transfer, the
+ * first instruction the JIT leaves to the interpreter (HALT, INPUT,
+ * OUTPUT*, SWI), or JIT_MAX_BLOCK instructions. Static successors are reached
+ * through a rel32 jump that is patched once the successor exists; JR/JALR
+ * look the target up in the block table directly.
+ *
+ * Loads/stores out of range and DIV by zero leave the block before the
+ * faulting instruction, so sim_step() raises the trap with the same state
+ * the interpreters would have.
+ */
+
+#include "sim_jit.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define SIM_HAVE_JIT 1
+#include <sys/mman.h>
+#endif
+
+#ifdef SIM_HAVE_JIT
+
+#define JIT_BUFFER_SIZE (4u << 20)
+#define JIT_MAX_BLOCK 64
+#define JIT_MAX_INSN_BYTES 128                    // Worst case for one guest instruction
+#define JIT_BLOCK_RESERVE (JIT_MAX_BLOCK * JIT_MAX_INSN_BYTES + 256)
+
+// State shared between the dispatcher and translated code (offsets < 128,
+// so every field is reachable with an 8-bit displacement from rbp)
+typedef struct {
+    int32_t *regs;
+    int32_t *mem;
+    void **blocks;
+    uint64_t icount;
+    uint64_t limit;
+    uint32_t mem_words;
+    uint32_t pc;
+    uint32_t reason;
+} JitContext;
+
+enum {
+    JIT_EXIT_NEXT = 0,     // Continue at ctx.pc through the dispatcher
+    JIT_EXIT_FALLBACK      // Execute ctx.pc with sim_step()
+};
+
+// Host registers (only the ones the emitter names)
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3 };
+
+// x86 condition codes
+enum { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+typedef void (*JitEntry)(JitContext *ctx, void *block);
+
+// ============================================================================
+// EMITTER
+// ============================================================================
+
+static void emit8(SimJit *jit, uint8_t byte) {
+    jit->buffer[jit->used++] = byte;
+}
+
+static void emit32(SimJit *jit, uint32_t value) {
+    memcpy(jit->buffer + jit->used, &value, 4);
+    jit->used += 4;
+}
+
+#define EMIT(...) do { \
+        static const uint8_t bytes_[] = { __VA_ARGS__ }; \
+        memcpy(jit->buffer + jit->used, bytes_, sizeof(bytes_)); \
+        jit->used += sizeof(bytes_); \
+    } while (0)
+
+// opcode + ModRM for [rbx + 4*guest] with 'reg' in the reg field
+static void emit_guest_op(SimJit *jit, uint8_t opcode, int reg, int guest) {
+    int disp = 4 * guest;
+    emit8(jit, opcode);
+    if (disp < 128) {
+        emit8(jit, (uint8_t)(0x40 | (reg << 3) | RBX));
+        emit8(jit, (uint8_t)disp);
+    } else {
+        emit8(jit, (uint8_t)(0x80 | (reg << 3) | RBX));
+        emit32(jit, (uint32_t)disp);
+    }
+}
+
+#define LOAD_GUEST(reg, guest)  emit_guest_op(jit, 0x8B, (reg), (guest))
+#define STORE_GUEST(reg, guest) emit_guest_op(jit, 0x89, (reg), (guest))
+
+// mov dword [rbx + 4*guest], imm32
+static void emit_store_imm(SimJit *jit, int guest, int32_t value) {
+    emit_guest_op(jit, 0xC7, 0, guest);
+    emit32(jit, (uint32_t)value);
+}
+
+// Short forward jump; returns the position of its rel8 for patch8()
+static size_t emit_jcc8(SimJit *jit, int cc) {
+    emit8(jit, (uint8_t)(0x70 | cc));
+    emit8(jit, 0);
+    return jit->used - 1;
+}
+
+static void patch8(SimJit *jit, size_t at) {
+    jit->buffer[at] = (uint8_t)(jit->used - (at + 1));
+}
+
+static void emit_jmp32(SimJit *jit, size_t target) {
+    emit8(jit, 0xE9);
+    emit32(jit, (uint32_t)(target - (jit->used + 4)));
+}
+
+// add r14, n
+static void emit_retire(SimJit *jit, uint32_t n) {
+    if (n == 0) return;
+    if (n < 128) {
+        EMIT(0x49, 0x83, 0xC6);
+        emit8(jit, (uint8_t)n);
+    } else {
+        EMIT(0x49, 0x81, 0xC6);
+        emit32(jit, n);
+    }
+}
+
+// ctx->reason = reason; return to the dispatcher with eax as the next pc
+static void emit_leave(SimJit *jit, int reason) {
+    EMIT(0xC7, 0x45, offsetof(JitContext, reason));
+    emit32(jit, (uint32_t)reason);
+    emit_jmp32(jit, jit->exit_offset);
+}
+
+static void emit_exit(SimJit *jit, uint32_t pc, int reason) {
+    emit8(jit, 0xB8);                          // mov eax, pc
+    emit32(jit, pc);
+    emit_leave(jit, reason);
+}
+
+static void add_pending(SimJit *jit, uint32_t site, uint32_t target) {
+    if (jit->pending_count == jit->pending_capacity) {
+        uint32_t capacity = jit->pending_capacity ? jit->pending_capacity * 2 : 64;
+        void *grown = realloc(jit->pending, capacity * sizeof(*jit->pending));
+        if (!grown) return;                    // Stays an exit to the dispatcher
+        jit->pending = grown;
+        jit->pending_capacity = capacity;
+    }
+    jit->pending[jit->pending_count].site = site;
+    jit->pending[jit->pending_count].target = target;
+    jit->pending_count++;
+}
+
+// Transfer to a static guest target: jumps straight into the target block
+// while under the step limit, otherwise (or until the target has been
+// translated) falls into an exit stub
+static void emit_chain(SimJit *jit, uint32_t target) {
+    if (target >= jit->prog->length) {
+        emit_exit(jit, target, JIT_EXIT_NEXT);
+        return;
+    }
+    EMIT(0x4D, 0x39, 0xFE);                    // cmp r14, r15
+    size_t over = emit_jcc8(jit, CC_AE);
+    emit8(jit, 0xE9);
+    size_t site = jit->used;
+    if (jit->blocks[target]) {
+        emit32(jit, (uint32_t)((uint8_t *)jit->blocks[target] - (jit->buffer + site + 4)));
+        jit->chained++;
+    } else {
+        emit32(jit, 0);                        // Falls through to the stub
+        add_pending(jit, (uint32_t)site, target);
+    }
+    patch8(jit, over);
+    emit_exit(jit, target, JIT_EXIT_NEXT);
+}
+
+// eax = rs + imm, leaving the block at 'pc' if it is not a valid address
+static void emit_address(SimJit *jit, const SimInsn *in, uint32_t pc, uint32_t retired) {
+    LOAD_GUEST(RAX, in->rs);
+    if (in->imm != 0) {
+        emit8(jit, 0x05);                      // add eax, imm32
+        emit32(jit, (uint32_t)in->imm);
+    }
+    EMIT(0x44, 0x39, 0xE8);                    // cmp eax, r13d
+    size_t ok = emit_jcc8(jit, CC_B);
+    emit_retire(jit, retired);
+    emit_exit(jit, pc, JIT_EXIT_FALLBACK);
+    patch8(jit, ok);
+}
+
+static void emit_div(SimJit *jit, const SimInsn *in, uint32_t pc, uint32_t retired) {
+    LOAD_GUEST(RCX, in->rt);
+    EMIT(0x85, 0xC9);                          // test ecx, ecx
+    size_t nonzero = emit_jcc8(jit, CC_NE);
+    emit_retire(jit, retired);
+    emit_exit(jit, pc, JIT_EXIT_FALLBACK);
+    patch8(jit, nonzero);
+
+    EMIT(0x83, 0xF9, 0xFF);                    // cmp ecx, -1
+    size_t minus_one = emit_jcc8(jit, CC_E);
+    LOAD_GUEST(RAX, in->rs);
+    EMIT(0x99, 0xF7, 0xF9);                    // cdq; idiv ecx
+    STORE_GUEST(RAX, SIM_REG_LO);
+    STORE_GUEST(RDX, SIM_REG_HI);
+    EMIT(0xEB, 0x00);                          // jmp done
+    size_t done = jit->used - 1;
+    patch8(jit, minus_one);
+    LOAD_GUEST(RAX, in->rs);                   // x / -1 without the INT_MIN fault
+    EMIT(0xF7, 0xD8);                          // neg eax
+    STORE_GUEST(RAX, SIM_REG_LO);
+    emit_store_imm(jit, SIM_REG_HI, 0);
+    patch8(jit, done);
+}
+
+static int branch_condition(int op) {
+    switch (op) {
+        case SIM_OP_BEQ:  return CC_E;
+        case SIM_OP_BNE:  return CC_NE;
+        case SIM_OP_BGT:  return CC_G;
+        case SIM_OP_BGTE: return CC_GE;
+        case SIM_OP_BLT:  return CC_L;
+        default:          return CC_LE;
+    }
+}
+
+// Instructions handed to sim_step() instead of being translated
+static int jit_supported(int op) {
+    if (op >= SIM_OP_COUNT) return 0;
+    switch (op) {
+        case SIM_OP_HALT: case SIM_OP_OUTPUTMEM: case SIM_OP_OUTPUTREG:
+        case SIM_OP_OUTPUTRESET: case SIM_OP_INPUT: case SIM_OP_SWI:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// ============================================================================
+// CODE CACHE
+// ============================================================================
+
+static int set_writable(SimJit *jit, int writable) {
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC;
+    return mprotect(jit->buffer, jit->capacity, prot);
+}
+
+static void flush_cache(SimJit *jit) {
+    memset(jit->blocks, 0, jit->prog->length * sizeof(void *));
+    jit->pending_count = 0;
+    jit->used = jit->entry_offset;
+    jit->flushes++;
+}
+
+// Entry trampoline and shared epilogue
+static void emit_trampoline(SimJit *jit) {
+    EMIT(0x55, 0x53, 0x41, 0x54, 0x41, 0x55,  // push rbp, rbx, r12, r13, r14, r15
+         0x41, 0x56, 0x41, 0x57);
+    EMIT(0x48, 0x89, 0xFD);                    // mov rbp, rdi
+    EMIT(0x48, 0x8B, 0x5D, offsetof(JitContext, regs));
+    EMIT(0x4C, 0x8B, 0x65, offsetof(JitContext, mem));
+    EMIT(0x44, 0x8B, 0x6D, offsetof(JitContext, mem_words));
+    EMIT(0x4C, 0x8B, 0x75, offsetof(JitContext, icount));
+    EMIT(0x4C, 0x8B, 0x7D, offsetof(JitContext, limit));
+    EMIT(0xFF, 0xE6);                          // jmp rsi
+
+    jit->exit_offset = jit->used;
+    EMIT(0x89, 0x45, offsetof(JitContext, pc));
+    EMIT(0x4C, 0x89, 0x75, offsetof(JitContext, icount));
+    EMIT(0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D,  // pop r15, r14, r13, r12, rbx, rbp
+         0x41, 0x5C, 0x5B, 0x5D);
+    EMIT(0xC3);                                // ret
+
+    jit->entry_offset = jit->used;
+}
+
+// Translates the block starting at 'start'; NULL if it begins with an
+// instruction the JIT does not handle
+static void *translate(SimJit *jit, uint32_t start) {
+    const SimProgram *prog = jit->prog;
+    SimInsn in;
+
+    sim_decode(prog->words[start], &in);
+    if (!jit_supported(in.op)) return NULL;
+
+    if (set_writable(jit, 1) != 0) return NULL;
+    if (jit->capacity - jit->used < JIT_BLOCK_RESERVE) flush_cache(jit);
+
+    size_t block_offset = jit->used;
+    uint32_t pc = start;
+    uint32_t n = 0;
+
+    for (;;) {
+        if (pc >= prog->length || n == JIT_MAX_BLOCK) {
+            emit_retire(jit, n);
+            emit_chain(jit, pc);
+            break;
+        }
+        sim_decode(prog->words[pc], &in);
+        if (!jit_supported(in.op)) {
+            emit_retire(jit, n);
+            emit_chain(jit, pc);
+            break;
+        }
+
+        int ends_block = 0;
+        switch (in.op) {
+            case SIM_OP_ADD: case SIM_OP_SUB: case SIM_OP_AND: case SIM_OP_OR: {
+                static const uint8_t alu[] = { 0x03, 0x2B, 0x23, 0x0B };
+                int index = in.op == SIM_OP_ADD ? 0 : in.op == SIM_OP_SUB ? 1 : in.op == SIM_OP_AND ? 2 : 3;
+                LOAD_GUEST(RAX, in.rs);
+                emit_guest_op(jit, alu[index], RAX, in.rt);
+                STORE_GUEST(RAX, in.rd);
+                break;
+            }
+            case SIM_OP_SLL: case SIM_OP_SRL:
+                LOAD_GUEST(RAX, in.rs);
+                if (in.imm & 31) {
+                    EMIT(0xC1);
+                    emit8(jit, in.op == SIM_OP_SLL ? 0xE0 : 0xE8);
+                    emit8(jit, (uint8_t)(in.imm & 31));
+                }
+                STORE_GUEST(RAX, in.rd);
+                break;
+            case SIM_OP_SLT: case SIM_OP_SET:
+                EMIT(0x31, 0xC9);              // xor ecx, ecx
+                LOAD_GUEST(RAX, in.rs);
+                emit_guest_op(jit, 0x3B, RAX, in.rt);
+                EMIT(0x0F);
+                emit8(jit, (uint8_t)(0x90 | (in.op == SIM_OP_SLT ? CC_L : CC_E)));
+                EMIT(0xC1);                    // setcc cl
+                STORE_GUEST(RCX, in.rd);
+                break;
+            case SIM_OP_MFHI:
+                LOAD_GUEST(RAX, SIM_REG_HI);
+                STORE_GUEST(RAX, in.rd);
+                break;
+            case SIM_OP_MFLO:
+                LOAD_GUEST(RAX, SIM_REG_LO);
+                STORE_GUEST(RAX, in.rd);
+                break;
+            case SIM_OP_MOVE:
+                LOAD_GUEST(RAX, in.rs);
+                STORE_GUEST(RAX, in.rd);
+                break;
+            case SIM_OP_MULT:
+                LOAD_GUEST(RAX, in.rs);
+                emit_guest_op(jit, 0xF7, 5, in.rt);   // imul dword [rt]
+                STORE_GUEST(RAX, SIM_REG_LO);
+                STORE_GUEST(RDX, SIM_REG_HI);
+                break;
+            case SIM_OP_DIV:
+                emit_div(jit, &in, pc, n);
+                break;
+            case SIM_OP_LA: case SIM_OP_LI:
+                emit_store_imm(jit, in.rt, in.imm);
+                break;
+            case SIM_OP_ADDI: case SIM_OP_SUBI: case SIM_OP_ANDI: case SIM_OP_ORI: {
+                static const uint8_t alu_imm[] = { 0x05, 0x2D, 0x25, 0x0D };
+                LOAD_GUEST(RAX, in.rs);
+                emit8(jit, alu_imm[in.op - SIM_OP_ADDI]);
+                emit32(jit, (uint32_t)in.imm);
+                STORE_GUEST(RAX, in.rt);
+                break;
+            }
+            case SIM_OP_LW:
+                emit_address(jit, &in, pc, n);
+                EMIT(0x41, 0x8B, 0x04, 0x84);  // mov eax, [r12 + rax*4]
+                STORE_GUEST(RAX, in.rt);
+                break;
+            case SIM_OP_SW:
+                emit_address(jit, &in, pc, n);
+                LOAD_GUEST(RCX, in.rt);
+                EMIT(0x41, 0x89, 0x0C, 0x84);  // mov [r12 + rax*4], ecx
+                break;
+            case SIM_OP_BEQ: case SIM_OP_BNE: case SIM_OP_BGT:
+            case SIM_OP_BGTE: case SIM_OP_BLT: case SIM_OP_BLTE: {
+                emit_retire(jit, n + 1);
+                LOAD_GUEST(RAX, in.rs);
+                emit_guest_op(jit, 0x3B, RAX, in.rt);
+                size_t taken = emit_jcc8(jit, branch_condition(in.op));
+                emit_chain(jit, pc + 1);
+                patch8(jit, taken);
+                emit_chain(jit, (uint32_t)in.imm);
+                ends_block = 1;
+                break;
+            }
+            case SIM_OP_J: case SIM_OP_JAL:
+                if (in.op == SIM_OP_JAL) emit_store_imm(jit, SIM_REG_RA, (int32_t)(pc + 1));
+                emit_retire(jit, n + 1);
+                emit_chain(jit, (uint32_t)in.imm);
+                ends_block = 1;
+                break;
+            case SIM_OP_JR: case SIM_OP_JALR: {
+                LOAD_GUEST(RAX, in.rs);
+                if (in.op == SIM_OP_JALR) emit_store_imm(jit, SIM_REG_RA, (int32_t)(pc + 1));
+                emit_retire(jit, n + 1);
+                emit8(jit, 0x3D);              // cmp eax, length
+                emit32(jit, prog->length);
+                size_t out_of_range = emit_jcc8(jit, CC_AE);
+                EMIT(0x48, 0x8B, 0x4D, offsetof(JitContext, blocks));
+                EMIT(0x48, 0x8B, 0x0C, 0xC1);  // mov rcx, [rcx + rax*8]
+                EMIT(0x48, 0x85, 0xC9);        // test rcx, rcx
+                size_t untranslated = emit_jcc8(jit, CC_E);
+                EMIT(0x4D, 0x39, 0xFE);        // cmp r14, r15
+                size_t at_limit = emit_jcc8(jit, CC_AE);
+                EMIT(0xFF, 0xE1);              // jmp rcx
+                patch8(jit, out_of_range);
+                patch8(jit, untranslated);
+                patch8(jit, at_limit);
+                emit_leave(jit, JIT_EXIT_NEXT);
+                ends_block = 1;
+                break;
+            }
+            default:
+                break;
+        }
+        n++;
+        pc++;
+        if (ends_block) break;
+    }
+
+    void *block = jit->buffer + block_offset;
+    jit->blocks[start] = block;
+    jit->translated_blocks++;
+    jit->translated_insns += n;
+
+    // Link every exit that was waiting for this block
+    for (uint32_t i = 0; i < jit->pending_count; ) {
+        if (jit->pending[i].target == start) {
+            uint32_t site = jit->pending[i].site;
+            uint32_t rel = (uint32_t)(block_offset - (site + 4));
+            memcpy(jit->buffer + site, &rel, 4);
+            jit->chained++;
+            jit->pending[i] = jit->pending[--jit->pending_count];
+        } else {
+            i++;
+        }
+    }
+
+    if (set_writable(jit, 0) != 0) return NULL;
+    return block;
+}
+
+SimJit *sim_jit_create(const SimProgram *prog) {
+    SimJit *jit = calloc(1, sizeof(SimJit));
+    if (!jit) return NULL;
+    jit->prog = prog;
+    jit->capacity = JIT_BUFFER_SIZE;
+    jit->blocks = calloc(prog->length ? prog->length : 1, sizeof(void *));
+    void *buffer = mmap(NULL, jit->capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (!jit->blocks || buffer == MAP_FAILED) {
+        if (buffer != MAP_FAILED) munmap(buffer, jit->capacity);
+        free(jit->blocks);
+        free(jit);
+        return NULL;
+    }
+    jit->buffer = buffer;
+    emit_trampoline(jit);
+    if (set_writable(jit, 0) != 0) {
+        sim_jit_destroy(jit);
+        return NULL;
+    }
+    return jit;
+}
+
+void sim_jit_destroy(SimJit *jit) {
+    if (!jit) return;
+    munmap(jit->buffer, jit->capacity);
+    free(jit->blocks);
+    free(jit->pending);
+    free(jit);
+}
+
+SimStatus sim_jit_run(SimJit *jit, SimMachine *m) {
+    const SimProgram *prog = jit->prog;
+    JitEntry enter = (JitEntry)(void *)jit->buffer;
+    JitContext ctx;
+
+    ctx.regs = m->regs;
+    ctx.mem = m->mem;
+    ctx.blocks = jit->blocks;
+    ctx.mem_words = m->mem_words;
+    ctx.limit = m->max_steps ? m->max_steps : UINT64_MAX;
+
+    while (m->status == SIM_RUNNING) {
+        if (m->max_steps && m->icount >= m->max_steps) {
+            m->status = SIM_STEP_LIMIT;
+            break;
+        }
+        if (m->pc >= prog->length) {
+            m->status = SIM_TRAP_PC;
+            break;
+        }
+
+        void *block = jit->blocks[m->pc];
+        if (!block) block = translate(jit, m->pc);
+        if (!block) {
+            // Translations are chained, so a store into the code drops them all
+            int writes_code = prog->words[m->pc] >> 26 == SIM_OP_SWI;
+            sim_step(m, prog);
+            jit->fallbacks++;
+            if (writes_code) flush_cache(jit);
+            continue;
+        }
+
+        ctx.icount = m->icount;
+        enter(&ctx, block);
+        m->icount = ctx.icount;
+        m->pc = ctx.pc;
+
+        if (ctx.reason == JIT_EXIT_FALLBACK) {
+            sim_step(m, prog);
+            jit->fallbacks++;
+        }
+    }
+    return m->status;
+}
+
+#else /* !SIM_HAVE_JIT */
+
+SimJit *sim_jit_create(const SimProgram *prog) {
+    (void)prog;
+    return NULL;
+}
+
+void sim_jit_destroy(SimJit *jit) {
+    (void)jit;
+}
+
+SimStatus sim_jit_run(SimJit *jit, SimMachine *m) {
+    (void)jit;
+    return m->status = SIM_TRAP_OPCODE;
+}
+
+#endif /* SIM_HAVE_JIT */
@@ -0,0 +1,51 @@
+#ifndef SIM_JIT_H
+#define SIM_JIT_H
+
+/**
+ * sim_jit.h - Dynamic binary translation for the ACMC simulator
+ *
+ * Translates basic blocks of the target ISA into x86-64 machine code on
+ * first execution. Guest registers stay in SimMachine.regs (addressed
+ * through a pinned host register), blocks with static successors are
+ * chained by patching their exit jumps, and I/O, HALT and faulting
+ * instructions are handed back to the reference interpreter.
+ *
+ * Only available on x86-64 System V hosts; elsewhere sim_jit_create()
+ * returns NULL and callers fall back to sim_run().
+ */
+
+#include "simulator.h"
+
+typedef struct {
+    const SimProgram *prog;
+    uint8_t *buffer;       // mmap'd code cache
+    size_t capacity;
+    size_t used;
+    size_t exit_offset;    // Shared block epilogue
+    size_t entry_offset;   // Start of the first translated block
+    void **blocks;         // Host address per guest pc, NULL if untranslated
+
+    // Chain jumps waiting for their target block to be translated
+    struct {
+        uint32_t site;     // Offset of the rel32 operand in the buffer
+        uint32_t target;   // Guest pc
+    } *pending;
+    uint32_t pending_count;
+    uint32_t pending_capacity;
+
+    // Statistics
+    uint32_t translated_blocks;
+    uint32_t translated_insns;
+    uint32_t chained;
+    uint32_t flushes;
+    uint64_t fallbacks;    // Instructions executed by sim_step()
+} SimJit;
+
+// Returns NULL if the host cannot run generated code
+SimJit *sim_jit_create(const SimProgram *prog);
+void sim_jit_destroy(SimJit *jit);
+
+// Runs until HALT, a trap or the step limit, like sim_run()
+SimStatus sim_jit_run(SimJit *jit, SimMachine *m);
+
+#endif /* SIM_JIT_H */
@@ -0,0 +1,139 @@
+/*
+ * sim_lines.c - Reader for .lines tables (see line_table.h for the format)
+ */
+
+#include "sim_lines.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINES_MAGIC "ACMCLINE"
+#define LINES_VERSION 1
+
+static int read_uleb(FILE *f, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(f);
+        if (byte == EOF) return -1;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int read_sleb(FILE *f, int64_t *value) {
+    int64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(f);
+        if (byte == EOF) return -1;
+        result |= (int64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            if (shift + 7 < 64 && (byte & 0x40)) result |= -((int64_t)1 << (shift + 7));
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Reads a length-prefixed file name and joins it to the table's directory
+static char *read_name(FILE *f, const char *filename) {
+    uint64_t length;
+    if (read_uleb(f, &length) != 0 || length > 4096) return NULL;
+
+    const char *slash = strrchr(filename, '/');
+    size_t dir_len = slash ? (size_t)(slash - filename) + 1 : 0;
+    char *path = malloc(dir_len + length + 1);
+    if (!path) return NULL;
+    memcpy(path, filename, dir_len);
+    if (fread(path + dir_len, 1, length, f) != length) {
+        free(path);
+        return NULL;
+    }
+    path[dir_len + length] = '\0';
+    return path;
+}
+
+int sim_lines_load(SimLines *t, const char *filename) {
+    memset(t, 0, sizeof(*t));
+
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open line table %s\n", filename);
+        return -1;
+    }
+
+    char magic[sizeof(LINES_MAGIC) - 1];
+    int ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+             memcmp(magic, LINES_MAGIC, sizeof(magic)) == 0 &&
+             fgetc(f) == LINES_VERSION;
+    if (ok) {
+        t->source_file = read_name(f, filename);
+        t->ir_file = read_name(f, filename);
+        ok = t->source_file && t->ir_file;
+    }
+
+    uint64_t rows = 0;
+    uint64_t *row_address = NULL;
+    int64_t *row_ir = NULL, *row_source = NULL;
+    if (ok) ok = read_uleb(f, &rows) == 0 && rows <= (1u << 24);
+    if (ok) {
+        row_address = malloc((rows + 1) * sizeof(uint64_t));
+        row_ir = malloc((rows + 1) * sizeof(int64_t));
+        row_source = malloc((rows + 1) * sizeof(int64_t));
+        ok = row_address && row_ir && row_source;
+    }
+
+    uint64_t address = 0;
+    int64_t ir = 0, source = 0;
+    for (uint64_t r = 0; ok && r < rows; r++) {
+        uint64_t address_delta;
+        int64_t ir_delta, source_delta;
+        ok = read_uleb(f, &address_delta) == 0 && read_sleb(f, &ir_delta) == 0 &&
+             read_sleb(f, &source_delta) == 0;
+        address += address_delta;
+        ir += ir_delta;
+        source += source_delta;
+        row_address[r] = address;
+        row_ir[r] = ir;
+        row_source[r] = source;
+    }
+
+    uint64_t end = 0;
+    if (ok) ok = read_uleb(f, &end) == 0 && end <= (1u << 26) && (rows == 0 || end >= address);
+    if (ok) {
+        t->length = (uint32_t)end;
+        t->ir_line = calloc(end ? end : 1, sizeof(uint32_t));
+        t->source_line = calloc(end ? end : 1, sizeof(uint32_t));
+        ok = t->ir_line && t->source_line;
+    }
+    for (uint64_t r = 0; ok && r < rows; r++) {
+        uint64_t stop = r + 1 < rows && row_address[r + 1] < end ? row_address[r + 1] : end;
+        for (uint64_t a = row_address[r]; a < stop; a++) {
+            t->ir_line[a] = row_ir[r] > 0 ? (uint32_t)row_ir[r] : 0;
+            t->source_line[a] = row_source[r] > 0 ? (uint32_t)row_source[r] : 0;
+        }
+    }
+
+    free(row_address);
+    free(row_ir);
+    free(row_source);
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "Error: %s is not a valid line table\n", filename);
+        sim_lines_free(t);
+        return -1;
+    }
+    return 0;
+}
+
+void sim_lines_free(SimLines *t) {
+    free(t->source_file);
+    free(t->ir_file);
+    free(t->ir_line);
+    free(t->source_line);
+    memset(t, 0, sizeof(*t));
+}
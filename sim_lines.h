@@ -0,0 +1,25 @@
+#ifndef SIM_LINES_H
+#define SIM_LINES_H
+
+/**
+ * sim_lines.h - Reader for the .lines tables written by the compiler
+ *
+ * Expands the delta-encoded rows of line_table.c into one IR line and one
+ * C- source line per instruction address. Line 0 means "no line".
+ */
+
+#include <stdint.h>
+
+typedef struct {
+    char *source_file;         // Resolved against the .lines directory
+    char *ir_file;
+    uint32_t length;           // Addresses covered
+    uint32_t *ir_line;         // Per address
+    uint32_t *source_line;     // Per address
+} SimLines;
+
+// Returns 0 on success
+int sim_lines_load(SimLines *t, const char *filename);
+void sim_lines_free(SimLines *t);
+
+#endif /* SIM_LINES_H */
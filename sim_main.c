@@ -0,0 +1,717 @@
+/*
+ * sim_main.c - Command-line driver for the ACMC simulator
+ *
+ * Usage: acmc-sim [options] <program.bin> [input-file]
+ *        acmc-sim --lockstep [options] <program.bin> <input-file>...
+ *        acmc-sim --batch <manifest> [-j threads] [--format tap|json]
+ *
+ * Values written by OUTPUTREG/OUTPUTMEM are printed to stdout, one per
+ * line. Exit status is 0 when the program executes HALT, 1 otherwise.
+ */
+
+#include "simulator.h"
+#include "sim_jit.h"
+#include "sim_batch.h"
+#include "sim_corpus.h"
+#include "sim_profile.h"
+#include "sim_trace.h"
+#include "sim_cache.h"
+#include "sim_pipeline.h"
+#include "sim_checkpoint.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "try: %s [options] <program.bin> [input-file]\n"
+            "     %s --lockstep [options] <program.bin> <input-file>...\n"
+            "     %s --batch <manifest> [options]\n"
+            "  -i <file>          read INPUT values from file\n"
+            "  --mem <words>      data memory size (default %d)\n"
+            "  --max-steps <n>    stop after n instructions\n"
+            "  --no-fuse          disable superinstructions\n"
+            "  --reference        use the decode-every-step interpreter\n"
+            "  --jit              translate hot blocks to native code (x86-64)\n"
+            "  --verify           also run the reference interpreter and compare\n"
+            "  --lockstep         run every input file in SIMD lanes, %d at a time\n"
+            "  --batch <file>     run every job of a manifest on a thread pool\n"
+            "  -j <n>             worker threads for --batch (default: all cores)\n"
+            "  --format <fmt>     --batch results as tap (default) or json\n"
+            "  --profile <file>   write flat profile, call graph and annotated listing\n"
+            "  --folded <file>    write folded call stacks (flamegraph.pl input)\n"
+            "  --asm <file>       listing used by the profiler (default: <program>.asm)\n"
+            "  --lines <file>     line table used by the profiler (default: <program>.lines)\n"
+            "  --trace <file>     record every LW/SW to a compressed memory trace\n"
+            "  --cache <spec>     model a data cache, e.g. size=256,line=4,ways=2,policy=wb,latency=10\n"
+            "  --cache-report <f> write cache stalls by function, source line and region\n"
+            "  --pipeline <spec>  time a 5-stage pipeline, e.g. forwarding=on,branch=ex,penalty=2,mult=4,div=16\n"
+            "  --pipeline-report <f> write CPI and stalls by function and instruction\n"
+            "  --checkpoint <f>   save the machine state at --checkpoint-at, then go on\n"
+            "  --checkpoint-at <p> instruction count, or function whose first instruction is next\n"
+            "  --restore <file>   start from a checkpoint (also with --batch)\n"
+            "  --stats            print instruction count and speed to stderr\n"
+            "  -q                 do not print output values\n",
+            prog, prog, prog, SIM_DEFAULT_MEM_WORDS, SIM_BATCH_LANES);
+}
+
+// Compares the final state of two runs; prints the first difference
+static int compare_machines(const SimMachine *a, const SimMachine *b) {
+    if (a->status != b->status) {
+        fprintf(stderr, "Verify: status %s vs %s\n", sim_status_name(a->status), sim_status_name(b->status));
+        return 0;
+    }
+    if (a->icount != b->icount || a->pc != b->pc) {
+        fprintf(stderr, "Verify: stopped after %llu instructions at pc %u vs %llu at pc %u\n",
+                (unsigned long long)a->icount, a->pc, (unsigned long long)b->icount, b->pc);
+        return 0;
+    }
+    if (a->output_count != b->output_count) {
+        fprintf(stderr, "Verify: %u output values vs %u\n", a->output_count, b->output_count);
+        return 0;
+    }
+    for (uint32_t i = 0; i < a->output_count; i++) {
+        if (a->output[i] != b->output[i]) {
+            fprintf(stderr, "Verify: output %u is %d vs %d\n", i, a->output[i], b->output[i]);
+            return 0;
+        }
+    }
+    for (int r = 0; r < SIM_NUM_REGS; r++) {
+        if (a->regs[r] != b->regs[r]) {
+            fprintf(stderr, "Verify: r%d is %d vs %d\n", r, a->regs[r], b->regs[r]);
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < a->mem_words; i++) {
+        if (a->mem[i] != b->mem[i]) {
+            fprintf(stderr, "Verify: mem[%u] is %d vs %d\n", i, a->mem[i], b->mem[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// <program><extension> next to a .bin/.binbd image, if there is one
+static char *companion_file(const char *program_file, const char *extension) {
+    const char *dot = strrchr(program_file, '.');
+    size_t stem = dot && strchr(dot, '/') == NULL ? (size_t)(dot - program_file) : strlen(program_file);
+    char *path = malloc(stem + strlen(extension) + 1);
+    if (!path) return NULL;
+    memcpy(path, program_file, stem);
+    strcpy(path + stem, extension);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        free(path);
+        return NULL;
+    }
+    fclose(f);
+    return path;
+}
+
+// Writes the profile files requested on the command line
+static int write_profile(const SimProfile *profile, const SimProgram *prog, const SimLines *lines,
+                         const char *report_file, const char *folded_file) {
+    int ok = 1;
+    if (report_file) {
+        FILE *f = fopen(report_file, "w");
+        if (f) {
+            sim_profile_write_report(profile, prog, lines, f);
+            fclose(f);
+        } else {
+            fprintf(stderr, "Error: Cannot write profile %s\n", report_file);
+            ok = 0;
+        }
+    }
+    if (folded_file) {
+        FILE *f = fopen(folded_file, "w");
+        if (f) {
+            sim_profile_write_folded(profile, f);
+            fclose(f);
+        } else {
+            fprintf(stderr, "Error: Cannot write folded stacks %s\n", folded_file);
+            ok = 0;
+        }
+    }
+    return ok;
+}
+
+// --checkpoint-at: an instruction count, or a function of the .asm listing
+static int resolve_checkpoint_point(const char *spec, const SimProgram *prog, const char *program_file,
+                                    const char *asm_file, SimCheckpointPoint *at) {
+    char *end;
+    unsigned long long count = strtoull(spec, &end, 0);
+    if (*spec != '\0' && *end == '\0') {
+        at->icount = count;
+        at->pc = UINT32_MAX;
+        return 0;
+    }
+
+    char *listing = asm_file ? NULL : companion_file(program_file, ".asm");
+    if (!asm_file && !listing) {
+        fprintf(stderr, "Error: --checkpoint-at %s needs the .asm listing (--asm)\n", spec);
+        return -1;
+    }
+    SimProfile functions;
+    int failed = sim_profile_init(&functions, prog, asm_file ? asm_file : listing) != 0;
+    free(listing);
+    if (failed) return -1;
+    at->icount = UINT64_MAX;
+    at->pc = UINT32_MAX;
+    for (int f = 0; f < functions.function_count; f++) {
+        if (strcmp(functions.functions[f].name, spec) == 0) at->pc = functions.functions[f].entry;
+    }
+    sim_profile_free(&functions);
+    if (at->pc == UINT32_MAX) {
+        fprintf(stderr, "Error: no function %s in the listing\n", spec);
+        return -1;
+    }
+    return 0;
+}
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Runs each input file in its own lane; outputs are printed per file
+static int run_lockstep(const SimProgram *prog, const char **inputs, int input_files,
+                        uint32_t mem_words, uint64_t max_steps, int verify, int stats, int quiet) {
+    SimBatch batch;
+    int32_t *values[SIM_BATCH_LANES] = { NULL };
+    int failures = 0;
+    uint64_t instructions = 0, steps = 0, split_steps = 0;
+    double seconds = 0;
+
+    for (int first = 0; first < input_files; first += SIM_BATCH_LANES) {
+        int lanes = input_files - first < SIM_BATCH_LANES ? input_files - first : SIM_BATCH_LANES;
+        if (sim_batch_init(&batch, (uint32_t)lanes, mem_words) != 0) return 1;
+        sim_batch_load_data(&batch, prog);
+        batch.max_steps = max_steps;
+
+        int loaded = 1;
+        for (int l = 0; l < lanes; l++) {
+            if (sim_read_input_file(inputs[first + l], &values[l], &batch.input_count[l]) != 0) {
+                loaded = 0;
+                break;
+            }
+            batch.input[l] = values[l];
+        }
+
+        if (loaded) {
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            sim_batch_run(&batch, prog);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            seconds += elapsed_seconds(&start, &end);
+            steps += batch.steps;
+            split_steps += batch.split_steps;
+
+            for (int l = 0; l < lanes; l++) {
+                instructions += batch.icount[l];
+                if (!quiet) {
+                    printf("== %s\n", inputs[first + l]);
+                    for (uint32_t i = 0; i < batch.output_count[l]; i++) printf("%d\n", batch.output[l][i]);
+                }
+                if (batch.status[l] != SIM_HALTED) {
+                    fprintf(stderr, "%s: Simulation stopped: %s at pc %u\n",
+                            inputs[first + l], sim_status_name(batch.status[l]), batch.pc[l]);
+                    failures++;
+                }
+                if (verify && batch.status[l] != SIM_STEP_LIMIT) {
+                    SimMachine lane, check;
+                    if (sim_machine_init(&lane, mem_words) == 0 && sim_machine_init(&check, mem_words) == 0) {
+                        sim_batch_extract(&batch, (uint32_t)l, &lane);
+                        sim_machine_load_data(&check, prog);
+                        check.input = values[l];
+                        check.input_count = batch.input_count[l];
+                        check.max_steps = max_steps;
+                        sim_run_reference(&check, prog);
+                        if (check.status == SIM_STEP_LIMIT) {
+                            fprintf(stderr, "%s: Verify: skipped, step limit reached\n", inputs[first + l]);
+                        } else if (!compare_machines(&lane, &check)) {
+                            fprintf(stderr, "%s: Verify: MISMATCH\n", inputs[first + l]);
+                            failures++;
+                        }
+                        sim_machine_free(&check);
+                    }
+                    sim_machine_free(&lane);
+                }
+            }
+        } else {
+            failures++;
+        }
+
+        for (int l = 0; l < lanes; l++) {
+            free(values[l]);
+            values[l] = NULL;
+        }
+        sim_batch_free(&batch);
+        if (!loaded) break;
+    }
+
+    if (verify && failures == 0) {
+        fprintf(stderr, "Verify: %d lanes identical to the reference interpreter\n", input_files);
+    }
+    if (stats) {
+        fprintf(stderr, "Lanes: %d\n", input_files);
+        fprintf(stderr, "Instructions: %llu (all lanes)\n", (unsigned long long)instructions);
+        fprintf(stderr, "Lockstep steps: %llu (%llu while diverged)\n",
+                (unsigned long long)steps, (unsigned long long)split_steps);
+        fprintf(stderr, "Time: %.6f s\n", seconds);
+        if (seconds > 0) fprintf(stderr, "Speed: %.2f MIPS\n", (double)instructions / seconds / 1e6);
+    }
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *program_file = NULL;
+    const char *input_file = NULL;
+    uint32_t mem_words = SIM_DEFAULT_MEM_WORDS;
+    uint64_t max_steps = 0;
+    int fuse = 1;
+    int reference = 0;
+    int jit_mode = 0;
+    int verify = 0;
+    int lockstep = 0;
+    const char *manifest = NULL;
+    SimCorpusOptions corpus = { 0, SIM_CORPUS_TAP, 0, 0, 1, NULL };
+    const char *profile_file = NULL;
+    const char *folded_file = NULL;
+    const char *asm_file = NULL;
+    const char *lines_file = NULL;
+    const char *trace_file = NULL;
+    const char *cache_spec = NULL;
+    const char *cache_report = NULL;
+    const char *pipeline_spec = NULL;
+    const char *pipeline_report = NULL;
+    const char *checkpoint_file = NULL;
+    const char *checkpoint_at = NULL;
+    const char *restore_file = NULL;
+    int stats = 0;
+    int quiet = 0;
+    const char **lockstep_inputs = malloc(argc * sizeof(char *));
+    int lockstep_count = 0;
+
+    if (!lockstep_inputs) return 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            input_file = argv[++i];
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_words = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc) {
+            max_steps = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--no-fuse") == 0) {
+            fuse = 0;
+        } else if (strcmp(argv[i], "--reference") == 0) {
+            reference = 1;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            jit_mode = 1;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = 1;
+        } else if (strcmp(argv[i], "--lockstep") == 0) {
+            lockstep = 1;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            manifest = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            corpus.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "json") == 0) {
+                corpus.format = SIM_CORPUS_JSON;
+            } else if (strcmp(argv[i], "tap") != 0) {
+                usage(argv[0]);
+                free(lockstep_inputs);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_file = argv[++i];
+        } else if (strcmp(argv[i], "--folded") == 0 && i + 1 < argc) {
+            folded_file = argv[++i];
+        } else if (strcmp(argv[i], "--asm") == 0 && i + 1 < argc) {
+            asm_file = argv[++i];
+        } else if (strcmp(argv[i], "--lines") == 0 && i + 1 < argc) {
+            lines_file = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_spec = argv[++i];
+        } else if (strcmp(argv[i], "--cache-report") == 0 && i + 1 < argc) {
+            cache_report = argv[++i];
+        } else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+            pipeline_spec = argv[++i];
+        } else if (strcmp(argv[i], "--pipeline-report") == 0 && i + 1 < argc) {
+            pipeline_report = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_file = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-at") == 0 && i + 1 < argc) {
+            checkpoint_at = argv[++i];
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restore_file = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = 1;
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quiet = 1;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(argv[0]);
+            free(lockstep_inputs);
+            return 1;
+        } else if (!program_file) {
+            program_file = argv[i];
+        } else {
+            lockstep_inputs[lockstep_count++] = argv[i];
+        }
+    }
+    if (trace_file && (manifest || lockstep || profile_file || folded_file)) {
+        fprintf(stderr, "Error: --trace runs a single program without --profile/--folded\n");
+        free(lockstep_inputs);
+        return 1;
+    }
+    int caching = cache_spec || cache_report;
+    int timing = pipeline_spec || pipeline_report;
+    SimCacheConfig cache_config;
+    SimPipelineConfig pipeline_config;
+    if ((caching || timing) && (manifest || lockstep || trace_file || profile_file || folded_file)) {
+        fprintf(stderr, "Error: --cache and --pipeline run a single program without --trace/--profile/--folded\n");
+        free(lockstep_inputs);
+        return 1;
+    }
+    if ((caching && sim_cache_parse(&cache_config, cache_spec) != 0) ||
+        (timing && sim_pipeline_parse(&pipeline_config, pipeline_spec) != 0)) {
+        free(lockstep_inputs);
+        return 1;
+    }
+    if (!checkpoint_file != !checkpoint_at ||
+        (checkpoint_file && (manifest || lockstep || trace_file || profile_file || folded_file ||
+                             caching || timing))) {
+        fprintf(stderr, "Error: --checkpoint needs --checkpoint-at and a plain single run\n");
+        free(lockstep_inputs);
+        return 1;
+    }
+    if (restore_file && lockstep) {
+        fprintf(stderr, "Error: --restore does not work with --lockstep\n");
+        free(lockstep_inputs);
+        return 1;
+    }
+    SimCheckpoint restored;
+    if (manifest) {
+        free(lockstep_inputs);
+        if (program_file || input_file) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (restore_file && sim_checkpoint_open(&restored, restore_file) != 0) return 1;
+        corpus.mem_words = mem_words;
+        corpus.max_steps = max_steps;
+        corpus.fuse = fuse;
+        corpus.checkpoint = restore_file ? &restored : NULL;
+        int failed = sim_corpus_run(manifest, &corpus, stdout) != 0;
+        if (restore_file) sim_checkpoint_close(&restored);
+        return failed ? 1 : 0;
+    }
+    if (input_file) lockstep_inputs[lockstep_count++] = input_file;
+    if (!program_file || (!lockstep && lockstep_count > 1) || (lockstep && lockstep_count == 0)) {
+        usage(argv[0]);
+        free(lockstep_inputs);
+        return 1;
+    }
+    if (!lockstep && lockstep_count == 1) input_file = lockstep_inputs[0];
+
+    SimProgram prog;
+    if (sim_load_program(&prog, program_file) != 0) {
+        free(lockstep_inputs);
+        return 1;
+    }
+
+    // The lanes share one image and a checkpoint does not hold the code
+    if (prog.writes_code && (lockstep || checkpoint_at || restore_file)) {
+        fprintf(stderr, "Error: %s writes its own code (SWI); --lockstep and checkpoints are not supported\n",
+                program_file);
+        free(lockstep_inputs);
+        sim_free_program(&prog);
+        return 1;
+    }
+
+    if (lockstep) {
+        int result = run_lockstep(&prog, lockstep_inputs, lockstep_count, mem_words, max_steps, verify, stats, quiet);
+        free(lockstep_inputs);
+        sim_free_program(&prog);
+        return result;
+    }
+    free(lockstep_inputs);
+
+    SimCheckpointPoint checkpoint_point;
+    if (checkpoint_at && resolve_checkpoint_point(checkpoint_at, &prog, program_file, asm_file, &checkpoint_point) != 0) {
+        sim_free_program(&prog);
+        return 1;
+    }
+
+    // The profiler counts every step of the reference interpreter. The
+    // cache and pipeline reports only borrow its function map.
+    int profiling = profile_file || folded_file;
+    int mapping = profiling || cache_report || pipeline_report;
+    SimProfile profile;
+    SimLines lines;
+    int have_lines = 0;
+    if (mapping) {
+        char *listing = asm_file ? NULL : companion_file(program_file, ".asm");
+        int failed = sim_profile_init(&profile, &prog, asm_file ? asm_file : listing) != 0;
+        free(listing);
+        if (failed) {
+            sim_free_program(&prog);
+            return 1;
+        }
+        char *table = lines_file ? NULL : companion_file(program_file, ".lines");
+        if (lines_file || table) have_lines = sim_lines_load(&lines, lines_file ? lines_file : table) == 0;
+        free(table);
+        reference = 1;
+        jit_mode = 0;
+    }
+    // So do the tracer and the timing models, to see the address of every LW/SW
+    if (trace_file || caching || timing) {
+        reference = 1;
+        jit_mode = 0;
+    }
+
+    if (!reference) {
+        sim_predecode(&prog, fuse);
+        if (!prog.code) {
+            fprintf(stderr, "Error: Cannot allocate predecoded program\n");
+            sim_free_program(&prog);
+            return 1;
+        }
+    }
+
+    SimJit *jit = NULL;
+    if (jit_mode && !reference) {
+        jit = sim_jit_create(&prog);
+        if (!jit) fprintf(stderr, "Warning: JIT not available on this host, using the interpreter\n");
+    }
+
+    int32_t *input = NULL;
+    uint32_t input_count = 0;
+    if (input_file && sim_read_input_file(input_file, &input, &input_count) != 0) {
+        if (mapping) sim_profile_free(&profile);
+        if (have_lines) sim_lines_free(&lines);
+        sim_jit_destroy(jit);
+        sim_free_program(&prog);
+        return 1;
+    }
+
+    // The reference check of --verify starts from the image as loaded
+    SimProgram pristine = { 0 };
+    if (verify && prog.writes_code && sim_copy_program(&pristine, &prog) != 0) {
+        fprintf(stderr, "Error: Cannot copy program\n");
+        if (mapping) sim_profile_free(&profile);
+        if (have_lines) sim_lines_free(&lines);
+        sim_jit_destroy(jit);
+        free(input);
+        sim_free_program(&prog);
+        return 1;
+    }
+
+    SimMachine machine;
+    int machine_failed;
+    if (restore_file) {
+        // The checkpoint stays open: the restored input stream lives in it
+        machine_failed = sim_checkpoint_open(&restored, restore_file) != 0;
+        if (!machine_failed && !sim_checkpoint_matches(&restored, &prog)) {
+            fprintf(stderr, "Error: checkpoint %s was taken from another program\n", restore_file);
+            machine_failed = 1;
+        }
+        if (!machine_failed && sim_checkpoint_restore(&restored, &machine) != 0) machine_failed = 1;
+        if (machine_failed && restored.fd >= 0) sim_checkpoint_close(&restored);
+    } else {
+        machine_failed = sim_machine_init(&machine, mem_words) != 0;
+        if (!machine_failed) sim_machine_load_data(&machine, &prog);
+    }
+    if (machine_failed) {
+        if (mapping) sim_profile_free(&profile);
+        if (have_lines) sim_lines_free(&lines);
+        sim_jit_destroy(jit);
+        free(input);
+        sim_free_program(&pristine);
+        sim_free_program(&prog);
+        return 1;
+    }
+    // An input file replaces a restored stream; the cursor stays
+    if (!restore_file || input_file) {
+        machine.input = input;
+        machine.input_count = input_count;
+    }
+    uint64_t first_instruction = machine.icount;
+    machine.max_steps = max_steps ? first_instruction + max_steps : 0;
+
+    SimTraceWriter *trace = NULL;
+    if (trace_file && !(trace = sim_trace_create(trace_file))) {
+        sim_machine_free(&machine);
+        if (restore_file) sim_checkpoint_close(&restored);
+        free(input);
+        sim_free_program(&pristine);
+        sim_free_program(&prog);
+        return 1;
+    }
+
+    SimCache cache;
+    SimPipeline pipeline;
+    int timing_failed = caching && sim_cache_init(&cache, &cache_config, &prog, machine.mem_words) != 0;
+    if (!timing_failed && timing && sim_pipeline_init(&pipeline, &pipeline_config, &prog) != 0) {
+        if (caching) sim_cache_free(&cache);
+        timing_failed = 1;
+    }
+    if (timing_failed) {
+        fprintf(stderr, "Error: Cannot allocate the timing model\n");
+        if (mapping) sim_profile_free(&profile);
+        if (have_lines) sim_lines_free(&lines);
+        sim_machine_free(&machine);
+        if (restore_file) sim_checkpoint_close(&restored);
+        free(input);
+        sim_free_program(&pristine);
+        sim_free_program(&prog);
+        return 1;
+    }
+
+    // The setup phase runs once, exactly, on the reference interpreter
+    int checkpoint_failed = 0;
+    if (checkpoint_file) {
+        if (sim_checkpoint_run_to(&machine, &prog, &checkpoint_point) != SIM_RUNNING) {
+            fprintf(stderr, "Error: program stopped before reaching the checkpoint\n");
+            checkpoint_failed = 1;
+        } else {
+            checkpoint_failed = sim_checkpoint_save(checkpoint_file, &machine, &prog) != 0;
+            if (!checkpoint_failed && stats) {
+                fprintf(stderr, "Checkpoint: %s at instruction %llu, pc %u\n", checkpoint_file,
+                        (unsigned long long)machine.icount, machine.pc);
+            }
+        }
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    SimStatus status;
+    if (profiling) {
+        status = sim_profile_run(&profile, &machine, &prog);
+    } else if (timing) {
+        status = sim_pipeline_run(&pipeline, caching ? &cache : NULL, &machine, &prog);
+    } else if (caching) {
+        status = sim_cache_run(&cache, &machine, &prog);
+    } else if (trace) {
+        status = sim_trace_run(trace, &machine, &prog);
+    } else if (reference) {
+        status = sim_run_reference(&machine, &prog);
+    } else if (jit) {
+        status = sim_jit_run(jit, &machine);
+    } else {
+        status = sim_run(&machine, &prog);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    uint64_t trace_records = 0, trace_raw = 0, trace_bytes = 0;
+    int trace_failed = trace && sim_trace_finish(trace, &trace_records, &trace_raw, &trace_bytes) != 0;
+    if (trace_failed) fprintf(stderr, "Error: Cannot write trace %s\n", trace_file);
+
+    int verified = 1;
+    if (verify) {
+        SimMachine check;
+        if (restore_file ? sim_checkpoint_restore(&restored, &check) != 0 : sim_machine_init(&check, mem_words) != 0) {
+            verified = 0;
+        } else {
+            if (!restore_file) sim_machine_load_data(&check, &prog);
+            if (!restore_file || input_file) {
+                check.input = input;
+                check.input_count = input_count;
+            }
+            check.max_steps = machine.max_steps;
+            sim_run_reference(&check, prog.writes_code ? &pristine : &prog);
+            if (status == SIM_STEP_LIMIT || check.status == SIM_STEP_LIMIT) {
+                // The engines check the limit at different points
+                fprintf(stderr, "Verify: skipped, step limit reached\n");
+            } else {
+                verified = compare_machines(&machine, &check);
+                fprintf(stderr, "Verify: %s\n", verified ? "identical to the reference interpreter" : "MISMATCH");
+            }
+            sim_machine_free(&check);
+        }
+    }
+
+    if (!quiet) {
+        for (uint32_t i = 0; i < machine.output_count; i++) {
+            printf("%d\n", machine.output[i]);
+        }
+    }
+
+    if (status != SIM_HALTED) {
+        fprintf(stderr, "Simulation stopped: %s at pc %u\n", sim_status_name(status), machine.pc);
+    }
+
+    if (stats) {
+        double seconds = elapsed_seconds(&start, &end);
+        fprintf(stderr, "Instructions: %llu\n", (unsigned long long)machine.icount);
+        if (restore_file) {
+            fprintf(stderr, "Restored at instruction %llu (%llu run)\n", (unsigned long long)first_instruction,
+                    (unsigned long long)(machine.icount - first_instruction));
+        }
+        fprintf(stderr, "Program words: %u\n", prog.length);
+        if (jit) {
+            fprintf(stderr, "Blocks translated: %u (%u instructions, %u chained exits, %u flushes)\n",
+                    jit->translated_blocks, jit->translated_insns, jit->chained, jit->flushes);
+            fprintf(stderr, "Interpreted by fallback: %llu\n", (unsigned long long)jit->fallbacks);
+        } else if (!reference) {
+            fprintf(stderr, "Superinstructions: %d\n", prog.fused);
+        }
+        if (trace) {
+            fprintf(stderr, "Trace: %llu accesses, %llu bytes (%llu before compression, %.2f bytes/access)\n",
+                    (unsigned long long)trace_records, (unsigned long long)trace_bytes,
+                    (unsigned long long)trace_raw, trace_records ? (double)trace_bytes / trace_records : 0.0);
+        }
+        fprintf(stderr, "Time: %.6f s\n", seconds);
+        if (seconds > 0) {
+            fprintf(stderr, "Speed: %.2f MIPS\n", (double)(machine.icount - first_instruction) / seconds / 1e6);
+        }
+    }
+
+    if (caching) {
+        if (stats || !cache_report) sim_cache_write_summary(&cache, machine.icount, stderr);
+        if (cache_report) {
+            FILE *f = fopen(cache_report, "w");
+            if (f) {
+                sim_cache_write_report(&cache, machine.icount, &profile, have_lines ? &lines : NULL, f);
+                fclose(f);
+            } else {
+                fprintf(stderr, "Error: Cannot write cache report %s\n", cache_report);
+                verified = 0;
+            }
+        }
+        sim_cache_free(&cache);
+    }
+    if (timing) {
+        if (stats || !pipeline_report) sim_pipeline_write_summary(&pipeline, stderr);
+        if (pipeline_report) {
+            FILE *f = fopen(pipeline_report, "w");
+            if (f) {
+                sim_pipeline_write_report(&pipeline, &prog, &profile, have_lines ? &lines : NULL, f);
+                fclose(f);
+            } else {
+                fprintf(stderr, "Error: Cannot write pipeline report %s\n", pipeline_report);
+                verified = 0;
+            }
+        }
+        sim_pipeline_free(&pipeline);
+    }
+    if (mapping && !profiling) {
+        sim_profile_free(&profile);
+        if (have_lines) sim_lines_free(&lines);
+    }
+
+    if (profiling) {
+        if (!write_profile(&profile, &prog, have_lines ? &lines : NULL, profile_file, folded_file)) verified = 0;
+        sim_profile_free(&profile);
+        if (have_lines) sim_lines_free(&lines);
+    }
+
+    sim_machine_free(&machine);
+    if (restore_file) sim_checkpoint_close(&restored);
+    sim_jit_destroy(jit);
+    free(input);
+    sim_free_program(&pristine);
+    sim_free_program(&prog);
+    return status == SIM_HALTED && verified && !trace_failed && !checkpoint_failed ? 0 : 1;
+}
@@ -0,0 +1,383 @@
+/*
+ * sim_pipeline.c - 5-stage pipeline timing model for acmc-sim --pipeline
+ *
+ * A scoreboard over the retired instruction stream: every register keeps
+ * the first cycle its value can be forwarded and the cycle it is written
+ * back, and each instruction enters EX at the latest of "one cycle after
+ * the previous one" and the cycles its operands, the MULT/DIV unit and the
+ * control flow allow. Cycle numbers follow the textbook diagram: the first
+ * instruction is fetched in cycle 0, decoded in 1 and executed in 2.
+ */
+
+#include "sim_pipeline.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TOP_INSTRUCTIONS 10
+
+static const char *const stall_names[SIM_STALL_KINDS] = {
+    "load-use", "data", "mult/div", "control", "memory"
+};
+
+int sim_pipeline_parse(SimPipelineConfig *config, const char *spec) {
+    char buffer[256];
+    int penalty_set = 0;
+    *config = (SimPipelineConfig){ 1, 1, 0, 4, 16 };
+    if (spec) {
+        if (strlen(spec) >= sizeof(buffer)) {
+            fprintf(stderr, "Error: pipeline specification too long\n");
+            return -1;
+        }
+        strcpy(buffer, spec);
+    } else {
+        buffer[0] = '\0';
+    }
+
+    for (char *item = strtok(buffer, ","); item; item = strtok(NULL, ",")) {
+        char *value = strchr(item, '=');
+        if (!value) {
+            fprintf(stderr, "Error: expected key=value in pipeline specification, got '%s'\n", item);
+            return -1;
+        }
+        *value++ = '\0';
+        char *end;
+        unsigned long number = strtoul(value, &end, 0);
+        int numeric = *value != '\0' && *end == '\0';
+        if (strcmp(item, "forwarding") == 0) {
+            if (strcmp(value, "on") != 0 && strcmp(value, "off") != 0) {
+                fprintf(stderr, "Error: pipeline forwarding must be on or off\n");
+                return -1;
+            }
+            config->forwarding = strcmp(value, "on") == 0;
+        } else if (strcmp(item, "branch") == 0) {
+            if (strcmp(value, "id") != 0 && strcmp(value, "ex") != 0) {
+                fprintf(stderr, "Error: pipeline branch must be id or ex\n");
+                return -1;
+            }
+            config->branch_in_ex = strcmp(value, "ex") == 0;
+        } else if (!numeric) {
+            fprintf(stderr, "Error: pipeline %s must be a number\n", item);
+            return -1;
+        } else if (strcmp(item, "penalty") == 0) {
+            config->penalty = (uint32_t)number;
+            penalty_set = 1;
+        } else if (strcmp(item, "mult") == 0 || strcmp(item, "div") == 0) {
+            if (number == 0) {
+                fprintf(stderr, "Error: pipeline %s latency must be at least 1\n", item);
+                return -1;
+            }
+            if (item[0] == 'm') config->mult_latency = (uint32_t)number; else config->div_latency = (uint32_t)number;
+        } else {
+            fprintf(stderr, "Error: unknown pipeline parameter '%s'\n", item);
+            return -1;
+        }
+    }
+    if (!penalty_set) config->penalty = config->branch_in_ex ? 2 : 1;
+    return 0;
+}
+
+int sim_pipeline_init(SimPipeline *p, const SimPipelineConfig *config, const SimProgram *prog) {
+    memset(p, 0, sizeof(*p));
+    p->config = *config;
+    p->length = prog->length;
+    p->executed = calloc(prog->length ? prog->length : 1, sizeof(uint64_t));
+    p->stalls = calloc(prog->length ? prog->length : 1, sizeof(*p->stalls));
+    if (!p->executed || !p->stalls) {
+        sim_pipeline_free(p);
+        return -1;
+    }
+    p->last_ex = 1;   // So that the first instruction executes in cycle 2
+    return 0;
+}
+
+void sim_pipeline_free(SimPipeline *p) {
+    free(p->executed);
+    free(p->stalls);
+    memset(p, 0, sizeof(*p));
+}
+
+// Stage an operand is needed in, relative to EX
+typedef enum { STAGE_ID = -1, STAGE_EX = 0, STAGE_MEM = 1 } Stage;
+
+typedef struct {
+    int reg;
+    Stage stage;
+} Operand;
+
+// Source operands of one instruction; returns how many
+static int operands(const SimPipelineConfig *k, const SimInsn *in, Operand *out) {
+    Stage branch = k->branch_in_ex ? STAGE_EX : STAGE_ID;
+    switch (in->op) {
+        case SIM_OP_ADD: case SIM_OP_SUB: case SIM_OP_AND: case SIM_OP_OR:
+        case SIM_OP_SLT: case SIM_OP_SET: case SIM_OP_MULT: case SIM_OP_DIV:
+            out[0] = (Operand){ in->rs, STAGE_EX };
+            out[1] = (Operand){ in->rt, STAGE_EX };
+            return 2;
+        case SIM_OP_SLL: case SIM_OP_SRL: case SIM_OP_MOVE: case SIM_OP_ADDI:
+        case SIM_OP_SUBI: case SIM_OP_ANDI: case SIM_OP_ORI: case SIM_OP_LW:
+        case SIM_OP_OUTPUTMEM: case SIM_OP_OUTPUTREG:
+            out[0] = (Operand){ in->rs, STAGE_EX };
+            return 1;
+        case SIM_OP_SW: case SIM_OP_SWI:
+            out[0] = (Operand){ in->rs, STAGE_EX };
+            out[1] = (Operand){ in->rt, STAGE_MEM };   // Store data
+            return 2;
+        case SIM_OP_MFHI:
+            out[0] = (Operand){ SIM_REG_HI, STAGE_EX };
+            return 1;
+        case SIM_OP_MFLO:
+            out[0] = (Operand){ SIM_REG_LO, STAGE_EX };
+            return 1;
+        case SIM_OP_JR: case SIM_OP_JALR:
+            out[0] = (Operand){ in->rs, branch };
+            return 1;
+        case SIM_OP_BEQ: case SIM_OP_BNE: case SIM_OP_BGT:
+        case SIM_OP_BGTE: case SIM_OP_BLT: case SIM_OP_BLTE:
+            out[0] = (Operand){ in->rs, branch };
+            out[1] = (Operand){ in->rt, branch };
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// Destination register, or -1; R0 is already redirected to the sink
+static int destination(const SimInsn *in) {
+    switch (in->op) {
+        case SIM_OP_ADD: case SIM_OP_SUB: case SIM_OP_AND: case SIM_OP_OR:
+        case SIM_OP_SLL: case SIM_OP_SRL: case SIM_OP_SLT: case SIM_OP_MFHI:
+        case SIM_OP_MFLO: case SIM_OP_MOVE: case SIM_OP_INPUT: case SIM_OP_SET:
+            return in->rd;
+        case SIM_OP_LA: case SIM_OP_ADDI: case SIM_OP_SUBI: case SIM_OP_ANDI:
+        case SIM_OP_ORI: case SIM_OP_LW: case SIM_OP_LI:
+            return in->rt;
+        case SIM_OP_JAL: case SIM_OP_JALR:
+            return SIM_REG_RA;
+        default:
+            return -1;
+    }
+}
+
+static void charge(SimPipeline *p, uint32_t pc, SimStallKind kind, uint64_t cycles) {
+    p->stalls[pc][kind] += cycles;
+    p->total[kind] += cycles;
+}
+
+// Times one retired instruction; next_pc tells whether it branched
+static void retire(SimPipeline *p, uint32_t pc, const SimInsn *in, uint32_t next_pc, uint32_t memory_stalls) {
+    const SimPipelineConfig *k = &p->config;
+    uint64_t earliest = p->last_ex + 1 + p->next_delay;
+    uint64_t ex = earliest;
+    SimStallKind cause = SIM_STALL_DATA;
+
+    Operand ops[2];
+    int count = operands(k, in, ops);
+    for (int i = 0; i < count; i++) {
+        int r = ops[i].reg;
+        if (r == 0) continue;
+        // Without forwarding every operand is read in ID, after the WB
+        uint64_t ready = p->written_back[r] + 1;
+        if (k->forwarding) {
+            ready = p->forward_ready[r];
+            if (ops[i].stage == STAGE_ID) ready++;
+            if (ops[i].stage == STAGE_MEM && ready) ready--;
+        }
+        if (ready > ex) {
+            ex = ready;
+            cause = (SimStallKind)p->producer[r];
+        }
+    }
+    int muldiv = in->op == SIM_OP_MULT || in->op == SIM_OP_DIV;
+    if (muldiv && p->unit_free > ex) {
+        ex = p->unit_free;
+        cause = SIM_STALL_MULDIV;
+    }
+    if (ex > earliest) charge(p, pc, cause, ex - earliest);
+
+    // Results
+    uint64_t mem_end = ex + 1 + memory_stalls;
+    if (muldiv) {
+        uint32_t latency = in->op == SIM_OP_MULT ? k->mult_latency : k->div_latency;
+        p->unit_free = ex + latency;
+        for (int r = SIM_REG_LO; r <= SIM_REG_HI; r++) {
+            p->forward_ready[r] = ex + latency;
+            p->written_back[r] = ex + latency;
+            p->producer[r] = SIM_STALL_MULDIV;
+        }
+    }
+    int rd = destination(in);
+    if (rd > 0) {
+        p->forward_ready[rd] = in->op == SIM_OP_LW ? mem_end + 1 : ex + 1;
+        p->written_back[rd] = mem_end + 1;
+        p->producer[rd] = in->op == SIM_OP_LW ? SIM_STALL_LOAD_USE : SIM_STALL_DATA;
+    }
+
+    // What this instruction holds back: the MEM stall freezes the stages
+    // behind it, a taken branch flushes the ones fetched after it
+    p->next_delay = memory_stalls;
+    if (memory_stalls) charge(p, pc, SIM_STALL_MEMORY, memory_stalls);
+    uint32_t flush = 0;
+    if (in->op == SIM_OP_J || in->op == SIM_OP_JAL) {
+        flush = 1;
+    } else if (next_pc != pc + 1 && in->op != SIM_OP_HALT) {
+        flush = k->penalty;   // Taken branch, JR, JALR
+    }
+    if (flush) {
+        p->next_delay += flush;
+        charge(p, pc, SIM_STALL_CONTROL, flush);
+    }
+
+    p->last_ex = ex;
+    p->cycles = mem_end + 2;   // WB, counting cycle 0
+    p->instructions++;
+    p->executed[pc]++;
+}
+
+SimStatus sim_pipeline_run(SimPipeline *p, SimCache *cache, SimMachine *m, const SimProgram *prog) {
+    while (m->status == SIM_RUNNING) {
+        uint32_t pc = m->pc;
+        uint64_t before = m->icount;
+        SimInsn in = { 0 };
+        uint32_t address = 0;
+        if (pc < prog->length) {
+            sim_decode(prog->words[pc], &in);
+            if (in.op == SIM_OP_LW || in.op == SIM_OP_SW) {
+                address = (uint32_t)m->regs[in.rs] + (uint32_t)in.imm;   // Before LW overwrites rs
+            }
+        }
+        sim_step(m, prog);
+        if (m->icount == before) break;
+
+        uint32_t memory_stalls = 0;
+        if (cache && (in.op == SIM_OP_LW || in.op == SIM_OP_SW)) {
+            memory_stalls = sim_cache_access(cache, pc, address, in.op == SIM_OP_SW);
+        }
+        retire(p, pc, &in, m->pc, memory_stalls);
+    }
+    return m->status;
+}
+
+// ---------------------------------------------------------------------------
+// Reports
+// ---------------------------------------------------------------------------
+
+static uint64_t stall_sum(const uint64_t *stalls) {
+    uint64_t sum = 0;
+    for (int k = 0; k < SIM_STALL_KINDS; k++) sum += stalls[k];
+    return sum;
+}
+
+static double ratio(uint64_t part, uint64_t total) {
+    return total ? (double)part / (double)total : 0.0;
+}
+
+void sim_pipeline_write_summary(const SimPipeline *p, FILE *out) {
+    const SimPipelineConfig *k = &p->config;
+    uint64_t stalls = stall_sum(p->total);
+    fprintf(out, "Pipeline: 5 stages, forwarding %s, branches in %s (penalty %u), mult %u, div %u cycles\n",
+            k->forwarding ? "on" : "off", k->branch_in_ex ? "EX" : "ID", k->penalty,
+            k->mult_latency, k->div_latency);
+    fprintf(out, "Cycles: %llu (%llu instructions, %llu stall cycles, CPI %.3f)\n",
+            (unsigned long long)p->cycles, (unsigned long long)p->instructions,
+            (unsigned long long)stalls, ratio(p->cycles, p->instructions));
+    fprintf(out, "Stalls:");
+    for (int s = 0; s < SIM_STALL_KINDS; s++) {
+        fprintf(out, "%s %s %llu", s ? "," : "", stall_names[s], (unsigned long long)p->total[s]);
+    }
+    fprintf(out, "\n");
+}
+
+typedef struct {
+    uint32_t key;              // Function index or address
+    uint64_t executed;
+    uint64_t stalls[SIM_STALL_KINDS];
+} ReportRow;
+
+static int compare_rows(const void *a, const void *b) {
+    const ReportRow *ra = a, *rb = b;
+    uint64_t sa = stall_sum(ra->stalls), sb = stall_sum(rb->stalls);
+    if (sa != sb) return sa < sb ? 1 : -1;
+    return ra->key < rb->key ? -1 : ra->key > rb->key;
+}
+
+static void write_row_counts(const ReportRow *row, FILE *out) {
+    uint64_t stalls = stall_sum(row->stalls);
+    fprintf(out, "%11llu %11llu %6.3f", (unsigned long long)row->executed,
+            (unsigned long long)(row->executed + stalls), ratio(row->executed + stalls, row->executed));
+    for (int s = 0; s < SIM_STALL_KINDS; s++) fprintf(out, " %9llu", (unsigned long long)row->stalls[s]);
+}
+
+static void write_header(const char *last, FILE *out) {
+    fprintf(out, "      insns      cycles    CPI");
+    for (int s = 0; s < SIM_STALL_KINDS; s++) fprintf(out, " %9s", stall_names[s]);
+    fprintf(out, "  %s\n", last);
+}
+
+static void write_functions(const SimPipeline *p, const SimProfile *functions, FILE *out) {
+    ReportRow *rows = calloc(functions->function_count ? functions->function_count : 1, sizeof(ReportRow));
+    if (!rows) return;
+    for (int f = 0; f < functions->function_count; f++) rows[f].key = (uint32_t)f;
+    for (uint32_t pc = 0; pc < p->length && pc < functions->length; pc++) {
+        ReportRow *row = &rows[functions->function_of[pc]];
+        row->executed += p->executed[pc];
+        for (int s = 0; s < SIM_STALL_KINDS; s++) row->stalls[s] += p->stalls[pc][s];
+    }
+    qsort(rows, functions->function_count, sizeof(ReportRow), compare_rows);
+
+    fprintf(out, "Cycles by function (pipeline fill not included):\n\n");
+    write_header("function", out);
+    for (int i = 0; i < functions->function_count; i++) {
+        if (rows[i].executed == 0) continue;
+        write_row_counts(&rows[i], out);
+        fprintf(out, "  %s\n", functions->functions[rows[i].key].name);
+    }
+    free(rows);
+}
+
+// Listing text of an address, or the opcode name without a listing
+static void write_instruction(const SimProfile *functions, uint32_t pc, const char *fallback, FILE *out) {
+    for (int i = 0; i < functions->listing_lines; i++) {
+        if (functions->listing_address[i] == pc) {
+            fprintf(out, "%s", functions->listing[i]);
+            return;
+        }
+    }
+    fprintf(out, "%u-%s", pc, fallback);
+}
+
+static void write_instructions(const SimPipeline *p, const SimProfile *functions, const SimLines *lines,
+                               const SimProgram *prog, FILE *out) {
+    ReportRow *rows = calloc(p->length ? p->length : 1, sizeof(ReportRow));
+    if (!rows) return;
+    for (uint32_t pc = 0; pc < p->length; pc++) {
+        rows[pc].key = pc;
+        rows[pc].executed = p->executed[pc];
+        memcpy(rows[pc].stalls, p->stalls[pc], sizeof(rows[pc].stalls));
+    }
+    qsort(rows, p->length, sizeof(ReportRow), compare_rows);
+
+    fprintf(out, "Most stalled instructions:\n\n");
+    write_header("line      function        instruction", out);
+    for (uint32_t i = 0; i < p->length && i < TOP_INSTRUCTIONS; i++) {
+        uint32_t pc = rows[i].key;
+        if (stall_sum(rows[i].stalls) == 0) break;
+        write_row_counts(&rows[i], out);
+        uint32_t line = lines && pc < lines->length ? lines->source_line[pc] : 0;
+        if (line) fprintf(out, "  %-8u", line); else fprintf(out, "  %-8s", "-");
+        fprintf(out, "  %-14s  ", pc < functions->length ? functions->functions[functions->function_of[pc]].name : "?");
+        SimInsn in;
+        sim_decode(prog->words[pc], &in);
+        write_instruction(functions, pc, sim_opcode_name(in.op), out);
+        fprintf(out, "\n");
+    }
+    free(rows);
+}
+
+void sim_pipeline_write_report(const SimPipeline *p, const SimProgram *prog, const SimProfile *functions,
+                               const SimLines *lines, FILE *out) {
+    sim_pipeline_write_summary(p, out);
+    fprintf(out, "\n");
+    write_functions(p, functions, out);
+    fprintf(out, "\n");
+    write_instructions(p, functions, lines, prog, out);
+}
@@ -0,0 +1,86 @@
+#ifndef SIM_PIPELINE_H
+#define SIM_PIPELINE_H
+
+/**
+ * sim_pipeline.h - Timing model of a 5-stage pipeline for the ACMC simulator
+ *
+ * Replays the retired instruction stream of the reference interpreter on
+ * a classic in-order IF/ID/EX/MEM/WB pipeline and counts the cycles it
+ * would take. The architectural results do not change; only time does.
+ *
+ * Modelled:
+ *   - forwarding from EX/MEM and MEM/WB into EX (or none: operands are
+ *     read in ID once the producer has reached WB)
+ *   - load-use stalls
+ *   - branches resolved in ID or EX, predicted not taken; a taken branch
+ *     or a JR/JALR flushes 'penalty' cycles, J/JAL one cycle
+ *   - a multi-cycle, non-pipelined MULT/DIV unit: MFHI/MFLO (any reader
+ *     of HI/LO) waits for it, and so does the next MULT/DIV
+ *   - MEM stage stalls from the data-cache model, when one is attached
+ *
+ * Every stall cycle is charged to the instruction that waited (or, for
+ * control and memory stalls, to the branch or LW/SW that caused them).
+ */
+
+#include "simulator.h"
+#include "sim_cache.h"
+#include "sim_profile.h"
+#include "sim_lines.h"
+
+typedef enum {
+    SIM_STALL_LOAD_USE,        // Operand produced by the LW just ahead
+    SIM_STALL_DATA,            // Operand of another instruction not ready
+    SIM_STALL_MULDIV,          // HI/LO not ready, or MULT/DIV unit busy
+    SIM_STALL_CONTROL,         // Taken branch or jump
+    SIM_STALL_MEMORY,          // Data-cache miss or write-through
+    SIM_STALL_KINDS
+} SimStallKind;
+
+typedef struct {
+    int forwarding;
+    int branch_in_ex;          // 0 = branches resolved in ID
+    uint32_t penalty;          // Cycles lost by a taken branch, JR or JALR
+    uint32_t mult_latency;
+    uint32_t div_latency;
+} SimPipelineConfig;
+
+typedef struct {
+    SimPipelineConfig config;
+    uint32_t length;
+    uint64_t *executed;        // Per address
+    uint64_t (*stalls)[SIM_STALL_KINDS];   // Per address
+
+    // Cycle numbers of the model; the first instruction is fetched in 0
+    uint64_t last_ex;          // EX cycle of the previous instruction
+    uint64_t next_delay;       // Cycles it holds back the next one
+    uint64_t forward_ready[SIM_NUM_REGS + 1];   // First cycle a stage can use the value
+    uint64_t written_back[SIM_NUM_REGS + 1];
+    uint8_t producer[SIM_NUM_REGS + 1];         // SimStallKind a wait on it counts as
+    uint64_t unit_free;        // MULT/DIV unit
+    uint64_t cycles;           // Through the WB of the last instruction
+    uint64_t instructions;
+    uint64_t total[SIM_STALL_KINDS];
+} SimPipeline;
+
+// Parses "key=value,..." (forwarding=on|off, branch=id|ex, penalty, mult,
+// div) over the defaults forwarding=on,branch=ex,mult=4,div=16; the
+// penalty defaults to 1 for branch=id and 2 for branch=ex. spec may be
+// NULL. Returns 0 on success; prints the problem otherwise.
+int sim_pipeline_parse(SimPipelineConfig *config, const char *spec);
+
+int sim_pipeline_init(SimPipeline *p, const SimPipelineConfig *config, const SimProgram *prog);
+void sim_pipeline_free(SimPipeline *p);
+
+// Runs the machine to completion with the reference interpreter; cache
+// may be NULL for a memory that never stalls
+SimStatus sim_pipeline_run(SimPipeline *p, SimCache *cache, SimMachine *m, const SimProgram *prog);
+
+// Cycles, CPI and stall breakdown, for --stats
+void sim_pipeline_write_summary(const SimPipeline *p, FILE *out);
+
+// Summary, CPI and stalls per function and the most stalled instructions.
+// 'functions' comes from sim_profile_init(); 'lines' may be NULL.
+void sim_pipeline_write_report(const SimPipeline *p, const SimProgram *prog, const SimProfile *functions,
+                               const SimLines *lines, FILE *out);
+
+#endif /* SIM_PIPELINE_H */
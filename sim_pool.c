@@ -0,0 +1,126 @@
+/*
+ * sim_pool.c - Work-stealing thread pool (POSIX threads)
+ */
+
+#include "sim_pool.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    pthread_mutex_t lock;
+    int head;              // Next job the owner takes
+    int tail;              // One past the last queued job; thieves take tail-1
+} PoolQueue;
+
+typedef struct {
+    PoolQueue *queues;
+    int workers;
+    SimPoolJob fn;
+    void *arg;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    int id;
+} PoolWorker;
+
+int sim_pool_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static int take_own(PoolQueue *q) {
+    int job = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail) job = q->head++;
+    pthread_mutex_unlock(&q->lock);
+    return job;
+}
+
+// Steals from the queue with the most jobs left; -1 when all are empty
+static int steal(Pool *pool, int self) {
+    for (;;) {
+        int victim = -1;
+        int most = 0;
+        for (int w = 0; w < pool->workers; w++) {
+            if (w == self) continue;
+            pthread_mutex_lock(&pool->queues[w].lock);
+            int left = pool->queues[w].tail - pool->queues[w].head;
+            pthread_mutex_unlock(&pool->queues[w].lock);
+            if (left > most) {
+                most = left;
+                victim = w;
+            }
+        }
+        if (victim < 0) return -1;
+
+        PoolQueue *q = &pool->queues[victim];
+        int job = -1;
+        pthread_mutex_lock(&q->lock);
+        if (q->head < q->tail) job = --q->tail;
+        pthread_mutex_unlock(&q->lock);
+        if (job >= 0) return job;
+    }
+}
+
+static void *worker_main(void *data) {
+    PoolWorker *worker = data;
+    Pool *pool = worker->pool;
+    PoolQueue *own = &pool->queues[worker->id];
+
+    for (;;) {
+        int job = take_own(own);
+        if (job < 0) job = steal(pool, worker->id);
+        if (job < 0) break;
+        pool->fn(job, worker->id, pool->arg);
+    }
+    return NULL;
+}
+
+int sim_pool_run(int count, int threads, SimPoolJob fn, void *arg) {
+    if (threads > count) threads = count;
+    if (threads <= 1) {
+        for (int job = 0; job < count; job++) fn(job, 0, arg);
+        return 0;
+    }
+
+    Pool pool = { NULL, threads, fn, arg };
+    pool.queues = calloc(threads, sizeof(PoolQueue));
+    PoolWorker *workers = calloc(threads, sizeof(PoolWorker));
+    pthread_t *ids = calloc(threads, sizeof(pthread_t));
+    if (!pool.queues || !workers || !ids) {
+        free(pool.queues);
+        free(workers);
+        free(ids);
+        return -1;
+    }
+
+    for (int w = 0; w < threads; w++) {
+        pthread_mutex_init(&pool.queues[w].lock, NULL);
+        pool.queues[w].head = (int)((long long)count * w / threads);
+        pool.queues[w].tail = (int)((long long)count * (w + 1) / threads);
+        workers[w].pool = &pool;
+        workers[w].id = w;
+    }
+
+    // Worker 0 is the calling thread
+    int started = 1;
+    for (int w = 1; w < threads; w++) {
+        if (pthread_create(&ids[w], NULL, worker_main, &workers[w]) != 0) {
+            fprintf(stderr, "Warning: Cannot start worker thread %d\n", w);
+            break;
+        }
+        started++;
+    }
+    worker_main(&workers[0]);
+    for (int w = 1; w < started; w++) pthread_join(ids[w], NULL);
+
+    // Jobs of workers that failed to start were stolen by the others
+    for (int w = 0; w < threads; w++) pthread_mutex_destroy(&pool.queues[w].lock);
+    free(pool.queues);
+    free(workers);
+    free(ids);
+    return 0;
+}
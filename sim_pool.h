@@ -0,0 +1,22 @@
+#ifndef SIM_POOL_H
+#define SIM_POOL_H
+
+/**
+ * sim_pool.h - Work-stealing thread pool for independent simulator jobs
+ *
+ * Jobs 0..count-1 are split into one contiguous run per worker. A worker
+ * takes jobs from the front of its own run; when it is empty it steals
+ * from the back of the fullest other run, so long jobs do not leave the
+ * remaining cores idle.
+ */
+
+typedef void (*SimPoolJob)(int job, int worker, void *arg);
+
+// Number of online processors (at least 1)
+int sim_pool_default_threads(void);
+
+// Runs every job once and returns when all are finished; threads <= 1
+// runs them in order on the calling thread. Returns 0 on success.
+int sim_pool_run(int count, int threads, SimPoolJob fn, void *arg);
+
+#endif /* SIM_POOL_H */
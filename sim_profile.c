@@ -0,0 +1,442 @@
+/*
+ * sim_profile.c - Exact instruction profiler for acmc-sim --profile
+ *
+ * Profiling uses the reference interpreter: it is about eight times slower
+ * than the threaded one, but every retired instruction is seen exactly
+ * once, with the shadow call stack kept in step. Trapping instructions do
+ * not retire and are not counted, as in sim_step().
+ */
+
+#include "sim_profile.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_ADDRESS UINT32_MAX
+
+typedef struct {
+    int node;                  // Caller context to return to
+    uint32_t return_address;
+} ProfileFrame;
+
+static char *copy_string(const char *s) {
+    char *copy = malloc(strlen(s) + 1);
+    if (copy) strcpy(copy, s);
+    return copy;
+}
+
+static int add_function(SimProfile *p, const char *name, uint32_t entry) {
+    for (int i = 0; i < p->function_count; i++) {
+        if (p->functions[i].entry == entry) return i;
+    }
+    SimProfileFunction *grown = realloc(p->functions, (p->function_count + 1) * sizeof(SimProfileFunction));
+    if (!grown) return -1;
+    p->functions = grown;
+    SimProfileFunction *f = &p->functions[p->function_count];
+    memset(f, 0, sizeof(*f));
+    f->name = copy_string(name);
+    f->entry = entry;
+    return p->function_count++;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const SimProfileFunction *fa = a, *fb = b;
+    return fa->entry < fb->entry ? -1 : fa->entry > fb->entry;
+}
+
+// Address of an .asm line: "N-..." is address N and the unnumbered
+// "j <main>" that assembly.c writes first is address 0
+static uint32_t listing_line_address(const char *line, int seen_numbered) {
+    const char *s = line;
+    while (*s == ' ' || *s == '\t') s++;
+    if (isdigit((unsigned char)*s)) {
+        uint32_t address = 0;
+        while (isdigit((unsigned char)*s)) address = address * 10 + (uint32_t)(*s++ - '0');
+        if (*s == '-') return address;
+    }
+    if (seen_numbered || *s == '\0' || *s == '#') return NO_ADDRESS;
+    if (strncmp(s, "Func ", 5) == 0 || s[strlen(s) - 1] == ':') return NO_ADDRESS;
+    return 0;
+}
+
+// Reads the listing and takes function names from its "Func name:" lines
+static int load_listing(SimProfile *p, const char *asm_file) {
+    FILE *f = fopen(asm_file, "r");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open assembly listing %s\n", asm_file);
+        return -1;
+    }
+
+    int capacity = 0;
+    int seen_numbered = 0;
+    char line[512];
+    char pending[sizeof(line)] = "";
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (p->listing_lines == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            char **lines = realloc(p->listing, capacity * sizeof(char *));
+            uint32_t *addresses = realloc(p->listing_address, capacity * sizeof(uint32_t));
+            if (lines) p->listing = lines;
+            if (addresses) p->listing_address = addresses;
+            if (!lines || !addresses) {
+                fclose(f);
+                return -1;
+            }
+        }
+
+        uint32_t address = listing_line_address(line, seen_numbered);
+        if (address != NO_ADDRESS && address != 0) seen_numbered = 1;
+        if (strncmp(line, "Func ", 5) == 0) {
+            snprintf(pending, sizeof(pending), "%s", line + 5);
+            pending[strcspn(pending, ":")] = '\0';
+        } else if (address != NO_ADDRESS && pending[0]) {
+            if (address < p->length) add_function(p, pending, address);
+            pending[0] = '\0';
+        }
+        p->listing_address[p->listing_lines] = address;
+        p->listing[p->listing_lines++] = copy_string(line);
+    }
+    fclose(f);
+    return 0;
+}
+
+int sim_profile_init(SimProfile *p, const SimProgram *prog, const char *asm_file) {
+    memset(p, 0, sizeof(*p));
+    p->length = prog->length;
+    p->counts = calloc(prog->length ? prog->length : 1, sizeof(uint64_t));
+    p->function_of = calloc(prog->length ? prog->length : 1, sizeof(int));
+    if (!p->counts || !p->function_of) {
+        sim_profile_free(p);
+        return -1;
+    }
+
+    if (asm_file) {
+        if (load_listing(p, asm_file) != 0) {
+            sim_profile_free(p);
+            return -1;
+        }
+    } else {
+        // No names: the target of the leading jump is main, JAL targets
+        // are the other functions
+        for (uint32_t a = 0; a < prog->length; a++) {
+            SimInsn in;
+            sim_decode(prog->words[a], &in);
+            if ((uint32_t)in.imm >= prog->length) continue;
+            if (a == 0 && in.op == SIM_OP_J) {
+                add_function(p, "main", (uint32_t)in.imm);
+            } else if (in.op == SIM_OP_JAL) {
+                char name[32];
+                snprintf(name, sizeof(name), "func_%u", (uint32_t)in.imm);
+                add_function(p, name, (uint32_t)in.imm);
+            }
+        }
+    }
+    if (add_function(p, "_start", 0) < 0) {
+        sim_profile_free(p);
+        return -1;
+    }
+    qsort(p->functions, p->function_count, sizeof(SimProfileFunction), compare_entries);
+
+    int f = 0;
+    for (uint32_t a = 0; a < p->length; a++) {
+        while (f + 1 < p->function_count && p->functions[f + 1].entry <= a) f++;
+        p->function_of[a] = f;
+    }
+    return 0;
+}
+
+void sim_profile_free(SimProfile *p) {
+    for (int i = 0; i < p->function_count; i++) free(p->functions[i].name);
+    for (int i = 0; i < p->listing_lines; i++) free(p->listing[i]);
+    free(p->functions);
+    free(p->listing);
+    free(p->listing_address);
+    free(p->nodes);
+    free(p->counts);
+    free(p->function_of);
+    memset(p, 0, sizeof(*p));
+}
+
+// Finds or creates the context 'function' called from 'parent'
+static int child_node(SimProfile *p, int parent, int function) {
+    if (parent >= 0) {
+        for (int c = p->nodes[parent].first_child; c >= 0; c = p->nodes[c].next_sibling) {
+            if (p->nodes[c].function == function) return c;
+        }
+    }
+    if (p->node_count == p->node_capacity) {
+        int capacity = p->node_capacity ? p->node_capacity * 2 : 64;
+        SimProfileNode *grown = realloc(p->nodes, capacity * sizeof(SimProfileNode));
+        if (!grown) return -1;
+        p->nodes = grown;
+        p->node_capacity = capacity;
+    }
+    int n = p->node_count++;
+    SimProfileNode *node = &p->nodes[n];
+    memset(node, 0, sizeof(*node));
+    node->function = function;
+    node->parent = parent;
+    node->first_child = -1;
+    node->next_sibling = -1;
+    if (parent >= 0) {
+        node->next_sibling = p->nodes[parent].first_child;
+        p->nodes[parent].first_child = n;
+    }
+    return n;
+}
+
+// Totals per context and per function once the run is over
+static void summarize(SimProfile *p) {
+    for (int n = 0; n < p->node_count; n++) p->nodes[n].inclusive = p->nodes[n].self;
+    // Children are always created after their parent
+    for (int n = p->node_count - 1; n > 0; n--) {
+        p->nodes[p->nodes[n].parent].inclusive += p->nodes[n].inclusive;
+    }
+
+    for (int f = 0; f < p->function_count; f++) {
+        p->functions[f].self = 0;
+        p->functions[f].inclusive = 0;
+        p->functions[f].calls = 0;
+    }
+    for (uint32_t a = 0; a < p->length; a++) p->functions[p->function_of[a]].self += p->counts[a];
+    for (int n = 1; n < p->node_count; n++) {
+        SimProfileNode *node = &p->nodes[n];
+        SimProfileFunction *f = &p->functions[node->function];
+        f->calls += node->calls;
+        node->recursive = 0;
+        for (int a = node->parent; a > 0 && !node->recursive; a = p->nodes[a].parent) {
+            node->recursive = p->nodes[a].function == node->function;
+        }
+        if (!node->recursive) f->inclusive += node->inclusive;
+    }
+}
+
+SimStatus sim_profile_run(SimProfile *p, SimMachine *m, const SimProgram *prog) {
+    ProfileFrame *stack = NULL;
+    int depth = 0, stack_capacity = 0;
+
+    int root = child_node(p, -1, -1);
+    int current = root >= 0 && m->pc < p->length ? child_node(p, root, p->function_of[m->pc]) : -1;
+    if (current < 0) {
+        fprintf(stderr, "Error: Cannot start profiling\n");
+        return m->status;
+    }
+    p->nodes[current].calls = 1;
+
+    while (m->status == SIM_RUNNING) {
+        uint32_t pc = m->pc;
+        uint64_t before = m->icount;
+        sim_step(m, prog);
+        if (m->icount == before) break;
+
+        p->counts[pc]++;
+        p->nodes[current].self++;
+        p->total++;
+
+        uint32_t next = m->pc;
+        if (next >= p->length) continue;   // Trap on the next step
+
+        SimInsn in;
+        sim_decode(prog->words[pc], &in);
+        int function = p->function_of[next];
+        if (in.op == SIM_OP_JAL || in.op == SIM_OP_JALR) {
+            if (depth == stack_capacity) {
+                stack_capacity = stack_capacity ? stack_capacity * 2 : 64;
+                ProfileFrame *grown = realloc(stack, stack_capacity * sizeof(ProfileFrame));
+                if (!grown) break;
+                stack = grown;
+            }
+            stack[depth].node = current;
+            stack[depth].return_address = pc + 1;
+            depth++;
+            current = child_node(p, current, function);
+            if (current < 0) break;
+            p->nodes[current].calls++;
+            continue;
+        }
+        if (in.op == SIM_OP_JR) {
+            // A return unwinds to the frame that saved this address
+            int frame = depth - 1;
+            while (frame >= 0 && stack[frame].return_address != next) frame--;
+            if (frame >= 0) {
+                current = stack[frame].node;
+                depth = frame;
+                continue;
+            }
+        }
+        if (function != p->nodes[current].function) {
+            // Plain jump into another function: replaces the frame
+            current = child_node(p, p->nodes[current].parent, function);
+            if (current < 0) break;
+            p->nodes[current].calls++;
+        }
+    }
+    if (m->status == SIM_RUNNING) {
+        fprintf(stderr, "Error: Out of memory while profiling\n");
+    }
+    free(stack);
+    summarize(p);
+    return m->status;
+}
+
+static double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+static int compare_self(const void *a, const void *b) {
+    const SimProfileFunction *fa = *(const SimProfileFunction * const *)a;
+    const SimProfileFunction *fb = *(const SimProfileFunction * const *)b;
+    if (fa->self != fb->self) return fa->self < fb->self ? 1 : -1;
+    return fa->entry < fb->entry ? -1 : fa->entry > fb->entry;
+}
+
+static void write_flat(const SimProfile *p, FILE *out) {
+    const SimProfileFunction **order = malloc(p->function_count * sizeof(SimProfileFunction *));
+    if (!order) return;
+    for (int f = 0; f < p->function_count; f++) order[f] = &p->functions[f];
+    qsort(order, p->function_count, sizeof(SimProfileFunction *), compare_self);
+
+    fprintf(out, "Flat profile (%llu instructions):\n\n", (unsigned long long)p->total);
+    fprintf(out, "  %%self        self  %%incl   inclusive       calls  function\n");
+    for (int i = 0; i < p->function_count; i++) {
+        const SimProfileFunction *f = order[i];
+        if (f->self == 0 && f->calls == 0) continue;
+        fprintf(out, "%7.2f %11llu %6.2f %11llu %11llu  %s\n",
+                percent(f->self, p->total), (unsigned long long)f->self,
+                percent(f->inclusive, p->total), (unsigned long long)f->inclusive,
+                (unsigned long long)f->calls, f->name);
+    }
+    free(order);
+}
+
+static void write_call_graph(const SimProfile *p, FILE *out) {
+    fprintf(out, "\nCall graph:\n\n");
+    fprintf(out, "  %-24s %-24s %11s %11s\n", "caller", "callee", "calls", "inclusive");
+    // One arc per (caller, callee) pair; contexts are merged
+    for (int caller = 0; caller < p->function_count; caller++) {
+        for (int callee = 0; callee < p->function_count; callee++) {
+            uint64_t calls = 0, inclusive = 0;
+            int seen = 0, outermost = 0;
+            for (int n = 1; n < p->node_count; n++) {
+                const SimProfileNode *node = &p->nodes[n];
+                if (node->function != callee || node->parent <= 0) continue;
+                if (p->nodes[node->parent].function != caller) continue;
+                seen = 1;
+                calls += node->calls;
+                // Recursive calls are already inside the outer call's cost
+                if (!node->recursive) {
+                    outermost = 1;
+                    inclusive += node->inclusive;
+                }
+            }
+            if (seen && outermost) {
+                fprintf(out, "  %-24s %-24s %11llu %11llu\n", p->functions[caller].name,
+                        p->functions[callee].name, (unsigned long long)calls,
+                        (unsigned long long)inclusive);
+            } else if (seen) {
+                fprintf(out, "  %-24s %-24s %11llu %11s\n", p->functions[caller].name,
+                        p->functions[callee].name, (unsigned long long)calls, "-");
+            }
+        }
+    }
+}
+
+static void write_listing(const SimProfile *p, const SimProgram *prog, FILE *out) {
+    fprintf(out, "\nAnnotated listing:\n\n");
+    if (p->listing) {
+        for (int i = 0; i < p->listing_lines; i++) {
+            uint32_t a = p->listing_address[i];
+            if (a != NO_ADDRESS && a < p->length) {
+                fprintf(out, "%11llu %6.2f | %s\n", (unsigned long long)p->counts[a],
+                        percent(p->counts[a], p->total), p->listing[i]);
+            } else {
+                fprintf(out, "%11s %6s | %s\n", "", "", p->listing[i]);
+            }
+        }
+        return;
+    }
+    int last_function = -1;
+    for (uint32_t a = 0; a < p->length; a++) {
+        if (p->function_of[a] != last_function) {
+            last_function = p->function_of[a];
+            fprintf(out, "%11s %6s | %s:\n", "", "", p->functions[last_function].name);
+        }
+        SimInsn in;
+        sim_decode(prog->words[a], &in);
+        fprintf(out, "%11llu %6.2f | %u-%s\n", (unsigned long long)p->counts[a],
+                percent(p->counts[a], p->total), a, sim_opcode_name(in.op));
+    }
+}
+
+// Prints 'text_file' with the instructions attributed to each of its lines;
+// line_of gives the 1-based line of every address
+static void write_annotated_file(const SimProfile *p, const uint32_t *line_of, uint32_t addresses,
+                                 const char *title, const char *text_file, FILE *out) {
+    FILE *f = fopen(text_file, "r");
+    if (!f) {
+        fprintf(out, "\n%s: cannot open %s\n", title, text_file);
+        return;
+    }
+
+    uint32_t lines = 0;
+    for (uint32_t a = 0; a < addresses; a++) {
+        if (line_of[a] > lines) lines = line_of[a];
+    }
+    uint64_t *counts = calloc((size_t)lines + 1, sizeof(uint64_t));
+    unsigned char *has_code = calloc((size_t)lines + 1, 1);
+    if (!counts || !has_code) {
+        free(counts);
+        free(has_code);
+        fclose(f);
+        return;
+    }
+    for (uint32_t a = 0; a < addresses && a < p->length; a++) {
+        counts[line_of[a]] += p->counts[a];
+        has_code[line_of[a]] = 1;
+    }
+
+    fprintf(out, "\n%s (%s):\n\n", title, text_file);
+    char text[512];
+    uint32_t line = 0;
+    while (fgets(text, sizeof(text), f)) {
+        line++;
+        text[strcspn(text, "\r\n")] = '\0';
+        if (line <= lines && has_code[line]) {
+            fprintf(out, "%11llu %6.2f | %5u  %s\n", (unsigned long long)counts[line],
+                    percent(counts[line], p->total), line, text);
+        } else {
+            fprintf(out, "%11s %6s | %5u  %s\n", "", "", line, text);
+        }
+    }
+    free(counts);
+    free(has_code);
+    fclose(f);
+}
+
+void sim_profile_write_report(const SimProfile *p, const SimProgram *prog,
+                              const SimLines *lines, FILE *out) {
+    write_flat(p, out);
+    write_call_graph(p, out);
+    write_listing(p, prog, out);
+    if (lines) {
+        write_annotated_file(p, lines->ir_line, lines->length, "Annotated IR", lines->ir_file, out);
+        write_annotated_file(p, lines->source_line, lines->length, "Annotated source", lines->source_file, out);
+    }
+}
+
+static void write_stack(const SimProfile *p, int node, FILE *out) {
+    if (p->nodes[node].parent > 0) {
+        write_stack(p, p->nodes[node].parent, out);
+        fputc(';', out);
+    }
+    fputs(p->functions[p->nodes[node].function].name, out);
+}
+
+void sim_profile_write_folded(const SimProfile *p, FILE *out) {
+    for (int n = 1; n < p->node_count; n++) {
+        if (p->nodes[n].self == 0) continue;
+        write_stack(p, n, out);
+        fprintf(out, " %llu\n", (unsigned long long)p->nodes[n].self);
+    }
+}
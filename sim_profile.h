@@ -0,0 +1,74 @@
+#ifndef SIM_PROFILE_H
+#define SIM_PROFILE_H
+
+/**
+ * sim_profile.h - Exact instruction profiler for the ACMC simulator
+ *
+ * Runs a program one instruction at a time through sim_step() and counts
+ * every retired instruction per address. JAL/JALR push a frame on a
+ * shadow stack and a JR to the saved return address pops it, which gives
+ * a calling-context tree: flat profile, call graph and folded stacks all
+ * come from it.
+ *
+ * Functions are the "Func name:" blocks of the .asm listing written by
+ * assembly.c; without a listing, every JAL target starts a function.
+ */
+
+#include "simulator.h"
+#include "sim_lines.h"
+
+typedef struct {
+    char *name;
+    uint32_t entry;            // First address
+    uint64_t self;             // Instructions retired inside the function
+    uint64_t inclusive;        // Including callees (recursion counted once)
+    uint64_t calls;
+} SimProfileFunction;
+
+// Node of the calling-context tree; node 0 is the root above _start
+typedef struct {
+    int function;
+    int parent;
+    int first_child;
+    int next_sibling;
+    uint64_t self;
+    uint64_t inclusive;
+    uint64_t calls;
+    int recursive;             // An outer context runs the same function
+} SimProfileNode;
+
+typedef struct {
+    uint32_t length;
+    uint64_t *counts;          // Executions per address
+    int *function_of;          // Function index per address
+
+    SimProfileFunction *functions;
+    int function_count;
+
+    SimProfileNode *nodes;
+    int node_count;
+    int node_capacity;
+
+    char **listing;            // .asm lines, NULL without a listing
+    uint32_t *listing_address; // Address per line, UINT32_MAX for labels
+    int listing_lines;
+
+    uint64_t total;
+} SimProfile;
+
+// asm_file may be NULL. Returns 0 on success.
+int sim_profile_init(SimProfile *p, const SimProgram *prog, const char *asm_file);
+void sim_profile_free(SimProfile *p);
+
+// Runs the machine to completion with the reference interpreter
+SimStatus sim_profile_run(SimProfile *p, SimMachine *m, const SimProgram *prog);
+
+// Flat profile, call graph and annotated listing; with a line table
+// (may be NULL) also the annotated IR and C- source
+void sim_profile_write_report(const SimProfile *p, const SimProgram *prog,
+                              const SimLines *lines, FILE *out);
+
+// One "caller;callee count" line per calling context (flamegraph.pl input)
+void sim_profile_write_folded(const SimProfile *p, FILE *out);
+
+#endif /* SIM_PROFILE_H */
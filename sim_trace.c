@@ -0,0 +1,453 @@
+/*
+ * sim_trace.c - Memory-access trace writer, reader and block compression
+ */
+
+#include "sim_trace.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAGIC "ACMCMTRC"
+#define TRACE_VERSION 1
+#define TRACE_BLOCK_BYTES 65536
+#define TRACE_RECORD_MAX 16        // 3 varints of at most 5 bytes each
+#define TRACE_BUFFERS 4
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+
+// ---------------------------------------------------------------------------
+// Varints
+// ---------------------------------------------------------------------------
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static uint8_t *put_uleb(uint8_t *out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static int get_uleb(const uint8_t *data, size_t size, size_t *pos, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && *pos < size; shift += 7) {
+        uint8_t byte = data[(*pos)++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void write_uleb(FILE *f, uint64_t value) {
+    uint8_t bytes[10];
+    fwrite(bytes, 1, put_uleb(bytes, value) - bytes, f);
+}
+
+static int read_uleb(FILE *f, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(f);
+        if (byte == EOF) return -1;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// ---------------------------------------------------------------------------
+// Block compression: LZ77 with a 64 KiB window, single-probe hash table.
+// Sequences are token (literal length << 4 | match length - 4), length
+// extensions in 255 steps, literals, 16-bit little-endian offset. The last
+// sequence has literals only.
+// ---------------------------------------------------------------------------
+
+static uint32_t lz_hash(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uint8_t *lz_put_length(uint8_t *out, size_t length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+static uint8_t *lz_put_sequence(uint8_t *out, const uint8_t *literals, size_t literal_length,
+                                size_t offset, size_t match_length) {
+    size_t match_code = match_length ? match_length - LZ_MIN_MATCH : 0;
+    *out++ = (uint8_t)((literal_length < 15 ? literal_length : 15) << 4 |
+                       (match_code < 15 ? match_code : 15));
+    if (literal_length >= 15) out = lz_put_length(out, literal_length - 15);
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+    if (match_length) {
+        *out++ = (uint8_t)(offset & 0xFF);
+        *out++ = (uint8_t)(offset >> 8);
+        if (match_code >= 15) out = lz_put_length(out, match_code - 15);
+    }
+    return out;
+}
+
+size_t sim_trace_compress(const uint8_t *src, size_t n, uint8_t *dst) {
+    uint32_t table[1 << LZ_HASH_BITS];   // Position + 1, 0 = empty
+    memset(table, 0, sizeof(table));
+
+    uint8_t *out = dst;
+    size_t anchor = 0, i = 0;
+    while (i + LZ_MIN_MATCH <= n) {
+        uint32_t h = lz_hash(src + i);
+        size_t candidate = table[h];
+        table[h] = (uint32_t)i + 1;
+        if (candidate && i - (candidate - 1) <= LZ_MAX_OFFSET &&
+            memcmp(src + candidate - 1, src + i, LZ_MIN_MATCH) == 0) {
+            size_t match = candidate - 1;
+            size_t length = LZ_MIN_MATCH;
+            while (i + length < n && src[match + length] == src[i + length]) length++;
+            out = lz_put_sequence(out, src + anchor, i - anchor, i - match, length);
+            i += length;
+            anchor = i;
+        } else {
+            i++;
+        }
+    }
+    out = lz_put_sequence(out, src + anchor, n - anchor, 0, 0);
+    return (size_t)(out - dst);
+}
+
+static int lz_get_length(const uint8_t *src, size_t n, size_t *pos, size_t *length) {
+    uint8_t byte;
+    do {
+        if (*pos >= n) return -1;
+        byte = src[(*pos)++];
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+size_t sim_trace_decompress(const uint8_t *src, size_t n, uint8_t *dst, size_t capacity) {
+    size_t in = 0, out = 0;
+    while (in < n) {
+        uint8_t token = src[in++];
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && lz_get_length(src, n, &in, &literal_length) != 0) return (size_t)-1;
+        if (literal_length > n - in || literal_length > capacity - out) return (size_t)-1;
+        memcpy(dst + out, src + in, literal_length);
+        in += literal_length;
+        out += literal_length;
+        if (in == n) break;   // Last sequence
+
+        if (n - in < 2) return (size_t)-1;
+        size_t offset = src[in] | (size_t)src[in + 1] << 8;
+        in += 2;
+        size_t match_length = token & 0x0F;
+        if (match_length == 15 && lz_get_length(src, n, &in, &match_length) != 0) return (size_t)-1;
+        match_length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > out || match_length > capacity - out) return (size_t)-1;
+        for (size_t k = 0; k < match_length; k++, out++) dst[out] = dst[out - offset];   // May overlap
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Writer
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t data[TRACE_BLOCK_BYTES];
+    size_t size;
+    uint64_t records;
+} TraceBlock;
+
+struct SimTraceWriter {
+    FILE *f;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    TraceBlock blocks[TRACE_BUFFERS];   // Ring: filled in order, written in order
+    uint64_t produced;                  // Blocks handed to the writer thread
+    uint64_t consumed;                  // Blocks written
+    int done;
+    int failed;                         // Set by the writer thread
+
+    TraceBlock *current;                // Owned by the simulation thread
+    uint32_t pc;
+    uint32_t address;
+    uint32_t block;                     // Generation of the entries in 'last_value'
+    uint32_t last_block[SIM_MAX_PROGRAM_WORDS];
+    int32_t last_value[SIM_MAX_PROGRAM_WORDS];
+    uint64_t records;
+    uint64_t raw_bytes;
+    uint64_t file_bytes;                // Updated by the writer thread
+    uint8_t stored[SIM_TRACE_PACKED_BOUND(TRACE_BLOCK_BYTES)];
+};
+
+static void write_block(SimTraceWriter *w, const TraceBlock *block) {
+    size_t packed = sim_trace_compress(block->data, block->size, w->stored);
+    const uint8_t *bytes = packed < block->size ? w->stored : block->data;
+    size_t stored = packed < block->size ? packed : block->size;
+
+    long before = ftell(w->f);
+    write_uleb(w->f, block->size);
+    write_uleb(w->f, stored);
+    write_uleb(w->f, block->records);
+    fwrite(bytes, 1, stored, w->f);
+    if (ferror(w->f)) w->failed = 1;
+    w->file_bytes += (uint64_t)(ftell(w->f) - before);
+}
+
+static void *writer_thread(void *arg) {
+    SimTraceWriter *w = arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (w->consumed == w->produced && !w->done) pthread_cond_wait(&w->changed, &w->lock);
+        if (w->consumed == w->produced) break;
+        TraceBlock *block = &w->blocks[w->consumed % TRACE_BUFFERS];
+        pthread_mutex_unlock(&w->lock);
+
+        write_block(w, block);
+
+        pthread_mutex_lock(&w->lock);
+        w->consumed++;
+        pthread_cond_broadcast(&w->changed);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// Hands the current block to the writer thread and starts the next one,
+// waiting only when every buffer is still queued
+static void submit_block(SimTraceWriter *w) {
+    pthread_mutex_lock(&w->lock);
+    w->produced++;
+    pthread_cond_broadcast(&w->changed);
+    while (w->produced - w->consumed >= TRACE_BUFFERS) pthread_cond_wait(&w->changed, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+
+    w->current = &w->blocks[w->produced % TRACE_BUFFERS];
+    w->current->size = 0;
+    w->current->records = 0;
+    w->pc = 0;
+    w->address = 0;
+    w->block++;
+}
+
+SimTraceWriter *sim_trace_create(const char *filename) {
+    SimTraceWriter *w = calloc(1, sizeof(SimTraceWriter));
+    if (!w) return NULL;
+    w->f = fopen(filename, "wb");
+    if (!w->f) {
+        fprintf(stderr, "Error: Cannot write trace %s\n", filename);
+        free(w);
+        return NULL;
+    }
+    fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), w->f);
+    fputc(TRACE_VERSION, w->f);
+    w->file_bytes = strlen(TRACE_MAGIC) + 1;
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->changed, NULL);
+    w->current = &w->blocks[0];
+    w->block = 1;
+    if (pthread_create(&w->thread, NULL, writer_thread, w) != 0) {
+        fprintf(stderr, "Error: Cannot start the trace writer thread\n");
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->changed);
+        fclose(w->f);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void sim_trace_record(SimTraceWriter *w, uint32_t pc, uint32_t address, int32_t value, int write) {
+    TraceBlock *block = w->current;
+    pc &= SIM_MAX_PROGRAM_WORDS - 1;   // Programs never get larger
+    int32_t previous = w->last_block[pc] == w->block ? w->last_value[pc] : 0;
+    w->last_block[pc] = w->block;
+    w->last_value[pc] = value;
+
+    uint8_t *out = block->data + block->size;
+    out = put_uleb(out, (uint64_t)zigzag((int32_t)(pc - w->pc)) << 1 | (write != 0));
+    out = put_uleb(out, zigzag((int32_t)(address - w->address)));
+    out = put_uleb(out, zigzag((int32_t)((uint32_t)value - (uint32_t)previous)));
+    block->size = (size_t)(out - block->data);
+    block->records++;
+    w->pc = pc;
+    w->address = address;
+    w->records++;
+    if (block->size > TRACE_BLOCK_BYTES - TRACE_RECORD_MAX) {
+        w->raw_bytes += block->size;
+        submit_block(w);
+    }
+}
+
+SimStatus sim_trace_run(SimTraceWriter *w, SimMachine *m, const SimProgram *prog) {
+    while (m->status == SIM_RUNNING) {
+        uint32_t pc = m->pc;
+        uint64_t before = m->icount;
+        int access = 0;
+        uint32_t address = 0;
+        if (pc < prog->length) {
+            SimInsn in;
+            sim_decode(prog->words[pc], &in);
+            if (in.op == SIM_OP_LW || in.op == SIM_OP_SW) {
+                access = in.op == SIM_OP_SW ? 2 : 1;
+                address = (uint32_t)m->regs[in.rs] + (uint32_t)in.imm;   // Before LW overwrites rs
+            }
+        }
+        sim_step(m, prog);
+        if (m->icount == before) break;
+        if (access) sim_trace_record(w, pc, address, m->mem[address], access == 2);
+    }
+    return m->status;
+}
+
+int sim_trace_finish(SimTraceWriter *w, uint64_t *records, uint64_t *raw_bytes, uint64_t *file_bytes) {
+    if (w->current->records) {
+        w->raw_bytes += w->current->size;
+        submit_block(w);
+    }
+    pthread_mutex_lock(&w->lock);
+    w->done = 1;
+    pthread_cond_broadcast(&w->changed);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+
+    // End marker
+    write_uleb(w->f, 0);
+    write_uleb(w->f, 0);
+    write_uleb(w->f, 0);
+    w->file_bytes += 3;
+    int failed = w->failed || ferror(w->f);
+    if (fclose(w->f) != 0) failed = 1;
+
+    if (records) *records = w->records;
+    if (raw_bytes) *raw_bytes = w->raw_bytes;
+    if (file_bytes) *file_bytes = w->file_bytes;
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->changed);
+    free(w);
+    return failed ? -1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+// ---------------------------------------------------------------------------
+
+int sim_trace_open(SimTraceReader *r, const char *filename) {
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(filename, "rb");
+    if (!r->f) {
+        fprintf(stderr, "Error: Cannot open trace %s\n", filename);
+        return -1;
+    }
+    char magic[sizeof(TRACE_MAGIC) - 1];
+    if (fread(magic, 1, sizeof(magic), r->f) != sizeof(magic) ||
+        memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 || fgetc(r->f) != TRACE_VERSION) {
+        fprintf(stderr, "Error: %s is not a memory trace\n", filename);
+        fclose(r->f);
+        r->f = NULL;
+        return -1;
+    }
+    r->last_block = calloc(SIM_MAX_PROGRAM_WORDS, sizeof(uint32_t));
+    r->last_value = calloc(SIM_MAX_PROGRAM_WORDS, sizeof(int32_t));
+    if (!r->last_block || !r->last_value) {
+        sim_trace_close(r);
+        return -1;
+    }
+    return 0;
+}
+
+// Reads and unpacks the next block; 0 on success, 1 at the end marker
+static int next_block(SimTraceReader *r) {
+    uint64_t raw_size, stored_size, records;
+    if (read_uleb(r->f, &raw_size) != 0 || read_uleb(r->f, &stored_size) != 0 ||
+        read_uleb(r->f, &records) != 0) return -1;
+    if (records == 0) {
+        r->complete = 1;
+        return 1;
+    }
+    if (raw_size > (1u << 24) || stored_size > raw_size) return -1;
+
+    if (raw_size > r->raw_capacity) {
+        uint8_t *grown = realloc(r->raw, raw_size);
+        if (!grown) return -1;
+        r->raw = grown;
+        r->raw_capacity = raw_size;
+    }
+    if (stored_size > r->stored_capacity) {
+        uint8_t *grown = realloc(r->stored, stored_size);
+        if (!grown) return -1;
+        r->stored = grown;
+        r->stored_capacity = stored_size;
+    }
+    if (fread(r->stored, 1, stored_size, r->f) != stored_size) return -1;
+    if (stored_size == raw_size) {
+        memcpy(r->raw, r->stored, raw_size);
+    } else if (sim_trace_decompress(r->stored, stored_size, r->raw, raw_size) != raw_size) {
+        return -1;
+    }
+
+    r->raw_size = raw_size;
+    r->pos = 0;
+    r->block_records = records;
+    r->pc = 0;
+    r->address = 0;
+    r->block++;
+    return 0;
+}
+
+int sim_trace_next(SimTraceReader *r, SimTraceRecord *record) {
+    if (r->complete) return 0;
+    if (r->block_records == 0) {
+        int status = next_block(r);
+        if (status != 0) return status > 0 ? 0 : -1;
+    }
+
+    uint64_t pc_field, address_field, value_field;
+    if (get_uleb(r->raw, r->raw_size, &r->pos, &pc_field) != 0 ||
+        get_uleb(r->raw, r->raw_size, &r->pos, &address_field) != 0 ||
+        get_uleb(r->raw, r->raw_size, &r->pos, &value_field) != 0) return -1;
+    r->pc += (uint32_t)unzigzag((uint32_t)(pc_field >> 1));
+    r->address += (uint32_t)unzigzag((uint32_t)address_field);
+    if (r->pc >= SIM_MAX_PROGRAM_WORDS) return -1;
+    int32_t previous = r->last_block[r->pc] == r->block ? r->last_value[r->pc] : 0;
+    int32_t value = (int32_t)((uint32_t)previous + (uint32_t)unzigzag((uint32_t)value_field));
+    r->last_block[r->pc] = r->block;
+    r->last_value[r->pc] = value;
+    record->pc = r->pc;
+    record->address = r->address;
+    record->value = value;
+    record->write = (int)(pc_field & 1);
+    r->block_records--;
+    return 1;
+}
+
+void sim_trace_close(SimTraceReader *r) {
+    if (r->f) fclose(r->f);
+    free(r->raw);
+    free(r->stored);
+    free(r->last_block);
+    free(r->last_value);
+    memset(r, 0, sizeof(*r));
+}
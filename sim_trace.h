@@ -0,0 +1,86 @@
+#ifndef SIM_TRACE_H
+#define SIM_TRACE_H
+
+/**
+ * sim_trace.h - Memory-access traces for the ACMC simulator
+ *
+ * Records every retired LW and SW as (pc, address, value, read/write).
+ * The simulation thread only varint-encodes records into a block buffer;
+ * full blocks go to a writer thread that compresses and writes them, so
+ * file I/O never runs on the simulation thread.
+ *
+ * File format:
+ *
+ *     "ACMCMTRC" version(1 byte)
+ *     blocks: uleb raw size, uleb stored size, uleb record count, bytes
+ *     a block with zero records ends the trace
+ *
+ * A block is stored LZ-compressed (LZ4-style sequences) when that is
+ * smaller and as-is otherwise (stored size == raw size). Records inside
+ * a block:
+ *
+ *     uleb  zigzag(pc - previous pc) << 1 | write
+ *     uleb  zigzag(address - previous address)
+ *     uleb  zigzag(value - previous value at the same pc)
+ *
+ * All previous values start from 0 in every block, so blocks decode
+ * independently. Loop counters and pointers then encode as the same few
+ * bytes on every iteration, which is what the LZ stage feeds on.
+ */
+
+#include "simulator.h"
+
+typedef struct {
+    uint32_t pc;
+    uint32_t address;
+    int32_t value;         // Value loaded, or stored
+    int write;             // 1 for SW, 0 for LW
+} SimTraceRecord;
+
+typedef struct SimTraceWriter SimTraceWriter;
+
+// Creates the file and starts the writer thread; NULL on failure
+SimTraceWriter *sim_trace_create(const char *filename);
+
+void sim_trace_record(SimTraceWriter *w, uint32_t pc, uint32_t address, int32_t value, int write);
+
+// Runs to completion through sim_step(), recording every LW/SW
+SimStatus sim_trace_run(SimTraceWriter *w, SimMachine *m, const SimProgram *prog);
+
+// Flushes, stops the writer thread and closes the file; returns 0 if
+// everything was written. Optionally reports records and file bytes.
+int sim_trace_finish(SimTraceWriter *w, uint64_t *records, uint64_t *raw_bytes, uint64_t *file_bytes);
+
+typedef struct {
+    FILE *f;
+    uint8_t *raw;
+    size_t raw_size;
+    size_t raw_capacity;
+    size_t pos;
+    uint8_t *stored;
+    size_t stored_capacity;
+    uint64_t block_records;    // Left in the current block
+    uint32_t pc;
+    uint32_t address;
+    uint32_t block;            // Generation of the entries in 'last_value'
+    uint32_t *last_block;      // Per pc, SIM_MAX_PROGRAM_WORDS entries
+    int32_t *last_value;
+    int complete;              // End marker seen
+} SimTraceReader;
+
+// Returns 0 on success
+int sim_trace_open(SimTraceReader *r, const char *filename);
+
+// 1 with a record, 0 at the end of the trace, -1 if it is truncated or corrupt
+int sim_trace_next(SimTraceReader *r, SimTraceRecord *record);
+
+void sim_trace_close(SimTraceReader *r);
+
+// Block compression used by the trace files; 'dst' must hold
+// SIM_TRACE_PACKED_BOUND(n) bytes. Decompression returns the output
+// size, or (size_t)-1 if the input is corrupt or does not fit.
+#define SIM_TRACE_PACKED_BOUND(n) ((n) + (n) / 255 + 16)
+size_t sim_trace_compress(const uint8_t *src, size_t n, uint8_t *dst);
+size_t sim_trace_decompress(const uint8_t *src, size_t n, uint8_t *dst, size_t capacity);
+
+#endif /* SIM_TRACE_H */
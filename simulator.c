@@ -0,0 +1,1008 @@
+/*
+ * simulator.c - Instruction-set simulator for the ACMC target processor
+ *
+ * Executes the 32-bit images produced by binary_generator.c.
+ *
+ * Key features:
+ * - Each word is predecoded once into a SimInsn (handler + unpacked fields)
+ * - Direct-threaded dispatch with computed goto when the host compiler is
+ *   GCC/Clang, plain switch dispatch otherwise
+ * - Superinstructions fuse the pairs the code generator emits most often
+ *   (lw+lw, lw+move, lw+add, sw+lw, mult/div+mflo, move+outputreg,
+ *   li/lw followed by a compare-and-branch)
+ * - Writes to R0 are redirected at predecode time, so the hot loop never
+ *   has to re-zero it
+ * - A reference interpreter (sim_step) decodes the raw word on every step
+ *   and is used to cross-check the fast path
+ * - SWI rewrites an instruction word; the predecoded slot is decoded again
+ *   and a superinstruction that ended on it is split
+ */
+
+#define _GNU_SOURCE                // strcasestr
+#include "simulator.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+
+#if defined(__GNUC__) && !defined(SIM_NO_THREADED)
+#define SIM_THREADED 1
+#endif
+
+// Handlers that exist only in the predecoded form
+enum {
+    SIM_XOP_END = SIM_OP_COUNT,   // Sentinel past the last instruction
+    SIM_XOP_BAD,                  // Undefined opcode
+    // Superinstructions: first instruction at ip[0], second at ip[1]
+    SIM_XOP_LW_LW,
+    SIM_XOP_LW_MOVE,
+    SIM_XOP_LW_ADD,
+    SIM_XOP_LW_SUB,
+    SIM_XOP_SW_LW,
+    SIM_XOP_ADDI_SW,
+    SIM_XOP_MULT_MFLO,
+    SIM_XOP_DIV_MFLO,
+    SIM_XOP_MOVE_OUTPUTREG,
+    SIM_XOP_LI_BEQ, SIM_XOP_LI_BNE, SIM_XOP_LI_BGT,
+    SIM_XOP_LI_BGTE, SIM_XOP_LI_BLT, SIM_XOP_LI_BLTE,
+    SIM_XOP_LW_BEQ, SIM_XOP_LW_BNE, SIM_XOP_LW_BGT,
+    SIM_XOP_LW_BGTE, SIM_XOP_LW_BLT, SIM_XOP_LW_BLTE,
+    SIM_XOP_COUNT
+};
+
+static const char *opcode_names[SIM_OP_COUNT] = {
+    "add", "sub", "mult", "div", "and", "or", "sll", "srl", "slt",
+    "mfhi", "mflo", "move", "jr", "jalr",
+    "la", "addi", "subi", "andi", "ori",
+    "beq", "bne", "bgt", "bgte", "blt", "blte",
+    "lw", "sw", "li", "j", "jal", "halt",
+    "outputmem", "outputreg", "outputreset", "input", "set", "swi"
+};
+
+const char *sim_opcode_name(int opcode) {
+    if (opcode >= 0 && opcode < SIM_OP_COUNT) return opcode_names[opcode];
+    return "???";
+}
+
+const char *sim_status_name(SimStatus status) {
+    switch (status) {
+        case SIM_RUNNING:       return "running";
+        case SIM_HALTED:        return "halted";
+        case SIM_TRAP_PC:       return "pc out of program";
+        case SIM_TRAP_MEM:      return "data address out of memory";
+        case SIM_TRAP_INPUT:    return "input exhausted";
+        case SIM_TRAP_DIV_ZERO: return "division by zero";
+        case SIM_TRAP_OPCODE:   return "undefined opcode";
+        case SIM_STEP_LIMIT:    return "step limit reached";
+    }
+    return "unknown";
+}
+
+// ============================================================================
+// PROGRAM LOADING AND DECODING
+// ============================================================================
+
+// Stores 'word' at 'address', growing the image; words skipped are zero
+static int store_word(SimProgram *prog, uint32_t *capacity, uint32_t address, uint32_t word, const char *filename) {
+    if (address >= SIM_MAX_PROGRAM_WORDS) {
+        fprintf(stderr, "Error: %s: program larger than %d words\n", filename, SIM_MAX_PROGRAM_WORDS);
+        return -1;
+    }
+    if (address >= *capacity) {
+        uint32_t new_capacity = *capacity ? *capacity : 256;
+        while (new_capacity <= address) new_capacity *= 2;
+        uint32_t *grown = realloc(prog->words, new_capacity * sizeof(uint32_t));
+        if (!grown) return -1;
+        memset(grown + *capacity, 0, (new_capacity - *capacity) * sizeof(uint32_t));
+        prog->words = grown;
+        *capacity = new_capacity;
+    }
+    prog->words[address] = word;
+    if (address >= prog->length) prog->length = address + 1;
+    if (word >> 26 == SIM_OP_SWI) prog->writes_code = 1;
+    return 0;
+}
+
+static int load_bin(SimProgram *prog, FILE *f, const char *filename) {
+    uint32_t capacity = 0;
+    char line[512];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+
+        // Skip comments (.binbd headers) and blank lines
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') continue;
+
+        // Collect the bits, ignoring the field separators of .binbd
+        uint32_t word = 0;
+        int bits = 0;
+        for (; *p && *p != '\n' && *p != '\r'; p++) {
+            if (*p == ' ' || *p == '\t') continue;
+            if (*p != '0' && *p != '1') {
+                bits = -1;
+                break;
+            }
+            word = (word << 1) | (uint32_t)(*p - '0');
+            bits++;
+        }
+        if (bits != 32) {
+            fprintf(stderr, "Error: %s:%d: expected a 32-bit binary word\n", filename, line_number);
+            return -1;
+        }
+        if (store_word(prog, &capacity, prog->length, word, filename) != 0) return -1;
+    }
+    return 0;
+}
+
+static int load_raw(SimProgram *prog, FILE *f, const char *filename) {
+    uint32_t capacity = 0;
+    unsigned char bytes[4];
+    size_t n;
+    while ((n = fread(bytes, 1, 4, f)) == 4) {
+        uint32_t word = (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+        if (store_word(prog, &capacity, prog->length, word, filename) != 0) return -1;
+    }
+    if (n != 0) {
+        fprintf(stderr, "Error: %s: size is not a multiple of 4 bytes\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// Number in a MIF radix (BIN, OCT, DEC, UNS or HEX); returns 0 on success
+static int mif_number(const char *text, int radix, uint32_t *value) {
+    char *end;
+    errno = 0;
+    if (radix == 10 && *text == '-') {
+        long long v = strtoll(text, &end, 10);
+        *value = (uint32_t)v;
+    } else {
+        unsigned long long v = strtoull(text, &end, radix);
+        *value = (uint32_t)v;
+    }
+    return errno == 0 && end != text && *end == '\0' ? 0 : -1;
+}
+
+static int mif_radix(const char *name) {
+    if (strcasecmp(name, "BIN") == 0) return 2;
+    if (strcasecmp(name, "OCT") == 0) return 8;
+    if (strcasecmp(name, "DEC") == 0 || strcasecmp(name, "UNS") == 0) return 10;
+    if (strcasecmp(name, "HEX") == 0) return 16;
+    return 0;
+}
+
+// Quartus .mif: "KEY = VALUE;" settings, then "CONTENT BEGIN", lines of
+// "address : word [word...];" or "[first..last] : word;", and "END;".
+// Comments are "-- to the end of the line" and "% ... %".
+static int load_mif(SimProgram *prog, FILE *f, const char *filename) {
+    // Read the file without comments
+    size_t size = 0, capacity = 4096;
+    char *text = malloc(capacity);
+    int c, in_block = 0;
+    while (text && (c = fgetc(f)) != EOF) {
+        if (c == '%') {
+            in_block = !in_block;
+            continue;
+        }
+        if (in_block) continue;
+        if (c == '-') {
+            int next = fgetc(f);
+            if (next == '-') {
+                while ((c = fgetc(f)) != EOF && c != '\n') {
+                }
+                if (c == EOF) break;
+            } else if (next != EOF) {
+                ungetc(next, f);
+            }
+        }
+        if (size + 2 > capacity) {
+            capacity *= 2;
+            char *grown = realloc(text, capacity);
+            if (!grown) {
+                free(text);
+                text = NULL;
+                break;
+            }
+            text = grown;
+        }
+        text[size++] = (char)c;
+    }
+    if (!text) return -1;
+    text[size] = '\0';
+
+    int width = 0, address_radix = 16, data_radix = 16, in_content = 0, ended = 0;
+    uint32_t capacity_words = 0;
+    int status = 0;
+    char *save;
+    for (char *statement = strtok_r(text, ";", &save); statement && status == 0 && !ended;
+         statement = strtok_r(NULL, ";", &save)) {
+        char key[32], value[32];
+        char *colon = strchr(statement, ':');
+        if (!in_content) {
+            char *begin = strcasestr(statement, "CONTENT");
+            if (begin && strcasestr(begin, "BEGIN")) {
+                // "CONTENT BEGIN" has no ';' before the first entry
+                in_content = 1;
+                statement = strcasestr(begin, "BEGIN") + 5;
+                colon = strchr(statement, ':');
+                if (!colon) continue;
+            } else if (sscanf(statement, " %31[A-Za-z_] = %31s", key, value) == 2) {
+                if (strcasecmp(key, "WIDTH") == 0) width = atoi(value);
+                if (strcasecmp(key, "ADDRESS_RADIX") == 0) address_radix = mif_radix(value);
+                if (strcasecmp(key, "DATA_RADIX") == 0) data_radix = mif_radix(value);
+                continue;
+            } else {
+                continue;
+            }
+        }
+        if (width != 32 || address_radix == 0 || data_radix == 0) {
+            fprintf(stderr, "Error: %s: expected WIDTH=32 and a BIN, OCT, DEC, UNS or HEX radix\n", filename);
+            status = -1;
+            break;
+        }
+        if (!colon) {
+            char word[8];
+            if (sscanf(statement, " %7s", word) == 1 && strcasecmp(word, "END") == 0) ended = 1;
+            continue;
+        }
+
+        // Addresses: "a" or "[a..b]"
+        *colon = '\0';
+        char first_text[32], last_text[32];
+        uint32_t first, last;
+        if (sscanf(statement, " [ %31[0-9A-Fa-f] .. %31[0-9A-Fa-f] ]", first_text, last_text) == 2) {
+            if (mif_number(first_text, address_radix, &first) != 0 || mif_number(last_text, address_radix, &last) != 0) status = -1;
+        } else if (sscanf(statement, " %31s", first_text) == 1) {
+            status = mif_number(first_text, address_radix, &first);
+            last = UINT32_MAX;   // One word per value
+        } else {
+            status = -1;
+        }
+
+        uint32_t address = first;
+        for (char *item = strtok(colon + 1, " \t\r\n"); item && status == 0; item = strtok(NULL, " \t\r\n")) {
+            uint32_t word;
+            if (mif_number(item, data_radix, &word) != 0) {
+                status = -1;
+                break;
+            }
+            if (last == UINT32_MAX) {
+                status = store_word(prog, &capacity_words, address++, word, filename);
+            } else {
+                for (address = first; address <= last && status == 0; address++) {
+                    status = store_word(prog, &capacity_words, address, word, filename);
+                }
+            }
+        }
+        if (status != 0) fprintf(stderr, "Error: %s: bad CONTENT entry\n", filename);
+    }
+    free(text);
+    if (status == 0 && !in_content) {
+        fprintf(stderr, "Error: %s: no CONTENT BEGIN\n", filename);
+        status = -1;
+    }
+    return status;
+}
+
+// Data image next to the program: <name>.data.mif (see data_image.h)
+static int load_data_image(SimProgram *prog, const char *filename) {
+    char path[1024];
+    const char *slash = strrchr(filename, '/');
+    const char *dot = strrchr(filename, '.');
+    size_t stem = dot && (!slash || dot > slash) ? (size_t)(dot - filename) : strlen(filename);
+    if (stem + sizeof(".data.mif") > sizeof(path)) return 0;
+    memcpy(path, filename, stem);
+    strcpy(path + stem, ".data.mif");
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    SimProgram image;
+    memset(&image, 0, sizeof(image));
+    int status = load_mif(&image, f, path);
+    fclose(f);
+    if (status != 0) {
+        free(image.words);
+        return status;
+    }
+    while (image.length > 0 && image.words[image.length - 1] == 0) image.length--;
+    prog->data = (int32_t *)image.words;
+    prog->data_length = image.length;
+    return 0;
+}
+
+int sim_load_program(SimProgram *prog, const char *filename) {
+    memset(prog, 0, sizeof(*prog));
+
+    const char *extension = strrchr(filename, '.');
+    int raw = extension && strcmp(extension, ".raw") == 0;
+    int mif = extension && strcmp(extension, ".mif") == 0;
+    FILE *f = fopen(filename, raw ? "rb" : "r");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open program image %s\n", filename);
+        return -1;
+    }
+
+    int status = raw ? load_raw(prog, f, filename) : mif ? load_mif(prog, f, filename) : load_bin(prog, f, filename);
+    fclose(f);
+    if (status == 0) status = load_data_image(prog, filename);
+    if (status != 0) sim_free_program(prog);
+    return status;
+}
+
+static int32_t sign_extend14(uint32_t value) {
+    return (int32_t)(value << 18) >> 18;
+}
+
+// Unpacks one word. Field layout (see binary_generator.c):
+//   R-type: [31:26] OPCODE | [25:20] RS | [19:14] RT | [13:8] RD | [7:0] SHAMT
+//   I-type: [31:26] OPCODE | [25:20] RS | [19:14] RT | [13:0] IMMEDIATE/ADDRESS
+//   J-type: [31:26] OPCODE | [25:0] ADDRESS
+void sim_decode(uint32_t word, SimInsn *insn) {
+    uint32_t opcode = word >> 26;
+
+    insn->handler = NULL;
+    insn->op = opcode < SIM_OP_COUNT ? (uint16_t)opcode : SIM_XOP_BAD;
+    insn->rs = (word >> 20) & 0x3F;
+    insn->rt = (word >> 14) & 0x3F;
+    insn->rd = (word >> 8) & 0x3F;
+    insn->imm = 0;
+
+    switch (opcode) {
+        case SIM_OP_SLL: case SIM_OP_SRL:
+            insn->imm = word & 0xFF;
+            break;
+        case SIM_OP_LA: case SIM_OP_ANDI: case SIM_OP_ORI: case SIM_OP_OUTPUTMEM:
+        case SIM_OP_BEQ: case SIM_OP_BNE: case SIM_OP_BGT:
+        case SIM_OP_BGTE: case SIM_OP_BLT: case SIM_OP_BLTE:
+            insn->imm = word & 0x3FFF;
+            break;
+        case SIM_OP_ADDI: case SIM_OP_SUBI: case SIM_OP_LW: case SIM_OP_SW: case SIM_OP_LI:
+        case SIM_OP_SWI:
+            insn->imm = sign_extend14(word & 0x3FFF);
+            break;
+        case SIM_OP_J: case SIM_OP_JAL:
+            insn->imm = word & 0x3FFFFFF;
+            break;
+        default:
+            break;
+    }
+
+    // R0 is hard-wired to zero: send its writes to a scratch register
+    switch (opcode) {
+        case SIM_OP_ADD: case SIM_OP_SUB: case SIM_OP_AND: case SIM_OP_OR:
+        case SIM_OP_SLL: case SIM_OP_SRL: case SIM_OP_SLT: case SIM_OP_MFHI:
+        case SIM_OP_MFLO: case SIM_OP_MOVE: case SIM_OP_INPUT: case SIM_OP_SET:
+            if (insn->rd == 0) insn->rd = SIM_REG_SINK;
+            break;
+        case SIM_OP_LA: case SIM_OP_ADDI: case SIM_OP_SUBI: case SIM_OP_ANDI:
+        case SIM_OP_ORI: case SIM_OP_LW: case SIM_OP_LI:
+            if (insn->rt == 0) insn->rt = SIM_REG_SINK;
+            break;
+        default:
+            break;
+    }
+}
+
+static int is_branch(int op) {
+    return op >= SIM_OP_BEQ && op <= SIM_OP_BLTE;
+}
+
+// Returns the superinstruction for the pair (a, b), or -1
+static int fuse_pair(const SimInsn *a, const SimInsn *b) {
+    switch (a->op) {
+        case SIM_OP_LW:
+            if (b->op == SIM_OP_LW) return SIM_XOP_LW_LW;
+            if (b->op == SIM_OP_MOVE) return SIM_XOP_LW_MOVE;
+            if (b->op == SIM_OP_ADD) return SIM_XOP_LW_ADD;
+            if (b->op == SIM_OP_SUB) return SIM_XOP_LW_SUB;
+            if (is_branch(b->op)) return SIM_XOP_LW_BEQ + (b->op - SIM_OP_BEQ);
+            break;
+        case SIM_OP_LI:
+            if (is_branch(b->op)) return SIM_XOP_LI_BEQ + (b->op - SIM_OP_BEQ);
+            break;
+        case SIM_OP_SW:
+            if (b->op == SIM_OP_LW) return SIM_XOP_SW_LW;
+            break;
+        case SIM_OP_ADDI:
+            if (b->op == SIM_OP_SW) return SIM_XOP_ADDI_SW;
+            break;
+        case SIM_OP_MULT:
+            if (b->op == SIM_OP_MFLO) return SIM_XOP_MULT_MFLO;
+            break;
+        case SIM_OP_DIV:
+            if (b->op == SIM_OP_MFLO) return SIM_XOP_DIV_MFLO;
+            break;
+        case SIM_OP_MOVE:
+            if (b->op == SIM_OP_OUTPUTREG) return SIM_XOP_MOVE_OUTPUTREG;
+            break;
+        default:
+            break;
+    }
+    return -1;
+}
+
+static SimStatus sim_exec(SimMachine *m, const SimProgram *prog, const void *const **table);
+
+void sim_predecode(SimProgram *prog, int fuse) {
+    free(prog->code);
+    prog->fused = 0;
+    prog->code = calloc(prog->length + 1, sizeof(SimInsn));
+    if (!prog->code) return;
+
+    for (uint32_t i = 0; i < prog->length; i++) {
+        SimInsn *insn = &prog->code[i];
+        sim_decode(prog->words[i], insn);
+        // Static targets outside the image land on the end sentinel
+        if ((is_branch(insn->op) || insn->op == SIM_OP_J || insn->op == SIM_OP_JAL) &&
+            (uint32_t)insn->imm > prog->length) {
+            insn->imm = (int32_t)prog->length;
+        }
+    }
+    prog->code[prog->length].op = SIM_XOP_END;
+
+    if (fuse) {
+        for (uint32_t i = 0; i + 1 < prog->length; i++) {
+            int fused = fuse_pair(&prog->code[i], &prog->code[i + 1]);
+            if (fused >= 0) {
+                prog->code[i].op = (uint16_t)fused;
+                prog->fused++;
+            }
+        }
+    }
+
+#ifdef SIM_THREADED
+    const void *const *table;
+    sim_exec(NULL, NULL, &table);
+    for (uint32_t i = 0; i <= prog->length; i++) {
+        prog->code[i].handler = table[prog->code[i].op];
+    }
+#endif
+}
+
+void sim_free_program(SimProgram *prog) {
+    free(prog->words);
+    free(prog->code);
+    free(prog->data);
+    prog->words = NULL;
+    prog->code = NULL;
+    prog->data = NULL;
+    prog->length = 0;
+    prog->data_length = 0;
+}
+
+int sim_copy_program(SimProgram *copy, const SimProgram *prog) {
+    memset(copy, 0, sizeof(*copy));
+    copy->words = malloc((prog->length ? prog->length : 1) * sizeof(uint32_t));
+    if (!copy->words) return -1;
+    memcpy(copy->words, prog->words, prog->length * sizeof(uint32_t));
+    copy->length = prog->length;
+    copy->writes_code = prog->writes_code;
+    if (prog->data) {
+        copy->data = malloc(prog->data_length * sizeof(int32_t) + 1);
+        if (!copy->data) return -1;
+        memcpy(copy->data, prog->data, prog->data_length * sizeof(int32_t));
+        copy->data_length = prog->data_length;
+    }
+    return 0;
+}
+
+// SWI: replaces the word at 'addr' (checked by the caller). The program is
+// const for the interpreters, but its arrays are the instruction memory.
+static void store_code(const SimProgram *prog, uint32_t addr, int32_t value) {
+    prog->words[addr] = (uint32_t)value;
+    if (!prog->code) return;
+
+#ifdef SIM_THREADED
+    const void *const *table;
+    sim_exec(NULL, NULL, &table);
+#endif
+    // The previous slot is decoded too, in case it fused with this one
+    for (uint32_t i = addr ? addr - 1 : 0; i <= addr; i++) {
+        SimInsn *insn = &prog->code[i];
+        sim_decode(prog->words[i], insn);
+        if ((is_branch(insn->op) || insn->op == SIM_OP_J || insn->op == SIM_OP_JAL) &&
+            (uint32_t)insn->imm > prog->length) {
+            insn->imm = (int32_t)prog->length;
+        }
+#ifdef SIM_THREADED
+        insn->handler = table[insn->op];
+#endif
+    }
+}
+
+// ============================================================================
+// MACHINE STATE AND I/O
+// ============================================================================
+
+int sim_read_input_file(const char *filename, int32_t **values, uint32_t *count) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open input file %s\n", filename);
+        return -1;
+    }
+    uint32_t capacity = 64;
+    *values = malloc(capacity * sizeof(int32_t));
+    *count = 0;
+    long value;
+    while (*values && fscanf(f, "%ld", &value) == 1) {
+        if (*count == capacity) {
+            capacity *= 2;
+            int32_t *grown = realloc(*values, capacity * sizeof(int32_t));
+            if (!grown) {
+                free(*values);
+                *values = NULL;
+                break;
+            }
+            *values = grown;
+        }
+        (*values)[(*count)++] = (int32_t)value;
+    }
+    fclose(f);
+    return *values ? 0 : -1;
+}
+
+int sim_machine_init(SimMachine *m, uint32_t mem_words) {
+    memset(m, 0, sizeof(*m));
+    m->mem_words = mem_words ? mem_words : SIM_DEFAULT_MEM_WORDS;
+    m->mem = calloc(m->mem_words, sizeof(int32_t));
+    if (!m->mem) {
+        fprintf(stderr, "Error: Cannot allocate %u words of data memory\n", m->mem_words);
+        return -1;
+    }
+    return 0;
+}
+
+void sim_machine_load_data(SimMachine *m, const SimProgram *prog) {
+    uint32_t words = prog->data_length < m->mem_words ? prog->data_length : m->mem_words;
+    if (words) memcpy(m->mem, prog->data, words * sizeof(int32_t));
+}
+
+// Clears registers, memory and output; keeps the input stream and limits
+void sim_machine_reset(SimMachine *m) {
+    memset(m->regs, 0, sizeof(m->regs));
+    memset(m->mem, 0, m->mem_words * sizeof(int32_t));
+    m->pc = 0;
+    m->input_pos = 0;
+    m->output_count = 0;
+    m->icount = 0;
+    m->status = SIM_RUNNING;
+}
+
+void sim_machine_free(SimMachine *m) {
+    if (m->mem_mapped) {
+        munmap(m->mem, m->mem_mapped);
+    } else {
+        free(m->mem);
+    }
+    m->mem_mapped = 0;
+    free(m->output);
+    m->mem = NULL;
+    m->output = NULL;
+}
+
+static void push_output(SimMachine *m, int32_t value) {
+    if (m->output_count == m->output_capacity) {
+        uint32_t capacity = m->output_capacity ? m->output_capacity * 2 : 64;
+        int32_t *grown = realloc(m->output, capacity * sizeof(int32_t));
+        if (!grown) return;
+        m->output = grown;
+        m->output_capacity = capacity;
+    }
+    m->output[m->output_count++] = value;
+}
+
+// Wrapping 32-bit arithmetic without signed-overflow UB
+#define WRAP_ADD(a, b) ((int32_t)((uint32_t)(a) + (uint32_t)(b)))
+#define WRAP_SUB(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)))
+
+// ============================================================================
+// REFERENCE INTERPRETER
+// ============================================================================
+
+SimStatus sim_step(SimMachine *m, const SimProgram *prog) {
+    if (m->status != SIM_RUNNING) return m->status;
+    if (m->pc >= prog->length) return m->status = SIM_TRAP_PC;
+
+    SimInsn in;
+    sim_decode(prog->words[m->pc], &in);
+    int32_t *R = m->regs;
+    uint32_t next = m->pc + 1;
+    uint32_t addr;
+
+    switch (in.op) {
+        case SIM_OP_ADD:  R[in.rd] = WRAP_ADD(R[in.rs], R[in.rt]); break;
+        case SIM_OP_SUB:  R[in.rd] = WRAP_SUB(R[in.rs], R[in.rt]); break;
+        case SIM_OP_MULT: {
+            int64_t product = (int64_t)R[in.rs] * R[in.rt];
+            R[SIM_REG_LO] = (int32_t)product;
+            R[SIM_REG_HI] = (int32_t)(product >> 32);
+            break;
+        }
+        case SIM_OP_DIV:
+            if (R[in.rt] == 0) return m->status = SIM_TRAP_DIV_ZERO;
+            if (R[in.rt] == -1) {
+                R[SIM_REG_LO] = WRAP_SUB(0, R[in.rs]);
+                R[SIM_REG_HI] = 0;
+            } else {
+                R[SIM_REG_LO] = R[in.rs] / R[in.rt];
+                R[SIM_REG_HI] = R[in.rs] % R[in.rt];
+            }
+            break;
+        case SIM_OP_AND:  R[in.rd] = R[in.rs] & R[in.rt]; break;
+        case SIM_OP_OR:   R[in.rd] = R[in.rs] | R[in.rt]; break;
+        case SIM_OP_SLL:  R[in.rd] = (int32_t)((uint32_t)R[in.rs] << (in.imm & 31)); break;
+        case SIM_OP_SRL:  R[in.rd] = (int32_t)((uint32_t)R[in.rs] >> (in.imm & 31)); break;
+        case SIM_OP_SLT:  R[in.rd] = R[in.rs] < R[in.rt]; break;
+        case SIM_OP_MFHI: R[in.rd] = R[SIM_REG_HI]; break;
+        case SIM_OP_MFLO: R[in.rd] = R[SIM_REG_LO]; break;
+        case SIM_OP_MOVE: R[in.rd] = R[in.rs]; break;
+        case SIM_OP_JR:   next = (uint32_t)R[in.rs]; break;
+        case SIM_OP_JALR:
+            next = (uint32_t)R[in.rs];
+            R[SIM_REG_RA] = (int32_t)(m->pc + 1);
+            break;
+        case SIM_OP_LA:   R[in.rt] = in.imm; break;
+        case SIM_OP_ADDI: R[in.rt] = WRAP_ADD(R[in.rs], in.imm); break;
+        case SIM_OP_SUBI: R[in.rt] = WRAP_SUB(R[in.rs], in.imm); break;
+        case SIM_OP_ANDI: R[in.rt] = R[in.rs] & in.imm; break;
+        case SIM_OP_ORI:  R[in.rt] = R[in.rs] | in.imm; break;
+        case SIM_OP_BEQ:  if (R[in.rs] == R[in.rt]) next = (uint32_t)in.imm; break;
+        case SIM_OP_BNE:  if (R[in.rs] != R[in.rt]) next = (uint32_t)in.imm; break;
+        case SIM_OP_BGT:  if (R[in.rs] > R[in.rt]) next = (uint32_t)in.imm; break;
+        case SIM_OP_BGTE: if (R[in.rs] >= R[in.rt]) next = (uint32_t)in.imm; break;
+        case SIM_OP_BLT:  if (R[in.rs] < R[in.rt]) next = (uint32_t)in.imm; break;
+        case SIM_OP_BLTE: if (R[in.rs] <= R[in.rt]) next = (uint32_t)in.imm; break;
+        case SIM_OP_LW:
+            addr = (uint32_t)WRAP_ADD(R[in.rs], in.imm);
+            if (addr >= m->mem_words) return m->status = SIM_TRAP_MEM;
+            R[in.rt] = m->mem[addr];
+            break;
+        case SIM_OP_SW:
+            addr = (uint32_t)WRAP_ADD(R[in.rs], in.imm);
+            if (addr >= m->mem_words) return m->status = SIM_TRAP_MEM;
+            m->mem[addr] = R[in.rt];
+            break;
+        case SIM_OP_LI:   R[in.rt] = in.imm; break;
+        case SIM_OP_J:    next = (uint32_t)in.imm; break;
+        case SIM_OP_JAL:
+            R[SIM_REG_RA] = (int32_t)(m->pc + 1);
+            next = (uint32_t)in.imm;
+            break;
+        case SIM_OP_HALT:
+            m->icount++;
+            return m->status = SIM_HALTED;
+        case SIM_OP_OUTPUTMEM:
+            addr = (uint32_t)WRAP_ADD(R[in.rs], in.imm);
+            if (addr >= m->mem_words) return m->status = SIM_TRAP_MEM;
+            push_output(m, m->mem[addr]);
+            break;
+        case SIM_OP_OUTPUTREG: push_output(m, R[in.rs]); break;
+        case SIM_OP_OUTPUTRESET: break;   // Clears the board display only
+        case SIM_OP_INPUT:
+            if (m->input_pos >= m->input_count) return m->status = SIM_TRAP_INPUT;
+            R[in.rd] = m->input[m->input_pos++];
+            break;
+        case SIM_OP_SET:  R[in.rd] = R[in.rs] == R[in.rt]; break;
+        case SIM_OP_SWI:
+            addr = (uint32_t)WRAP_ADD(R[in.rs], in.imm);
+            if (addr >= prog->length) return m->status = SIM_TRAP_MEM;
+            store_code(prog, addr, R[in.rt]);
+            break;
+        default:
+            return m->status = SIM_TRAP_OPCODE;
+    }
+
+    m->icount++;
+    m->pc = next;
+    if (m->max_steps && m->icount >= m->max_steps) m->status = SIM_STEP_LIMIT;
+    return m->status;
+}
+
+SimStatus sim_run_reference(SimMachine *m, const SimProgram *prog) {
+    while (sim_step(m, prog) == SIM_RUNNING) {
+    }
+    return m->status;
+}
+
+// ============================================================================
+// THREADED INTERPRETER
+// ============================================================================
+
+// Semantics shared by plain handlers and superinstructions
+#define DO_ADD(i)   R[(i)->rd] = WRAP_ADD(R[(i)->rs], R[(i)->rt])
+#define DO_SUB(i)   R[(i)->rd] = WRAP_SUB(R[(i)->rs], R[(i)->rt])
+#define DO_MOVE(i)  R[(i)->rd] = R[(i)->rs]
+#define DO_MFLO(i)  R[(i)->rd] = R[SIM_REG_LO]
+#define DO_LI(i)    R[(i)->rt] = (i)->imm
+#define DO_ADDI(i)  R[(i)->rt] = WRAP_ADD(R[(i)->rs], (i)->imm)
+#define DO_MULT(i) do { \
+        int64_t product_ = (int64_t)R[(i)->rs] * R[(i)->rt]; \
+        R[SIM_REG_LO] = (int32_t)product_; \
+        R[SIM_REG_HI] = (int32_t)(product_ >> 32); \
+    } while (0)
+#define DO_DIV(i) do { \
+        int32_t divisor_ = R[(i)->rt]; \
+        if (divisor_ == 0) { fault = (i); goto trap_div; } \
+        if (divisor_ == -1) { \
+            R[SIM_REG_LO] = WRAP_SUB(0, R[(i)->rs]); \
+            R[SIM_REG_HI] = 0; \
+        } else { \
+            R[SIM_REG_LO] = R[(i)->rs] / divisor_; \
+            R[SIM_REG_HI] = R[(i)->rs] % divisor_; \
+        } \
+    } while (0)
+#define DO_LW(i) do { \
+        uint32_t addr_ = (uint32_t)WRAP_ADD(R[(i)->rs], (i)->imm); \
+        if (addr_ >= mem_words) { fault = (i); goto trap_mem; } \
+        R[(i)->rt] = mem[addr_]; \
+    } while (0)
+#define DO_SW(i) do { \
+        uint32_t addr_ = (uint32_t)WRAP_ADD(R[(i)->rs], (i)->imm); \
+        if (addr_ >= mem_words) { fault = (i); goto trap_mem; } \
+        mem[addr_] = R[(i)->rt]; \
+    } while (0)
+
+#ifdef SIM_THREADED
+#define HANDLER(op) op##_h:
+#define DISPATCH() goto *ip->handler
+#else
+#define HANDLER(op) case op:
+#define DISPATCH() goto dispatch
+#endif
+
+// Control transfer; the step limit is only checked here, since any
+// non-terminating program has to pass through a jump or branch
+#define JUMP(target) do { \
+        ip = code + (target); \
+        if (n >= limit) goto step_limit; \
+        DISPATCH(); \
+    } while (0)
+
+#define BRANCH_HANDLER(op, cmp) \
+    HANDLER(SIM_OP_##op) \
+        n++; \
+        if (R[ip->rs] cmp R[ip->rt]) JUMP(ip->imm); \
+        ip++; \
+        DISPATCH();
+
+#define FUSED_BRANCH_HANDLER(first, DO_FIRST, op, cmp) \
+    HANDLER(SIM_XOP_##first##_##op) \
+        n++; \
+        DO_FIRST(ip); \
+        n++; \
+        if (R[ip[1].rs] cmp R[ip[1].rt]) JUMP(ip[1].imm); \
+        ip += 2; \
+        DISPATCH();
+
+#define FUSED_HANDLER(name, DO_FIRST, DO_SECOND) \
+    HANDLER(name) \
+        n++; \
+        DO_FIRST(ip); \
+        n++; \
+        DO_SECOND(ip + 1); \
+        ip += 2; \
+        DISPATCH();
+
+// With table != NULL only publishes the handler addresses for sim_predecode()
+static SimStatus sim_exec(SimMachine *m, const SimProgram *prog, const void *const **table) {
+#ifdef SIM_THREADED
+    static const void *const handlers[SIM_XOP_COUNT] = {
+        [SIM_OP_ADD] = &&SIM_OP_ADD_h, [SIM_OP_SUB] = &&SIM_OP_SUB_h,
+        [SIM_OP_MULT] = &&SIM_OP_MULT_h, [SIM_OP_DIV] = &&SIM_OP_DIV_h,
+        [SIM_OP_AND] = &&SIM_OP_AND_h, [SIM_OP_OR] = &&SIM_OP_OR_h,
+        [SIM_OP_SLL] = &&SIM_OP_SLL_h, [SIM_OP_SRL] = &&SIM_OP_SRL_h,
+        [SIM_OP_SLT] = &&SIM_OP_SLT_h, [SIM_OP_MFHI] = &&SIM_OP_MFHI_h,
+        [SIM_OP_MFLO] = &&SIM_OP_MFLO_h, [SIM_OP_MOVE] = &&SIM_OP_MOVE_h,
+        [SIM_OP_JR] = &&SIM_OP_JR_h, [SIM_OP_JALR] = &&SIM_OP_JALR_h,
+        [SIM_OP_LA] = &&SIM_OP_LA_h, [SIM_OP_ADDI] = &&SIM_OP_ADDI_h,
+        [SIM_OP_SUBI] = &&SIM_OP_SUBI_h, [SIM_OP_ANDI] = &&SIM_OP_ANDI_h,
+        [SIM_OP_ORI] = &&SIM_OP_ORI_h,
+        [SIM_OP_BEQ] = &&SIM_OP_BEQ_h, [SIM_OP_BNE] = &&SIM_OP_BNE_h,
+        [SIM_OP_BGT] = &&SIM_OP_BGT_h, [SIM_OP_BGTE] = &&SIM_OP_BGTE_h,
+        [SIM_OP_BLT] = &&SIM_OP_BLT_h, [SIM_OP_BLTE] = &&SIM_OP_BLTE_h,
+        [SIM_OP_LW] = &&SIM_OP_LW_h, [SIM_OP_SW] = &&SIM_OP_SW_h,
+        [SIM_OP_LI] = &&SIM_OP_LI_h, [SIM_OP_J] = &&SIM_OP_J_h,
+        [SIM_OP_JAL] = &&SIM_OP_JAL_h, [SIM_OP_HALT] = &&SIM_OP_HALT_h,
+        [SIM_OP_OUTPUTMEM] = &&SIM_OP_OUTPUTMEM_h, [SIM_OP_OUTPUTREG] = &&SIM_OP_OUTPUTREG_h,
+        [SIM_OP_OUTPUTRESET] = &&SIM_OP_OUTPUTRESET_h, [SIM_OP_INPUT] = &&SIM_OP_INPUT_h,
+        [SIM_OP_SET] = &&SIM_OP_SET_h, [SIM_OP_SWI] = &&SIM_OP_SWI_h,
+        [SIM_XOP_END] = &&SIM_XOP_END_h, [SIM_XOP_BAD] = &&SIM_XOP_BAD_h,
+        [SIM_XOP_LW_LW] = &&SIM_XOP_LW_LW_h, [SIM_XOP_LW_MOVE] = &&SIM_XOP_LW_MOVE_h,
+        [SIM_XOP_LW_ADD] = &&SIM_XOP_LW_ADD_h, [SIM_XOP_LW_SUB] = &&SIM_XOP_LW_SUB_h,
+        [SIM_XOP_SW_LW] = &&SIM_XOP_SW_LW_h, [SIM_XOP_ADDI_SW] = &&SIM_XOP_ADDI_SW_h,
+        [SIM_XOP_MULT_MFLO] = &&SIM_XOP_MULT_MFLO_h, [SIM_XOP_DIV_MFLO] = &&SIM_XOP_DIV_MFLO_h,
+        [SIM_XOP_MOVE_OUTPUTREG] = &&SIM_XOP_MOVE_OUTPUTREG_h,
+        [SIM_XOP_LI_BEQ] = &&SIM_XOP_LI_BEQ_h, [SIM_XOP_LI_BNE] = &&SIM_XOP_LI_BNE_h,
+        [SIM_XOP_LI_BGT] = &&SIM_XOP_LI_BGT_h, [SIM_XOP_LI_BGTE] = &&SIM_XOP_LI_BGTE_h,
+        [SIM_XOP_LI_BLT] = &&SIM_XOP_LI_BLT_h, [SIM_XOP_LI_BLTE] = &&SIM_XOP_LI_BLTE_h,
+        [SIM_XOP_LW_BEQ] = &&SIM_XOP_LW_BEQ_h, [SIM_XOP_LW_BNE] = &&SIM_XOP_LW_BNE_h,
+        [SIM_XOP_LW_BGT] = &&SIM_XOP_LW_BGT_h, [SIM_XOP_LW_BGTE] = &&SIM_XOP_LW_BGTE_h,
+        [SIM_XOP_LW_BLT] = &&SIM_XOP_LW_BLT_h, [SIM_XOP_LW_BLTE] = &&SIM_XOP_LW_BLTE_h,
+    };
+    if (table) {
+        *table = handlers;
+        return SIM_RUNNING;
+    }
+#else
+    if (table) {
+        *table = NULL;
+        return SIM_RUNNING;
+    }
+#endif
+
+    if (m->status != SIM_RUNNING) return m->status;
+    if (m->pc >= prog->length) return m->status = SIM_TRAP_PC;
+
+    // Hot state lives in locals for the duration of the run
+    int32_t *R = m->regs;
+    int32_t *mem = m->mem;
+    const uint32_t mem_words = m->mem_words;
+    const uint32_t length = prog->length;
+    const SimInsn *code = prog->code;
+    const SimInsn *ip = code + m->pc;
+    const SimInsn *fault = NULL;
+    uint64_t n = m->icount;
+    const uint64_t limit = m->max_steps ? m->max_steps : UINT64_MAX;
+    uint32_t target;
+
+#ifdef SIM_THREADED
+    DISPATCH();
+#else
+dispatch:
+    switch (ip->op) {
+#endif
+
+    HANDLER(SIM_OP_ADD)  n++; DO_ADD(ip); ip++; DISPATCH();
+    HANDLER(SIM_OP_SUB)  n++; DO_SUB(ip); ip++; DISPATCH();
+    HANDLER(SIM_OP_MULT) n++; DO_MULT(ip); ip++; DISPATCH();
+    HANDLER(SIM_OP_DIV)  n++; DO_DIV(ip); ip++; DISPATCH();
+    HANDLER(SIM_OP_AND)  n++; R[ip->rd] = R[ip->rs] & R[ip->rt]; ip++; DISPATCH();
+    HANDLER(SIM_OP_OR)   n++; R[ip->rd] = R[ip->rs] | R[ip->rt]; ip++; DISPATCH();
+    HANDLER(SIM_OP_SLL)  n++; R[ip->rd] = (int32_t)((uint32_t)R[ip->rs] << (ip->imm & 31)); ip++; DISPATCH();
+    HANDLER(SIM_OP_SRL)  n++; R[ip->rd] = (int32_t)((uint32_t)R[ip->rs] >> (ip->imm & 31)); ip++; DISPATCH();
+    HANDLER(SIM_OP_SLT)  n++; R[ip->rd] = R[ip->rs] < R[ip->rt]; ip++; DISPATCH();
+    HANDLER(SIM_OP_MFHI) n++; R[ip->rd] = R[SIM_REG_HI]; ip++; DISPATCH();
+    HANDLER(SIM_OP_MFLO) n++; DO_MFLO(ip); ip++; DISPATCH();
+    HANDLER(SIM_OP_MOVE) n++; DO_MOVE(ip); ip++; DISPATCH();
+    HANDLER(SIM_OP_JR)
+        n++;
+        target = (uint32_t)R[ip->rs];
+        if (target >= length) goto trap_jump;
+        JUMP(target);
+    HANDLER(SIM_OP_JALR)
+        n++;
+        target = (uint32_t)R[ip->rs];
+        R[SIM_REG_RA] = (int32_t)(ip - code + 1);
+        if (target >= length) goto trap_jump;
+        JUMP(target);
+    HANDLER(SIM_OP_LA)   n++; R[ip->rt] = ip->imm; ip++; DISPATCH();
+    HANDLER(SIM_OP_ADDI) n++; DO_ADDI(ip); ip++; DISPATCH();
+    HANDLER(SIM_OP_SUBI) n++; R[ip->rt] = WRAP_SUB(R[ip->rs], ip->imm); ip++; DISPATCH();
+    HANDLER(SIM_OP_ANDI) n++; R[ip->rt] = R[ip->rs] & ip->imm; ip++; DISPATCH();
+    HANDLER(SIM_OP_ORI)  n++; R[ip->rt] = R[ip->rs] | ip->imm; ip++; DISPATCH();
+    BRANCH_HANDLER(BEQ, ==)
+    BRANCH_HANDLER(BNE, !=)
+    BRANCH_HANDLER(BGT, >)
+    BRANCH_HANDLER(BGTE, >=)
+    BRANCH_HANDLER(BLT, <)
+    BRANCH_HANDLER(BLTE, <=)
+    HANDLER(SIM_OP_LW)   n++; DO_LW(ip); ip++; DISPATCH();
+    HANDLER(SIM_OP_SW)   n++; DO_SW(ip); ip++; DISPATCH();
+    HANDLER(SIM_OP_LI)   n++; DO_LI(ip); ip++; DISPATCH();
+    HANDLER(SIM_OP_J)    n++; JUMP(ip->imm);
+    HANDLER(SIM_OP_JAL)
+        n++;
+        R[SIM_REG_RA] = (int32_t)(ip - code + 1);
+        JUMP(ip->imm);
+    HANDLER(SIM_OP_HALT)
+        n++;
+        m->status = SIM_HALTED;
+        goto done;
+    HANDLER(SIM_OP_OUTPUTMEM) {
+        n++;
+        uint32_t addr = (uint32_t)WRAP_ADD(R[ip->rs], ip->imm);
+        if (addr >= mem_words) {
+            fault = ip;
+            goto trap_mem;
+        }
+        push_output(m, mem[addr]);
+        ip++;
+        DISPATCH();
+    }
+    HANDLER(SIM_OP_OUTPUTREG) n++; push_output(m, R[ip->rs]); ip++; DISPATCH();
+    HANDLER(SIM_OP_OUTPUTRESET) n++; ip++; DISPATCH();
+    HANDLER(SIM_OP_INPUT)
+        n++;
+        if (m->input_pos >= m->input_count) {
+            n--;
+            m->status = SIM_TRAP_INPUT;
+            goto done;
+        }
+        R[ip->rd] = m->input[m->input_pos++];
+        ip++;
+        DISPATCH();
+    HANDLER(SIM_OP_SET) n++; R[ip->rd] = R[ip->rs] == R[ip->rt]; ip++; DISPATCH();
+    HANDLER(SIM_OP_SWI) {
+        n++;
+        uint32_t addr = (uint32_t)WRAP_ADD(R[ip->rs], ip->imm);
+        if (addr >= length) {
+            fault = ip;
+            goto trap_mem;
+        }
+        store_code(prog, addr, R[ip->rt]);
+        ip++;
+        DISPATCH();
+    }
+
+    // Superinstructions
+    FUSED_HANDLER(SIM_XOP_LW_LW, DO_LW, DO_LW)
+    FUSED_HANDLER(SIM_XOP_LW_MOVE, DO_LW, DO_MOVE)
+    FUSED_HANDLER(SIM_XOP_LW_ADD, DO_LW, DO_ADD)
+    FUSED_HANDLER(SIM_XOP_LW_SUB, DO_LW, DO_SUB)
+    FUSED_HANDLER(SIM_XOP_SW_LW, DO_SW, DO_LW)
+    FUSED_HANDLER(SIM_XOP_ADDI_SW, DO_ADDI, DO_SW)
+    FUSED_HANDLER(SIM_XOP_MULT_MFLO, DO_MULT, DO_MFLO)
+    FUSED_HANDLER(SIM_XOP_DIV_MFLO, DO_DIV, DO_MFLO)
+    HANDLER(SIM_XOP_MOVE_OUTPUTREG)
+        n += 2;
+        DO_MOVE(ip);
+        push_output(m, R[ip[1].rs]);
+        ip += 2;
+        DISPATCH();
+    FUSED_BRANCH_HANDLER(LI, DO_LI, BEQ, ==)
+    FUSED_BRANCH_HANDLER(LI, DO_LI, BNE, !=)
+    FUSED_BRANCH_HANDLER(LI, DO_LI, BGT, >)
+    FUSED_BRANCH_HANDLER(LI, DO_LI, BGTE, >=)
+    FUSED_BRANCH_HANDLER(LI, DO_LI, BLT, <)
+    FUSED_BRANCH_HANDLER(LI, DO_LI, BLTE, <=)
+    FUSED_BRANCH_HANDLER(LW, DO_LW, BEQ, ==)
+    FUSED_BRANCH_HANDLER(LW, DO_LW, BNE, !=)
+    FUSED_BRANCH_HANDLER(LW, DO_LW, BGT, >)
+    FUSED_BRANCH_HANDLER(LW, DO_LW, BGTE, >=)
+    FUSED_BRANCH_HANDLER(LW, DO_LW, BLT, <)
+    FUSED_BRANCH_HANDLER(LW, DO_LW, BLTE, <=)
+
+    HANDLER(SIM_XOP_END)
+        m->status = SIM_TRAP_PC;
+        goto done;
+    HANDLER(SIM_XOP_BAD)
+        m->status = SIM_TRAP_OPCODE;
+        goto done;
+
+#ifndef SIM_THREADED
+    default:
+        m->status = SIM_TRAP_OPCODE;
+        goto done;
+    }
+#endif
+
+trap_mem:
+    n--;
+    ip = fault;
+    m->status = SIM_TRAP_MEM;
+    goto done;
+trap_div:
+    n--;
+    ip = fault;
+    m->status = SIM_TRAP_DIV_ZERO;
+    goto done;
+trap_jump:
+    m->status = SIM_TRAP_PC;
+    m->icount = n;
+    m->pc = target;
+    return m->status;
+step_limit:
+    m->status = SIM_STEP_LIMIT;
+done:
+    m->icount = n;
+    m->pc = (uint32_t)(ip - code);
+    return m->status;
+}
+
+SimStatus sim_run(SimMachine *m, const SimProgram *prog) {
+    if (!prog->code) return m->status = SIM_TRAP_PC;
+    return sim_exec(m, prog, NULL);
+}
@@ -0,0 +1,137 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+/**
+ * simulator.h - Instruction-set simulator for the ACMC target processor
+ *
+ * Loads the .bin images written by binary_generator.c and executes them
+ * on a software model of the custom MIPS processor (64 registers,
+ * word-addressed data memory, HI/LO in R63/R62, input/output ports).
+ *
+ * Every 32-bit word is predecoded once into a SimInsn holding the
+ * handler address and the unpacked register/immediate fields, so the
+ * hot loop never touches the raw encoding again. SWI stores into the
+ * instruction memory (the resident bootloader of acmc --bootloader) and
+ * updates both forms of the word it replaces.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SIM_NUM_REGS 64
+#define SIM_REG_RA 31            // Return address (JAL/JALR)
+#define SIM_REG_LO 62            // LO half of MULT, quotient of DIV
+#define SIM_REG_HI 63            // HI half of MULT, remainder of DIV
+#define SIM_REG_SINK 64          // Writes to R0 are redirected here
+
+#define SIM_DEFAULT_MEM_WORDS 16384   // 14-bit data address space
+#define SIM_MAX_PROGRAM_WORDS 65536
+
+// Opcodes of the processor, same values as the table in binary_generator.c
+typedef enum {
+    SIM_OP_ADD = 0x00, SIM_OP_SUB, SIM_OP_MULT, SIM_OP_DIV,
+    SIM_OP_AND, SIM_OP_OR, SIM_OP_SLL, SIM_OP_SRL, SIM_OP_SLT,
+    SIM_OP_MFHI, SIM_OP_MFLO, SIM_OP_MOVE, SIM_OP_JR, SIM_OP_JALR,
+    SIM_OP_LA, SIM_OP_ADDI, SIM_OP_SUBI, SIM_OP_ANDI, SIM_OP_ORI,
+    SIM_OP_BEQ, SIM_OP_BNE, SIM_OP_BGT, SIM_OP_BGTE, SIM_OP_BLT, SIM_OP_BLTE,
+    SIM_OP_LW, SIM_OP_SW, SIM_OP_LI, SIM_OP_J, SIM_OP_JAL, SIM_OP_HALT,
+    SIM_OP_OUTPUTMEM, SIM_OP_OUTPUTREG, SIM_OP_OUTPUTRESET, SIM_OP_INPUT,
+    SIM_OP_SET, SIM_OP_SWI,
+    SIM_OP_COUNT
+} SimOpcode;
+
+// Predecoded instruction. 'op' indexes the handler table; it is either a
+// SimOpcode or one of the fused superinstructions private to simulator.c.
+typedef struct {
+    const void *handler;   // Threaded-code target (NULL without computed goto)
+    uint16_t op;
+    uint8_t rs, rt, rd;    // rd/rt already redirected to SIM_REG_SINK for R0
+    int32_t imm;           // Sign-extended immediate, shift amount or target
+} SimInsn;
+
+// Loaded program image
+typedef struct {
+    uint32_t *words;       // Raw 32-bit instruction words
+    SimInsn *code;         // Predecoded form, length + 1 entries (end sentinel)
+    uint32_t length;
+    int fused;             // Superinstructions formed by sim_predecode()
+    int writes_code;       // Contains SWI: the image changes while it runs
+    int32_t *data;         // Initial data memory (<name>.data.mif), NULL if none
+    uint32_t data_length;  // Words up to the last nonzero one
+} SimProgram;
+
+typedef enum {
+    SIM_RUNNING = 0,
+    SIM_HALTED,            // Executed HALT
+    SIM_TRAP_PC,           // Jumped or fell outside the program
+    SIM_TRAP_MEM,          // Data address outside memory (program, for SWI)
+    SIM_TRAP_INPUT,        // INPUT with no values left
+    SIM_TRAP_DIV_ZERO,     // DIV by zero
+    SIM_TRAP_OPCODE,       // Undefined opcode
+    SIM_STEP_LIMIT         // max_steps reached
+} SimStatus;
+
+// Architectural state plus the I/O channels of one simulated processor
+typedef struct {
+    int32_t regs[SIM_NUM_REGS + 1];
+    uint32_t pc;
+    int32_t *mem;
+    uint32_t mem_words;
+    size_t mem_mapped;     // Bytes mapped by sim_checkpoint_restore(), 0 if allocated
+
+    const int32_t *input;  // Values returned by INPUT, in order
+    uint32_t input_count;
+    uint32_t input_pos;
+
+    int32_t *output;       // Values written by OUTPUTREG/OUTPUTMEM
+    uint32_t output_count;
+    uint32_t output_capacity;
+
+    uint64_t icount;       // Instructions retired
+    uint64_t max_steps;    // 0 = unlimited
+    SimStatus status;
+} SimMachine;
+
+// Loads a program image. Returns 0 on success. By extension:
+//   .mif   Quartus memory initialization file (WIDTH=32, any radix)
+//   .raw   4 bytes per word, most significant byte first
+//   other  .bin or .binbd: one 32-character binary word per line, '#'
+//          comment lines and embedded spaces are ignored
+// The initial data memory of the program's global variables is read from
+// <name>.data.mif next to the image, when the compiler wrote one.
+int sim_load_program(SimProgram *prog, const char *filename);
+
+// Builds the predecoded code array; fuse != 0 enables superinstructions
+void sim_predecode(SimProgram *prog, int fuse);
+
+void sim_free_program(SimProgram *prog);
+
+// Copies the raw words of 'prog' (not the predecoded form), for runs of a
+// program that writes its own code. Returns 0 on success.
+int sim_copy_program(SimProgram *copy, const SimProgram *prog);
+
+// Unpacks one raw word into a SimInsn (no handler, no fusion)
+void sim_decode(uint32_t word, SimInsn *insn);
+
+// Reads whitespace-separated integers used as the INPUT stream
+int sim_read_input_file(const char *filename, int32_t **values, uint32_t *count);
+
+int sim_machine_init(SimMachine *m, uint32_t mem_words);
+
+// Copies the initial data memory of 'prog' into a freshly initialized or
+// reset machine
+void sim_machine_load_data(SimMachine *m, const SimProgram *prog);
+void sim_machine_reset(SimMachine *m);
+void sim_machine_free(SimMachine *m);
+
+// Fast path: threaded dispatch over the predecoded program
+SimStatus sim_run(SimMachine *m, const SimProgram *prog);
+
+// Reference path: decodes the raw word on every step
+SimStatus sim_step(SimMachine *m, const SimProgram *prog);
+SimStatus sim_run_reference(SimMachine *m, const SimProgram *prog);
+
+const char *sim_status_name(SimStatus status);
+const char *sim_opcode_name(int opcode);
+
+#endif /* SIMULATOR_H */
@@ -0,0 +1,328 @@
+/*
+ * trace_report.c - Memory-access trace analysis (acmc-trace)
+ *
+ * Reads a trace written by "acmc-sim --trace" and reports the data memory
+ * footprint, every run of touched words (arrays and stack frames show up
+ * as separate regions) with an access histogram, and the stride pattern
+ * of every LW/SW site. Function names come from the .asm listing and
+ * source lines from the .lines table next to the trace, when present.
+ *
+ * Usage: acmc-trace [--asm <file>] [--lines <file>] [--gap <words>] <trace>
+ */
+
+#include "sim_trace.h"
+#include "sim_lines.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_ADDRESS (1u << 24)
+#define SITE_STRIDES 3
+#define HISTOGRAM_ROWS 32
+#define BAR_WIDTH 40
+
+typedef struct {
+    uint64_t reads, writes;
+    uint32_t min, max;
+    uint32_t last;
+    int32_t strides[SITE_STRIDES];
+    uint64_t stride_counts[SITE_STRIDES];
+    uint64_t other_strides;
+} Site;
+
+typedef struct {
+    uint32_t start, end;       // Inclusive
+    uint64_t reads, writes;
+} Region;
+
+static uint64_t *word_reads = NULL, *word_writes = NULL;
+static uint32_t word_capacity = 0;
+static Site *sites = NULL;
+static uint32_t site_capacity = 0;
+
+// Function name per address from the "Func name:" blocks of the listing
+static char **function_of = NULL;
+static uint32_t function_length = 0;
+
+static int grow(void **array, uint32_t *capacity, uint32_t needed, size_t element) {
+    if (needed < *capacity) return 0;
+    if (needed >= MAX_ADDRESS) return -1;
+    uint32_t new_capacity = *capacity ? *capacity : 1024;
+    while (new_capacity <= needed) new_capacity *= 2;
+    void *grown = realloc(*array, (size_t)new_capacity * element);
+    if (!grown) return -1;
+    memset((char *)grown + (size_t)*capacity * element, 0, (size_t)(new_capacity - *capacity) * element);
+    *array = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+static int add_record(const SimTraceRecord *r) {
+    // The two word arrays grow together and share word_capacity
+    uint32_t words = word_capacity, site_words = site_capacity;
+    if (grow((void **)&word_reads, &words, r->address, sizeof(uint64_t)) != 0 ||
+        grow((void **)&word_writes, &word_capacity, r->address, sizeof(uint64_t)) != 0 ||
+        grow((void **)&sites, &site_words, r->pc, sizeof(Site)) != 0) return -1;
+    site_capacity = site_words;
+
+    if (r->write) word_writes[r->address]++; else word_reads[r->address]++;
+
+    Site *s = &sites[r->pc];
+    if (s->reads + s->writes == 0) {
+        s->min = s->max = r->address;
+    } else {
+        int32_t stride = (int32_t)(r->address - s->last);
+        int k;
+        for (k = 0; k < SITE_STRIDES && s->stride_counts[k]; k++) {
+            if (s->strides[k] == stride) break;
+        }
+        if (k < SITE_STRIDES) {
+            s->strides[k] = stride;
+            s->stride_counts[k]++;
+        } else {
+            s->other_strides++;
+        }
+        if (r->address < s->min) s->min = r->address;
+        if (r->address > s->max) s->max = r->address;
+    }
+    s->last = r->address;
+    if (r->write) s->writes++; else s->reads++;
+    return 0;
+}
+
+static void load_functions(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) return;
+    char line[512];
+    char *current = NULL;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "Func ", 5) == 0) {
+            char *colon = strchr(line + 5, ':');
+            if (colon) *colon = '\0';
+            current = strdup(line + 5);   // Kept for the whole run
+            continue;
+        }
+        char *end;
+        unsigned long address = strtoul(line, &end, 10);
+        if (end == line || *end != '-' || !current) continue;
+        if (grow((void **)&function_of, &function_length, (uint32_t)address, sizeof(char *)) != 0) break;
+        function_of[address] = current;
+    }
+    fclose(f);
+}
+
+static const char *function_name(uint32_t pc) {
+    return pc < function_length && function_of[pc] ? function_of[pc] : "?";
+}
+
+// <stem><extension> next to the trace, if that file exists
+static char *companion_file(const char *trace_file, const char *extension) {
+    const char *dot = strrchr(trace_file, '.');
+    size_t stem = dot && strchr(dot, '/') == NULL ? (size_t)(dot - trace_file) : strlen(trace_file);
+    char *path = malloc(stem + strlen(extension) + 1);
+    if (!path) return NULL;
+    memcpy(path, trace_file, stem);
+    strcpy(path + stem, extension);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        free(path);
+        return NULL;
+    }
+    fclose(f);
+    return path;
+}
+
+static void print_bar(uint64_t value, uint64_t max) {
+    int width = max ? (int)((value * BAR_WIDTH + max - 1) / max) : 0;
+    for (int i = 0; i < width; i++) putchar('#');
+    putchar('\n');
+}
+
+static void print_site_location(uint32_t pc, const SimLines *lines) {
+    printf("%-14s", function_name(pc));
+    if (lines && pc < lines->length && lines->source_line[pc]) {
+        printf(" line %-5u", lines->source_line[pc]);
+    } else {
+        printf(" %-10s", "");
+    }
+}
+
+// Dominant stride of a site, as text
+static void describe_strides(const Site *s, char *out, size_t size) {
+    uint64_t pairs = s->reads + s->writes - 1;
+    if (pairs == 0) {
+        snprintf(out, size, "single access");
+        return;
+    }
+    int best = 0;
+    for (int k = 1; k < SITE_STRIDES; k++) {
+        if (s->stride_counts[k] > s->stride_counts[best]) best = k;
+    }
+    double share = 100.0 * (double)s->stride_counts[best] / (double)pairs;
+    if (s->stride_counts[best] == pairs && s->strides[best] == 0) {
+        snprintf(out, size, "same word");
+    } else if (share >= 90.0) {
+        snprintf(out, size, "stride %+d (%.0f%%)", s->strides[best], share);
+    } else {
+        size_t used = snprintf(out, size, "mixed:");
+        for (int k = 0; k < SITE_STRIDES && s->stride_counts[k] && used < size; k++) {
+            used += snprintf(out + used, size - used, " %+d (%.0f%%)", s->strides[k],
+                             100.0 * (double)s->stride_counts[k] / (double)pairs);
+        }
+        if (s->other_strides && used < size) snprintf(out + used, size - used, " other");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *trace_file = NULL, *asm_file = NULL, *lines_file = NULL;
+    uint32_t gap = 16;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--asm") == 0 && i + 1 < argc) {
+            asm_file = argv[++i];
+        } else if (strcmp(argv[i], "--lines") == 0 && i + 1 < argc) {
+            lines_file = argv[++i];
+        } else if (strcmp(argv[i], "--gap") == 0 && i + 1 < argc) {
+            gap = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (!trace_file && argv[i][0] != '-') {
+            trace_file = argv[i];
+        } else {
+            trace_file = NULL;
+            break;
+        }
+    }
+    if (!trace_file) {
+        fprintf(stderr, "Usage: %s [--asm <file>] [--lines <file>] [--gap <words>] <trace>\n", argv[0]);
+        return 1;
+    }
+
+    SimTraceReader reader;
+    if (sim_trace_open(&reader, trace_file) != 0) return 1;
+    SimTraceRecord record;
+    uint64_t accesses = 0, reads = 0;
+    int status;
+    while ((status = sim_trace_next(&reader, &record)) > 0) {
+        if (add_record(&record) != 0) {
+            fprintf(stderr, "Error: Address %u or pc %u out of range\n", record.address, record.pc);
+            status = -2;
+            break;
+        }
+        accesses++;
+        if (!record.write) reads++;
+    }
+    sim_trace_close(&reader);
+    if (status == -2) return 1;
+    if (status < 0) fprintf(stderr, "Warning: %s is truncated, reporting the first %llu accesses\n",
+                            trace_file, (unsigned long long)accesses);
+
+    char *listing = asm_file ? NULL : companion_file(trace_file, ".asm");
+    if (asm_file || listing) load_functions(asm_file ? asm_file : listing);
+    free(listing);
+    SimLines lines;
+    char *table = lines_file ? NULL : companion_file(trace_file, ".lines");
+    int have_lines = (lines_file || table) && sim_lines_load(&lines, lines_file ? lines_file : table) == 0;
+    free(table);
+
+    // Footprint
+    uint32_t distinct = 0, lowest = 0, highest = 0;
+    for (uint32_t a = 0; a < word_capacity; a++) {
+        if (!word_reads[a] && !word_writes[a]) continue;
+        if (!distinct) lowest = a;
+        highest = a;
+        distinct++;
+    }
+    printf("Memory trace: %s\n", trace_file);
+    printf("Accesses: %llu (%llu LW, %llu SW)\n", (unsigned long long)accesses,
+           (unsigned long long)reads, (unsigned long long)(accesses - reads));
+    if (!distinct) return 0;
+    uint32_t rounded = 1;
+    while (rounded < highest + 1) rounded <<= 1;
+    printf("Distinct words: %u, addresses %u..%u\n", distinct, lowest, highest);
+    printf("Data memory needed: %u words (%u rounded to a power of two)\n\n", highest + 1, rounded);
+
+    // Regions: runs of touched words separated by more than 'gap' untouched ones
+    Region *regions = NULL;
+    int region_count = 0, region_capacity = 0;
+    for (uint32_t a = lowest; a <= highest; a++) {
+        if (!word_reads[a] && !word_writes[a]) continue;
+        if (region_count == 0 || a - regions[region_count - 1].end > gap + 1) {
+            if (region_count == region_capacity) {
+                region_capacity = region_capacity ? region_capacity * 2 : 16;
+                Region *grown = realloc(regions, region_capacity * sizeof(Region));
+                if (!grown) return 1;
+                regions = grown;
+            }
+            regions[region_count++] = (Region){ a, a, 0, 0 };
+        }
+        Region *r = &regions[region_count - 1];
+        r->end = a;
+        r->reads += word_reads[a];
+        r->writes += word_writes[a];
+    }
+
+    for (int i = 0; i < region_count; i++) {
+        Region *r = &regions[i];
+        uint32_t words = r->end - r->start + 1;
+        printf("Region %d: words %u..%u (%u words), %llu LW, %llu SW\n", i, r->start, r->end, words,
+               (unsigned long long)r->reads, (unsigned long long)r->writes);
+
+        // Sites whose accesses start inside this region
+        printf("  Accessed by:\n");
+        for (uint32_t pc = 0; pc < site_capacity; pc++) {
+            const Site *s = &sites[pc];
+            if (s->reads + s->writes == 0 || s->min < r->start || s->min > r->end) continue;
+            printf("    pc %-6u ", pc);
+            print_site_location(pc, have_lines ? &lines : NULL);
+            printf(" %s %llu\n", s->writes ? "SW" : "LW", (unsigned long long)(s->reads + s->writes));
+        }
+
+        uint32_t bucket = 1;
+        while ((words + bucket - 1) / bucket > HISTOGRAM_ROWS) bucket <<= 1;
+        uint64_t max = 0;
+        for (uint32_t b = r->start; b <= r->end; b += bucket) {
+            uint64_t sum = 0;
+            for (uint32_t a = b; a < b + bucket && a <= r->end; a++) sum += word_reads[a] + word_writes[a];
+            if (sum > max) max = sum;
+        }
+        printf("  %-13s %10s %10s\n", bucket == 1 ? "word" : "words", "LW", "SW");
+        for (uint32_t b = r->start; b <= r->end; b += bucket) {
+            uint64_t lw = 0, sw = 0;
+            uint32_t last = b + bucket - 1 <= r->end ? b + bucket - 1 : r->end;
+            for (uint32_t a = b; a <= last; a++) {
+                lw += word_reads[a];
+                sw += word_writes[a];
+            }
+            if (bucket == 1) {
+                printf("  %-13u", b);
+            } else {
+                char range[32];
+                snprintf(range, sizeof(range), "%u..%u", b, last);
+                printf("  %-13s", range);
+            }
+            printf(" %10llu %10llu  ", (unsigned long long)lw, (unsigned long long)sw);
+            print_bar(lw + sw, max);
+        }
+        printf("\n");
+    }
+
+    printf("Access sites\n");
+    printf("  %-6s %-14s %-10s %-5s %10s %-13s  %s\n", "pc", "function", "source", "kind",
+           "accesses", "addresses", "stride pattern");
+    for (uint32_t pc = 0; pc < site_capacity; pc++) {
+        const Site *s = &sites[pc];
+        if (s->reads + s->writes == 0) continue;
+        char span[32], pattern[128];
+        snprintf(span, sizeof(span), s->min == s->max ? "%u" : "%u..%u", s->min, s->max);
+        describe_strides(s, pattern, sizeof(pattern));
+        printf("  %-6u ", pc);
+        print_site_location(pc, have_lines ? &lines : NULL);
+        printf(" %-5s %10llu %-13s  %s\n", s->writes ? "SW" : "LW",
+               (unsigned long long)(s->reads + s->writes), span, pattern);
+    }
+
+    free(regions);
+    if (have_lines) sim_lines_free(&lines);
+    free(word_reads);
+    free(word_writes);
+    free(sites);
+    free(function_of);
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * upload.c - Streams a program to the resident bootloader (acmc-upload)
+ *
+ * Writes the values the loader of "acmc --bootloader" reads with INPUT
+ * (protocol in bootloader.h): the sync word, the number of words, the
+ * words of the .bin and the checksum, one decimal value per line. The
+ * values of an input file for the program itself may follow, so the same
+ * stream feeds acmc-sim or the serial bridge to the board's input port:
+ *
+ *     acmc-upload gcd.bin input.txt > /dev/ttyUSB0
+ *     acmc-upload -o gcd.stream gcd.bin input.txt
+ *     acmc-sim bootloader.bin gcd.stream
+ *
+ * The loader answers with the number of words (or -1) on the output before
+ * the program's own output. The stream carries no data memory, so a
+ * program with initialized globals (a <program>.data.mif next to it) is
+ * rejected.
+ *
+ * Usage: acmc-upload [-o <stream>] [-m <words>] <program.bin> [<input-file>]
+ */
+
+#include "bootloader.h"
+#include "data_image.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OPCODE_J 0x1C
+
+static uint32_t *words = NULL;
+static uint32_t word_count = 0;
+
+// Reads a .bin or .binbd: one 32-bit word per line, '#' lines skipped
+static int read_image(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "acmc-upload: cannot open %s\n", filename);
+        return -1;
+    }
+    uint32_t capacity = 0;
+    char line[512];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') continue;
+
+        uint32_t word = 0;
+        int bits = 0;
+        for (; *p && *p != '\n' && *p != '\r'; p++) {
+            if (*p == ' ' || *p == '\t') continue;
+            if (*p != '0' && *p != '1') break;
+            word = (word << 1) | (uint32_t)(*p - '0');
+            bits++;
+        }
+        if (bits != 32 || (*p && *p != '\n' && *p != '\r')) {
+            fprintf(stderr, "acmc-upload: %s:%d: expected a 32-bit binary word\n", filename, line_number);
+            fclose(f);
+            return -1;
+        }
+        if (word_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            uint32_t *grown = realloc(words, capacity * sizeof(uint32_t));
+            if (!grown) {
+                fclose(f);
+                return -1;
+            }
+            words = grown;
+        }
+        words[word_count++] = word;
+    }
+    fclose(f);
+    return 0;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: acmc-upload [-o <stream>] [-m <words>] <program.bin> [<input-file>]\n");
+    fprintf(stderr, "  -m <words>   instruction memory of the bootloader (default %d)\n", BOOTLOADER_DEFAULT_MEMORY);
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    int memory_words = BOOTLOADER_DEFAULT_MEMORY;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            output = argv[++arg];
+        } else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc) {
+            memory_words = atoi(argv[++arg]);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (argc - arg < 1 || argc - arg > 2) {
+        usage();
+        return 1;
+    }
+    const char *program = argv[arg];
+    const char *input = argc - arg == 2 ? argv[arg + 1] : NULL;
+
+    if (read_image(program) != 0) return 1;
+
+    // Initial values of globals would be lost: the loader only writes words
+    // to the instruction memory
+    char data_image[300];
+    snprintf(data_image, sizeof(data_image), "%s", program);
+    char *dot = strrchr(data_image, '.');
+    if (dot && strchr(dot, '/') == NULL) *dot = '\0';
+    strncat(data_image, DATA_IMAGE_SUFFIX, sizeof(data_image) - strlen(data_image) - 1);
+    FILE *data = fopen(data_image, "r");
+    if (data) {
+        fclose(data);
+        fprintf(stderr, "acmc-upload: %s has initialized globals (%s); the bootloader cannot load them\n",
+                program, data_image);
+        return 1;
+    }
+
+    // The loader keeps its own jump in word 0 and starts main from it
+    uint32_t loader = memory_words > BOOTLOADER_WORDS ? (uint32_t)(memory_words - BOOTLOADER_WORDS) : 0;
+    if (word_count == 0 || words[0] >> 26 != OPCODE_J || (words[0] & 0x3FFFFFF) >= word_count) {
+        fprintf(stderr, "acmc-upload: %s does not start with a jump to main\n", program);
+        return 1;
+    }
+    if (word_count > loader) {
+        fprintf(stderr, "acmc-upload: %s has %u words; the bootloader is at %u\n", program, word_count, loader);
+        return 1;
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "acmc-upload: cannot create %s\n", output);
+        return 1;
+    }
+
+    uint32_t s1 = 0, s2 = 0;
+    fprintf(out, "%d\n%u\n", BOOTLOADER_SYNC, word_count);
+    for (uint32_t i = 0; i < word_count; i++) {
+        s1 += words[i];
+        s2 += s1;
+        fprintf(out, "%d\n", (int32_t)words[i]);
+    }
+    fprintf(out, "%d\n", (int32_t)s2);
+
+    int failed = 0;
+    if (input) {
+        FILE *in = fopen(input, "r");
+        if (!in) {
+            fprintf(stderr, "acmc-upload: cannot open %s\n", input);
+            failed = 1;
+        } else {
+            long value;
+            while (fscanf(in, "%ld", &value) == 1) fprintf(out, "%ld\n", value);
+            fclose(in);
+        }
+    }
+
+    if (ferror(out)) {
+        fprintf(stderr, "acmc-upload: error writing the stream\n");
+        failed = 1;
+    }
+    if (out != stdout) fclose(out);
+    free(words);
+    return failed;
+}
@@ -10,12 +10,18 @@ void printToken(TokenType token, const char *tokenString) {
     case WHILE:
     case INT:
     case VOID:
+    case CONST:
       fprintf(listing, "reserved word: %s\n", tokenString);
       break;
     case MAIS: fprintf(listing, "+\n"); break;
     case SUB: fprintf(listing, "-\n"); break;
     case MULT: fprintf(listing, "*\n"); break;
     case DIV: fprintf(listing, "/\n"); break;
+    case MOD: fprintf(listing, "%%\n"); break;
+    case EBIT: fprintf(listing, "&\n"); break;
+    case OUBIT: fprintf(listing, "|\n"); break;
+    case DESLE: fprintf(listing, "<<\n"); break;
+    case DESLD: fprintf(listing, ">>\n"); break;
     case IGUAL: fprintf(listing, "=\n"); break;
     case IGDAD: fprintf(listing, "==\n"); break;
     case DIFER: fprintf(listing, "!=\n"); break;
@@ -0,0 +1,973 @@
+/*
+ * wcet.c - Worst-case execution time bound (see wcet.h)
+ */
+
+#include "wcet.h"
+#include "assembly.h"
+#include "line_table.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_PATH (-2LL)                  // No path of that kind
+#define MAX_INFERRED_ITERATIONS 10000000
+#define MAX_PREHEADER_BLOCKS 64         // Searched back for the initial value
+#define PIPELINE_FILL 4                 // Cycles until the first instruction leaves WB
+
+typedef enum { I_PLAIN, I_BRANCH, I_JUMP, I_CALL, I_RETURN, I_HALT, I_INDIRECT } InsnKind;
+
+typedef struct {
+    int address;
+    char mnemonic[16];
+    char ops[3][64];
+    InsnKind kind;
+    int target;                 // Instruction of a branch or jump, function of a call; -1 unresolved
+    int cycles;
+} WInsn;
+
+typedef struct {
+    char name[64];
+    int function;
+    int insn;                   // Instruction the label is on
+} WLabel;
+
+typedef struct {
+    int first, last;            // Instructions
+    int succ[2];                // Local block numbers
+    int succ_count;
+    int terminal;               // Ends in jr or halt
+    long long cost;             // Own cycles plus the calls, or WCET_UNBOUNDED
+} WBlock;
+
+typedef struct {
+    int header;
+    char *body;                 // Per local block
+    int size;
+    int *exits;                 // Blocks outside reached from the body
+    int exit_count;
+    int terminal;               // Returns from inside
+    long long bound;            // Iterations (back edges taken), -1 if unknown
+    const char *bound_source;
+    long long annotation;       // @bound on its line, or -1
+    long long iteration;        // Longest path from the header back to it
+    long long exit;             // Longest path from the header out of the loop
+    long long total;
+} WLoop;
+
+typedef struct {
+    char name[64];
+    int first_insn, end_insn;
+    int first_block, block_count;
+    int state;                  // 0 not analysed, 1 in progress, 2 done
+    long long bound;
+    char reason[160];
+    char *report;               // Loops and critical path
+    size_t report_size;
+} WFunction;
+
+typedef struct {
+    WInsn *insns;
+    int insn_count, insn_capacity;
+    WLabel *labels;
+    int label_count, label_capacity;
+    WFunction *functions;
+    int function_count, function_capacity;
+    WBlock *blocks;
+    int block_count, block_capacity;
+    long long *annotations;     // Per source line, -1 if none
+    int annotation_lines;
+} Analysis;
+
+// Longest paths of one region (a loop body or a whole function)
+typedef struct {
+    long long back, exit;
+    int exit_next;              // Node the exit path continues with, -1 if it ends
+    char state;                 // 0 not computed, 1 in progress, 2 done
+} PathMemo;
+
+// Per-function working state
+typedef struct {
+    WFunction *fn;
+    WBlock *blocks;             // fn's blocks, numbered from 0
+    int n;
+    int **preds;
+    int *pred_count;
+    int *rpo_number;            // -1 if unreachable
+    int *idom;
+    WLoop *loops;
+    int loop_count;
+    int *rep;                   // Analysed loop containing the block, or -1
+    PathMemo *memo;             // Per node: blocks 0..n-1, then loops
+    int irreducible;
+} FunctionAnalysis;
+
+static void *growArray(void *items, int *capacity, size_t size) {
+    int new_capacity = *capacity ? *capacity * 2 : 64;
+    void *grown = realloc(items, new_capacity * size);
+    if (grown) *capacity = new_capacity;
+    return grown;
+}
+
+static long long addCycles(long long a, long long b) {
+    if (a == WCET_UNBOUNDED || b == WCET_UNBOUNDED || a > LLONG_MAX / 4 || b > LLONG_MAX / 4) return WCET_UNBOUNDED;
+    return a + b;
+}
+
+static long long multiplyCycles(long long count, long long cycles) {
+    if (cycles == WCET_UNBOUNDED || (cycles > 0 && count > LLONG_MAX / 4 / cycles)) return WCET_UNBOUNDED;
+    return count * cycles;
+}
+
+// NO_PATH < any bound < WCET_UNBOUNDED
+static int longer(long long a, long long b) {
+    if (a == b) return 0;
+    if (a == WCET_UNBOUNDED) return 1;
+    if (b == WCET_UNBOUNDED) return 0;
+    return a > b;
+}
+
+static void setReason(WFunction *fn, const char *reason) {
+    if (!fn->reason[0]) snprintf(fn->reason, sizeof(fn->reason), "%s", reason);
+}
+
+// --- Reading the listing ---
+
+static int isBranch(const char *m) {
+    return strcmp(m, "beq") == 0 || strcmp(m, "bne") == 0 || strcmp(m, "bgt") == 0 ||
+           strcmp(m, "bgte") == 0 || strcmp(m, "blt") == 0 || strcmp(m, "blte") == 0;
+}
+
+static InsnKind insnKind(const char *m) {
+    if (isBranch(m)) return I_BRANCH;
+    if (strcmp(m, "j") == 0) return I_JUMP;
+    if (strcmp(m, "jal") == 0) return I_CALL;
+    if (strcmp(m, "jr") == 0) return I_RETURN;
+    if (strcmp(m, "halt") == 0) return I_HALT;
+    if (strcmp(m, "jalr") == 0) return I_INDIRECT;
+    return I_PLAIN;
+}
+
+static int findFunction(const Analysis *a, const char *name) {
+    for (int i = 0; i < a->function_count; i++) {
+        if (strcmp(a->functions[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int findLabel(const Analysis *a, int function, const char *name) {
+    for (int i = 0; i < a->label_count; i++) {
+        if (a->labels[i].function == function && strcmp(a->labels[i].name, name) == 0) return a->labels[i].insn;
+    }
+    return -1;
+}
+
+static int readListing(Analysis *a, const char *asm_filename) {
+    FILE *f = fopen(asm_filename, "r");
+    if (!f) {
+        printf("Error: Could not open %s\n", asm_filename);
+        return -1;
+    }
+
+    int current = -1;
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        size_t length = strlen(line);
+        if (strncmp(line, "Func ", 5) == 0) {
+            if (a->function_count == a->function_capacity) {
+                WFunction *grown = growArray(a->functions, &a->function_capacity, sizeof(WFunction));
+                if (!grown) break;
+                a->functions = grown;
+            }
+            current = a->function_count++;
+            WFunction *fn = &a->functions[current];
+            memset(fn, 0, sizeof(*fn));
+            size_t name_length = strcspn(line + 5, ":");
+            if (name_length >= sizeof(fn->name)) name_length = sizeof(fn->name) - 1;
+            memcpy(fn->name, line + 5, name_length);
+            fn->name[name_length] = '\0';
+            fn->first_insn = fn->end_insn = a->insn_count;
+            continue;
+        }
+        if (length > 1 && length < sizeof(a->labels[0].name) && line[length - 1] == ':' && current >= 0) {
+            if (a->label_count == a->label_capacity) {
+                WLabel *grown = growArray(a->labels, &a->label_capacity, sizeof(WLabel));
+                if (!grown) break;
+                a->labels = grown;
+            }
+            WLabel *l = &a->labels[a->label_count++];
+            line[length - 1] = '\0';
+            strcpy(l->name, line);
+            l->function = current;
+            l->insn = a->insn_count;
+            continue;
+        }
+
+        // "N-instruction"; the leading "j <main>" has no number
+        char *dash = strchr(line, '-');
+        if (current < 0 || !dash || dash == line || dash[1] == '#') continue;
+        if (a->insn_count == a->insn_capacity) {
+            WInsn *grown = growArray(a->insns, &a->insn_capacity, sizeof(WInsn));
+            if (!grown) break;
+            a->insns = grown;
+        }
+        WInsn *in = &a->insns[a->insn_count];
+        memset(in, 0, sizeof(*in));
+        in->address = atoi(line);
+        if (sscanf(dash + 1, "%15s %63s %63s %63s", in->mnemonic, in->ops[0], in->ops[1], in->ops[2]) < 1) continue;
+        in->kind = insnKind(in->mnemonic);
+        in->cycles = instructionCycles(in->mnemonic);
+        in->target = -1;
+        a->insn_count++;
+        a->functions[current].end_insn = a->insn_count;
+    }
+    fclose(f);
+
+    for (int fi = 0; fi < a->function_count; fi++) {
+        WFunction *fn = &a->functions[fi];
+        for (int i = fn->first_insn; i < fn->end_insn; i++) {
+            WInsn *in = &a->insns[i];
+            if (in->kind == I_BRANCH) in->target = findLabel(a, fi, in->ops[2]);
+            else if (in->kind == I_JUMP) in->target = findLabel(a, fi, in->ops[0]);
+            else if (in->kind == I_CALL) in->target = findFunction(a, in->ops[0]);
+        }
+    }
+    return 0;
+}
+
+// Comments with "@bound N", by source line
+static void readAnnotations(Analysis *a, const char *source_filename) {
+    FILE *f = fopen(source_filename, "r");
+    if (!f) return;
+    char line[1024];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        char *mark = strstr(line, "@bound");
+        if (!mark) continue;
+        long long bound = strtoll(mark + 6, NULL, 10);
+        if (line_number >= a->annotation_lines) {
+            int lines = a->annotation_lines ? a->annotation_lines : 64;
+            while (lines <= line_number) lines *= 2;
+            long long *grown = realloc(a->annotations, lines * sizeof(long long));
+            if (!grown) break;
+            for (int i = a->annotation_lines; i < lines; i++) grown[i] = -1;
+            a->annotations = grown;
+            a->annotation_lines = lines;
+        }
+        if (bound >= 0) a->annotations[line_number] = bound;
+    }
+    fclose(f);
+}
+
+static long long annotationAt(const Analysis *a, int line) {
+    return line > 0 && line < a->annotation_lines ? a->annotations[line] : -1;
+}
+
+// --- Control-flow graph ---
+
+static int blockOfInsn(const FunctionAnalysis *c, int insn) {
+    for (int b = 0; b < c->n; b++) {
+        if (insn >= c->blocks[b].first && insn <= c->blocks[b].last) return b;
+    }
+    return -1;
+}
+
+static int buildBlocks(Analysis *a, WFunction *fn) {
+    int count = fn->end_insn - fn->first_insn;
+    char *leader = calloc(count ? count : 1, 1);
+    if (!leader) return -1;
+    for (int i = fn->first_insn; i < fn->end_insn; i++) {
+        WInsn *in = &a->insns[i];
+        if (i == fn->first_insn) leader[0] = 1;
+        if ((in->kind == I_BRANCH || in->kind == I_JUMP) && in->target >= fn->first_insn && in->target < fn->end_insn) {
+            leader[in->target - fn->first_insn] = 1;
+        }
+        if (in->kind != I_PLAIN && in->kind != I_CALL && i + 1 < fn->end_insn) leader[i + 1 - fn->first_insn] = 1;
+    }
+
+    fn->first_block = a->block_count;
+    for (int i = 0; i < count; i++) {
+        if (!leader[i]) continue;
+        if (a->block_count == a->block_capacity) {
+            WBlock *grown = growArray(a->blocks, &a->block_capacity, sizeof(WBlock));
+            if (!grown) {
+                free(leader);
+                return -1;
+            }
+            a->blocks = grown;
+        }
+        WBlock *b = &a->blocks[a->block_count++];
+        memset(b, 0, sizeof(*b));
+        b->first = fn->first_insn + i;
+        b->last = b->first;
+        while (b->last + 1 < fn->end_insn && !leader[b->last + 1 - fn->first_insn]) b->last++;
+    }
+    fn->block_count = a->block_count - fn->first_block;
+    free(leader);
+    return 0;
+}
+
+// Successors and costs; analyses the functions called first
+static void analyzeFunction(Analysis *a, int function);
+
+static void linkBlocks(Analysis *a, FunctionAnalysis *c) {
+    WFunction *fn = c->fn;
+    char reason[160];
+
+    // The callees add their blocks to a->blocks, which may move
+    for (int i = fn->first_insn; i < fn->end_insn; i++) {
+        int callee = a->insns[i].kind == I_CALL ? a->insns[i].target : -1;
+        if (callee >= 0 && a->functions[callee].state == 0) analyzeFunction(a, callee);
+    }
+    c->blocks = &a->blocks[fn->first_block];
+
+    for (int bi = 0; bi < c->n; bi++) {
+        WBlock *b = &c->blocks[bi];
+        WInsn *last = &a->insns[b->last];
+        int next = b->last + 1 < fn->end_insn ? bi + 1 : -1;
+        int target = last->target >= fn->first_insn && last->target < fn->end_insn ? blockOfInsn(c, last->target) : -1;
+
+        b->cost = 0;
+        for (int i = b->first; i <= b->last; i++) {
+            WInsn *in = &a->insns[i];
+            b->cost = addCycles(b->cost, in->cycles);
+            if (in->kind == I_CALL) {
+                int callee = in->target;
+                if (callee < 0) {
+                    snprintf(reason, sizeof(reason), "call to unknown %s at %d", in->ops[0], in->address);
+                } else {
+                    if (a->functions[callee].state == 1) {
+                        snprintf(reason, sizeof(reason), "recursive call to %s at %d", in->ops[0], in->address);
+                    } else if (a->functions[callee].bound == WCET_UNBOUNDED) {
+                        snprintf(reason, sizeof(reason), "calls %s, which has no bound", in->ops[0]);
+                    } else {
+                        b->cost = addCycles(b->cost, a->functions[callee].bound);
+                        continue;
+                    }
+                }
+                b->cost = WCET_UNBOUNDED;
+                setReason(fn, reason);
+            } else if (in->kind == I_INDIRECT) {
+                snprintf(reason, sizeof(reason), "indirect call at %d", in->address);
+                b->cost = WCET_UNBOUNDED;
+                setReason(fn, reason);
+            }
+        }
+
+        if ((last->kind == I_BRANCH || last->kind == I_JUMP) && target < 0) {
+            snprintf(reason, sizeof(reason), "jump to %s at %d leaves the function",
+                     last->kind == I_BRANCH ? last->ops[2] : last->ops[0], last->address);
+            b->cost = WCET_UNBOUNDED;
+            setReason(fn, reason);
+        }
+        if (last->kind == I_BRANCH) {
+            if (next >= 0) b->succ[b->succ_count++] = next;
+            if (target >= 0 && target != next) b->succ[b->succ_count++] = target;
+        } else if (last->kind == I_JUMP) {
+            if (target >= 0) b->succ[b->succ_count++] = target;
+        } else if (last->kind == I_RETURN || last->kind == I_HALT) {
+            b->terminal = 1;
+        } else if (next >= 0) {
+            b->succ[b->succ_count++] = next;
+        } else {
+            b->terminal = 1;    // Falls off the end of the function
+        }
+    }
+}
+
+static int numberBlocks(FunctionAnalysis *c, int b, int *order, int *visited, int count) {
+    visited[b] = 1;
+    for (int s = 0; s < c->blocks[b].succ_count; s++) {
+        int succ = c->blocks[b].succ[s];
+        if (!visited[succ]) count = numberBlocks(c, succ, order, visited, count);
+    }
+    order[count] = b;   // Postorder; reversed by the caller
+    return count + 1;
+}
+
+static int intersect(const FunctionAnalysis *c, int b1, int b2) {
+    while (b1 != b2) {
+        while (c->rpo_number[b1] > c->rpo_number[b2]) b1 = c->idom[b1];
+        while (c->rpo_number[b2] > c->rpo_number[b1]) b2 = c->idom[b2];
+    }
+    return b1;
+}
+
+// Iterative dominators (Cooper, Harvey and Kennedy)
+static void computeDominators(FunctionAnalysis *c, int *order, int reachable) {
+    for (int b = 0; b < c->n; b++) {
+        c->rpo_number[b] = -1;
+        c->idom[b] = -1;
+    }
+    for (int i = 0; i < reachable; i++) c->rpo_number[order[reachable - 1 - i]] = i;
+    c->idom[0] = 0;
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 1; i < reachable; i++) {
+            int b = order[reachable - 1 - i];
+            int new_idom = -1;
+            for (int p = 0; p < c->pred_count[b]; p++) {
+                int pred = c->preds[b][p];
+                if (c->idom[pred] < 0) continue;
+                new_idom = new_idom < 0 ? pred : intersect(c, pred, new_idom);
+            }
+            if (new_idom >= 0 && c->idom[b] != new_idom) {
+                c->idom[b] = new_idom;
+                changed = 1;
+            }
+        }
+    }
+}
+
+static int dominates(const FunctionAnalysis *c, int d, int b) {
+    while (1) {
+        if (b == d) return 1;
+        if (b == 0 || c->idom[b] < 0) return 0;
+        b = c->idom[b];
+    }
+}
+
+static WLoop *loopWithHeader(FunctionAnalysis *c, int header) {
+    for (int i = 0; i < c->loop_count; i++) {
+        if (c->loops[i].header == header) return &c->loops[i];
+    }
+    WLoop *loop = &c->loops[c->loop_count++];
+    memset(loop, 0, sizeof(*loop));
+    loop->header = header;
+    loop->body = calloc(c->n, 1);
+    loop->body[header] = 1;
+    loop->size = 1;
+    loop->bound = -1;
+    return loop;
+}
+
+// Natural loops of the back edges, innermost first
+static void findLoops(FunctionAnalysis *c) {
+    int *stack = malloc(c->n * sizeof(int));
+    for (int u = 0; u < c->n; u++) {
+        if (c->rpo_number[u] < 0) continue;
+        for (int s = 0; s < c->blocks[u].succ_count; s++) {
+            int h = c->blocks[u].succ[s];
+            if (!dominates(c, h, u)) continue;
+            WLoop *loop = loopWithHeader(c, h);
+            int top = 0;
+            if (!loop->body[u]) {
+                loop->body[u] = 1;
+                loop->size++;
+                stack[top++] = u;
+            }
+            while (top > 0) {
+                int b = stack[--top];
+                for (int p = 0; p < c->pred_count[b]; p++) {
+                    int pred = c->preds[b][p];
+                    if (c->rpo_number[pred] < 0 || loop->body[pred]) continue;
+                    loop->body[pred] = 1;
+                    loop->size++;
+                    stack[top++] = pred;
+                }
+            }
+        }
+    }
+    free(stack);
+
+    for (int i = 1; i < c->loop_count; i++) {
+        WLoop loop = c->loops[i];
+        int j = i;
+        for (; j > 0 && c->loops[j - 1].size > loop.size; j--) c->loops[j] = c->loops[j - 1];
+        c->loops[j] = loop;
+    }
+    for (int i = 0; i < c->loop_count; i++) {
+        WLoop *loop = &c->loops[i];
+        loop->exits = malloc((2 * loop->size) * sizeof(int));
+        for (int b = 0; b < c->n; b++) {
+            if (!loop->body[b]) continue;
+            if (c->blocks[b].terminal) loop->terminal = 1;
+            for (int s = 0; s < c->blocks[b].succ_count; s++) {
+                int succ = c->blocks[b].succ[s];
+                if (!loop->body[succ]) loop->exits[loop->exit_count++] = succ;
+            }
+        }
+    }
+}
+
+// --- Longest paths ---
+
+static int nodeOf(const FunctionAnalysis *c, int block) {
+    return c->rep[block] < 0 ? block : c->n + c->rep[block];
+}
+
+// Longest path from 'node' back to 'header' and out of 'region' (or to
+// jr/halt); region NULL is the whole function
+static void longestPaths(FunctionAnalysis *c, int node, const char *region, int header) {
+    PathMemo *m = &c->memo[node];
+    m->state = 1;
+
+    const int *succ;
+    int succ_count, terminal;
+    long long cost;
+    if (node < c->n) {
+        succ = c->blocks[node].succ;
+        succ_count = c->blocks[node].succ_count;
+        terminal = c->blocks[node].terminal;
+        cost = c->blocks[node].cost;
+    } else {
+        WLoop *loop = &c->loops[node - c->n];
+        succ = loop->exits;
+        succ_count = loop->exit_count;
+        terminal = loop->terminal;
+        cost = loop->total;
+    }
+
+    long long back = NO_PATH, exit = terminal ? 0 : NO_PATH;
+    int exit_next = -1;
+    for (int s = 0; s < succ_count; s++) {
+        int block = succ[s];
+        if (region && !region[block]) {
+            if (longer(0, exit)) exit = 0;
+            continue;
+        }
+        if (block == header) {
+            if (longer(0, back)) back = 0;
+            continue;
+        }
+        int next = nodeOf(c, block);
+        if (c->memo[next].state == 1) {
+            c->irreducible = 1;
+            continue;
+        }
+        if (c->memo[next].state == 0) longestPaths(c, next, region, header);
+        if (longer(c->memo[next].back, back)) back = c->memo[next].back;
+        if (longer(c->memo[next].exit, exit)) {
+            exit = c->memo[next].exit;
+            exit_next = next;
+        }
+    }
+    m->back = back == NO_PATH ? NO_PATH : addCycles(cost, back);
+    m->exit = exit == NO_PATH ? NO_PATH : addCycles(cost, exit);
+    m->exit_next = exit_next;
+    m->state = 2;
+}
+
+static void resetMemo(FunctionAnalysis *c) {
+    memset(c->memo, 0, (c->n + c->loop_count) * sizeof(PathMemo));
+}
+
+// --- Loop bounds ---
+
+typedef enum { E_UNKNOWN, E_CONST, E_SLOT } ExprKind;
+
+typedef struct {
+    ExprKind kind;
+    int slot;                   // Stack slot (offset from r30) for E_SLOT
+    long long value;            // Constant, or added to the slot
+} Expr;
+
+static int writesRegister(const WInsn *in) {
+    static const char *const no_destination[] = {
+        "sw", "mult", "div", "outputreg", "outputmem", "outputreset", NULL
+    };
+    if (in->kind != I_PLAIN || in->ops[0][0] != 'r') return 0;
+    for (int i = 0; no_destination[i]; i++) {
+        if (strcmp(in->mnemonic, no_destination[i]) == 0) return 0;
+    }
+    return 1;
+}
+
+// Value of 'reg' just before instruction 'insn', looking back to 'first'
+static Expr registerValue(const Analysis *a, int insn, int first, const char *reg) {
+    Expr e = { E_UNKNOWN, 0, 0 };
+    if (strcmp(reg, "r0") == 0) {
+        e.kind = E_CONST;
+        return e;
+    }
+    for (int i = insn - 1; i >= first; i--) {
+        const WInsn *in = &a->insns[i];
+        if (in->kind == I_CALL || in->kind == I_INDIRECT) return e;   // The callee clobbers registers
+        if (!writesRegister(in) || strcmp(in->ops[0], reg) != 0) continue;
+        if (strcmp(in->mnemonic, "lw") == 0 && strcmp(in->ops[1], "r30") == 0) {
+            e.kind = E_SLOT;
+            e.slot = atoi(in->ops[2]);
+        } else if (strcmp(in->mnemonic, "addi") == 0 || strcmp(in->mnemonic, "subi") == 0) {
+            e = registerValue(a, i, first, in->ops[1]);
+            long long k = atoll(in->ops[2]);
+            if (e.kind != E_UNKNOWN) e.value += in->mnemonic[0] == 'a' ? k : -k;
+        } else if (strcmp(in->mnemonic, "li") == 0) {
+            e.kind = E_CONST;
+            e.value = atoll(in->ops[1]);
+        } else if (strcmp(in->mnemonic, "move") == 0) {
+            e = registerValue(a, i, first, in->ops[1]);
+        }
+        return e;
+    }
+    return e;
+}
+
+static int isSlotStore(const WInsn *in, int slot) {
+    return strcmp(in->mnemonic, "sw") == 0 && strcmp(in->ops[1], "r30") == 0 && atoi(in->ops[2]) == slot;
+}
+
+// Constant last stored to 'slot' before instruction 'insn' of 'block',
+// following single predecessors; returns 0 if found
+static int slotValueBefore(const Analysis *a, const FunctionAnalysis *c, int block, int insn, int slot,
+                           int depth, long long *value) {
+    for (int steps = 0; steps < MAX_PREHEADER_BLOCKS; steps++) {
+        int first = c->blocks[block].first;
+        for (int i = insn - 1; i >= first; i--) {
+            if (!isSlotStore(&a->insns[i], slot)) continue;
+            Expr e = registerValue(a, i, first, a->insns[i].ops[0]);
+            if (e.kind == E_CONST) {
+                *value = e.value;
+                return 0;
+            }
+            long long base;
+            if (e.kind == E_SLOT && depth < 4 && slotValueBefore(a, c, block, i, e.slot, depth + 1, &base) == 0) {
+                *value = base + e.value;
+                return 0;
+            }
+            return -1;
+        }
+        if (c->pred_count[block] != 1) return -1;
+        block = c->preds[block][0];
+        insn = c->blocks[block].last + 1;
+    }
+    return -1;
+}
+
+static int continues(const char *branch, int32_t x, int32_t y) {
+    if (strcmp(branch, "beq") == 0) return x == y;
+    if (strcmp(branch, "bne") == 0) return x != y;
+    if (strcmp(branch, "bgt") == 0) return x > y;
+    if (strcmp(branch, "bgte") == 0) return x >= y;
+    if (strcmp(branch, "blt") == 0) return x < y;
+    return x <= y;
+}
+
+// Iterations of a loop whose header ends in the exit test "v op limit",
+// where v is a stack variable stored once per iteration as v + step
+static long long inferBound(const Analysis *a, const FunctionAnalysis *c, const WLoop *loop, char *variable,
+                            size_t variable_size) {
+    const WBlock *header = &c->blocks[loop->header];
+    const WInsn *test = &a->insns[header->last];
+    if (test->kind != I_BRANCH || header->succ_count != 2) return -1;
+    int target = blockOfInsn(c, test->target);
+    int taken_exits = !loop->body[target];
+    int fall_exits = !loop->body[loop->header + 1 < c->n ? loop->header + 1 : 0];
+    if (taken_exits == fall_exits) return -1;
+
+    Expr operand[2];
+    operand[0] = registerValue(a, header->last, header->first, test->ops[0]);
+    operand[1] = registerValue(a, header->last, header->first, test->ops[1]);
+
+    // Stores to the variables of the test inside the loop
+    int induction = -1;
+    long long step = 0;
+    for (int o = 0; o < 2; o++) {
+        if (operand[o].kind != E_SLOT) continue;
+        int stores = 0, store_block = -1;
+        Expr stored = { E_UNKNOWN, 0, 0 };
+        for (int b = 0; b < c->n; b++) {
+            if (!loop->body[b]) continue;
+            for (int i = c->blocks[b].first; i <= c->blocks[b].last; i++) {
+                if (!isSlotStore(&a->insns[i], operand[o].slot)) continue;
+                stores++;
+                store_block = b;
+                stored = registerValue(a, i, c->blocks[b].first, a->insns[i].ops[0]);
+            }
+        }
+        if (stores == 0) continue;
+        if (induction >= 0 || stores != 1 || stored.kind != E_SLOT || stored.slot != operand[o].slot ||
+            stored.value == 0 || c->rep[store_block] >= 0) {
+            return -1;
+        }
+        // Once in every iteration: the store dominates the back edges
+        for (int b = 0; b < c->n; b++) {
+            if (!loop->body[b]) continue;
+            for (int s = 0; s < c->blocks[b].succ_count; s++) {
+                if (c->blocks[b].succ[s] == loop->header && !dominates(c, store_block, b)) return -1;
+            }
+        }
+        induction = o;
+        step = stored.value;
+    }
+    if (induction < 0) return -1;
+
+    // Start values, from the single entry into the header
+    int entry = -1;
+    for (int p = 0; p < c->pred_count[loop->header]; p++) {
+        int pred = c->preds[loop->header][p];
+        if (loop->body[pred]) continue;
+        if (entry >= 0) return -1;
+        entry = pred;
+    }
+    if (entry < 0) return -1;
+    long long start[2];
+    for (int o = 0; o < 2; o++) {
+        if (operand[o].kind == E_CONST) {
+            start[o] = operand[o].value;
+        } else if (operand[o].kind != E_SLOT ||
+                   slotValueBefore(a, c, entry, c->blocks[entry].last + 1, operand[o].slot, 0, &start[o]) != 0) {
+            return -1;
+        } else {
+            start[o] += operand[o].value;
+        }
+    }
+
+    int32_t v = (int32_t)start[induction];
+    int32_t limit = (int32_t)start[1 - induction];
+    long long iterations = 0;
+    while (1) {
+        int holds = induction == 0 ? continues(test->mnemonic, v, limit) : continues(test->mnemonic, limit, v);
+        if (holds == taken_exits) break;
+        if (++iterations > MAX_INFERRED_ITERATIONS) return -1;
+        v = (int32_t)((uint32_t)v + (uint32_t)step);
+    }
+    snprintf(variable, variable_size, "slot %d", operand[induction].slot);
+    return iterations;
+}
+
+// --- Report ---
+
+static void blockLines(const Analysis *a, const WBlock *b, int *low, int *high) {
+    *low = *high = 0;
+    for (int i = b->first; i <= b->last; i++) {
+        int line = lineTableAddressSourceLine(a->insns[i].address);
+        if (line <= 0) continue;
+        if (!*low || line < *low) *low = line;
+        if (line > *high) *high = line;
+    }
+}
+
+static int loopLine(const Analysis *a, const FunctionAnalysis *c, const WLoop *loop) {
+    int low, high;
+    blockLines(a, &c->blocks[loop->header], &low, &high);
+    return high;
+}
+
+static const char *loopName(const Analysis *a, const FunctionAnalysis *c, const WLoop *loop) {
+    int insn = c->blocks[loop->header].first;
+    for (int i = 0; i < a->label_count; i++) {
+        if (a->labels[i].insn == insn && &a->functions[a->labels[i].function] == c->fn) return a->labels[i].name;
+    }
+    return "loop";
+}
+
+static void writeCycles(FILE *out, long long cycles) {
+    if (cycles == WCET_UNBOUNDED) fprintf(out, "unbounded");
+    else fprintf(out, "%lld", cycles);
+}
+
+static void writeFunctionReport(const Analysis *a, FunctionAnalysis *c, FILE *out) {
+    for (int i = 0; i < c->loop_count; i++) {
+        const WLoop *loop = &c->loops[i];
+        fprintf(out, "  loop %s (line %d): ", loopName(a, c, loop), loopLine(a, c, loop));
+        if (loop->bound < 0) {
+            fprintf(out, "no bound\n");
+            continue;
+        }
+        fprintf(out, "%lld iterations (%s), ", loop->bound, loop->bound_source);
+        writeCycles(out, loop->iteration);
+        fprintf(out, " cycles per iteration + ");
+        writeCycles(out, loop->exit);
+        fprintf(out, " to leave = ");
+        writeCycles(out, loop->total);
+        fprintf(out, "\n");
+    }
+
+    if (c->fn->bound == WCET_UNBOUNDED) return;
+    fprintf(out, "  critical path:\n");
+    for (int node = nodeOf(c, 0); node >= 0; node = c->memo[node].exit_next) {
+        if (node >= c->n) {
+            const WLoop *loop = &c->loops[node - c->n];
+            fprintf(out, "    loop %-16s line %-9d %10lld\n", loopName(a, c, loop), loopLine(a, c, loop), loop->total);
+            continue;
+        }
+        const WBlock *b = &c->blocks[node];
+        int low, high;
+        blockLines(a, b, &low, &high);
+        char range[32], lines[32];
+        snprintf(range, sizeof(range), "%d-%d", a->insns[b->first].address, a->insns[b->last].address);
+        if (low == high) snprintf(lines, sizeof(lines), "line %d", low);
+        else snprintf(lines, sizeof(lines), "lines %d-%d", low, high);
+        fprintf(out, "    %-21s %-14s %10lld", range, low ? lines : "", b->cost);
+        for (int i = b->first; i <= b->last; i++) {
+            if (a->insns[i].kind == I_CALL) fprintf(out, "  calls %s", a->insns[i].ops[0]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+// --- Analysis ---
+
+static void freeFunctionAnalysis(FunctionAnalysis *c) {
+    for (int b = 0; b < c->n; b++) free(c->preds[b]);
+    for (int i = 0; i < c->loop_count; i++) {
+        free(c->loops[i].body);
+        free(c->loops[i].exits);
+    }
+    free(c->preds);
+    free(c->pred_count);
+    free(c->rpo_number);
+    free(c->idom);
+    free(c->loops);
+    free(c->rep);
+    free(c->memo);
+}
+
+static void analyzeFunction(Analysis *a, int function) {
+    WFunction *fn = &a->functions[function];
+    fn->state = 1;
+    fn->bound = WCET_UNBOUNDED;
+    if (fn->end_insn == fn->first_insn || buildBlocks(a, fn) != 0) {
+        setReason(fn, "no instructions");
+        fn->state = 2;
+        return;
+    }
+
+    FunctionAnalysis c;
+    memset(&c, 0, sizeof(c));
+    c.fn = fn;
+    c.n = fn->block_count;
+    linkBlocks(a, &c);
+
+    int n = c.n;
+    c.preds = calloc(n, sizeof(int *));
+    c.pred_count = calloc(n, sizeof(int));
+    c.rpo_number = malloc(n * sizeof(int));
+    c.idom = malloc(n * sizeof(int));
+    c.loops = calloc(n, sizeof(WLoop));
+    c.rep = malloc(n * sizeof(int));
+    c.memo = calloc(2 * n, sizeof(PathMemo));
+    int *order = malloc(n * sizeof(int));
+    int *visited = calloc(n, sizeof(int));
+    if (!c.preds || !c.pred_count || !c.rpo_number || !c.idom || !c.loops || !c.rep || !c.memo || !order || !visited) {
+        setReason(fn, "out of memory");
+        free(order);
+        free(visited);
+        freeFunctionAnalysis(&c);
+        fn->state = 2;
+        return;
+    }
+
+    for (int b = 0; b < n; b++) {
+        c.rep[b] = -1;
+        c.preds[b] = malloc(n * sizeof(int));
+    }
+    for (int b = 0; b < n; b++) {
+        for (int s = 0; s < c.blocks[b].succ_count; s++) {
+            int succ = c.blocks[b].succ[s];
+            c.preds[succ][c.pred_count[succ]++] = b;
+        }
+    }
+    int reachable = numberBlocks(&c, 0, order, visited, 0);
+    computeDominators(&c, order, reachable);
+    findLoops(&c);
+    free(order);
+    free(visited);
+
+    char reason[160];
+    for (int i = 0; i < c.loop_count; i++) {
+        WLoop *loop = &c.loops[i];
+        int line = loopLine(a, &c, loop);
+        char variable[32];
+        long long annotation = annotationAt(a, line) >= 0 ? annotationAt(a, line) : annotationAt(a, line - 1);
+        loop->bound = inferBound(a, &c, loop, variable, sizeof(variable));
+        loop->bound_source = "induction variable";
+        if (loop->bound < 0 && annotation >= 0) {
+            loop->bound = annotation;
+            loop->bound_source = "@bound";
+        }
+
+        resetMemo(&c);
+        longestPaths(&c, loop->header, loop->body, loop->header);
+        loop->iteration = c.memo[loop->header].back;
+        loop->exit = c.memo[loop->header].exit;
+        if (loop->bound < 0) {
+            snprintf(reason, sizeof(reason), "loop %s at line %d has no bound (add a @bound comment)",
+                     loopName(a, &c, loop), line);
+            setReason(fn, reason);
+            loop->total = WCET_UNBOUNDED;
+        } else if (loop->exit == NO_PATH) {
+            snprintf(reason, sizeof(reason), "loop %s at line %d never exits", loopName(a, &c, loop), line);
+            setReason(fn, reason);
+            loop->total = WCET_UNBOUNDED;
+        } else {
+            loop->total = addCycles(multiplyCycles(loop->bound, loop->iteration), loop->exit);
+        }
+        for (int b = 0; b < n; b++) {
+            if (loop->body[b]) c.rep[b] = i;
+        }
+    }
+
+    resetMemo(&c);
+    longestPaths(&c, nodeOf(&c, 0), NULL, -1);
+    fn->bound = c.memo[nodeOf(&c, 0)].exit;
+    if (c.irreducible) {
+        setReason(fn, "irreducible control flow");
+        fn->bound = WCET_UNBOUNDED;
+    } else if (fn->bound == NO_PATH) {
+        setReason(fn, "never returns");
+        fn->bound = WCET_UNBOUNDED;
+    }
+
+    FILE *report = open_memstream(&fn->report, &fn->report_size);
+    if (report) {
+        writeFunctionReport(a, &c, report);
+        fclose(report);
+    }
+    freeFunctionAnalysis(&c);
+    fn->state = 2;
+}
+
+int wcetAnalyze(const char *asm_filename, const char *source_filename, const char *report_filename,
+                long long *program_bound) {
+    Analysis a;
+    memset(&a, 0, sizeof(a));
+    *program_bound = WCET_UNBOUNDED;
+    if (readListing(&a, asm_filename) != 0) return -1;
+    readAnnotations(&a, source_filename);
+
+    for (int f = 0; f < a.function_count; f++) {
+        if (a.functions[f].state == 0) analyzeFunction(&a, f);
+    }
+    int main_function = findFunction(&a, "main");
+    if (main_function >= 0 && a.functions[main_function].bound != WCET_UNBOUNDED) {
+        *program_bound = addCycles(a.functions[main_function].bound, instructionCycles("j") + PIPELINE_FILL);
+    }
+
+    int failed = 0;
+    FILE *out = fopen(report_filename, "w");
+    if (!out) {
+        printf("Error: Could not create %s\n", report_filename);
+        failed = 1;
+    } else {
+        const char *base = strrchr(source_filename, '/');
+        fprintf(out, "# acmc WCET bounds for %s\n", base ? base + 1 : source_filename);
+        fprintf(out, "# Worst-case cycles of the opcode table, no memory stalls; the program\n");
+        fprintf(out, "# adds the jump to main and %d cycles of pipeline fill to main\n", PIPELINE_FILL);
+        fprintf(out, "program: ");
+        writeCycles(out, *program_bound);
+        fprintf(out, " cycles\n");
+        for (int f = 0; f < a.function_count; f++) {
+            const WFunction *fn = &a.functions[f];
+            fprintf(out, "\nfunction %s: ", fn->name);
+            writeCycles(out, fn->bound);
+            fprintf(out, fn->bound == WCET_UNBOUNDED ? " (%s)\n" : " cycles\n", fn->reason);
+            if (fn->report) fputs(fn->report, out);
+        }
+        failed = ferror(out);
+        fclose(out);
+    }
+
+    for (int f = 0; f < a.function_count; f++) free(a.functions[f].report);
+    free(a.functions);
+    free(a.insns);
+    free(a.labels);
+    free(a.blocks);
+    free(a.annotations);
+    return failed ? -1 : 0;
+}
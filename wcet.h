@@ -0,0 +1,39 @@
+#ifndef WCET_H
+#define WCET_H
+
+/**
+ * wcet.h - Static worst-case execution time bound of the generated code
+ *
+ * Works on the control-flow graph of the .asm written by assembly.c:
+ *
+ *   - every basic block costs the sum of the worst-case cycles of its
+ *     instructions (instructionCycles(), the opcode table of assembly.c),
+ *     plus the bound of each function it calls with jal
+ *   - loops are the natural loops of the dominator tree. A loop costs
+ *     bound * (longest path from the header back to it) + (longest path
+ *     from the header out of it), inner loops first
+ *   - the bound is inferred when the exit test in the header compares a
+ *     stack variable stored once in the loop as "v = v + step" with a
+ *     constant, or with a variable the loop does not store, and both
+ *     start from constants; otherwise it comes from a comment with
+ *     "@bound N" on the line of the while or on the line above it
+ *   - a function costs its longest path from the entry to jr/halt
+ *
+ * Recursion, jalr, loops without a bound and irreducible control flow
+ * make a bound unknown (WCET_UNBOUNDED), with the reason in the report.
+ * The model has no memory stalls; the program bound covers the cycles
+ * of acmc-sim --pipeline with forwarding and without --cache.
+ */
+
+#define WCET_UNBOUNDED (-1LL)
+
+// Analyses 'asm_filename' (source lines come from the line table of the
+// same compilation, annotations from 'source_filename') and writes the
+// bound of every function, its loops and its critical path to
+// 'report_filename'. *program_bound gets the bound of the whole program
+// (jump to main, main and pipeline fill) or WCET_UNBOUNDED. Returns 0 on
+// success.
+int wcetAnalyze(const char *asm_filename, const char *source_filename, const char *report_filename,
+                long long *program_bound);
+
+#endif /* WCET_H */